@@ -21,6 +21,8 @@
 #define STUPA_HANDLER_H_
 
 #include <cstring>
+#include <sstream>
+#include <string>
 #include "thread.h"
 #include "stupa.h"
 
@@ -30,27 +32,47 @@ class StupaSearchHandler {
  private:
   StupaSearch stpsearch_; ///<  stupa search
   ReadWriteLock lock_;
+  Metrics metrics_;       ///< runtime metrics
+  SlowQueryLog slow_log_; ///< log of slow and sampled queries
+
+  /**
+   * Record wait time to acquire a lock.
+   * @param write write lock if true
+   * @param start time before acquiring the lock (nsec)
+   */
+  void record_lock_wait(bool write, uint64_t start) {
+    metrics_.record_lock_wait(write ? Metrics::WRITE_LOCK : Metrics::READ_LOCK,
+                              get_time_nsec() - start);
+  }
 
  public:
   /**
    * Constructor.
    * @param invsize maximum size of inverted indexes
    * @param max_doc maximum number of documents
+   * @param retention retention policy of inverted indexes
    */
-  StupaSearchHandler(size_t invsize, size_t max_doc)
+  StupaSearchHandler(size_t invsize, size_t max_doc,
+                     InvertedIndex::RetentionPolicy retention
+                       = InvertedIndex::RETAIN_RECENT)
     : stpsearch_(SearchModel::COSINE,
-                 invsize, max_doc) { }
+                 invsize, max_doc, retention) { }
 
   /**
    * Add a document.
    * @param document_id the identifier of input document
    * @param features feature strings of input document
+   * @param quality quality score of input document (0.0-1.0)
    */
   void add_document(const std::string &document_id,
-                    const std::vector<std::string> &features) {
+                    const std::vector<std::string> &features,
+                    double quality = 0.0) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::ADD);
     if (document_id.empty() || features.empty()) return;
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, true);
-    stpsearch_.add_document(document_id, features);
+    record_lock_wait(true, start);
+    stpsearch_.add_document(document_id, features, quality);
   }
 
   /**
@@ -58,8 +80,11 @@ class StupaSearchHandler {
    * @param document_id the identifier of document to be deleted
    */
   void delete_document(const std::string &document_id) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::DELETE);
     if (document_id.empty()) return;
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, true);
+    record_lock_wait(true, start);
     stpsearch_.delete_document(document_id);
   }
 
@@ -68,7 +93,10 @@ class StupaSearchHandler {
    * @return the number of documents
    */
   int64_t size() {
+    Metrics::ScopedTimer timer(metrics_, Metrics::SIZE);
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, false);
+    record_lock_wait(false, start);
     return static_cast<uint64_t>(stpsearch_.size());
   }
 
@@ -77,7 +105,10 @@ class StupaSearchHandler {
    * @param filename file name
    */
   void clear() {
+    Metrics::ScopedTimer timer(metrics_, Metrics::CLEAR);
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, true);
+    record_lock_wait(true, start);
     stpsearch_.clear();
   }
 
@@ -91,8 +122,20 @@ class StupaSearchHandler {
     const std::vector<std::string> & query,
     std::vector<std::pair<std::string, double> > &results,
     const int64_t max) {
-    RWGuard m(lock_, false);
-    stpsearch_.search_by_document(query, results, max);
+    Metrics::ScopedTimer timer(metrics_, Metrics::SEARCH_BY_DOCUMENT);
+    SearchTrace trace;
+    uint64_t start = get_time_nsec();
+    {
+      RWGuard m(lock_, false);
+      trace.lock_wait = get_time_nsec() - start;
+      metrics_.record_lock_wait(Metrics::READ_LOCK, trace.lock_wait);
+      stpsearch_.search_by_document(query, results, max, &trace);
+    }
+    metrics_.record(trace);
+    if (slow_log_.enabled()) {
+      slow_log_.record(Metrics::operation_name(Metrics::SEARCH_BY_DOCUMENT),
+                       query, trace, get_time_nsec() - start);
+    }
   }
 
   /**
@@ -105,8 +148,20 @@ class StupaSearchHandler {
     const std::vector<std::string> & query,
     std::vector<std::pair<std::string, double> > &results,
     const int64_t max) {
-    RWGuard m(lock_, false);
-    stpsearch_.search_by_feature(query, results, max);
+    Metrics::ScopedTimer timer(metrics_, Metrics::SEARCH_BY_FEATURE);
+    SearchTrace trace;
+    uint64_t start = get_time_nsec();
+    {
+      RWGuard m(lock_, false);
+      trace.lock_wait = get_time_nsec() - start;
+      metrics_.record_lock_wait(Metrics::READ_LOCK, trace.lock_wait);
+      stpsearch_.search_by_feature(query, results, max, &trace);
+    }
+    metrics_.record(trace);
+    if (slow_log_.enabled()) {
+      slow_log_.record(Metrics::operation_name(Metrics::SEARCH_BY_FEATURE),
+                       query, trace, get_time_nsec() - start);
+    }
   }
 
   /**
@@ -115,12 +170,15 @@ class StupaSearchHandler {
    * @return return true if sccessed
    */
   bool save(const std::string& filename) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::SAVE);
     std::ofstream ofs(filename.c_str());
     if (!ofs) {
       fprintf(stderr, "Cannot open file %s\n", filename.c_str());
       return false;
     }
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, false);
+    record_lock_wait(false, start);
     stpsearch_.save(ofs);
     return true;
   }
@@ -131,14 +189,158 @@ class StupaSearchHandler {
    * @return true if successed
    */
   bool load(const std::string& filename) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::LOAD);
     std::ifstream ifs(filename.c_str());
     if (!ifs) {
       fprintf(stderr, "Cannot open file %s\n", filename.c_str());
       return false;
     }
+    uint64_t start = get_time_nsec();
     RWGuard m(lock_, true);
+    record_lock_wait(true, start);
     stpsearch_.load(ifs);
-    return true;
+    return !ifs.fail();
+  }
+
+  /**
+   * Purge deleted documents from posting lists.
+   * @param max_lists maximum number of posting lists to be compacted
+   * @return the number of compacted posting lists
+   */
+  size_t compact(size_t max_lists) {
+    uint64_t start = get_time_nsec();
+    RWGuard m(lock_, true);
+    record_lock_wait(true, start);
+    return stpsearch_.compact(max_lists);
+  }
+
+  /**
+   * Reassign identifiers to documents (searches wait until finished).
+   * @param order order of documents
+   */
+  void reassign_document_ids(StupaSearch::ReassignOrder order) {
+    uint64_t start = get_time_nsec();
+    RWGuard m(lock_, true);
+    record_lock_wait(true, start);
+    stpsearch_.reassign_document_ids(order);
+  }
+
+  /**
+   * Set the number of documents to be read in each posting list.
+   * @param depth the number of documents (0: all documents)
+   */
+  void set_lookup_depth(size_t depth) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_lookup_depth(depth);
+  }
+
+  /**
+   * Set the size of high-impact tier of long posting lists.
+   * @param size the number of high-impact documents (0: no tiers)
+   */
+  void set_tier_size(size_t size) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_tier_size(size);
+  }
+
+  /**
+   * Set the memory budget of the cache of decoded posting lists.
+   * The cache is shared by searches under the read lock.
+   * @param bytes memory budget (0: no cache)
+   */
+  void set_posting_cache(size_t bytes) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_posting_cache(bytes);
+  }
+
+  /**
+   * Set the planner choosing lookup of inverted indexes or scan of documents.
+   * @param planner planner
+   * @param threads the number of threads to scan documents
+   */
+  void set_planner(StupaSearch::Planner planner, size_t threads) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_planner(planner, threads);
+  }
+
+  /**
+   * Find candidates of searches by documents with MinHash index.
+   * @param bands the number of bands (0: use inverted indexes)
+   * @param rows the number of rows in a band
+   */
+  void set_minhash(size_t bands, size_t rows) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_minhash(bands, rows);
+  }
+
+  /**
+   * Score only candidates of the nearest SimHash signatures to queries.
+   * @param bits bits of a signature (64, 128 or 256, 0: not used)
+   * @param max the number of candidates to be scored
+   */
+  void set_prefilter(size_t bits, size_t max) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_prefilter(bits, max);
+  }
+
+  /**
+   * Set the ratio of documents over which a feature is not looked up.
+   * @param ratio ratio of documents which have a feature (0: off)
+   */
+  void set_max_df(double ratio) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_max_df(ratio);
+  }
+
+  /**
+   * Skip the most frequent features within a ratio of postings in lookup.
+   * @param ratio ratio of postings of skipped features (0: off)
+   */
+  void set_skip_postings(double ratio) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_skip_postings(ratio);
+  }
+
+  /**
+   * Set the ratio of deleted documents to compact a posting list.
+   * @param ratio ratio of deleted documents in a posting list
+   */
+  void set_compaction_ratio(double ratio) {
+    RWGuard m(lock_, true);
+    stpsearch_.set_compaction_ratio(ratio);
+  }
+
+  /**
+   * Get runtime metrics and statistics of index.
+   * @param result output 'name \t value' lines
+   */
+  void stats(std::string &result) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::STATS);
+    IndexStatistics stats;
+    {
+      uint64_t start = get_time_nsec();
+      RWGuard m(lock_, false);
+      record_lock_wait(false, start);
+      stpsearch_.statistics(stats);
+    }
+    std::ostringstream oss;
+    metrics_.write(oss);
+    stats.write(oss);
+    result = oss.str();
+  }
+
+  /**
+   * Get the log of slow and sampled queries to configure it.
+   * @return slow-query log
+   */
+  SlowQueryLog &slow_log() { return slow_log_; }
+
+  /**
+   * Get the latest entries of the slow-query log.
+   * @param result output entries (one entry per line)
+   */
+  void slow_queries(std::string &result) {
+    slow_log_.recent(result);
   }
 };
 
@@ -162,6 +162,58 @@ TEST(HandlerTest, SearchByFeatureTest) {
   }
 }
 
+/* stats */
+TEST(HandlerTest, StatsTest) {
+  stupa::evhttp::StupaSearchHandler handler(INV_SIZE, MAX_DOC);
+  TestSet documents;
+  set_input_documents(documents);
+  add_documents(handler, documents);
+  std::vector<std::pair<std::string, double> > results;
+  handler.search_by_feature(documents.begin()->second, results, MAX_RESULT);
+
+  std::string stats;
+  handler.stats(stats);
+  std::stringstream ss;
+  ss << "operation.add.count\t" << documents.size() << "\n";
+  EXPECT_NE(std::string::npos, stats.find(ss.str()));
+  EXPECT_NE(std::string::npos,
+            stats.find("operation.search_by_feature.count\t1\n"));
+  EXPECT_NE(std::string::npos, stats.find("stage.scoring.count\t1\n"));
+  ss.str("");
+  ss << "lock_wait.write.count\t" << documents.size() << "\n";
+  EXPECT_NE(std::string::npos, stats.find(ss.str()));
+  ss.str("");
+  ss << "index.documents\t" << documents.size() << "\n";
+  EXPECT_NE(std::string::npos, stats.find(ss.str()));
+}
+
+/* slow_log, slow_queries */
+TEST(HandlerTest, SlowQueryTest) {
+  stupa::evhttp::StupaSearchHandler handler(INV_SIZE, MAX_DOC);
+  TestSet documents;
+  set_input_documents(documents);
+  add_documents(handler, documents);
+  std::vector<std::pair<std::string, double> > results;
+  handler.search_by_feature(documents.begin()->second, results, MAX_RESULT);
+  std::string entries;
+  handler.slow_queries(entries);
+  EXPECT_TRUE(entries.empty());
+
+  handler.slow_log().set_sample_rate(1);
+  std::vector<std::string> queries(1, documents.begin()->first);
+  results.clear();
+  handler.search_by_document(queries, results, MAX_RESULT);
+  handler.slow_queries(entries);
+  EXPECT_NE(std::string::npos,
+            entries.find("\toperation=search_by_document\t"));
+  std::stringstream ss;
+  ss << "\tquery_features=" << documents.begin()->second.size() << "\t";
+  EXPECT_NE(std::string::npos, entries.find(ss.str()));
+  ss.str("");
+  ss << "\tresults=" << results.size() << "\t";
+  EXPECT_NE(std::string::npos, entries.find(ss.str()));
+}
+
 /* save, load */
 TEST(HandlerTest, SaveLoadTest) {
   stupa::evhttp::StupaSearchHandler handler(INV_SIZE, MAX_DOC);
@@ -0,0 +1,517 @@
+//
+// HTTP load generator for stupa_evhttpd
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <sys/queue.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <event.h>
+#include <evhttp.h>
+#include "stupa.h"
+
+const char *HOST          = "127.0.0.1";
+const int PORT            = 22122;
+const size_t CONCURRENCY  = 8;
+const double DURATION     = 10.0;
+const size_t QUERY_SIZE   = 1;
+const size_t MAX_RESULT   = 20;
+const int TIMEOUT         = 10;
+
+/** Operations sent to the server */
+enum Operation {
+  OP_DSEARCH,
+  OP_FSEARCH,
+  OP_ADD,
+  NUM_OPERATIONS,
+};
+
+/** names and paths of operations */
+const char *OP_NAMES[NUM_OPERATIONS] = { "dsearch", "fsearch", "add" };
+const char *OP_PATHS[NUM_OPERATIONS] = { "/dsearch", "/fsearch", "/add" };
+
+/**
+ * Parameters of load generator.
+ */
+struct Param {
+  const char *host;         ///< host name of the server
+  int port;                 ///< port number of the server
+  size_t concurrency;       ///< the number of keep-alive connections
+  size_t num_requests;      ///< the number of requests (0: use duration)
+  double duration;          ///< measuring time (sec)
+  double warmup;            ///< warmup time (sec), not measured
+  double rate;              ///< request rate of open loop (0: closed loop)
+  size_t mix[NUM_OPERATIONS];  ///< ratio of operations
+  size_t query_size;        ///< the number of ids/features of a query
+  size_t max;               ///< maximum number of search results
+  const char *filename;     ///< path of input tsv file
+
+  Param() : host(HOST), port(PORT), concurrency(CONCURRENCY),
+            num_requests(0), duration(DURATION), warmup(0.0), rate(0.0),
+            query_size(QUERY_SIZE), max(MAX_RESULT), filename(NULL) {
+    mix[OP_DSEARCH] = 8;
+    mix[OP_FSEARCH] = 1;
+    mix[OP_ADD] = 1;
+  }
+};
+
+/* function prototypes */
+int main(int argc, char **argv);
+static void usage(const char *progname);
+static void parse_options(int argc, char **argv, Param &param);
+static void parse_mix(const char *str, Param &param);
+static bool read_dataset(const char *path,
+                         std::vector<std::string> &document_ids,
+                         std::vector<std::vector<std::string> > &features);
+static std::string join_string(const std::vector<std::string> &v);
+static std::string encode_uri(const std::string &s);
+
+/**
+ * Load generator sending requests over keep-alive connections.
+ *
+ * In closed-loop mode every connection has one outstanding request and
+ * sends the next one as soon as a response arrives. In open-loop mode
+ * requests are scheduled at a fixed rate and queued on the connections
+ * regardless of responses, and latency is measured from the scheduled
+ * time so that a stalled server is not hidden by a stalled client.
+ */
+class LoadGenerator {
+ private:
+  /** Context of a request in flight */
+  struct Request {
+    LoadGenerator *generator;  ///< load generator
+    Operation op;              ///< type of operation
+    size_t conn;               ///< index of connection
+    double start;              ///< (scheduled) start time
+  };
+
+  Param param_;                                   ///< parameters
+  std::vector<std::string> document_ids_;         ///< replayed documents
+  std::vector<std::vector<std::string> > features_;  ///< their features
+  std::vector<evhttp_connection *> conns_;        ///< connections
+  stupa::Histogram hist_[NUM_OPERATIONS];         ///< latency (usec)
+  size_t errors_[NUM_OPERATIONS];                 ///< the number of errors
+  size_t issued_;                                 ///< the number of issued
+  size_t outstanding_;                            ///< requests in flight
+  size_t next_add_;                               ///< next document to add
+  double start_time_;                             ///< start time
+  double measure_time_;                           ///< end of warmup
+  double end_time_;                               ///< end time
+  double finish_time_;                            ///< time of last response
+  bool stopped_;                                  ///< no more requests
+  event timer_;                                   ///< open-loop timer
+  unsigned int seed_;                             ///< seed of random numbers
+
+  /**
+   * Choose an operation according to the mix ratio.
+   * @return operation
+   */
+  Operation choose_operation() {
+    size_t total = 0;
+    for (int i = 0; i < NUM_OPERATIONS; i++) total += param_.mix[i];
+    size_t r = static_cast<size_t>(stupa::myrand(&seed_)) % total;
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      if (r < param_.mix[i]) return static_cast<Operation>(i);
+      r -= param_.mix[i];
+    }
+    return OP_DSEARCH;
+  }
+
+  /**
+   * Make the body of a request.
+   * @param op type of operation
+   * @param body output body
+   */
+  void make_body(Operation op, std::string &body) {
+    std::vector<std::string> query;
+    size_t ndocs = document_ids_.size();
+    if (op == OP_ADD) {
+      size_t index = next_add_++ % ndocs;
+      body = "id=" + encode_uri(document_ids_[index])
+             + "&feature=" + encode_uri(join_string(features_[index]));
+      return;
+    }
+    for (size_t i = 0; i < param_.query_size; i++) {
+      size_t index = static_cast<size_t>(stupa::myrand(&seed_)) % ndocs;
+      if (op == OP_DSEARCH) {
+        query.push_back(document_ids_[index]);
+      } else {
+        const std::vector<std::string> &f = features_[index];
+        query.push_back(f[static_cast<size_t>(stupa::myrand(&seed_))
+                          % f.size()]);
+      }
+    }
+    char maxstr[32];
+    snprintf(maxstr, sizeof(maxstr), "%d", static_cast<int>(param_.max));
+    body = "query=" + encode_uri(join_string(query)) + "&max=" + maxstr;
+  }
+
+  /**
+   * Send a request.
+   * @param conn index of connection
+   * @param start (scheduled) start time
+   */
+  void send_request(size_t conn, double start) {
+    Request *r = new Request;
+    r->generator = this;
+    r->op = choose_operation();
+    r->conn = conn;
+    r->start = start;
+    std::string body;
+    make_body(r->op, body);
+
+    evhttp_request *req = evhttp_request_new(cb_response, r);
+    evhttp_add_header(req->output_headers, "Host", param_.host);
+    evhttp_add_header(req->output_headers, "Content-Type",
+                      "application/x-www-form-urlencoded");
+    evbuffer_add(req->output_buffer, body.data(), body.size());
+    issued_++;
+    outstanding_++;
+    if (evhttp_make_request(conns_[conn], req, EVHTTP_REQ_POST,
+                            OP_PATHS[r->op]) != 0) {
+      errors_[r->op]++;
+      outstanding_--;
+      delete r;
+    }
+  }
+
+  /**
+   * Check whether more requests should be issued.
+   * @param now current time
+   * @return true if finished
+   */
+  bool is_finished(double now) {
+    if (stopped_) return true;
+    if (param_.num_requests > 0) {
+      stopped_ = issued_ >= param_.num_requests;
+    } else {
+      stopped_ = now >= end_time_;
+    }
+    return stopped_;
+  }
+
+  /**
+   * Handle a response.
+   * @param req evhttp request object (NULL if the connection failed)
+   * @param r context of the request
+   */
+  void handle_response(evhttp_request *req, Request *r) {
+    double now = stupa::get_time();
+    outstanding_--;
+    if (!req || req->response_code != HTTP_OK) {
+      errors_[r->op]++;
+    } else if (r->start >= measure_time_) {
+      hist_[r->op].add(static_cast<uint64_t>((now - r->start) * 1e6));
+      finish_time_ = now;
+    }
+    if (param_.rate <= 0 && !is_finished(now)) {
+      send_request(r->conn, now);
+    }
+    if (stopped_ && outstanding_ == 0) event_loopexit(NULL);
+    delete r;
+  }
+
+  /**
+   * Schedule requests of open loop.
+   */
+  void schedule() {
+    double now = stupa::get_time();
+    size_t due = static_cast<size_t>((now - start_time_) * param_.rate);
+    while (issued_ < due && !is_finished(now)) {
+      double start = start_time_ + issued_ / param_.rate;
+      send_request(issued_ % conns_.size(), start);
+    }
+    if (stopped_) {
+      if (outstanding_ == 0) event_loopexit(NULL);
+      return;
+    }
+    timeval tv = { 0, 1000 };
+    evtimer_add(&timer_, &tv);
+  }
+
+  /**
+   * Callback function of responses.
+   * @param req evhttp request object
+   * @param arg context of the request
+   */
+  static void cb_response(evhttp_request *req, void *arg) {
+    Request *r = reinterpret_cast<Request *>(arg);
+    r->generator->handle_response(req, r);
+  }
+
+  /**
+   * Callback function of open-loop timer.
+   * @param fd not used
+   * @param event not used
+   * @param arg load generator
+   */
+  static void cb_timer(int fd, short event, void *arg) {
+    reinterpret_cast<LoadGenerator *>(arg)->schedule();
+  }
+
+ public:
+  /**
+   * Constructor.
+   * @param param parameters
+   */
+  explicit LoadGenerator(const Param &param)
+    : param_(param), issued_(0), outstanding_(0), next_add_(0),
+      start_time_(0.0), measure_time_(0.0), end_time_(0.0),
+      finish_time_(0.0), stopped_(false),
+      seed_(static_cast<unsigned int>(time(NULL))) {
+    for (int i = 0; i < NUM_OPERATIONS; i++) errors_[i] = 0;
+  }
+
+  /**
+   * Destructor.
+   */
+  ~LoadGenerator() {
+    for (size_t i = 0; i < conns_.size(); i++) {
+      evhttp_connection_free(conns_[i]);
+    }
+  }
+
+  /**
+   * Read queries and documents to be replayed.
+   * @param path path of a tsv file
+   * @return true if successed
+   */
+  bool read(const char *path) {
+    return read_dataset(path, document_ids_, features_);
+  }
+
+  /**
+   * Send requests until finished.
+   */
+  void run() {
+    event_init();
+    for (size_t i = 0; i < param_.concurrency; i++) {
+      evhttp_connection *conn =
+        evhttp_connection_new(param_.host, static_cast<u_short>(param_.port));
+      evhttp_connection_set_timeout(conn, TIMEOUT);
+      conns_.push_back(conn);
+    }
+    if (param_.num_requests > 0) param_.warmup = 0.0;
+    start_time_ = stupa::get_time();
+    measure_time_ = start_time_ + param_.warmup;
+    end_time_ = measure_time_ + param_.duration;
+    if (param_.rate > 0) {
+      evtimer_set(&timer_, cb_timer, this);
+      schedule();
+    } else {
+      for (size_t i = 0; i < conns_.size(); i++) {
+        if (!is_finished(start_time_)) send_request(i, start_time_);
+      }
+    }
+    event_dispatch();
+  }
+
+  /**
+   * Show results.
+   */
+  void show_result() const {
+    stupa::Histogram total;
+    size_t errors = 0;
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      total.merge(hist_[i]);
+      errors += errors_[i];
+    }
+    double elapsed = finish_time_ - measure_time_;
+    printf("[Load-test Result]\n");
+    printf(" Mode       : %s\n", param_.rate > 0 ? "open loop" : "closed loop");
+    printf(" Requests   : %llu (errors: %llu)\n",
+           static_cast<unsigned long long>(total.count()),
+           static_cast<unsigned long long>(errors));
+    printf(" Elapsed    : %.2f (sec)\n", elapsed);
+    printf(" Throughput : %.2f (req/sec)\n",
+           elapsed > 0 ? total.count() / elapsed : 0.0);
+    printf(" Latency (usec)\n");
+    printf("  %-8s %10s %10s %10s %10s %10s %10s\n",
+           "op", "count", "mean", "p50", "p99", "p999", "max");
+    for (int i = 0; i <= NUM_OPERATIONS; i++) {
+      const stupa::Histogram &h = (i < NUM_OPERATIONS) ? hist_[i] : total;
+      if (h.count() == 0) continue;
+      printf("  %-8s %10llu %10.1f %10llu %10llu %10llu %10llu\n",
+             i < NUM_OPERATIONS ? OP_NAMES[i] : "all",
+             static_cast<unsigned long long>(h.count()), h.mean(),
+             static_cast<unsigned long long>(h.percentile(50.0)),
+             static_cast<unsigned long long>(h.percentile(99.0)),
+             static_cast<unsigned long long>(h.percentile(99.9)),
+             static_cast<unsigned long long>(h.max()));
+    }
+  }
+};
+
+
+int main(int argc, char **argv) {
+  Param param;
+  parse_options(argc, argv, param);
+  LoadGenerator generator(param);
+  if (!generator.read(param.filename)) {
+    fprintf(stderr, "[ERROR]Cannot read documents: %s\n", param.filename);
+    return EXIT_FAILURE;
+  }
+  generator.run();
+  generator.show_result();
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Show usage.
+ * @param progname name of this program
+ */
+static void usage(const char *progname) {
+  fprintf(stderr, "%s : Stupa HTTP load generator\n\n", progname);
+  fprintf(stderr, "Usage: %s [options] file\n", progname);
+  fprintf(stderr, " -s host     host name of the server (default:%s)\n", HOST);
+  fprintf(stderr, " -p port     port number (default:%d)\n", PORT);
+  fprintf(stderr, " -c num      number of keep-alive connections (default:%d)\n",
+          static_cast<int>(CONCURRENCY));
+  fprintf(stderr, " -n num      number of requests (default: use -t)\n");
+  fprintf(stderr, " -t sec      measuring time (default:%.0f)\n", DURATION);
+  fprintf(stderr, " -W sec      warmup time, not measured (default:0)\n");
+  fprintf(stderr, " -r rate     requests per second of open loop\n");
+  fprintf(stderr, "             (default: closed loop)\n");
+  fprintf(stderr, " -m d:f:a    ratio of dsearch:fsearch:add (default:8:1:1)\n");
+  fprintf(stderr, " -q num      number of ids or features of a query (default:%d)\n",
+          static_cast<int>(QUERY_SIZE));
+  fprintf(stderr, " -x num      maximum number of search results (default:%d)\n",
+          static_cast<int>(MAX_RESULT));
+  fprintf(stderr, " -h          show help message\n");
+  fprintf(stderr, " file        tsv file of documents to be replayed\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Parse command-line options.
+ * @param argc the number of arguments
+ * @param argv arguments
+ * @param param output parameters
+ */
+static void parse_options(int argc, char **argv, Param &param) {
+  int i = 1;
+  while (i < argc) {
+    if (argv[i][0] == '-' && i + 1 >= argc) {
+      usage(argv[0]);
+    } else if (!strcmp(argv[i], "-s")) {
+      param.host = argv[++i];
+    } else if (!strcmp(argv[i], "-p")) {
+      param.port = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-c")) {
+      param.concurrency = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-n")) {
+      param.num_requests = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-t")) {
+      param.duration = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-W")) {
+      param.warmup = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-r")) {
+      param.rate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-m")) {
+      parse_mix(argv[++i], param);
+    } else if (!strcmp(argv[i], "-q")) {
+      param.query_size = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-x")) {
+      param.max = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || param.filename) {
+      usage(argv[0]);
+    } else {
+      param.filename = argv[i];
+    }
+    ++i;
+  }
+  if (!param.filename || param.concurrency == 0 || param.query_size == 0) {
+    usage(argv[0]);
+  }
+}
+
+/**
+ * Parse ratio of operations.
+ * @param str ratio string (dsearch:fsearch:add)
+ * @param param output parameters
+ */
+static void parse_mix(const char *str, Param &param) {
+  std::vector<std::string> ratios;
+  stupa::split_string(str, ":", ratios);
+  size_t total = 0;
+  for (int i = 0; i < NUM_OPERATIONS; i++) {
+    param.mix[i] = (i < static_cast<int>(ratios.size()))
+                   ? atoi(ratios[i].c_str()) : 0;
+    total += param.mix[i];
+  }
+  if (total == 0) {
+    fprintf(stderr, "[ERROR]Invalid ratio of operations: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Read documents from a tsv file.
+ * @param path path of a tsv file
+ * @param document_ids output identifiers of documents
+ * @param features output features of documents
+ * @return true if successed
+ */
+static bool read_dataset(const char *path,
+                         std::vector<std::string> &document_ids,
+                         std::vector<std::vector<std::string> > &features) {
+  std::ifstream ifs(path);
+  if (!ifs) return false;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    size_t p = line.find(stupa::DELIMITER);
+    if (line.empty() || p == std::string::npos) continue;
+    std::vector<std::string> f;
+    stupa::split_string(line.substr(p + stupa::DELIMITER.size()),
+                        stupa::DELIMITER, f);
+    if (p == 0 || f.empty()) continue;
+    document_ids.push_back(line.substr(0, p));
+    features.push_back(f);
+  }
+  return !document_ids.empty();
+}
+
+/**
+ * Join strings with the delimiter.
+ * @param v input strings
+ * @return joined string
+ */
+static std::string join_string(const std::vector<std::string> &v) {
+  std::string s;
+  for (size_t i = 0; i < v.size(); i++) {
+    if (i > 0) s += stupa::DELIMITER;
+    s += v[i];
+  }
+  return s;
+}
+
+/**
+ * Encode a string for a URI.
+ * @param s input string
+ * @return encoded string
+ */
+static std::string encode_uri(const std::string &s) {
+  char *encoded = evhttp_encode_uri(s.c_str());
+  std::string result(encoded);
+  free(encoded);
+  return result;
+}
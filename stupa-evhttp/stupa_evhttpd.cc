@@ -19,6 +19,7 @@
 
 #include <csignal>
 #include <sys/queue.h>
+#include <unistd.h>
 #include <iostream>
 #include <event.h>
 #include <evhttp.h>
@@ -28,6 +29,9 @@ const int PORT          = 22122;
 const size_t INV_SIZE   = 100;
 const size_t NUM_WORKER = 4;
 const size_t MAX_RESULT = 50;
+const size_t LOG_FILES  = 4;
+const size_t COMPACT_MSEC  = 1000;
+const size_t COMPACT_LISTS = 16;
 
 /**
  * Parameters to start stupa server
@@ -38,8 +42,55 @@ struct Param {
   size_t invsize;     ///< maximum size of inverted indexes.
   size_t num_worker;  ///< the number of worker threads
   char   *filename;   ///< path of input file.
+  char   *log_path;   ///< path of slow-query log.
+  double log_msec;    ///< threshold of slow queries (msec, 0: off).
+  size_t log_sample;  ///< log every N-th query (0: off).
+  size_t log_bytes;   ///< maximum size of a log file.
+  size_t compact_msec;  ///< interval of compaction (msec, 0: off).
+  double compact_ratio; ///< ratio of deleted documents to compact.
+  size_t reassign_msec; ///< interval of reassigning ids (msec, 0: off).
+  stupa::StupaSearch::ReassignOrder reassign_order;  ///< order of reassigning.
+  stupa::InvertedIndex::RetentionPolicy retention;  ///< retention policy.
+  size_t depth;          ///< documents to be read in each posting list.
+  size_t tier;           ///< size of high-impact tier of posting lists.
+  size_t posting_cache;  ///< bytes of cache of decoded posting lists.
+  double max_df;         ///< ratio of documents to skip features in lookup.
+  double skip_postings;  ///< ratio of postings of skipped features.
+  size_t bands;          ///< bands of MinHash index (0: not used).
+  size_t rows;           ///< rows in a band of MinHash index.
+  size_t sigbits;        ///< bits of SimHash signatures (0: not used).
+  size_t scored;         ///< candidates to be scored after prefilter.
+  stupa::StupaSearch::Planner planner;  ///< plan of searches.
+  size_t scan_threads;   ///< the number of threads to scan documents.
 
-  Param() : port(PORT), max_doc(0), invsize(INV_SIZE), filename(NULL) { }
+  Param() : port(PORT), max_doc(0), invsize(INV_SIZE), filename(NULL),
+            log_path(NULL), log_msec(0), log_sample(0),
+            log_bytes(stupa::SlowQueryLog::DEFAULT_MAX_BYTES),
+            compact_msec(COMPACT_MSEC),
+            compact_ratio(stupa::InvertedIndex::DEFAULT_COMPACTION_RATIO),
+            reassign_msec(0),
+            reassign_order(stupa::StupaSearch::REASSIGN_BY_ID),
+            retention(stupa::InvertedIndex::RETAIN_RECENT), depth(0), tier(0),
+            posting_cache(0), max_df(0), skip_postings(0), bands(0),
+            rows(stupa::MinHashIndex::DEFAULT_ROWS), sigbits(0), scored(0),
+            planner(stupa::StupaSearch::PLANNER_LOOKUP), scan_threads(1) { }
+};
+
+/**
+ * Arguments of the compaction thread
+ */
+struct Compactor {
+  stupa::evhttp::StupaSearchHandler *handler;  ///< search handler.
+  size_t msec;                                 ///< interval (msec).
+};
+
+/**
+ * Arguments of the thread to reassign document ids
+ */
+struct Reassigner {
+  stupa::evhttp::StupaSearchHandler *handler;  ///< search handler.
+  size_t msec;                                 ///< interval (msec).
+  stupa::StupaSearch::ReassignOrder order;     ///< order of documents.
 };
 
 /* function prototypes */
@@ -52,12 +103,16 @@ void write_search_result(
 void cb_add(evhttp_request *req, void *arg);
 void cb_delete(evhttp_request *req, void *arg);
 void cb_size(evhttp_request *req, void *arg);
+void cb_stats(evhttp_request *req, void *arg);
+void cb_slowlog(evhttp_request *req, void *arg);
 void cb_clear(evhttp_request *req, void *arg);
 void cb_dsearch(evhttp_request *req, void *arg);
 void cb_fsearch(evhttp_request *req, void *arg);
 void cb_save(evhttp_request *req, void *arg);
 void cb_load(evhttp_request *req, void *arg);
 void cb_notfound(evhttp_request *req, void *arg);
+void *run_compactor(void *arg);
+void *run_reassigner(void *arg);
 void start_server(const Param &param);
 
 
@@ -84,6 +139,41 @@ void usage(const char *progname) {
   fprintf(stderr, " -w nworker  number of worker thread (default:%d)\n",
           static_cast<int>(NUM_WORKER));
   fprintf(stderr, " -f file     load a file (binary format)\n");
+  fprintf(stderr, " -l file     write slow and sampled queries to a file\n");
+  fprintf(stderr, " -t msec     log queries slower than msec (default: off)\n");
+  fprintf(stderr, " -s num      log every num-th query (default: off)\n");
+  fprintf(stderr, " -r bytes    rotate the log file over bytes (default:%d)\n",
+          static_cast<int>(stupa::SlowQueryLog::DEFAULT_MAX_BYTES));
+  fprintf(stderr, " -R policy   keep recent, quality or weight documents in\n");
+  fprintf(stderr, "             inverted indexes (default: recent)\n");
+  fprintf(stderr, " -D num      read num documents of high impact in each\n");
+  fprintf(stderr, "             inverted index (default: all)\n");
+  fprintf(stderr, " -T num      read more than num documents of an inverted\n");
+  fprintf(stderr, "             index only for more candidates\n");
+  fprintf(stderr, "             (default: off)\n");
+  fprintf(stderr, " -P bytes    cache decoded posting lists up to bytes\n");
+  fprintf(stderr, "             (default: off)\n");
+  fprintf(stderr, " -x ratio    do not look up features in over ratio of\n");
+  fprintf(stderr, "             documents (default: off)\n");
+  fprintf(stderr, " -X ratio    do not look up the most frequent features\n");
+  fprintf(stderr, "             of up to ratio of postings (default: off)\n");
+  fprintf(stderr, " -M b:r      find candidates of /dsearch by MinHash\n");
+  fprintf(stderr, "             index of b bands of r rows (default: off)\n");
+  fprintf(stderr, " -S b:m      score m candidates of the nearest b-bit\n");
+  fprintf(stderr, "             SimHash signatures (default: off)\n");
+  fprintf(stderr, " -Q plan[:n] plan of searches: lookup of inverted\n");
+  fprintf(stderr, "             indexes, scan of documents by n threads or\n");
+  fprintf(stderr, "             cost (default: lookup)\n");
+  fprintf(stderr, " -c msec     interval of compacting posting lists\n");
+  fprintf(stderr, "             (default:%d, 0: off)\n",
+          static_cast<int>(COMPACT_MSEC));
+  fprintf(stderr, " -g ratio    compact a posting list over ratio of\n");
+  fprintf(stderr, "             deleted documents (default:%.2f)\n",
+          stupa::InvertedIndex::DEFAULT_COMPACTION_RATIO);
+  fprintf(stderr, " -a msec     interval of reassigning document ids,\n");
+  fprintf(stderr, "             blocking searches (default: off)\n");
+  fprintf(stderr, " -A          reassign document ids by similarity of\n");
+  fprintf(stderr, "             features (default: insertion order)\n");
   fprintf(stderr, " -h          show help message\n");
   exit(EXIT_FAILURE);
 }
@@ -112,12 +202,97 @@ void parse_options(int argc, char **argv, Param &param) {
     } else if (!strcmp(argv[i], "-f")) {
       param.filename = argv[++i];
       ++i;
+    } else if (!strcmp(argv[i], "-l")) {
+      param.log_path = argv[++i];
+      ++i;
+    } else if (!strcmp(argv[i], "-t")) {
+      param.log_msec = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-s")) {
+      param.log_sample = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-r")) {
+      param.log_bytes = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-R")) {
+      const char *policy = argv[++i];
+      if (!strcmp(policy, "recent")) {
+        param.retention = stupa::InvertedIndex::RETAIN_RECENT;
+      } else if (!strcmp(policy, "quality")) {
+        param.retention = stupa::InvertedIndex::RETAIN_QUALITY;
+      } else if (!strcmp(policy, "weight")) {
+        param.retention = stupa::InvertedIndex::RETAIN_WEIGHT;
+      } else {
+        usage(argv[0]);
+      }
+      ++i;
+    } else if (!strcmp(argv[i], "-D")) {
+      param.depth = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-T")) {
+      param.tier = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-P")) {
+      param.posting_cache = strtoul(argv[++i], NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-x")) {
+      param.max_df = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-X")) {
+      param.skip_postings = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-M")) {
+      char *ptr;
+      param.bands = strtoul(argv[++i], &ptr, 10);
+      if (*ptr == ':') param.rows = strtoul(ptr + 1, NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-S")) {
+      char *ptr;
+      param.sigbits = strtoul(argv[++i], &ptr, 10);
+      if (*ptr == ':') param.scored = strtoul(ptr + 1, NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-Q")) {
+      char *ptr = argv[++i];
+      char *sep = strchr(ptr, ':');
+      if (sep) {
+        param.scan_threads = strtoul(sep + 1, NULL, 10);
+        *sep = '\0';
+      }
+      if (!strcmp(ptr, "lookup")) {
+        param.planner = stupa::StupaSearch::PLANNER_LOOKUP;
+      } else if (!strcmp(ptr, "scan")) {
+        param.planner = stupa::StupaSearch::PLANNER_SCAN;
+      } else if (!strcmp(ptr, "cost")) {
+        param.planner = stupa::StupaSearch::PLANNER_COST;
+      } else {
+        usage(argv[0]);
+      }
+      ++i;
+    } else if (!strcmp(argv[i], "-c")) {
+      param.compact_msec = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-g")) {
+      param.compact_ratio = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-a")) {
+      param.reassign_msec = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-A")) {
+      param.reassign_order = stupa::StupaSearch::REASSIGN_BY_SIMILARITY;
+      ++i;
     } else if (!strcmp(argv[i], "-h")) {
       usage(argv[0]);
     } else {
       usage(argv[0]);
     }
   }
+  // recent documents are kept by the order of ids
+  if (param.reassign_order == stupa::StupaSearch::REASSIGN_BY_SIMILARITY
+      && param.retention == stupa::InvertedIndex::RETAIN_RECENT
+      && param.invsize > 0) {
+    fprintf(stderr, "-A needs -R quality, -R weight or -i 0\n");
+    exit(EXIT_FAILURE);
+  }
 }
 
 /**
@@ -195,12 +370,13 @@ void cb_add(evhttp_request *req, void *arg) {
   parse_postdata(req, headers);
   const char *id = evhttp_find_header(&headers, "id");
   const char *fstr = evhttp_find_header(&headers, "feature");
+  const char *qstr = evhttp_find_header(&headers, "quality");
   if (id && fstr) {
     char *id_dec = evhttp_decode_uri(id);
     char *fstr_dec = evhttp_decode_uri(fstr);
     std::vector<std::string> features;
     stupa::split_string(fstr_dec, "\t", features);
-    handler->add_document(id_dec, features);
+    handler->add_document(id_dec, features, qstr ? atof(qstr) : 0.0);
     evhttp_send_reply(req, HTTP_OK, "OK", NULL);
     free(id_dec);
     free(fstr_dec);
@@ -266,6 +442,51 @@ void cb_size(evhttp_request *req, void *arg) {
   evbuffer_free(buf); 
 }
 
+/**
+ * 'stats' callback function
+ * @param req evhttp request object
+ * @param arg optional argument
+ *
+ * Format (one metric per line):
+ * operation.search_by_document.p99_us \t 120.500
+ * index.posting_bytes \t 1048576
+ */
+void cb_stats(evhttp_request *req, void *arg) {
+  stupa::evhttp::StupaSearchHandler *handler =
+    reinterpret_cast<stupa::evhttp::StupaSearchHandler *>(arg);
+  evhttp_add_header(req->output_headers, "Content-Type",
+                    "text/plain; charset=UTF-8");
+  evbuffer *buf = create_buffer(req);
+  if (!buf) return;
+  std::string stats;
+  handler->stats(stats);
+  evbuffer_add(buf, stats.data(), stats.size());
+  evhttp_send_reply(req, HTTP_OK, "OK", buf);
+  evbuffer_free(buf);
+}
+
+/**
+ * 'slowlog' callback function
+ * @param req evhttp request object
+ * @param arg optional argument
+ *
+ * Format (the latest entries of the slow-query log, one query per line):
+ * time=... \t reason=slow \t operation=search_by_document \t total_us=...
+ */
+void cb_slowlog(evhttp_request *req, void *arg) {
+  stupa::evhttp::StupaSearchHandler *handler =
+    reinterpret_cast<stupa::evhttp::StupaSearchHandler *>(arg);
+  evhttp_add_header(req->output_headers, "Content-Type",
+                    "text/plain; charset=UTF-8");
+  evbuffer *buf = create_buffer(req);
+  if (!buf) return;
+  std::string entries;
+  handler->slow_queries(entries);
+  evbuffer_add(buf, entries.data(), entries.size());
+  evhttp_send_reply(req, HTTP_OK, "OK", buf);
+  evbuffer_free(buf);
+}
+
 /**
  * 'dsearch' callback function (search by documents)
  * @param req evhttp request object
@@ -402,6 +623,33 @@ void cb_load(evhttp_request *req, void *arg) {
   evhttp_clear_headers(&headers);
 }
 
+/**
+ * Compact posting lists in background.  The write lock is released
+ * after every COMPACT_LISTS posting lists.
+ * @param arg Compactor object
+ */
+void *run_compactor(void *arg) {
+  Compactor *compactor = reinterpret_cast<Compactor *>(arg);
+  while (true) {
+    usleep(compactor->msec * 1000);
+    while (compactor->handler->compact(COMPACT_LISTS) == COMPACT_LISTS) { }
+  }
+  return NULL;
+}
+
+/**
+ * Reassign document ids in background.
+ * @param arg Reassigner object
+ */
+void *run_reassigner(void *arg) {
+  Reassigner *reassigner = reinterpret_cast<Reassigner *>(arg);
+  while (true) {
+    usleep(reassigner->msec * 1000);
+    reassigner->handler->reassign_document_ids(reassigner->order);
+  }
+  return NULL;
+}
+
 /**
  * Start stupa search server.
  * @param port port number
@@ -414,15 +662,52 @@ void start_server(const Param &param) {
     fprintf(stderr, "cannot start stupa server\n");
     exit(EXIT_FAILURE);
   }
-  stupa::evhttp::StupaSearchHandler handler(param.invsize, param.max_doc);
+  stupa::evhttp::StupaSearchHandler handler(param.invsize, param.max_doc,
+                                            param.retention);
+  handler.set_lookup_depth(param.depth);
+  handler.set_tier_size(param.tier);
+  handler.set_posting_cache(param.posting_cache);
+  handler.set_max_df(param.max_df);
+  handler.set_skip_postings(param.skip_postings);
+  handler.set_minhash(param.bands, param.rows);
+  handler.set_prefilter(param.sigbits, param.scored);
+  handler.set_planner(param.planner, param.scan_threads);
   if (param.filename) {
     printf("Load: %s\n", param.filename);
     handler.load(param.filename);
   }
+  stupa::SlowQueryLog &slow_log = handler.slow_log();
+  if (param.log_path
+      && !slow_log.open(param.log_path, param.log_bytes, LOG_FILES)) {
+    fprintf(stderr, "cannot open log file %s\n", param.log_path);
+    exit(EXIT_FAILURE);
+  }
+  slow_log.set_threshold(static_cast<uint64_t>(param.log_msec * 1e6));
+  slow_log.set_sample_rate(param.log_sample);
+  handler.set_compaction_ratio(param.compact_ratio);
+  Compactor compactor;
+  compactor.handler = &handler;
+  compactor.msec = param.compact_msec;
+  if (compactor.msec > 0) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_compactor, &compactor);
+    pthread_detach(thread);
+  }
+  Reassigner reassigner;
+  reassigner.handler = &handler;
+  reassigner.msec = param.reassign_msec;
+  reassigner.order = param.reassign_order;
+  if (reassigner.msec > 0) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_reassigner, &reassigner);
+    pthread_detach(thread);
+  }
   // set event handlers
   evhttp_set_cb(httpd, "/add",     cb_add,     &handler);
   evhttp_set_cb(httpd, "/delete",  cb_delete,  &handler);
   evhttp_set_cb(httpd, "/size",    cb_size,    &handler);
+  evhttp_set_cb(httpd, "/stats",   cb_stats,   &handler);
+  evhttp_set_cb(httpd, "/slowlog", cb_slowlog, &handler);
   evhttp_set_cb(httpd, "/clear",   cb_clear,   &handler);
   evhttp_set_cb(httpd, "/fsearch", cb_fsearch, &handler);
   evhttp_set_cb(httpd, "/dsearch", cb_dsearch, &handler);
@@ -22,6 +22,8 @@ class SearchIf {
   virtual void search_by_feature(std::vector<SearchResult> & _return, const int64_t max, const std::vector<std::string> & query) = 0;
   virtual bool save(const std::string& filename) = 0;
   virtual bool load(const std::string& filename) = 0;
+  virtual void stats(std::string& _return) = 0;
+  virtual void slow_queries(std::string& _return) = 0;
 };
 
 class SearchNull : virtual public SearchIf {
@@ -54,6 +56,12 @@ class SearchNull : virtual public SearchIf {
     bool _return = false;
     return _return;
   }
+  void stats(std::string& /* _return */) {
+    return;
+  }
+  void slow_queries(std::string& /* _return */) {
+    return;
+  }
 };
 
 class Search_add_document_args {
@@ -755,6 +763,174 @@ class Search_load_presult {
 
 };
 
+class Search_stats_args {
+ public:
+
+  Search_stats_args() {
+  }
+
+  virtual ~Search_stats_args() throw() {}
+
+
+  bool operator == (const Search_stats_args & /* rhs */) const
+  {
+    return true;
+  }
+  bool operator != (const Search_stats_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Search_stats_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_stats_pargs {
+ public:
+
+
+  virtual ~Search_stats_pargs() throw() {}
+
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_stats_result {
+ public:
+
+  Search_stats_result() : success("") {
+  }
+
+  virtual ~Search_stats_result() throw() {}
+
+  std::string success;
+
+  struct __isset {
+    __isset() : success(false) {}
+    bool success;
+  } __isset;
+
+  bool operator == (const Search_stats_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Search_stats_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Search_stats_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_stats_presult {
+ public:
+
+
+  virtual ~Search_stats_presult() throw() {}
+
+  std::string* success;
+
+  struct __isset {
+    __isset() : success(false) {}
+    bool success;
+  } __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
+class Search_slow_queries_args {
+ public:
+
+  Search_slow_queries_args() {
+  }
+
+  virtual ~Search_slow_queries_args() throw() {}
+
+
+  bool operator == (const Search_slow_queries_args & /* rhs */) const
+  {
+    return true;
+  }
+  bool operator != (const Search_slow_queries_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Search_slow_queries_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_slow_queries_pargs {
+ public:
+
+
+  virtual ~Search_slow_queries_pargs() throw() {}
+
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_slow_queries_result {
+ public:
+
+  Search_slow_queries_result() : success("") {
+  }
+
+  virtual ~Search_slow_queries_result() throw() {}
+
+  std::string success;
+
+  struct __isset {
+    __isset() : success(false) {}
+    bool success;
+  } __isset;
+
+  bool operator == (const Search_slow_queries_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Search_slow_queries_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Search_slow_queries_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+class Search_slow_queries_presult {
+ public:
+
+
+  virtual ~Search_slow_queries_presult() throw() {}
+
+  std::string* success;
+
+  struct __isset {
+    __isset() : success(false) {}
+    bool success;
+  } __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
 class SearchClient : virtual public SearchIf {
  public:
   SearchClient(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> prot) :
@@ -799,6 +975,12 @@ class SearchClient : virtual public SearchIf {
   bool load(const std::string& filename);
   void send_load(const std::string& filename);
   bool recv_load();
+  void stats(std::string& _return);
+  void send_stats();
+  void recv_stats(std::string& _return);
+  void slow_queries(std::string& _return);
+  void send_slow_queries();
+  void recv_slow_queries(std::string& _return);
  protected:
   boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot_;
   boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot_;
@@ -820,6 +1002,8 @@ class SearchProcessor : virtual public ::apache::thrift::TProcessor {
   void process_search_by_feature(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);
   void process_save(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);
   void process_load(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);
+  void process_stats(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);
+  void process_slow_queries(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);
  public:
   SearchProcessor(boost::shared_ptr<SearchIf> iface) :
     iface_(iface) {
@@ -831,6 +1015,8 @@ class SearchProcessor : virtual public ::apache::thrift::TProcessor {
     processMap_["search_by_feature"] = &SearchProcessor::process_search_by_feature;
     processMap_["save"] = &SearchProcessor::process_save;
     processMap_["load"] = &SearchProcessor::process_load;
+    processMap_["stats"] = &SearchProcessor::process_stats;
+    processMap_["slow_queries"] = &SearchProcessor::process_slow_queries;
   }
 
   virtual bool process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot);
@@ -927,6 +1113,30 @@ class SearchMultiface : virtual public SearchIf {
     }
   }
 
+  void stats(std::string& _return) {
+    uint32_t sz = ifaces_.size();
+    for (uint32_t i = 0; i < sz; ++i) {
+      if (i == sz - 1) {
+        ifaces_[i]->stats(_return);
+        return;
+      } else {
+        ifaces_[i]->stats(_return);
+      }
+    }
+  }
+
+  void slow_queries(std::string& _return) {
+    uint32_t sz = ifaces_.size();
+    for (uint32_t i = 0; i < sz; ++i) {
+      if (i == sz - 1) {
+        ifaces_[i]->slow_queries(_return);
+        return;
+      } else {
+        ifaces_[i]->slow_queries(_return);
+      }
+    }
+  }
+
 };
 
 }} // namespace
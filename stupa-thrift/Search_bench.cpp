@@ -0,0 +1,466 @@
+//
+// Load generator for stupa Thrift servers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
+#include <transport/TSocket.h>
+#include <transport/TBufferTransports.h>
+#include "Search.h"
+#include "stupa.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+
+using boost::shared_ptr;
+
+const char *HOST          = "127.0.0.1";
+const int PORT            = 9090;
+const size_t CONCURRENCY  = 8;
+const double DURATION     = 10.0;
+const size_t QUERY_SIZE   = 1;
+const size_t MAX_RESULT   = 20;
+
+/** Operations sent to the server */
+enum Operation {
+  OP_DSEARCH,
+  OP_FSEARCH,
+  OP_ADD,
+  NUM_OPERATIONS,
+};
+
+/** names of operations */
+const char *OP_NAMES[NUM_OPERATIONS] = { "dsearch", "fsearch", "add" };
+
+/**
+ * Parameters of load generator.
+ */
+struct Param {
+  const char *host;         ///< host name of the server
+  int port;                 ///< port number of the server
+  size_t concurrency;       ///< the number of connections (threads)
+  size_t num_requests;      ///< the number of requests (0: use duration)
+  double duration;          ///< measuring time (sec)
+  double warmup;            ///< warmup time (sec), not measured
+  bool compact;             ///< use compact protocol
+  bool buffered;            ///< use buffered transport instead of framed
+  size_t mix[NUM_OPERATIONS];  ///< ratio of operations
+  size_t query_size;        ///< the number of ids/features of a query
+  size_t max;               ///< maximum number of search results
+  const char *filename;     ///< path of input tsv file
+
+  Param() : host(HOST), port(PORT), concurrency(CONCURRENCY),
+            num_requests(0), duration(DURATION), warmup(0.0),
+            compact(false), buffered(false), query_size(QUERY_SIZE),
+            max(MAX_RESULT), filename(NULL) {
+    mix[OP_DSEARCH] = 8;
+    mix[OP_FSEARCH] = 1;
+    mix[OP_ADD] = 1;
+  }
+};
+
+/* function prototypes */
+int main(int argc, char **argv);
+static void usage(const char *progname);
+static void parse_options(int argc, char **argv, Param &param);
+static void parse_mix(const char *str, Param &param);
+static bool read_dataset(const char *path,
+                         std::vector<std::string> &document_ids,
+                         std::vector<std::vector<std::string> > &features);
+
+/**
+ * Load generator sending requests from blocking clients.
+ *
+ * Every thread has its own connection and sends the next request as soon
+ * as the response of the previous one arrives (closed loop), so the
+ * results can be compared with those of stupa_evbench.
+ */
+class LoadGenerator {
+ private:
+  /** Context of a client thread */
+  struct Worker {
+    LoadGenerator *generator;              ///< load generator
+    stupa::Histogram hist[NUM_OPERATIONS];  ///< latency (usec)
+    size_t errors[NUM_OPERATIONS];         ///< the number of errors
+    double finish_time;                    ///< time of last response
+    unsigned int seed;                     ///< seed of random numbers
+  };
+
+  Param param_;                                   ///< parameters
+  std::vector<std::string> document_ids_;         ///< replayed documents
+  std::vector<std::vector<std::string> > features_;  ///< their features
+  std::vector<Worker> workers_;                   ///< client threads
+  volatile size_t issued_;                        ///< the number of issued
+  volatile size_t next_add_;                      ///< next document to add
+  double measure_time_;                           ///< end of warmup
+  double end_time_;                               ///< end time
+
+  /**
+   * Choose an operation according to the mix ratio.
+   * @param seed seed of random numbers
+   * @return operation
+   */
+  Operation choose_operation(unsigned int *seed) const {
+    size_t total = 0;
+    for (int i = 0; i < NUM_OPERATIONS; i++) total += param_.mix[i];
+    size_t r = static_cast<size_t>(stupa::myrand(seed)) % total;
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      if (r < param_.mix[i]) return static_cast<Operation>(i);
+      r -= param_.mix[i];
+    }
+    return OP_DSEARCH;
+  }
+
+  /**
+   * Make a query.
+   * @param op type of search operation
+   * @param seed seed of random numbers
+   * @param query output query
+   */
+  void make_query(Operation op, unsigned int *seed,
+                  std::vector<std::string> &query) const {
+    size_t ndocs = document_ids_.size();
+    for (size_t i = 0; i < param_.query_size; i++) {
+      size_t index = static_cast<size_t>(stupa::myrand(seed)) % ndocs;
+      if (op == OP_DSEARCH) {
+        query.push_back(document_ids_[index]);
+      } else {
+        const std::vector<std::string> &f = features_[index];
+        query.push_back(f[static_cast<size_t>(stupa::myrand(seed))
+                          % f.size()]);
+      }
+    }
+  }
+
+  /**
+   * Check whether more requests should be issued.
+   * @param now current time
+   * @return true if finished
+   */
+  bool is_finished(double now) {
+    if (param_.num_requests > 0) {
+      return __sync_fetch_and_add(&issued_, 1) >= param_.num_requests;
+    }
+    return now >= end_time_;
+  }
+
+  /**
+   * Send requests from a client thread.
+   * @param w context of the thread
+   */
+  void work(Worker &w) {
+    shared_ptr<TSocket> socket(new TSocket(param_.host, param_.port));
+    shared_ptr<TTransport> transport;
+    if (param_.buffered) {
+      transport.reset(new TBufferedTransport(socket));
+    } else {
+      transport.reset(new TFramedTransport(socket));
+    }
+    shared_ptr<TProtocol> protocol;
+    if (param_.compact) {
+      protocol.reset(new TCompactProtocol(transport));
+    } else {
+      protocol.reset(new TBinaryProtocol(transport));
+    }
+    stupa::thrift::SearchClient client(protocol);
+    try {
+      transport->open();
+    } catch (TException &e) {
+      fprintf(stderr, "[ERROR]Cannot connect to %s:%d: %s\n",
+              param_.host, param_.port, e.what());
+      return;
+    }
+
+    std::vector<std::string> query;
+    std::vector<stupa::thrift::SearchResult> results;
+    double now = stupa::get_time();
+    while (!is_finished(now)) {
+      Operation op = choose_operation(&w.seed);
+      double start = now;
+      try {
+        if (op == OP_ADD) {
+          size_t index = __sync_fetch_and_add(&next_add_, 1)
+                         % document_ids_.size();
+          client.add_document(document_ids_[index], features_[index]);
+        } else {
+          query.clear();
+          make_query(op, &w.seed, query);
+          if (op == OP_DSEARCH) {
+            client.search_by_document(results, param_.max, query);
+          } else {
+            client.search_by_feature(results, param_.max, query);
+          }
+        }
+        now = stupa::get_time();
+        if (start >= measure_time_) {
+          w.hist[op].add(static_cast<uint64_t>((now - start) * 1e6));
+          w.finish_time = now;
+        }
+      } catch (TException &) {
+        w.errors[op]++;
+        try {
+          transport->close();
+          transport->open();
+        } catch (TException &) {
+          break;
+        }
+        now = stupa::get_time();
+      }
+    }
+    transport->close();
+  }
+
+  /**
+   * Entry point of a client thread.
+   * @param arg context of the thread
+   * @return NULL
+   */
+  static void *run_worker(void *arg) {
+    Worker *w = reinterpret_cast<Worker *>(arg);
+    w->generator->work(*w);
+    return NULL;
+  }
+
+ public:
+  /**
+   * Constructor.
+   * @param param parameters
+   */
+  explicit LoadGenerator(const Param &param)
+    : param_(param), issued_(0), next_add_(0), measure_time_(0.0),
+      end_time_(0.0) { }
+
+  /**
+   * Read queries and documents to be replayed.
+   * @param path path of a tsv file
+   * @return true if successed
+   */
+  bool read(const char *path) {
+    return read_dataset(path, document_ids_, features_);
+  }
+
+  /**
+   * Send requests until finished.
+   */
+  void run() {
+    if (param_.num_requests > 0) param_.warmup = 0.0;
+    double start_time = stupa::get_time();
+    measure_time_ = start_time + param_.warmup;
+    end_time_ = measure_time_ + param_.duration;
+    workers_.resize(param_.concurrency);
+    std::vector<pthread_t> threads(param_.concurrency);
+    unsigned int seed = static_cast<unsigned int>(time(NULL));
+    for (size_t i = 0; i < workers_.size(); i++) {
+      Worker &w = workers_[i];
+      w.generator = this;
+      for (int j = 0; j < NUM_OPERATIONS; j++) w.errors[j] = 0;
+      w.finish_time = measure_time_;
+      w.seed = seed + static_cast<unsigned int>(i);
+      pthread_create(&threads[i], NULL, run_worker, &w);
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  /**
+   * Show results.
+   */
+  void show_result() const {
+    stupa::Histogram hist[NUM_OPERATIONS];
+    stupa::Histogram total;
+    size_t errors = 0;
+    double finish_time = measure_time_;
+    for (size_t i = 0; i < workers_.size(); i++) {
+      for (int j = 0; j < NUM_OPERATIONS; j++) {
+        hist[j].merge(workers_[i].hist[j]);
+        total.merge(workers_[i].hist[j]);
+        errors += workers_[i].errors[j];
+      }
+      if (workers_[i].finish_time > finish_time) {
+        finish_time = workers_[i].finish_time;
+      }
+    }
+    double elapsed = finish_time - measure_time_;
+    printf("[Load-test Result]\n");
+    printf(" Protocol   : %s, %s transport\n",
+           param_.compact ? "compact" : "binary",
+           param_.buffered ? "buffered" : "framed");
+    printf(" Requests   : %llu (errors: %llu)\n",
+           static_cast<unsigned long long>(total.count()),
+           static_cast<unsigned long long>(errors));
+    printf(" Elapsed    : %.2f (sec)\n", elapsed);
+    printf(" Throughput : %.2f (req/sec)\n",
+           elapsed > 0 ? total.count() / elapsed : 0.0);
+    printf(" Latency (usec)\n");
+    printf("  %-8s %10s %10s %10s %10s %10s %10s\n",
+           "op", "count", "mean", "p50", "p99", "p999", "max");
+    for (int i = 0; i <= NUM_OPERATIONS; i++) {
+      const stupa::Histogram &h = (i < NUM_OPERATIONS) ? hist[i] : total;
+      if (h.count() == 0) continue;
+      printf("  %-8s %10llu %10.1f %10llu %10llu %10llu %10llu\n",
+             i < NUM_OPERATIONS ? OP_NAMES[i] : "all",
+             static_cast<unsigned long long>(h.count()), h.mean(),
+             static_cast<unsigned long long>(h.percentile(50.0)),
+             static_cast<unsigned long long>(h.percentile(99.0)),
+             static_cast<unsigned long long>(h.percentile(99.9)),
+             static_cast<unsigned long long>(h.max()));
+    }
+  }
+};
+
+
+int main(int argc, char **argv) {
+  Param param;
+  parse_options(argc, argv, param);
+  LoadGenerator generator(param);
+  if (!generator.read(param.filename)) {
+    fprintf(stderr, "[ERROR]Cannot read documents: %s\n", param.filename);
+    return EXIT_FAILURE;
+  }
+  generator.run();
+  generator.show_result();
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Show usage.
+ * @param progname name of this program
+ */
+static void usage(const char *progname) {
+  fprintf(stderr, "%s : Stupa Thrift load generator\n\n", progname);
+  fprintf(stderr, "Usage: %s [options] file\n", progname);
+  fprintf(stderr, " -s host     host name of the server (default:%s)\n", HOST);
+  fprintf(stderr, " -p port     port number (default:%d)\n", PORT);
+  fprintf(stderr, " -c num      number of connections (threads) (default:%d)\n",
+          static_cast<int>(CONCURRENCY));
+  fprintf(stderr, " -n num      number of requests (default: use -t)\n");
+  fprintf(stderr, " -t sec      measuring time (default:%.0f)\n", DURATION);
+  fprintf(stderr, " -W sec      warmup time, not measured (default:0)\n");
+  fprintf(stderr, " -C          use compact protocol (default: binary)\n");
+  fprintf(stderr, " -B          use buffered transport for stupa_thread\n");
+  fprintf(stderr, "             (default: framed transport for stupa_nonblock)\n");
+  fprintf(stderr, " -m d:f:a    ratio of dsearch:fsearch:add (default:8:1:1)\n");
+  fprintf(stderr, " -q num      number of ids or features of a query (default:%d)\n",
+          static_cast<int>(QUERY_SIZE));
+  fprintf(stderr, " -x num      maximum number of search results (default:%d)\n",
+          static_cast<int>(MAX_RESULT));
+  fprintf(stderr, " -h          show help message\n");
+  fprintf(stderr, " file        tsv file of documents to be replayed\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Parse command-line options.
+ * @param argc the number of arguments
+ * @param argv arguments
+ * @param param output parameters
+ */
+static void parse_options(int argc, char **argv, Param &param) {
+  int i = 1;
+  while (i < argc) {
+    if (!strcmp(argv[i], "-C")) {
+      param.compact = true;
+    } else if (!strcmp(argv[i], "-B")) {
+      param.buffered = true;
+    } else if (argv[i][0] == '-' && i + 1 >= argc) {
+      usage(argv[0]);
+    } else if (!strcmp(argv[i], "-s")) {
+      param.host = argv[++i];
+    } else if (!strcmp(argv[i], "-p")) {
+      param.port = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-c")) {
+      param.concurrency = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-n")) {
+      param.num_requests = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-t")) {
+      param.duration = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-W")) {
+      param.warmup = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-m")) {
+      parse_mix(argv[++i], param);
+    } else if (!strcmp(argv[i], "-q")) {
+      param.query_size = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-x")) {
+      param.max = atoi(argv[++i]);
+    } else if (argv[i][0] == '-' || param.filename) {
+      usage(argv[0]);
+    } else {
+      param.filename = argv[i];
+    }
+    ++i;
+  }
+  if (!param.filename || param.concurrency == 0 || param.query_size == 0) {
+    usage(argv[0]);
+  }
+}
+
+/**
+ * Parse ratio of operations.
+ * @param str ratio string (dsearch:fsearch:add)
+ * @param param output parameters
+ */
+static void parse_mix(const char *str, Param &param) {
+  std::vector<std::string> ratios;
+  stupa::split_string(str, ":", ratios);
+  size_t total = 0;
+  for (int i = 0; i < NUM_OPERATIONS; i++) {
+    param.mix[i] = (i < static_cast<int>(ratios.size()))
+                   ? atoi(ratios[i].c_str()) : 0;
+    total += param.mix[i];
+  }
+  if (total == 0) {
+    fprintf(stderr, "[ERROR]Invalid ratio of operations: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Read documents from a tsv file.
+ * @param path path of a tsv file
+ * @param document_ids output identifiers of documents
+ * @param features output features of documents
+ * @return true if successed
+ */
+static bool read_dataset(const char *path,
+                         std::vector<std::string> &document_ids,
+                         std::vector<std::vector<std::string> > &features) {
+  std::ifstream ifs(path);
+  if (!ifs) return false;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    size_t p = line.find(stupa::DELIMITER);
+    if (line.empty() || p == std::string::npos) continue;
+    std::vector<std::string> f;
+    stupa::split_string(line.substr(p + stupa::DELIMITER.size()),
+                        stupa::DELIMITER, f);
+    if (p == 0 || f.empty()) continue;
+    document_ids.push_back(line.substr(0, p));
+    features.push_back(f);
+  }
+  return !document_ids.empty();
+}
@@ -18,6 +18,8 @@
 //
 
 #include <cstring>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
 #include "Search_handler.h"
 
 namespace stupa { namespace thrift { /* namespace stupa::thrift */
@@ -30,7 +32,46 @@ void usage(const char *progname) {
           static_cast<int>(INV_SIZE));
   fprintf(stderr, " -w nworker  number of worker thread (default:%d)\n",
           WORKER_COUNT);
+  fprintf(stderr, " -n nthread  number of IO threads of nonblocking server\n");
+  fprintf(stderr, "             (default:%d)\n",
+          IO_THREAD_COUNT);
+  fprintf(stderr, " -c          use compact protocol\n");
+  fprintf(stderr, "             (default: binary protocol)\n");
+  fprintf(stderr, " -L          search without locks\n");
+  fprintf(stderr, "             (keeps two copies of index)\n");
   fprintf(stderr, " -f file     load a file (binary format)\n");
+  fprintf(stderr, " -l file     write slow and sampled queries to a file\n");
+  fprintf(stderr, " -t msec     log queries slower than msec (default: off)\n");
+  fprintf(stderr, " -s num      log every num-th query (default: off)\n");
+  fprintf(stderr, " -r bytes    rotate the log file over bytes (default:%d)\n",
+          static_cast<int>(SlowQueryLog::DEFAULT_MAX_BYTES));
+  fprintf(stderr, " -R policy   keep recent, quality or weight documents in\n");
+  fprintf(stderr, "             inverted indexes (default: recent)\n");
+  fprintf(stderr, " -D num      read num documents of high impact in each\n");
+  fprintf(stderr, "             inverted index (default: all)\n");
+  fprintf(stderr, " -T num      read more than num documents of an inverted\n");
+  fprintf(stderr, "             index only for more candidates\n");
+  fprintf(stderr, "             (default: off)\n");
+  fprintf(stderr, " -P bytes    cache decoded posting lists up to bytes\n");
+  fprintf(stderr, "             (default: off)\n");
+  fprintf(stderr, " -x ratio    do not look up features in over ratio of\n");
+  fprintf(stderr, "             documents (default: off)\n");
+  fprintf(stderr, " -X ratio    do not look up the most frequent features\n");
+  fprintf(stderr, "             of up to ratio of postings (default: off)\n");
+  fprintf(stderr, " -M b:r      find candidates of search_by_document by\n");
+  fprintf(stderr, "             MinHash index of b bands of r rows\n");
+  fprintf(stderr, "             (default: off)\n");
+  fprintf(stderr, " -S b:m      score m candidates of the nearest b-bit\n");
+  fprintf(stderr, "             SimHash signatures (default: off)\n");
+  fprintf(stderr, " -Q plan[:n] plan of searches: lookup of inverted\n");
+  fprintf(stderr, "             indexes, scan of documents by n threads or\n");
+  fprintf(stderr, "             cost (default: lookup)\n");
+  fprintf(stderr, " -C msec     interval of compacting posting lists\n");
+  fprintf(stderr, "             (default:%d, 0: off)\n",
+          static_cast<int>(COMPACT_MSEC));
+  fprintf(stderr, " -g ratio    compact a posting list over ratio of\n");
+  fprintf(stderr, "             deleted documents (default:%.2f)\n",
+          InvertedIndex::DEFAULT_COMPACTION_RATIO);
   fprintf(stderr, " -h          show help message\n");
   exit(1);
 }
@@ -50,9 +91,90 @@ void parse_options(int argc, char **argv, ServerParam &param) {
     } else if (!strcmp(argv[i], "-w")) {
       param.workerCount = atoi(argv[++i]);
       ++i;
+    } else if (!strcmp(argv[i], "-n")) {
+      param.ioThreadCount = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-c")) {
+      param.compact = true;
+      ++i;
+    } else if (!strcmp(argv[i], "-L")) {
+      param.leftRight = true;
+      ++i;
     } else if (!strcmp(argv[i], "-f")) {
       param.filename = argv[++i];
       ++i;
+    } else if (!strcmp(argv[i], "-l")) {
+      param.log_path = argv[++i];
+      ++i;
+    } else if (!strcmp(argv[i], "-t")) {
+      param.log_msec = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-s")) {
+      param.log_sample = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-r")) {
+      param.log_bytes = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-R")) {
+      const char *policy = argv[++i];
+      if (!strcmp(policy, "recent")) {
+        param.retention = InvertedIndex::RETAIN_RECENT;
+      } else if (!strcmp(policy, "quality")) {
+        param.retention = InvertedIndex::RETAIN_QUALITY;
+      } else if (!strcmp(policy, "weight")) {
+        param.retention = InvertedIndex::RETAIN_WEIGHT;
+      } else {
+        usage(argv[0]);
+      }
+      ++i;
+    } else if (!strcmp(argv[i], "-D")) {
+      param.lookupDepth = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-T")) {
+      param.tierSize = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-P")) {
+      param.postingCache = strtoul(argv[++i], NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-x")) {
+      param.maxDf = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-X")) {
+      param.skipPostings = atof(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-M")) {
+      char *ptr;
+      param.minhashBands = strtoul(argv[++i], &ptr, 10);
+      if (*ptr == ':') param.minhashRows = strtoul(ptr + 1, NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-S")) {
+      char *ptr;
+      param.signatureBits = strtoul(argv[++i], &ptr, 10);
+      if (*ptr == ':') param.scored = strtoul(ptr + 1, NULL, 10);
+      ++i;
+    } else if (!strcmp(argv[i], "-Q")) {
+      char *ptr = argv[++i];
+      char *sep = strchr(ptr, ':');
+      if (sep) {
+        param.scanThreads = strtoul(sep + 1, NULL, 10);
+        *sep = '\0';
+      }
+      if (!strcmp(ptr, "lookup")) {
+        param.planner = StupaSearch::PLANNER_LOOKUP;
+      } else if (!strcmp(ptr, "scan")) {
+        param.planner = StupaSearch::PLANNER_SCAN;
+      } else if (!strcmp(ptr, "cost")) {
+        param.planner = StupaSearch::PLANNER_COST;
+      } else {
+        usage(argv[0]);
+      }
+      ++i;
+    } else if (!strcmp(argv[i], "-C")) {
+      param.compact_msec = atoi(argv[++i]);
+      ++i;
+    } else if (!strcmp(argv[i], "-g")) {
+      param.compact_ratio = atof(argv[++i]);
+      ++i;
     } else if (!strcmp(argv[i], "-h")) {
       usage(argv[0]);
     } else {
@@ -61,4 +183,48 @@ void parse_options(int argc, char **argv, ServerParam &param) {
   }
 }
 
+template <typename Handler>
+static boost::shared_ptr<SearchIf> init_handler(Handler *handler,
+                                                const ServerParam &param) {
+  boost::shared_ptr<SearchIf> result(handler);
+  if (param.filename) handler->load(param.filename);
+  SlowQueryLog &slow_log = handler->slow_log();
+  if (param.log_path
+      && !slow_log.open(param.log_path, param.log_bytes, LOG_FILES)) {
+    fprintf(stderr, "Cannot open log file %s\n", param.log_path);
+    exit(1);
+  }
+  slow_log.set_threshold(static_cast<uint64_t>(param.log_msec * 1e6));
+  slow_log.set_sample_rate(param.log_sample);
+  handler->set_lookup_depth(param.lookupDepth);
+  handler->set_tier_size(param.tierSize);
+  handler->set_posting_cache(param.postingCache);
+  handler->set_max_df(param.maxDf);
+  handler->set_skip_postings(param.skipPostings);
+  handler->set_minhash(param.minhashBands, param.minhashRows);
+  handler->set_prefilter(param.signatureBits, param.scored);
+  handler->set_planner(param.planner, param.scanThreads);
+  handler->set_compaction_ratio(param.compact_ratio);
+  handler->start_compactor(param.compact_msec);
+  return result;
+}
+
+boost::shared_ptr<SearchIf> create_handler(const ServerParam &param) {
+  if (param.leftRight) {
+    return init_handler(
+      new LeftRightSearchHandler(param.invsize, param.max_doc,
+                                 param.retention), param);
+  }
+  return init_handler(
+    new SearchHandler(param.invsize, param.max_doc, param.retention), param);
+}
+
+boost::shared_ptr<TProtocolFactory> create_protocol_factory(
+  const ServerParam &param) {
+  if (param.compact) {
+    return boost::shared_ptr<TProtocolFactory>(new TCompactProtocolFactory());
+  }
+  return boost::shared_ptr<TProtocolFactory>(new TBinaryProtocolFactory());
+}
+
 }}  /* namespace stupa::thrift */
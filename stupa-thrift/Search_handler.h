@@ -22,31 +22,359 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <boost/shared_ptr.hpp>
 #include <concurrency/Mutex.h>
+#include <protocol/TProtocol.h>
 #include "Search.h"
 #include "stupa.h"
 
 using namespace apache::thrift;
 using namespace apache::thrift::concurrency;
+using namespace apache::thrift::protocol;
 
 namespace stupa { namespace thrift { /* namespace stupa::thrift */
 
-const int PORT         = 9090;
-const int WORKER_COUNT = 4;
-const size_t INV_SIZE  = 100;
+const int PORT            = 9090;
+const int WORKER_COUNT    = 4;
+const int IO_THREAD_COUNT = 1;
+const size_t INV_SIZE     = 100;
+const size_t LOG_FILES    = 4;
+const size_t COMPACT_MSEC  = 1000;
+const size_t COMPACT_LISTS = 16;
 
+/**
+ * Update to add a document.
+ */
+struct AddDocument {
+  const std::string &document_id;          ///< identifier of document
+  const std::vector<std::string> &features;  ///< features of document
+
+  AddDocument(const std::string &id, const std::vector<std::string> &f)
+    : document_id(id), features(f) { }
+  void operator()(StupaSearch &search) const {
+    search.add_document(document_id, features);
+  }
+};
+
+/**
+ * Update to delete a document.
+ */
+struct DeleteDocument {
+  const std::string &document_id;  ///< identifier of document
+
+  explicit DeleteDocument(const std::string &id) : document_id(id) { }
+  void operator()(StupaSearch &search) const {
+    search.delete_document(document_id);
+  }
+};
+
+/**
+ * Update to clear all documents.
+ */
+struct ClearDocuments {
+  void operator()(StupaSearch &search) const { search.clear(); }
+};
+
+/**
+ * Update to load documents from a file.
+ */
+struct LoadDocuments {
+  const std::string &filename;  ///< file name
+
+  explicit LoadDocuments(const std::string &f) : filename(f) { }
+  void operator()(StupaSearch &search) const {
+    std::ifstream ifs(filename.c_str());
+    search.load(ifs);
+  }
+};
+
+/**
+ * Update to purge deleted documents from posting lists.
+ */
+struct CompactIndex {
+  size_t max_lists;  ///< maximum number of posting lists to be compacted
+  size_t *count;     ///< output the number of compacted posting lists
+
+  CompactIndex(size_t max, size_t *c) : max_lists(max), count(c) { }
+  void operator()(StupaSearch &search) const {
+    *count = search.compact(max_lists);
+  }
+};
+
+/**
+ * Update to set the number of documents to be read in each posting list.
+ */
+struct SetLookupDepth {
+  size_t depth;  ///< the number of documents (0: all documents)
+
+  explicit SetLookupDepth(size_t d) : depth(d) { }
+  void operator()(StupaSearch &search) const {
+    search.set_lookup_depth(depth);
+  }
+};
+
+/**
+ * Update to set the size of high-impact tier of long posting lists.
+ */
+struct SetTierSize {
+  size_t size;  ///< the number of high-impact documents (0: no tiers)
+
+  explicit SetTierSize(size_t s) : size(s) { }
+  void operator()(StupaSearch &search) const { search.set_tier_size(size); }
+};
+
+/**
+ * Update to set the memory budget of the cache of decoded posting lists.
+ */
+struct SetPostingCache {
+  size_t bytes;  ///< memory budget (0: no cache)
+
+  explicit SetPostingCache(size_t b) : bytes(b) { }
+  void operator()(StupaSearch &search) const {
+    search.set_posting_cache(bytes);
+  }
+};
+
+/**
+ * Update to find candidates of searches by documents with MinHash index.
+ */
+struct SetMinHash {
+  size_t bands;  ///< the number of bands (0: use inverted indexes)
+  size_t rows;   ///< the number of rows in a band
+
+  SetMinHash(size_t b, size_t r) : bands(b), rows(r) { }
+  void operator()(StupaSearch &search) const {
+    search.set_minhash(bands, rows);
+  }
+};
+
+/**
+ * Update to score only candidates of the nearest SimHash signatures.
+ */
+struct SetPrefilter {
+  size_t bits;  ///< bits of a signature (0: not used)
+  size_t max;   ///< the number of candidates to be scored
+
+  SetPrefilter(size_t b, size_t m) : bits(b), max(m) { }
+  void operator()(StupaSearch &search) const {
+    search.set_prefilter(bits, max);
+  }
+};
+
+/**
+ * Update to set the planner choosing lookup or scan of documents.
+ */
+struct SetPlanner {
+  StupaSearch::Planner planner;  ///< planner
+  size_t threads;  ///< the number of threads to scan documents
+
+  SetPlanner(StupaSearch::Planner p, size_t t) : planner(p), threads(t) { }
+  void operator()(StupaSearch &search) const {
+    search.set_planner(planner, threads);
+  }
+};
+
+/**
+ * Update to set the ratio of documents over which features are not looked up.
+ */
+struct SetMaxDf {
+  double ratio;  ///< ratio of documents which have a feature (0: off)
+
+  explicit SetMaxDf(double r) : ratio(r) { }
+  void operator()(StupaSearch &search) const { search.set_max_df(ratio); }
+};
+
+/**
+ * Update to skip the most frequent features within a ratio of postings.
+ */
+struct SetSkipPostings {
+  double ratio;  ///< ratio of postings of skipped features (0: off)
+
+  explicit SetSkipPostings(double r) : ratio(r) { }
+  void operator()(StupaSearch &search) const {
+    search.set_skip_postings(ratio);
+  }
+};
+
+/**
+ * Update to set the ratio of deleted documents to compact a posting list.
+ */
+struct SetCompactionRatio {
+  double ratio;  ///< ratio of deleted documents
+
+  explicit SetCompactionRatio(double r) : ratio(r) { }
+  void operator()(StupaSearch &search) const {
+    search.set_compaction_ratio(ratio);
+  }
+};
+
+/**
+ * StupaSearch guarded by a read-write lock.
+ */
+class LockedSearch {
+ private:
+  StupaSearch search_;   ///< stupa search
+  ReadWriteMutex lock_;  ///< read-write lock
+
+ public:
+  /**
+   * Guard to read the index while it exists.
+   */
+  class Reader {
+   private:
+    RWGuard guard_;              ///< read lock
+    const StupaSearch &search_;  ///< stupa search
+
+   public:
+    explicit Reader(LockedSearch &store)
+      : guard_(store.lock_, 0), search_(store.search_) { }
+    const StupaSearch *operator->() const { return &search_; }
+  };
+
+  /**
+   * Constructor.
+   * @param invsize maximum size of inverted indexes
+   * @param max_doc maximum number of documents
+   * @param retention retention policy of inverted indexes
+   */
+  LockedSearch(size_t invsize, size_t max_doc,
+               InvertedIndex::RetentionPolicy retention)
+    : search_(SearchModel::INNER_PRODUCT, invsize, max_doc, retention) { }
+
+  /**
+   * Apply an update under the write lock.
+   * @param update update of the index
+   * @return wait time to acquire the lock (nsec)
+   */
+  template <typename Update>
+  uint64_t write(const Update &update) {
+    uint64_t start = get_time_nsec();
+    RWGuard m(lock_, 1);
+    uint64_t wait = get_time_nsec() - start;
+    update(search_);
+    return wait;
+  }
+};
+
+/**
+ * Two copies of StupaSearch whose readers never block (see LeftRight).
+ * Memory and update time are doubled.
+ */
+class LeftRightSearch {
+ private:
+  LeftRight<StupaSearch> search_;  ///< stupa search
+
+ public:
+  /**
+   * Guard to read the index while it exists.
+   */
+  class Reader {
+   private:
+    LeftRight<StupaSearch>::ReadGuard guard_;  ///< read indicator
+
+   public:
+    explicit Reader(LeftRightSearch &store) : guard_(store.search_) { }
+    const StupaSearch *operator->() const { return guard_.operator->(); }
+  };
+
+  /**
+   * Constructor.
+   * @param invsize maximum size of inverted indexes
+   * @param max_doc maximum number of documents
+   * @param retention retention policy of inverted indexes
+   */
+  LeftRightSearch(size_t invsize, size_t max_doc,
+                  InvertedIndex::RetentionPolicy retention)
+    : search_(new StupaSearch(SearchModel::INNER_PRODUCT, invsize, max_doc,
+                              retention),
+              new StupaSearch(SearchModel::INNER_PRODUCT, invsize, max_doc,
+                              retention)) { }
+
+  /**
+   * Apply an update to both copies.
+   * @param update update of the index
+   * @return wait time to acquire the lock of writers (nsec)
+   */
+  template <typename Update>
+  uint64_t write(const Update &update) {
+    uint64_t start = get_time_nsec();
+    LeftRight<StupaSearch>::WriteGuard writer(search_);
+    uint64_t wait = get_time_nsec() - start;
+    update(writer.standby());
+    writer.publish();
+    update(writer.standby());
+    return wait;
+  }
+};
 
-class SearchHandler : virtual public SearchIf {
+/**
+ * Handler of search requests.
+ * @param Store StupaSearch with concurrency control
+ *              (LockedSearch or LeftRightSearch)
+ */
+template <typename Store>
+class BasicSearchHandler : virtual public SearchIf {
  private:
-  StupaSearch stpsearch_;  ///< stupa search
-  ReadWriteMutex lock_;          ///< read-write lock
+  typedef typename Store::Reader Reader;
+
+  Store store_;                  ///< stupa search
+  Metrics metrics_;              ///< runtime metrics
+  SlowQueryLog slow_log_;        ///< log of slow and sampled queries
+  pthread_t compactor_;          ///< compaction thread
+  volatile bool compacting_;     ///< true while compaction thread runs
+  size_t compact_msec_;          ///< interval of compaction (msec)
+
+  /**
+   * Compact posting lists in background until stopped.  The lock of
+   * writers is released after every COMPACT_LISTS posting lists.
+   * @param arg handler
+   */
+  static void *run_compactor(void *arg) {
+    BasicSearchHandler *handler = reinterpret_cast<BasicSearchHandler *>(arg);
+    while (handler->compacting_) {
+      usleep(handler->compact_msec_ * 1000);
+      while (handler->compacting_
+             && handler->compact(COMPACT_LISTS) == COMPACT_LISTS) { }
+    }
+    return NULL;
+  }
+
+  /**
+   * Copy search results.
+   * @param results search results
+   * @param _return output search results
+   */
+  static void copy_results(
+    const std::vector<std::pair<std::string, double> > &results,
+    std::vector<SearchResult> &_return) {
+    _return.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      SearchResult sr;
+      sr.name = results[i].first;
+      sr.point = results[i].second;
+      _return[i] = sr;
+    }
+  }
 
  public:
-  SearchHandler(size_t invsize, size_t max_doc)
-    : stpsearch_(SearchModel::INNER_PRODUCT, invsize, max_doc) { }
+  BasicSearchHandler(size_t invsize, size_t max_doc,
+                     InvertedIndex::RetentionPolicy retention
+                       = InvertedIndex::RETAIN_RECENT)
+    : store_(invsize, max_doc, retention), compacting_(false),
+      compact_msec_(0) { }
+
+  ~BasicSearchHandler() {
+    if (compacting_) {
+      compacting_ = false;
+      pthread_join(compactor_, NULL);
+    }
+  }
 
   /**
    * Add a document.
@@ -55,9 +383,10 @@ class SearchHandler : virtual public SearchIf {
    */
   void add_document(const std::string &document_id,
                     const std::vector<std::string> &features) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::ADD);
     if (document_id.empty() || features.empty()) return;
-    RWGuard m(lock_, 1);
-    stpsearch_.add_document(document_id, features);
+    metrics_.record_lock_wait(Metrics::WRITE_LOCK,
+                              store_.write(AddDocument(document_id, features)));
   }
 
   /**
@@ -65,9 +394,10 @@ class SearchHandler : virtual public SearchIf {
    * @param document_id the identifier of document to be deleted
    */
   void delete_document(const std::string &document_id) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::DELETE);
     if (document_id.empty()) return;
-    RWGuard m(lock_, 1);
-    stpsearch_.delete_document(document_id);
+    metrics_.record_lock_wait(Metrics::WRITE_LOCK,
+                              store_.write(DeleteDocument(document_id)));
   }
 
   /**
@@ -75,16 +405,20 @@ class SearchHandler : virtual public SearchIf {
    * @return the number of documents
    */
   int64_t size() {
-    RWGuard m(lock_, 0);
-    return static_cast<uint64_t>(stpsearch_.size());
+    Metrics::ScopedTimer timer(metrics_, Metrics::SIZE);
+    uint64_t start = get_time_nsec();
+    Reader reader(store_);
+    metrics_.record_lock_wait(Metrics::READ_LOCK, get_time_nsec() - start);
+    return static_cast<uint64_t>(reader->size());
   }
 
   /**
    * Clear status.
    */
   void clear() {
-    RWGuard m(lock_, 1);
-    stpsearch_.clear();
+    Metrics::ScopedTimer timer(metrics_, Metrics::CLEAR);
+    metrics_.record_lock_wait(Metrics::WRITE_LOCK,
+                              store_.write(ClearDocuments()));
   }
 
   /**
@@ -96,16 +430,22 @@ class SearchHandler : virtual public SearchIf {
   void search_by_document(std::vector<SearchResult> & _return,
                           const int64_t max,
                           const std::vector<std::string> & query) {
-    RWGuard m(lock_, 0);
+    Metrics::ScopedTimer timer(metrics_, Metrics::SEARCH_BY_DOCUMENT);
+    SearchTrace trace;
     std::vector<std::pair<std::string, double> > results;
-    stpsearch_.search_by_document(query, results, max);
-    _return.resize(results.size());
-    for (size_t i = 0; i < results.size(); i++) {
-      SearchResult sr;
-      sr.name = results[i].first;
-      sr.point = results[i].second;
-      _return[i] = sr;
+    uint64_t start = get_time_nsec();
+    {
+      Reader reader(store_);
+      trace.lock_wait = get_time_nsec() - start;
+      metrics_.record_lock_wait(Metrics::READ_LOCK, trace.lock_wait);
+      reader->search_by_document(query, results, max, &trace);
+    }
+    metrics_.record(trace);
+    if (slow_log_.enabled()) {
+      slow_log_.record(Metrics::operation_name(Metrics::SEARCH_BY_DOCUMENT),
+                       query, trace, get_time_nsec() - start);
     }
+    copy_results(results, _return);
   }
 
   /**
@@ -117,16 +457,22 @@ class SearchHandler : virtual public SearchIf {
   void search_by_feature(std::vector<SearchResult> & _return,
                           const int64_t max,
                           const std::vector<std::string> & query) {
-    RWGuard m(lock_, 0);
+    Metrics::ScopedTimer timer(metrics_, Metrics::SEARCH_BY_FEATURE);
+    SearchTrace trace;
     std::vector<std::pair<std::string, double> > results;
-    stpsearch_.search_by_feature(query, results, max);
-    _return.resize(results.size());
-    for (size_t i = 0; i < results.size(); i++) {
-      SearchResult sr;
-      sr.name = results[i].first;
-      sr.point = results[i].second;
-      _return[i] = sr;
+    uint64_t start = get_time_nsec();
+    {
+      Reader reader(store_);
+      trace.lock_wait = get_time_nsec() - start;
+      metrics_.record_lock_wait(Metrics::READ_LOCK, trace.lock_wait);
+      reader->search_by_feature(query, results, max, &trace);
+    }
+    metrics_.record(trace);
+    if (slow_log_.enabled()) {
+      slow_log_.record(Metrics::operation_name(Metrics::SEARCH_BY_FEATURE),
+                       query, trace, get_time_nsec() - start);
     }
+    copy_results(results, _return);
   }
 
   /**
@@ -135,13 +481,16 @@ class SearchHandler : virtual public SearchIf {
    * @return return true if sccessed
    */
   bool save(const std::string& filename) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::SAVE);
     std::ofstream ofs(filename.c_str());
     if (!ofs) {
       fprintf(stderr, "Cannot open file %s\n", filename.c_str());
       return false;
     }
-    RWGuard m(lock_, 0);
-    stpsearch_.save(ofs);
+    uint64_t start = get_time_nsec();
+    Reader reader(store_);
+    metrics_.record_lock_wait(Metrics::READ_LOCK, get_time_nsec() - start);
+    reader->save(ofs);
     return true;
   }
 
@@ -151,33 +500,202 @@ class SearchHandler : virtual public SearchIf {
    * @return true if successed
    */
   bool load(const std::string& filename) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::LOAD);
     std::ifstream ifs(filename.c_str());
     if (!ifs) {
       fprintf(stderr, "Cannot open file %s\n", filename.c_str());
       return false;
     }
-    RWGuard m(lock_, 1);
-    stpsearch_.load(ifs);
+    metrics_.record_lock_wait(Metrics::WRITE_LOCK,
+                              store_.write(LoadDocuments(filename)));
     return true;
   }
+
+  /**
+   * Get runtime metrics and statistics of index.
+   * @param _return output 'name \t value' lines
+   */
+  void stats(std::string &_return) {
+    Metrics::ScopedTimer timer(metrics_, Metrics::STATS);
+    IndexStatistics stats;
+    {
+      uint64_t start = get_time_nsec();
+      Reader reader(store_);
+      metrics_.record_lock_wait(Metrics::READ_LOCK, get_time_nsec() - start);
+      reader->statistics(stats);
+    }
+    std::ostringstream oss;
+    metrics_.write(oss);
+    stats.write(oss);
+    _return = oss.str();
+  }
+
+  /**
+   * Get the latest entries of the slow-query log.
+   * @param _return output entries (one entry per line)
+   */
+  void slow_queries(std::string &_return) {
+    _return.clear();
+    slow_log_.recent(_return);
+  }
+
+  /**
+   * Get the log of slow and sampled queries to configure it.
+   * @return slow-query log
+   */
+  SlowQueryLog &slow_log() { return slow_log_; }
+
+  /**
+   * Purge deleted documents from posting lists.
+   * @param max_lists maximum number of posting lists to be compacted
+   * @return the number of compacted posting lists
+   */
+  size_t compact(size_t max_lists) {
+    size_t count = 0;
+    metrics_.record_lock_wait(Metrics::WRITE_LOCK,
+                              store_.write(CompactIndex(max_lists, &count)));
+    return count;
+  }
+
+  /**
+   * Set the ratio of deleted documents to compact a posting list.
+   * @param ratio ratio of deleted documents in a posting list
+   */
+  void set_compaction_ratio(double ratio) {
+    store_.write(SetCompactionRatio(ratio));
+  }
+
+  /**
+   * Set the number of documents to be read in each posting list.
+   * @param depth the number of documents (0: all documents)
+   */
+  void set_lookup_depth(size_t depth) {
+    store_.write(SetLookupDepth(depth));
+  }
+
+  /**
+   * Set the size of high-impact tier of long posting lists.
+   * @param size the number of high-impact documents (0: no tiers)
+   */
+  void set_tier_size(size_t size) { store_.write(SetTierSize(size)); }
+
+  /**
+   * Set the memory budget of the cache of decoded posting lists.
+   * @param bytes memory budget (0: no cache)
+   */
+  void set_posting_cache(size_t bytes) {
+    store_.write(SetPostingCache(bytes));
+  }
+
+  /**
+   * Find candidates of searches by documents with MinHash index.
+   * @param bands the number of bands (0: use inverted indexes)
+   * @param rows the number of rows in a band
+   */
+  void set_minhash(size_t bands, size_t rows) {
+    store_.write(SetMinHash(bands, rows));
+  }
+
+  /**
+   * Score only candidates of the nearest SimHash signatures to queries.
+   * @param bits bits of a signature (64, 128 or 256, 0: not used)
+   * @param max the number of candidates to be scored
+   */
+  void set_prefilter(size_t bits, size_t max) {
+    store_.write(SetPrefilter(bits, max));
+  }
+
+  /**
+   * Set the planner choosing lookup of inverted indexes or scan of documents.
+   * @param planner planner
+   * @param threads the number of threads to scan documents
+   */
+  void set_planner(StupaSearch::Planner planner, size_t threads) {
+    store_.write(SetPlanner(planner, threads));
+  }
+
+  /**
+   * Set the ratio of documents over which a feature is not looked up.
+   * @param ratio ratio of documents which have a feature (0: off)
+   */
+  void set_max_df(double ratio) { store_.write(SetMaxDf(ratio)); }
+
+  /**
+   * Skip the most frequent features within a ratio of postings in lookup.
+   * @param ratio ratio of postings of skipped features (0: off)
+   */
+  void set_skip_postings(double ratio) {
+    store_.write(SetSkipPostings(ratio));
+  }
+
+  /**
+   * Start the thread compacting posting lists in background.
+   * @param msec interval of compaction (msec)
+   */
+  void start_compactor(size_t msec) {
+    if (compacting_ || msec == 0) return;
+    compact_msec_ = msec;
+    compacting_ = true;
+    pthread_create(&compactor_, NULL, run_compactor, this);
+  }
 };
 
+/** handler guarded by a read-write lock */
+typedef BasicSearchHandler<LockedSearch> SearchHandler;
+/** handler whose readers never block */
+typedef BasicSearchHandler<LeftRightSearch> LeftRightSearchHandler;
+
 /**
  * Parameters to start stupa server
  */
 struct ServerParam {
-  int    port;         ///< port number.
-  size_t max_doc;      ///< maximum number of documents.
-  int    workerCount;  ///< the number of worker threads.
-  size_t invsize;      ///< maximum size of inverted indexes.
-  char   *filename;    ///< path of input file.
+  int    port;           ///< port number.
+  size_t max_doc;        ///< maximum number of documents.
+  int    workerCount;    ///< the number of worker threads.
+  int    ioThreadCount;  ///< the number of IO threads (nonblocking server).
+  bool   compact;        ///< use compact protocol.
+  bool   leftRight;      ///< use the handler whose readers never block.
+  size_t invsize;        ///< maximum size of inverted indexes.
+  char   *filename;      ///< path of input file.
+  char   *log_path;      ///< path of slow-query log.
+  double log_msec;       ///< threshold of slow queries (msec, 0: off).
+  size_t log_sample;     ///< log every N-th query (0: off).
+  size_t log_bytes;      ///< maximum size of a log file.
+  size_t compact_msec;   ///< interval of compaction (msec, 0: off).
+  double compact_ratio;  ///< ratio of deleted documents to compact.
+  InvertedIndex::RetentionPolicy retention;  ///< retention policy.
+  size_t lookupDepth;    ///< documents to be read in each posting list.
+  size_t tierSize;       ///< size of high-impact tier of posting lists.
+  size_t postingCache;   ///< bytes of cache of decoded posting lists.
+  double maxDf;          ///< ratio of documents to skip features in lookup.
+  double skipPostings;   ///< ratio of postings of skipped features.
+  size_t minhashBands;   ///< bands of MinHash index (0: not used).
+  size_t minhashRows;    ///< rows in a band of MinHash index.
+  size_t signatureBits;  ///< bits of SimHash signatures (0: not used).
+  size_t scored;         ///< candidates to be scored after prefilter.
+  StupaSearch::Planner planner;  ///< plan of searches.
+  size_t scanThreads;    ///< the number of threads to scan documents.
 
   ServerParam() : port(PORT), max_doc(0), workerCount(WORKER_COUNT),
-                  invsize(INV_SIZE), filename(NULL) { }
+                  ioThreadCount(IO_THREAD_COUNT), compact(false),
+                  leftRight(false), invsize(INV_SIZE), filename(NULL),
+                  log_path(NULL), log_msec(0), log_sample(0),
+                  log_bytes(SlowQueryLog::DEFAULT_MAX_BYTES),
+                  compact_msec(COMPACT_MSEC),
+                  compact_ratio(InvertedIndex::DEFAULT_COMPACTION_RATIO),
+                  retention(InvertedIndex::RETAIN_RECENT), lookupDepth(0),
+                  tierSize(0), postingCache(0), maxDf(0), skipPostings(0),
+                  minhashBands(0), minhashRows(MinHashIndex::DEFAULT_ROWS),
+                  signatureBits(0),
+                  scored(0), planner(StupaSearch::PLANNER_LOOKUP),
+                  scanThreads(1) { }
 };
 
 void usage(const char *progname);
 void parse_options(int argc, char **argv, ServerParam &param);
+boost::shared_ptr<SearchIf> create_handler(const ServerParam &param);
+boost::shared_ptr<TProtocolFactory> create_protocol_factory(
+  const ServerParam &param);
 
 }}  /* namespace stupa::thrift */
 
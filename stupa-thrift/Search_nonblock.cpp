@@ -48,11 +48,9 @@ int main(int argc, char **argv) {
 }
 
 void start_nonblocking_thread_server(const ServerParam &param) {
-  shared_ptr<SearchHandler> handler(
-    new SearchHandler(param.invsize, param.max_doc));
-  if (param.filename) handler->load(param.filename);
+  shared_ptr<SearchIf> handler = create_handler(param);
   shared_ptr<TProcessor> processor(new SearchProcessor(handler));
-  shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  shared_ptr<TProtocolFactory> protocolFactory = create_protocol_factory(param);
 
   shared_ptr<ThreadManager> threadManager =
     ThreadManager::newSimpleThreadManager(param.workerCount);
@@ -63,5 +61,6 @@ void start_nonblocking_thread_server(const ServerParam &param) {
 
   TNonblockingServer server(processor, protocolFactory, param.port,
                             threadManager);
+  server.setNumIOThreads(param.ioThreadCount);
   server.serve();
 }
@@ -52,26 +52,22 @@ int main(int argc, char **argv) {
 }
 
 void start_simple_server(const ServerParam &param) {
-  shared_ptr<SearchHandler> handler(
-    new SearchHandler(param.invsize, param.max_doc));
-  if (param.filename) handler->load(param.filename);
+  shared_ptr<SearchIf> handler = create_handler(param);
   shared_ptr<TProcessor> processor(new SearchProcessor(handler));
   shared_ptr<TServerTransport> serverTransport(new TServerSocket(param.port));
   shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
-  shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  shared_ptr<TProtocolFactory> protocolFactory = create_protocol_factory(param);
 
   TSimpleServer server(processor, serverTransport, transportFactory, protocolFactory);
   server.serve();
 }
 
 void start_thread_pool_server(const ServerParam &param) {
-  shared_ptr<SearchHandler> handler(
-    new SearchHandler(param.invsize, param.max_doc));
-  if (param.filename) handler->load(param.filename);
+  shared_ptr<SearchIf> handler = create_handler(param);
   shared_ptr<TProcessor> processor(new SearchProcessor(handler));
   shared_ptr<TServerTransport> serverTransport(new TServerSocket(param.port));
   shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
-  shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  shared_ptr<TProtocolFactory> protocolFactory = create_protocol_factory(param);
 
   shared_ptr<ThreadManager> threadManager =
     ThreadManager::newSimpleThreadManager(param.workerCount);
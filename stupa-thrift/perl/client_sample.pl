@@ -68,6 +68,26 @@ if ($@) {
     exit 1;
 }
 
+# get runtime metrics
+eval {
+    my $stats = $client->stats();
+    print "Stats:\n$stats";
+};
+if ($@) {
+    print "[ERROR] ", $@->{message}, "\n";
+    exit 1;
+}
+
+# get slow and sampled queries
+eval {
+    my $slow_queries = $client->slow_queries();
+    print "Slow queries:\n$slow_queries";
+};
+if ($@) {
+    print "[ERROR] ", $@->{message}, "\n";
+    exit 1;
+}
+
 # search by document ids
 my @queries = ('Fred');
 my $max = 20;
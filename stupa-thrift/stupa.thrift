@@ -14,5 +14,7 @@ service Search {
   list<SearchResult> search_by_document(1: i64 max, 2: list<string> query),
   list<SearchResult> search_by_feature(1: i64 max, 2: list<string> query),
   bool save(1: string filename),
-  bool load(1: string filename)
+  bool load(1: string filename),
+  string stats(),
+  string slow_queries()
 }
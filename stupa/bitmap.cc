@@ -0,0 +1,210 @@
+//
+// Compressed bitmap of integers (Roaring bitmap)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include <cstring>
+#include "bitmap.h"
+#include "util.h"
+
+namespace stupa {
+
+namespace {
+/** words of a bitmap container */
+const size_t BITMAP_WORDS = 65536 / 64;
+
+/**
+ * Get words of the data of a container.
+ * @param count the number of integers of the container
+ * @return words of the data
+ */
+inline size_t container_words(size_t count) {
+  return count > BITMAP_ARRAY_MAX ? BITMAP_WORDS : (count + 3) / 4;
+}
+
+/**
+ * Count integers of each container.
+ * @param v input array of sorted integers
+ * @param counts output <high bits, the number of integers> of containers
+ */
+void count_containers(const std::vector<Identifier> &v,
+                      std::vector<std::pair<uint64_t, uint64_t> > &counts) {
+  for (size_t i = 0; i < v.size(); i++) {
+    uint64_t high = static_cast<uint64_t>(v[i]) >> 16;
+    if (counts.empty() || counts.back().first != high) {
+      counts.push_back(std::pair<uint64_t, uint64_t>(high, 0));
+    }
+    counts.back().second++;
+  }
+}
+} /* namespace */
+
+/**
+ * Get size of compressed bitmap of integers before compression.
+ */
+size_t sizeof_bitmap(const std::vector<Identifier> &v) {
+  size_t words = 2;
+  uint64_t high = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < v.size(); i++) {
+    uint64_t h = static_cast<uint64_t>(v[i]) >> 16;
+    if (count > 0 && h != high) {
+      words += 2 + container_words(count);
+      count = 0;
+    }
+    high = h;
+    count++;
+  }
+  if (count > 0) words += 2 + container_words(count);
+  return words * sizeof(uint64_t);
+}
+
+/**
+ * Bitmap compression.
+ */
+char *compress_bitmap(const std::vector<Identifier> &v) {
+  if (v.empty()) return NULL;
+  std::vector<std::pair<uint64_t, uint64_t> > counts;
+  count_containers(v, counts);
+  size_t size = sizeof_bitmap(v);
+  char *buf = new char[size];
+  std::memset(buf, 0, size);
+  uint64_t *words = reinterpret_cast<uint64_t *>(buf);
+  words[0] = v.size();
+  words[1] = counts.size();
+  uint64_t *header = words + 2;
+  uint64_t *data = header + 2 * counts.size();
+  size_t i = 0;
+  for (size_t c = 0; c < counts.size(); c++) {
+    header[2 * c] = counts[c].first;
+    header[2 * c + 1] = counts[c].second;
+    size_t count = static_cast<size_t>(counts[c].second);
+    if (count > BITMAP_ARRAY_MAX) {
+      for (size_t j = 0; j < count; j++, i++) {
+        uint64_t low = static_cast<uint64_t>(v[i]) & 0xffff;
+        data[low >> 6] |= static_cast<uint64_t>(1) << (low & 63);
+      }
+    } else {
+      uint16_t *array = reinterpret_cast<uint16_t *>(data);
+      for (size_t j = 0; j < count; j++, i++) {
+        array[j] = static_cast<uint16_t>(v[i] & 0xffff);
+      }
+    }
+    data += container_words(count);
+  }
+  return buf;
+}
+
+/**
+ * Bitmap decompression.
+ */
+void decompress_bitmap(const char *ptr, std::vector<Identifier> &v) {
+  if (!ptr) return;
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(ptr);
+  v.reserve(v.size() + static_cast<size_t>(words[0]));
+  size_t num = static_cast<size_t>(words[1]);
+  const uint64_t *header = words + 2;
+  const uint64_t *data = header + 2 * num;
+  for (size_t c = 0; c < num; c++) {
+    uint64_t base = header[2 * c] << 16;
+    size_t count = static_cast<size_t>(header[2 * c + 1]);
+    if (count > BITMAP_ARRAY_MAX) {
+      for (size_t w = 0; w < BITMAP_WORDS; w++) {
+        uint64_t word = data[w];
+        while (word) {
+          v.push_back(static_cast<Identifier>(base + w * 64 + ctz64(word)));
+          word &= word - 1;
+        }
+      }
+    } else {
+      const uint16_t *array = reinterpret_cast<const uint16_t *>(data);
+      for (size_t j = 0; j < count; j++) {
+        v.push_back(static_cast<Identifier>(base + array[j]));
+      }
+    }
+    data += container_words(count);
+  }
+}
+
+/**
+ * Get size of compressed bitmap.
+ */
+size_t sizeof_bitmap(const char *ptr) {
+  if (!ptr) return 0;
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(ptr);
+  size_t num = static_cast<size_t>(words[1]);
+  size_t size = 2 + 2 * num;
+  for (size_t c = 0; c < num; c++) {
+    size += container_words(static_cast<size_t>(words[2 + 2 * c + 1]));
+  }
+  return size * sizeof(uint64_t);
+}
+
+/**
+ * Get the number of integers of compressed bitmap.
+ */
+size_t count_bitmap(const char *ptr) {
+  if (!ptr) return 0;
+  return static_cast<size_t>(reinterpret_cast<const uint64_t *>(ptr)[0]);
+}
+
+/**
+ * Get the smallest integer of compressed bitmap.
+ */
+Identifier first_bitmap(const char *ptr) {
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(ptr);
+  const uint64_t *header = words + 2;
+  const uint64_t *data = header + 2 * words[1];
+  uint64_t base = header[0] << 16;
+  if (header[1] <= BITMAP_ARRAY_MAX) {
+    return static_cast<Identifier>(
+      base + reinterpret_cast<const uint16_t *>(data)[0]);
+  }
+  size_t w = 0;
+  while (!data[w]) w++;
+  return static_cast<Identifier>(base + w * 64 + ctz64(data[w]));
+}
+
+/**
+ * Check whether compressed bitmap has an integer.
+ */
+bool find_bitmap(const char *ptr, Identifier id) {
+  if (!ptr) return false;
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(ptr);
+  size_t num = static_cast<size_t>(words[1]);
+  const uint64_t *header = words + 2;
+  const uint64_t *data = header + 2 * num;
+  uint64_t high = static_cast<uint64_t>(id) >> 16;
+  uint64_t low = static_cast<uint64_t>(id) & 0xffff;
+  for (size_t c = 0; c < num && header[2 * c] <= high; c++) {
+    size_t count = static_cast<size_t>(header[2 * c + 1]);
+    if (header[2 * c] < high) {
+      data += container_words(count);
+      continue;
+    }
+    if (count > BITMAP_ARRAY_MAX) {
+      return (data[low >> 6] >> (low & 63)) & 1;
+    }
+    const uint16_t *array = reinterpret_cast<const uint16_t *>(data);
+    return std::binary_search(array, array + count,
+                              static_cast<uint16_t>(low));
+  }
+  return false;
+}
+
+} /* namespace stupa */
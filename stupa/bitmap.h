@@ -0,0 +1,95 @@
+//
+// Compressed bitmap of integers (Roaring bitmap)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_BITMAP_H_
+#define STUPA_BITMAP_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include "identifier.h"
+
+namespace stupa {
+
+/*
+ * Sorted integers are divided into containers by their high bits
+ * (integer >> 16).  A container of up to BITMAP_ARRAY_MAX integers is
+ * an array of their low 16 bits, and a denser container is a bitmap of
+ * 65536 bits.  Compressed data is a sequence of 64-bit words:
+ * the number of integers, the number of containers, <high bits,
+ * the number of integers> of each container, then the arrays (padded to
+ * words) and bitmaps of the containers.
+ */
+
+/** Maximum number of integers in an array container */
+const size_t BITMAP_ARRAY_MAX = 4096;
+
+/**
+ * Get size of compressed bitmap of integers before compression.
+ * @param v input array of sorted integers
+ * @return size of compressed data
+ */
+size_t sizeof_bitmap(const std::vector<Identifier> &v);
+
+/**
+ * Bitmap compression.
+ * @param v input array of sorted integers
+ * @return compressed data (NULL: empty input), must be deleted later
+ */
+char *compress_bitmap(const std::vector<Identifier> &v);
+
+/**
+ * Bitmap decompression.
+ * @param ptr compressed data
+ * @param v output array of integers (appended)
+ */
+void decompress_bitmap(const char *ptr, std::vector<Identifier> &v);
+
+/**
+ * Get size of compressed bitmap.
+ * @param ptr compressed data
+ * @return size of compressed data
+ */
+size_t sizeof_bitmap(const char *ptr);
+
+/**
+ * Get the number of integers of compressed bitmap.
+ * @param ptr compressed data
+ * @return the number of integers
+ */
+size_t count_bitmap(const char *ptr);
+
+/**
+ * Get the smallest integer of compressed bitmap.
+ * @param ptr compressed data
+ * @return the smallest integer
+ */
+Identifier first_bitmap(const char *ptr);
+
+/**
+ * Check whether compressed bitmap has an integer.
+ * @param ptr compressed data
+ * @param id integer
+ * @return true if found
+ */
+bool find_bitmap(const char *ptr, Identifier id);
+
+} /* namespace stupa */
+
+#endif  // STUPA_BITMAP_H_
@@ -0,0 +1,80 @@
+//
+// Tests for compressed bitmap of integers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <ctime>
+#include <set>
+#include <vector>
+#include "bitmap.h"
+
+namespace {
+
+/* check compression and decompression of integers */
+void check_bitmap(const std::vector<stupa::Identifier> &input) {
+  char *bitmap = stupa::compress_bitmap(input);
+  ASSERT_TRUE(bitmap != NULL);
+  EXPECT_EQ(stupa::sizeof_bitmap(input), stupa::sizeof_bitmap(bitmap));
+  EXPECT_EQ(input.size(), stupa::count_bitmap(bitmap));
+  EXPECT_EQ(input[0], stupa::first_bitmap(bitmap));
+  std::vector<stupa::Identifier> v;
+  stupa::decompress_bitmap(bitmap, v);
+  EXPECT_TRUE(v == input);
+  delete [] bitmap;
+}
+
+} /* namespace */
+
+/* containers of arrays */
+TEST(BitmapTest, ArrayTest) {
+  std::set<stupa::Identifier> ids;
+  while (ids.size() < 1000) ids.insert(rand() % 1000000 + 1);
+  std::vector<stupa::Identifier> input(ids.begin(), ids.end());
+  check_bitmap(input);
+
+  std::vector<stupa::Identifier> one(1, 65536 * 3 + 5);
+  check_bitmap(one);
+
+  EXPECT_TRUE(stupa::compress_bitmap(std::vector<stupa::Identifier>())
+              == NULL);
+  EXPECT_EQ(0, stupa::sizeof_bitmap(static_cast<const char *>(NULL)));
+  EXPECT_EQ(0, stupa::count_bitmap(NULL));
+}
+
+/* containers of bitmaps and arrays */
+TEST(BitmapTest, DenseTest) {
+  std::vector<stupa::Identifier> input;
+  // a bitmap starting at a high bit, an array, and a full bitmap
+  for (stupa::Identifier id = 100; id < 65536; id += 3) input.push_back(id);
+  for (stupa::Identifier id = 65536; id < 65536 + 100; id++) {
+    input.push_back(id);
+  }
+  for (stupa::Identifier id = 65536 * 2 + 65535; id < 65536 * 4; id++) {
+    input.push_back(id);
+  }
+  check_bitmap(input);
+  // bitmaps of dense integers are smaller than 2 bytes per integer
+  EXPECT_GT(input.size() * 2, stupa::sizeof_bitmap(input));
+}
+
+int main(int argc, char **argv) {
+  srand((unsigned int)time(NULL));
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,196 @@
+//
+// Tests for cache of decoded posting lists
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+#include "posting_cache.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_SEGMENT = 4;     ///< number of impacts of a posting list
+const size_t NUM_READER  = 4;     ///< number of reader threads
+const size_t NUM_READ    = 1000;  ///< number of reads of a thread
+const size_t MAX_BYTES   = 1024 * 1024;  ///< memory budget
+
+/* add documents of some impacts to a posting list */
+void add_documents(stupa::ImpactPostingList &plist, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    plist.add(static_cast<stupa::DocumentId>(i * 3 + 1),
+              static_cast<unsigned char>(i % NUM_SEGMENT));
+  }
+}
+
+/* check that the cache reads the same documents as the list */
+void check_list(stupa::PostingCache &cache, stupa::FeatureId feature_id,
+                const stupa::ImpactPostingList &plist,
+                size_t max, size_t from) {
+  std::vector<stupa::DocumentId> expected, actual(1, 0);
+  size_t expected_next = plist.list(expected, max, from);
+  EXPECT_EQ(expected_next, cache.list(feature_id, plist, actual, max, from));
+  // documents are appended
+  ASSERT_EQ(expected.size() + 1, actual.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                         actual.begin() + 1));
+}
+
+/* arguments of a reader thread */
+struct ReaderArg {
+  stupa::PostingCache *cache;            ///< shared cache
+  const stupa::ImpactPostingList *plist;  ///< posting list
+  size_t errors;                          ///< the number of wrong reads
+};
+
+/* read a posting list through the cache */
+static void *read_list(void *arg) {
+  ReaderArg *r = reinterpret_cast<ReaderArg *>(arg);
+  std::vector<stupa::DocumentId> expected, v;
+  r->plist->list(expected);
+  for (size_t i = 0; i < NUM_READ; i++) {
+    v.clear();
+    r->cache->list(1, *r->plist, v, 0, 0);
+    if (v != expected) r->errors++;
+  }
+  return NULL;
+}
+
+} /* namespace */
+
+/* list */
+TEST(PostingCacheTest, ListTest) {
+  stupa::ImpactPostingList plist;
+  add_documents(plist, stupa::PostingCache::MIN_POSTINGS * 2);
+  ASSERT_EQ(NUM_SEGMENT, plist.segments());
+  stupa::PostingCache cache(MAX_BYTES);
+
+  check_list(cache, 1, plist, 0, 0);
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_EQ(1, cache.size());
+  EXPECT_LT(0, cache.bytes());
+
+  // every shape of reads is served by the entry
+  check_list(cache, 1, plist, 0, 0);
+  check_list(cache, 1, plist, 1, 0);
+  check_list(cache, 1, plist, stupa::PostingCache::MIN_POSTINGS, 1);
+  check_list(cache, 1, plist, 0, NUM_SEGMENT - 1);
+  check_list(cache, 1, plist, 0, NUM_SEGMENT);
+  EXPECT_EQ(5, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+
+  // short posting lists are not cached
+  stupa::ImpactPostingList short_list;
+  add_documents(short_list, 10);
+  check_list(cache, 2, short_list, 0, 0);
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(1, cache.misses());
+
+  cache.clear();
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(0, cache.bytes());
+
+  // no cache without a memory budget
+  stupa::PostingCache disabled;
+  check_list(disabled, 1, plist, 0, 0);
+  EXPECT_EQ(0, disabled.size());
+}
+
+/* invalidation by versions */
+TEST(PostingCacheTest, VersionTest) {
+  stupa::ImpactPostingList plist;
+  add_documents(plist, stupa::PostingCache::MIN_POSTINGS * 2);
+  stupa::PostingCache cache(MAX_BYTES);
+  check_list(cache, 1, plist, 0, 0);
+
+  uint64_t version = plist.version();
+  plist.add(2, 0);
+  EXPECT_NE(version, plist.version());
+  check_list(cache, 1, plist, 0, 0);
+  EXPECT_EQ(2, cache.misses());
+
+  version = plist.version();
+  plist.remove(2);
+  EXPECT_NE(version, plist.version());
+  check_list(cache, 1, plist, 0, 0);
+  EXPECT_EQ(3, cache.misses());
+  EXPECT_EQ(1, cache.size());
+
+  // a new list of the same feature never has the version of an old one
+  stupa::ImpactPostingList other(plist);
+  EXPECT_NE(plist.version(), other.version());
+  check_list(cache, 1, other, 0, 0);
+  EXPECT_EQ(4, cache.misses());
+}
+
+/* eviction of least recently used entries */
+TEST(PostingCacheTest, EvictionTest) {
+  stupa::ImpactPostingList plist;
+  add_documents(plist, stupa::PostingCache::MIN_POSTINGS * 2);
+  stupa::PostingCache cache(MAX_BYTES);
+  check_list(cache, 1, plist, 0, 0);
+  size_t bytes = cache.bytes();
+
+  // budget of two entries
+  cache.set_max_bytes(bytes * 2);
+  check_list(cache, 2, plist, 0, 0);
+  check_list(cache, 1, plist, 0, 0);  // feature 2 is least recently used
+  check_list(cache, 3, plist, 0, 0);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(1, cache.evictions());
+  EXPECT_GE(bytes * 2, cache.bytes());
+  check_list(cache, 1, plist, 0, 0);
+  EXPECT_EQ(2, cache.hits());
+  check_list(cache, 2, plist, 0, 0);
+  EXPECT_EQ(4, cache.misses());
+
+  // entries over the budget are not cached
+  cache.set_max_bytes(bytes / 2);
+  EXPECT_EQ(0, cache.size());
+  check_list(cache, 1, plist, 0, 0);
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(0, cache.bytes());
+}
+
+/* reads of many threads */
+TEST(PostingCacheTest, ThreadTest) {
+  stupa::ImpactPostingList plist;
+  add_documents(plist, stupa::PostingCache::MIN_POSTINGS * 4);
+  stupa::PostingCache cache(MAX_BYTES);
+  pthread_t threads[NUM_READER];
+  ReaderArg args[NUM_READER];
+  for (size_t i = 0; i < NUM_READER; i++) {
+    args[i].cache = &cache;
+    args[i].plist = &plist;
+    args[i].errors = 0;
+    pthread_create(&threads[i], NULL, read_list, &args[i]);
+  }
+  for (size_t i = 0; i < NUM_READER; i++) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, args[i].errors);
+  }
+  EXPECT_EQ(NUM_READER * NUM_READ, cache.hits() + cache.misses());
+  EXPECT_EQ(1, cache.size());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
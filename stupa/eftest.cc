@@ -0,0 +1,124 @@
+//
+// Tests for Elias-Fano code
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include "elias_fano.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_INTEGERS = 1000;  ///< the number of integers
+
+/* set random sorted integers (may be duplicated) */
+void random_integers(size_t size, stupa::Identifier max,
+                     std::vector<stupa::Identifier> &v) {
+  for (size_t i = 0; i < size; i++) v.push_back(rand() % max);
+  std::sort(v.begin(), v.end());
+}
+
+/* check compression, decompression and random access */
+void check_elias_fano(const std::vector<stupa::Identifier> &input) {
+  char *ef = stupa::compress_elias_fano(input);
+  ASSERT_TRUE(ef != NULL);
+  EXPECT_EQ(input.size(), stupa::count_elias_fano(ef));
+  EXPECT_LT(0, stupa::sizeof_elias_fano(ef));
+  std::vector<stupa::Identifier> v;
+  stupa::decompress_elias_fano(ef, v);
+  EXPECT_TRUE(v == input);
+
+  stupa::EliasFanoReader reader(ef);
+  EXPECT_EQ(input.size(), reader.size());
+  EXPECT_EQ(stupa::sizeof_elias_fano(ef), reader.bytes());
+  for (size_t i = 0; i < input.size(); i += 7) {
+    EXPECT_EQ(input[i], reader.access(i));
+  }
+  EXPECT_EQ(input.back(), reader.access(input.size() - 1));
+  delete [] ef;
+}
+
+} /* namespace */
+
+/* compression and random access */
+TEST(EliasFanoTest, CompressTest) {
+  std::vector<stupa::Identifier> sparse, dense, one(1, 12345);
+  random_integers(NUM_INTEGERS, 1000000, sparse);
+  random_integers(NUM_INTEGERS, 100, dense);  // no lower bits
+  check_elias_fano(sparse);
+  check_elias_fano(dense);
+  check_elias_fano(one);
+
+  // large integers
+  std::vector<stupa::Identifier> large;
+  large.push_back(0);
+  large.push_back(stupa::FEATURE_MAX_ID - 1);
+  large.push_back(stupa::FEATURE_MAX_ID);
+  check_elias_fano(large);
+
+  EXPECT_TRUE(stupa::compress_elias_fano(std::vector<stupa::Identifier>())
+              == NULL);
+  EXPECT_EQ(0, stupa::sizeof_elias_fano(NULL));
+  EXPECT_EQ(0, stupa::count_elias_fano(NULL));
+  stupa::EliasFanoReader empty(NULL);
+  EXPECT_TRUE(empty.end());
+  EXPECT_FALSE(empty.next_geq(0));
+}
+
+/* skips of the cursor */
+TEST(EliasFanoTest, NextGeqTest) {
+  std::vector<stupa::Identifier> input;
+  random_integers(NUM_INTEGERS, 100000, input);
+  char *ef = stupa::compress_elias_fano(input);
+  std::vector<stupa::Identifier> targets;
+  random_integers(NUM_INTEGERS / 10, 110000, targets);
+
+  stupa::EliasFanoReader reader(ef);
+  for (size_t i = 0; i < targets.size(); i++) {
+    std::vector<stupa::Identifier>::const_iterator it =
+      std::lower_bound(input.begin(), input.end(), targets[i]);
+    if (it == input.end()) {
+      EXPECT_FALSE(reader.next_geq(targets[i]));
+      EXPECT_TRUE(reader.end());
+    } else {
+      ASSERT_TRUE(reader.next_geq(targets[i]));
+      EXPECT_EQ(*it, reader.value());
+    }
+  }
+
+  // the cursor does not move backward
+  stupa::EliasFanoReader sequential(ef);
+  ASSERT_TRUE(sequential.next_geq(input[NUM_INTEGERS / 2]));
+  EXPECT_TRUE(sequential.next_geq(0));
+  EXPECT_EQ(input[NUM_INTEGERS / 2], sequential.value());
+  size_t count = 0;
+  for (; !sequential.end(); sequential.next()) count++;
+  EXPECT_EQ(input.end() - std::lower_bound(input.begin(), input.end(),
+                                           input[NUM_INTEGERS / 2]),
+            static_cast<ptrdiff_t>(count));
+  delete [] ef;
+}
+
+int main(int argc, char **argv) {
+  srand((unsigned int)time(NULL));
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,195 @@
+//
+// Elias-Fano code of sorted integers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include "elias_fano.h"
+#include "util.h"
+
+namespace stupa {
+
+namespace {
+/** words of the header (the number of integers, lower bits, largest) */
+const size_t EF_HEADER_WORDS = 3;
+
+/**
+ * Words of each part of Elias-Fano code.
+ */
+struct EliasFanoLayout {
+  size_t samples;  ///< words of sampled positions
+  size_t upper;    ///< words of upper bits
+  size_t lower;    ///< words of lower bits
+
+  /**
+   * Constructor.
+   * @param size the number of integers
+   * @param lower_bits the number of lower bits
+   * @param largest the largest integer
+   */
+  EliasFanoLayout(uint64_t size, uint64_t lower_bits, uint64_t largest) {
+    samples = static_cast<size_t>((size + EF_SAMPLE - 1) / EF_SAMPLE);
+    upper = static_cast<size_t>((size + (largest >> lower_bits) + 63) / 64);
+    lower = static_cast<size_t>((size * lower_bits + 63) / 64);
+  }
+
+  /**
+   * Get words of all parts with the header.
+   * @return words
+   */
+  size_t words() const { return EF_HEADER_WORDS + samples + upper + lower; }
+};
+} /* namespace */
+
+/**
+ * Elias-Fano compression.
+ */
+char *compress_elias_fano(const std::vector<Identifier> &v) {
+  if (v.empty()) return NULL;
+  uint64_t size = v.size();
+  uint64_t largest = v.back();
+  uint64_t lower_bits = 0;
+  while (lower_bits < 63
+         && (static_cast<uint64_t>(1) << (lower_bits + 1)) <= largest / size) {
+    lower_bits++;
+  }
+  EliasFanoLayout layout(size, lower_bits, largest);
+  std::vector<uint64_t> words(layout.words(), 0);
+  words[0] = size;
+  words[1] = lower_bits;
+  words[2] = largest;
+  uint64_t *samples = &words[EF_HEADER_WORDS];
+  uint64_t *upper = samples + layout.samples;
+  uint64_t *lower = upper + layout.upper;
+  uint64_t mask = (static_cast<uint64_t>(1) << lower_bits) - 1;
+  for (size_t i = 0; i < v.size(); i++) {
+    uint64_t bit = (static_cast<uint64_t>(v[i]) >> lower_bits) + i;
+    upper[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+    if (i % EF_SAMPLE == 0) samples[i / EF_SAMPLE] = bit;
+    if (lower_bits == 0) continue;
+    uint64_t low = static_cast<uint64_t>(v[i]) & mask;
+    uint64_t offset = i * lower_bits;
+    size_t shift = static_cast<size_t>(offset % 64);
+    lower[offset / 64] |= low << shift;
+    if (shift + lower_bits > 64) lower[offset / 64 + 1] |= low >> (64 - shift);
+  }
+  size_t bytes = words.size() * sizeof(uint64_t);
+  char *buf = new char[bytes];
+  std::memcpy(buf, &words[0], bytes);
+  return buf;
+}
+
+/**
+ * Elias-Fano decompression.
+ */
+void decompress_elias_fano(const char *ptr, std::vector<Identifier> &v) {
+  if (!ptr) return;
+  EliasFanoReader reader(ptr);
+  v.reserve(v.size() + reader.size());
+  for (; !reader.end(); reader.next()) v.push_back(reader.value());
+}
+
+/**
+ * Get size of Elias-Fano code.
+ */
+size_t sizeof_elias_fano(const char *ptr) {
+  return EliasFanoReader(ptr).bytes();
+}
+
+/**
+ * Get the number of integers of Elias-Fano code.
+ */
+size_t count_elias_fano(const char *ptr) {
+  return EliasFanoReader(ptr).size();
+}
+
+/**
+ * Constructor.
+ */
+EliasFanoReader::EliasFanoReader(const char *ptr)
+  : samples_(NULL), upper_(NULL), lower_(NULL), size_(0), bytes_(0),
+    lower_bits_(0), mask_(0), pos_(0), bit_(0) {
+  if (!ptr) return;
+  uint64_t size = word(ptr, 0);
+  uint64_t lower_bits = word(ptr, 1);
+  EliasFanoLayout layout(size, lower_bits, word(ptr, 2));
+  size_ = static_cast<size_t>(size);
+  bytes_ = layout.words() * sizeof(uint64_t);
+  lower_bits_ = static_cast<size_t>(lower_bits);
+  mask_ = (static_cast<uint64_t>(1) << lower_bits_) - 1;
+  samples_ = ptr + EF_HEADER_WORDS * sizeof(uint64_t);
+  upper_ = samples_ + layout.samples * sizeof(uint64_t);
+  lower_ = upper_ + layout.upper * sizeof(uint64_t);
+  bit_ = word(samples_, 0);
+}
+
+/**
+ * Get the position of an integer in the upper bits.
+ */
+uint64_t EliasFanoReader::select(size_t i) const {
+  uint64_t bit = word(samples_, i / EF_SAMPLE);
+  size_t rank = i % EF_SAMPLE;
+  size_t w = static_cast<size_t>(bit / 64);
+  uint64_t bits = word(upper_, w) & (~static_cast<uint64_t>(0) << (bit % 64));
+  size_t count = static_cast<size_t>(popcount64(bits));
+  while (rank >= count) {
+    rank -= count;
+    bits = word(upper_, ++w);
+    count = static_cast<size_t>(popcount64(bits));
+  }
+  for (; rank > 0; rank--) bits &= bits - 1;
+  return static_cast<uint64_t>(w) * 64 + ctz64(bits);
+}
+
+/**
+ * Get the position of the next bit set to 1 in the upper bits.
+ */
+uint64_t EliasFanoReader::next_bit(uint64_t bit) const {
+  size_t w = static_cast<size_t>(bit / 64);
+  uint64_t bits = word(upper_, w) & (~static_cast<uint64_t>(0) << (bit % 64));
+  while (!bits) bits = word(upper_, ++w);
+  return static_cast<uint64_t>(w) * 64 + ctz64(bits);
+}
+
+/**
+ * Move the cursor to the first integer not less than a value.
+ */
+bool EliasFanoReader::next_geq(Identifier x) {
+  if (end()) return false;
+  if (value() >= x) return true;
+  // the last sample less than x after the cursor
+  size_t low = pos_ / EF_SAMPLE + 1;
+  size_t high = (size_ + EF_SAMPLE - 1) / EF_SAMPLE;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    if (value(mid * EF_SAMPLE, word(samples_, mid)) < x) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low - 1 > pos_ / EF_SAMPLE) {
+    pos_ = (low - 1) * EF_SAMPLE;
+    bit_ = word(samples_, low - 1);
+  }
+  while (value() < x) {
+    next();
+    if (end()) return false;
+  }
+  return true;
+}
+
+} /* namespace stupa */
@@ -0,0 +1,193 @@
+//
+// Elias-Fano code of sorted integers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_ELIAS_FANO_H_
+#define STUPA_ELIAS_FANO_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include "identifier.h"
+
+namespace stupa {
+
+/*
+ * The lower bits of each integer are packed into an array, and the upper
+ * bits are a unary-coded bit vector (the i-th integer sets bit
+ * (upper bits + i)).  Compressed data is a sequence of 64-bit words:
+ * the number of integers, the number of lower bits, the largest integer,
+ * positions of every EF_SAMPLE-th bit of the upper bits, the upper bits,
+ * then the lower bits.  Data need not be aligned.
+ */
+
+/** Interval of integers whose positions in the upper bits are sampled */
+const size_t EF_SAMPLE = 64;
+
+/**
+ * Elias-Fano compression.
+ * @param v input array of sorted integers (may be duplicated)
+ * @return compressed data (NULL: empty input), must be deleted later
+ */
+char *compress_elias_fano(const std::vector<Identifier> &v);
+
+/**
+ * Elias-Fano decompression.
+ * @param ptr compressed data
+ * @param v output array of integers (appended)
+ */
+void decompress_elias_fano(const char *ptr, std::vector<Identifier> &v);
+
+/**
+ * Get size of Elias-Fano code.
+ * @param ptr compressed data
+ * @return size of compressed data
+ */
+size_t sizeof_elias_fano(const char *ptr);
+
+/**
+ * Get the number of integers of Elias-Fano code.
+ * @param ptr compressed data
+ * @return the number of integers
+ */
+size_t count_elias_fano(const char *ptr);
+
+/**
+ * Reader of Elias-Fano code with random access.
+ * The cursor moves forward from the first integer.
+ */
+class EliasFanoReader {
+ private:
+  const char *samples_;  ///< sampled positions in the upper bits
+  const char *upper_;    ///< upper bits
+  const char *lower_;    ///< lower bits
+  size_t size_;          ///< the number of integers
+  size_t bytes_;         ///< size of compressed data
+  size_t lower_bits_;    ///< the number of lower bits
+  uint64_t mask_;        ///< mask of lower bits
+  size_t pos_;           ///< index of the integer at the cursor
+  uint64_t bit_;         ///< position of the cursor in the upper bits
+
+  /**
+   * Read a word of unaligned data.
+   * @param ptr data
+   * @param i index of the word
+   * @return word
+   */
+  static uint64_t word(const char *ptr, size_t i) {
+    uint64_t w;
+    std::memcpy(&w, ptr + i * sizeof(uint64_t), sizeof(w));
+    return w;
+  }
+
+  /**
+   * Get lower bits of an integer.
+   * @param i index of the integer
+   * @return lower bits
+   */
+  uint64_t lower(size_t i) const {
+    if (lower_bits_ == 0) return 0;
+    uint64_t offset = static_cast<uint64_t>(i) * lower_bits_;
+    size_t w = static_cast<size_t>(offset / 64);
+    size_t shift = static_cast<size_t>(offset % 64);
+    uint64_t bits = word(lower_, w) >> shift;
+    if (shift + lower_bits_ > 64) bits |= word(lower_, w + 1) << (64 - shift);
+    return bits & mask_;
+  }
+
+  /**
+   * Get the integer of a position in the upper bits.
+   * @param i index of the integer
+   * @param bit position of the integer in the upper bits
+   * @return integer
+   */
+  Identifier value(size_t i, uint64_t bit) const {
+    return static_cast<Identifier>(((bit - i) << lower_bits_) | lower(i));
+  }
+
+  /**
+   * Get the position of an integer in the upper bits.
+   * @param i index of the integer
+   * @return position in the upper bits
+   */
+  uint64_t select(size_t i) const;
+
+  /**
+   * Get the position of the next bit set to 1 in the upper bits.
+   * @param bit position in the upper bits
+   * @return position of the next bit
+   */
+  uint64_t next_bit(uint64_t bit) const;
+
+ public:
+  /**
+   * Constructor.
+   * @param ptr compressed data (NULL: no integers)
+   */
+  explicit EliasFanoReader(const char *ptr);
+
+  /**
+   * Get the number of integers.
+   * @return the number of integers
+   */
+  size_t size() const { return size_; }
+
+  /**
+   * Get size of compressed data.
+   * @return size of compressed data
+   */
+  size_t bytes() const { return bytes_; }
+
+  /**
+   * Get an integer (without moving the cursor).
+   * @param i index of the integer
+   * @return integer
+   */
+  Identifier access(size_t i) const { return value(i, select(i)); }
+
+  /**
+   * Check whether the cursor is past the last integer.
+   * @return true if no integers are left
+   */
+  bool end() const { return pos_ >= size_; }
+
+  /**
+   * Get the integer at the cursor.
+   * @return integer
+   */
+  Identifier value() const { return value(pos_, bit_); }
+
+  /**
+   * Move the cursor to the next integer.
+   */
+  void next() {
+    if (++pos_ < size_) bit_ = next_bit(bit_ + 1);
+  }
+
+  /**
+   * Move the cursor to the first integer not less than a value.
+   * Sampled integers are skipped without decoding others.
+   * @param x value
+   * @return false if no integers are left
+   */
+  bool next_geq(Identifier x);
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_ELIAS_FANO_H_
@@ -0,0 +1,163 @@
+//
+// Forward index class (compressed features of documents)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include "forward_index.h"
+
+namespace stupa {
+
+const double ForwardIndex::COMPACT_RATIO = 0.5;
+const size_t ForwardIndex::COMPACT_MIN_BYTES;
+const uint64_t ForwardIndex::EMPTY_OFFSET;
+
+/**
+ * Allocate space in the arena.
+ */
+uint64_t ForwardIndex::allocate(uint32_t size) {
+  if (size == 0) return 0;
+  // the smallest free space to hold the size
+  FreeSpace::iterator it = free_.lower_bound(size);
+  if (it == free_.end()) {
+    uint64_t offset = arena_.size();
+    arena_.resize(arena_.size() + size);
+    return offset;
+  }
+  uint32_t rest = it->first - size;
+  uint64_t offset = it->second;
+  free_.erase(it);
+  if (rest > 0) free_.insert(FreeSpace::value_type(rest, offset + size));
+  free_bytes_ -= size;
+  return offset;
+}
+
+/**
+ * Release space of a slot to the free-space map.
+ */
+void ForwardIndex::release(size_t slot) {
+  if (sizes_[slot] > 0) {
+    free_.insert(FreeSpace::value_type(sizes_[slot], offsets_[slot]));
+    free_bytes_ += sizes_[slot];
+  }
+  offsets_[slot] = EMPTY_OFFSET;
+  sizes_[slot] = 0;
+}
+
+/**
+ * Store compressed features of a document.
+ */
+void ForwardIndex::set(DocumentId id, const char *data, size_t size) {
+  if (offsets_.empty()) {
+    base_ = id;
+  } else if (id < base_) {
+    size_t shift = static_cast<size_t>(base_ - id);
+    offsets_.insert(offsets_.begin(), shift, EMPTY_OFFSET);
+    sizes_.insert(sizes_.begin(), shift, 0);
+    base_ = id;
+  }
+  size_t s = static_cast<size_t>(id - base_);
+  if (s >= offsets_.size()) {
+    offsets_.resize(s + 1, EMPTY_OFFSET);
+    sizes_.resize(s + 1, 0);
+  }
+  if (offsets_[s] == EMPTY_OFFSET) {
+    num_documents_++;
+  } else {
+    release(s);
+  }
+  if (!data) size = 0;
+  uint64_t offset = allocate(static_cast<uint32_t>(size));
+  if (size > 0) std::copy(data, data + size, arena_.begin() + offset);
+  offsets_[s] = offset;
+  sizes_[s] = static_cast<uint32_t>(size);
+}
+
+/**
+ * Delete a document.
+ */
+bool ForwardIndex::erase(DocumentId id) {
+  size_t s = slot(id);
+  if (s >= offsets_.size()) return false;
+  release(s);
+  num_documents_--;
+  if (arena_.size() >= COMPACT_MIN_BYTES
+      && free_bytes_ > arena_.size() * COMPACT_RATIO) {
+    compact();
+  } else if (num_documents_ == 0) {
+    clear();
+  }
+  return true;
+}
+
+/**
+ * Delete all documents.
+ */
+void ForwardIndex::clear() {
+  std::vector<uint64_t>().swap(offsets_);
+  std::vector<uint32_t>().swap(sizes_);
+  std::vector<char>().swap(arena_);
+  free_.clear();
+  free_bytes_ = 0;
+  num_documents_ = 0;
+  base_ = DOC_START_ID;
+}
+
+/**
+ * Rewrite the arena in the order of document ids without free space.
+ */
+void ForwardIndex::compact() {
+  // slots of deleted documents at both ends are dropped
+  size_t first = 0;
+  while (first < offsets_.size() && offsets_[first] == EMPTY_OFFSET) first++;
+  size_t last = offsets_.size();
+  while (last > first && offsets_[last - 1] == EMPTY_OFFSET) last--;
+
+  std::vector<uint64_t> offsets(offsets_.begin() + first,
+                                offsets_.begin() + last);
+  std::vector<uint32_t> sizes(sizes_.begin() + first, sizes_.begin() + last);
+  std::vector<char> arena;
+  arena.reserve(arena_.size() - free_bytes_);
+  for (size_t i = 0; i < offsets.size(); i++) {
+    if (offsets[i] == EMPTY_OFFSET) continue;
+    uint64_t offset = arena.size();
+    arena.insert(arena.end(), arena_.begin() + offsets[i],
+                 arena_.begin() + offsets[i] + sizes[i]);
+    offsets[i] = offset;
+  }
+  base_ += first;
+  offsets_.swap(offsets);
+  sizes_.swap(sizes);
+  arena_.swap(arena);
+  free_.clear();
+  free_bytes_ = 0;
+}
+
+/**
+ * Exchange documents with other forward index.
+ */
+void ForwardIndex::swap(ForwardIndex &other) {
+  std::swap(base_, other.base_);
+  offsets_.swap(other.offsets_);
+  sizes_.swap(other.sizes_);
+  arena_.swap(other.arena_);
+  free_.swap(other.free_);
+  std::swap(free_bytes_, other.free_bytes_);
+  std::swap(num_documents_, other.num_documents_);
+}
+
+} /* namespace stupa */
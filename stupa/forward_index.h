@@ -0,0 +1,284 @@
+//
+// Forward index class (compressed features of documents)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_FORWARD_INDEX_H_
+#define STUPA_FORWARD_INDEX_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+#include "identifier.h"
+
+namespace stupa {
+
+/**
+ * Forward index class.
+ *
+ * Compressed features of documents are stored in one contiguous arena,
+ * and their offsets are kept in an array indexed by (document id - base),
+ * so document ids should be dense (as given by StupaSearch).  Space of
+ * deleted documents is recorded in a free-space map and reused by added
+ * documents, and the arena is compacted in the order of document ids when
+ * over COMPACT_RATIO of it is free.
+ */
+class ForwardIndex {
+ public:
+  /** Type definition of a document: <document id, compressed features> */
+  typedef std::pair<DocumentId, const char *> value_type;
+
+  /** Ratio of free space of the arena to be compacted */
+  static const double COMPACT_RATIO;
+  /** Minimum size of the arena to be compacted */
+  static const size_t COMPACT_MIN_BYTES = 4096;
+
+  class const_iterator;
+  friend class const_iterator;
+
+  /**
+   * Iterator of documents in the order of document ids.
+   */
+  class const_iterator {
+   private:
+    const ForwardIndex *index_;  ///< forward index
+    size_t slot_;                ///< slot of a document
+    value_type value_;           ///< current document
+
+    /**
+     * Move to the next slot of a document.
+     */
+    void skip_empty() {
+      while (slot_ < index_->offsets_.size()
+             && index_->offsets_[slot_] == EMPTY_OFFSET) {
+        slot_++;
+      }
+      if (slot_ < index_->offsets_.size()) {
+        value_.first = index_->base_ + slot_;
+        value_.second = index_->data(slot_);
+      }
+    }
+
+   public:
+    const_iterator() : index_(NULL), slot_(0), value_(0, NULL) { }
+
+    /**
+     * Constructor.
+     * @param index forward index
+     * @param slot the first slot
+     */
+    const_iterator(const ForwardIndex *index, size_t slot)
+      : index_(index), slot_(slot), value_(0, NULL) {
+      skip_empty();
+    }
+
+    const value_type &operator*() const { return value_; }
+    const value_type *operator->() const { return &value_; }
+
+    const_iterator &operator++() {
+      slot_++;
+      skip_empty();
+      return *this;
+    }
+
+    bool operator==(const const_iterator &other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return slot_ != other.slot_;
+    }
+  };
+
+ private:
+  /** Offset of slots without documents */
+  static const uint64_t EMPTY_OFFSET = ~static_cast<uint64_t>(0);
+
+  /** Type definition of <size, offset> map of free space */
+  typedef std::multimap<uint32_t, uint64_t> FreeSpace;
+
+  DocumentId base_;                ///< document id of the first slot
+  std::vector<uint64_t> offsets_;  ///< offsets in the arena (by slot)
+  std::vector<uint32_t> sizes_;    ///< bytes of features (by slot)
+  std::vector<char> arena_;        ///< compressed features of documents
+  FreeSpace free_;                 ///< free space in the arena
+  size_t free_bytes_;              ///< bytes of free space
+  size_t num_documents_;           ///< the number of documents
+
+  /**
+   * Get the slot of a document.
+   * @param id the identifier of a document
+   * @return slot (offsets_.size(): not stored)
+   */
+  size_t slot(DocumentId id) const {
+    if (id < base_ || id - base_ >= offsets_.size()
+        || offsets_[id - base_] == EMPTY_OFFSET) {
+      return offsets_.size();
+    }
+    return static_cast<size_t>(id - base_);
+  }
+
+  /**
+   * Get compressed features in a slot.
+   * @param slot slot of a document
+   * @return compressed features (NULL: no features)
+   */
+  const char *data(size_t slot) const {
+    return sizes_[slot] > 0 ? &arena_[offsets_[slot]] : NULL;
+  }
+
+  /**
+   * Allocate space in the arena.
+   * @param size bytes to be allocated
+   * @return offset of allocated space
+   */
+  uint64_t allocate(uint32_t size);
+
+  /**
+   * Release space of a slot to the free-space map.
+   * @param slot slot of a document
+   */
+  void release(size_t slot);
+
+ public:
+  /**
+   * Constructor.
+   */
+  ForwardIndex()
+    : base_(DOC_START_ID), free_bytes_(0), num_documents_(0) { }
+
+  /**
+   * Get the number of documents.
+   * @return the number of documents
+   */
+  size_t size() const { return num_documents_; }
+
+  /**
+   * Check whether no documents are stored.
+   * @return true if empty
+   */
+  bool empty() const { return num_documents_ == 0; }
+
+  /**
+   * Get bytes of the arena.
+   * @return bytes of the arena
+   */
+  size_t bytes() const { return arena_.size(); }
+
+  /**
+   * Get bytes of free space in the arena.
+   * @return bytes of free space
+   */
+  size_t free_bytes() const { return free_bytes_; }
+
+  /**
+   * Get compressed features of a document.
+   * @param id the identifier of a document
+   * @return compressed features (NULL: not stored or no features)
+   */
+  const char *get(DocumentId id) const {
+    size_t s = slot(id);
+    return s < offsets_.size() ? data(s) : NULL;
+  }
+
+  /**
+   * Find a document.
+   * @param id the identifier of a document
+   * @return iterator of the document (end(): not stored)
+   */
+  const_iterator find(DocumentId id) const {
+    return const_iterator(this, slot(id));
+  }
+
+  /**
+   * Get the iterator of the first document.
+   * @return iterator
+   */
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  /**
+   * Get the iterator past the last document.
+   * @return iterator
+   */
+  const_iterator end() const { return const_iterator(this, offsets_.size()); }
+
+  /**
+   * Get the identifier of the first slot.
+   * Documents are stored in the range [first_id(), end_id()).
+   * @return the identifier of the first slot
+   */
+  DocumentId first_id() const { return base_; }
+
+  /**
+   * Get the identifier past the last slot.
+   * @return the identifier past the last slot
+   */
+  DocumentId end_id() const {
+    return static_cast<DocumentId>(base_ + offsets_.size());
+  }
+
+  /**
+   * Prefetch compressed features of a document into caches.
+   * @param id the identifier of a document
+   */
+  void prefetch(DocumentId id) const {
+#ifdef __GNUC__
+    size_t s = slot(id);
+    if (s >= offsets_.size() || sizes_[s] == 0) return;
+    const char *ptr = &arena_[offsets_[s]];
+    __builtin_prefetch(ptr);
+    // features over a cache line
+    __builtin_prefetch(ptr + sizes_[s] - 1);
+#endif
+  }
+
+  /**
+   * Store compressed features of a document (replaced if stored).
+   * @param id the identifier of a document
+   * @param data compressed features (NULL: no features)
+   * @param size bytes of compressed features
+   */
+  void set(DocumentId id, const char *data, size_t size);
+
+  /**
+   * Delete a document.
+   * @param id the identifier of a document
+   * @return false if the document is not stored
+   */
+  bool erase(DocumentId id);
+
+  /**
+   * Delete all documents.
+   */
+  void clear();
+
+  /**
+   * Rewrite the arena in the order of document ids without free space.
+   */
+  void compact();
+
+  /**
+   * Exchange documents with other forward index.
+   * @param other forward index
+   */
+  void swap(ForwardIndex &other);
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_FORWARD_INDEX_H_
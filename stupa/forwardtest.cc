@@ -0,0 +1,159 @@
+//
+// Tests for forward index class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "forward_index.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_DOC = 1000;  ///< the number of documents
+
+/* data of a document: bytes of (id % 7 + 5) copies of a letter */
+std::string document_data(stupa::DocumentId id) {
+  return std::string(id % 7 + 5, static_cast<char>('a' + id % 26));
+}
+
+/* check data of a document */
+void check_document(const stupa::ForwardIndex &index, stupa::DocumentId id) {
+  std::string expected = document_data(id);
+  const char *data = index.get(id);
+  ASSERT_TRUE(data != NULL);
+  EXPECT_EQ(expected, std::string(data, expected.size()));
+}
+
+} /* namespace */
+
+/* set, get, find, iteration */
+TEST(ForwardIndexTest, SetGetTest) {
+  stupa::ForwardIndex index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_TRUE(index.begin() == index.end());
+  size_t bytes = 0;
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    stupa::DocumentId id = i + stupa::DOC_START_ID;
+    std::string data = document_data(id);
+    index.set(id, data.data(), data.size());
+    bytes += data.size();
+  }
+  EXPECT_EQ(NUM_DOC, index.size());
+  EXPECT_EQ(bytes, index.bytes());
+  EXPECT_EQ(0, index.free_bytes());
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    check_document(index, i + stupa::DOC_START_ID);
+  }
+  EXPECT_TRUE(index.get(stupa::DOC_START_ID - 1) == NULL);
+  EXPECT_TRUE(index.get(NUM_DOC + stupa::DOC_START_ID) == NULL);
+  EXPECT_TRUE(index.find(NUM_DOC + stupa::DOC_START_ID) == index.end());
+
+  // documents are iterated in the order of ids
+  stupa::DocumentId expected = stupa::DOC_START_ID;
+  for (stupa::ForwardIndex::const_iterator it = index.begin();
+       it != index.end(); ++it) {
+    EXPECT_EQ(expected, it->first);
+    EXPECT_EQ(index.get(expected), it->second);
+    expected++;
+  }
+  EXPECT_EQ(NUM_DOC + stupa::DOC_START_ID, expected);
+
+  // a document without features
+  stupa::DocumentId id = NUM_DOC + stupa::DOC_START_ID;
+  index.set(id, NULL, 0);
+  EXPECT_EQ(NUM_DOC + 1, index.size());
+  EXPECT_TRUE(index.get(id) == NULL);
+  ASSERT_TRUE(index.find(id) != index.end());
+  EXPECT_TRUE(index.find(id)->second == NULL);
+
+  index.clear();
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0, index.bytes());
+  EXPECT_TRUE(index.get(stupa::DOC_START_ID) == NULL);
+}
+
+/* erase, reuse of free space, compaction */
+TEST(ForwardIndexTest, EraseTest) {
+  stupa::ForwardIndex index;
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    stupa::DocumentId id = i + stupa::DOC_START_ID;
+    std::string data = document_data(id);
+    index.set(id, data.data(), data.size());
+  }
+  size_t bytes = index.bytes();
+
+  // space of a deleted document is reused by a document of the same size
+  stupa::DocumentId id = stupa::DOC_START_ID + 10;
+  EXPECT_TRUE(index.erase(id));
+  EXPECT_FALSE(index.erase(id));
+  EXPECT_TRUE(index.get(id) == NULL);
+  EXPECT_TRUE(index.find(id) == index.end());
+  EXPECT_EQ(NUM_DOC - 1, index.size());
+  EXPECT_EQ(document_data(id).size(), index.free_bytes());
+  std::string data = document_data(id);
+  index.set(id, data.data(), data.size());
+  EXPECT_EQ(0, index.free_bytes());
+  EXPECT_EQ(bytes, index.bytes());
+  check_document(index, id);
+
+  // replaced features keep the other documents
+  data = "replaced features";
+  index.set(id, data.data(), data.size());
+  EXPECT_EQ(data, std::string(index.get(id), data.size()));
+  EXPECT_EQ(NUM_DOC, index.size());
+  check_document(index, id + 1);
+
+  // the oldest documents are deleted and the arena is compacted
+  for (size_t i = 0; i < NUM_DOC * 3 / 4; i++) {
+    index.erase(i + stupa::DOC_START_ID);
+  }
+  EXPECT_EQ(NUM_DOC / 4, index.size());
+  EXPECT_GT(bytes, index.bytes());
+  EXPECT_GE(index.bytes() * stupa::ForwardIndex::COMPACT_RATIO,
+            index.free_bytes());
+  for (size_t i = NUM_DOC * 3 / 4; i < NUM_DOC; i++) {
+    check_document(index, i + stupa::DOC_START_ID);
+  }
+
+  // ids below the first slot
+  id = stupa::DOC_START_ID + 1;
+  data = document_data(id);
+  index.set(id, data.data(), data.size());
+  check_document(index, id);
+  EXPECT_EQ(id, index.begin()->first);
+  index.compact();
+  EXPECT_EQ(0, index.free_bytes());
+  check_document(index, id);
+  for (size_t i = NUM_DOC * 3 / 4; i < NUM_DOC; i++) {
+    check_document(index, i + stupa::DOC_START_ID);
+  }
+
+  // all documents are deleted
+  index.erase(id);
+  for (size_t i = NUM_DOC * 3 / 4; i < NUM_DOC; i++) {
+    index.erase(i + stupa::DOC_START_ID);
+  }
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0, index.bytes());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,573 @@
+//
+// Flat hash map class (open addressing with groups of control bytes)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_HASH_MAP_H_
+#define STUPA_HASH_MAP_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <string>
+#include <utility>
+
+/* include SIMD intrinsics */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace stupa {
+
+/**
+ * Mix bits of an integer (finalizer of MurmurHash3).
+ * @param x input integer
+ * @return hash value
+ */
+inline uint64_t mix_hash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+/**
+ * Hash bytes by 8-byte words.
+ * @param data bytes
+ * @param size the number of bytes
+ * @return hash value
+ */
+inline uint64_t hash_bytes(const char *data, size_t size) {
+  const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+  uint64_t h = size * multiplier;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    h = (h ^ word) * multiplier;
+    h ^= h >> 32;
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    h = (h ^ word) * multiplier;
+  }
+  return mix_hash(h);
+}
+
+/**
+ * Hash function of integer keys.
+ */
+template<typename KeyType>
+struct FlatHash {
+  uint64_t operator()(const KeyType &key) const {
+    return mix_hash(static_cast<uint64_t>(key));
+  }
+};
+
+/**
+ * Hash function of string keys.
+ */
+template<>
+struct FlatHash<std::string> {
+  uint64_t operator()(const std::string &key) const {
+    return hash_bytes(key.data(), key.size());
+  }
+};
+
+/**
+ * Flat hash map class.
+ *
+ * Entries are stored in one array with a control byte for each slot:
+ * 7 bits of the hash value of a key for a full slot, or a mark of an
+ * empty or deleted slot.  Keys are looked up by groups of GROUP_SIZE
+ * control bytes, which are compared at once by SSE2 instructions.
+ * The interface is a subset of std::map; iterators are invalidated by
+ * insertion of keys, but not by erasure.
+ */
+template<typename KeyType, typename ValueType,
+         typename HashType = FlatHash<KeyType> >
+class FlatHashMap {
+ public:
+  typedef KeyType key_type;                             ///< key
+  typedef ValueType mapped_type;                        ///< value
+  typedef std::pair<const KeyType, ValueType> value_type;  ///< entry
+  typedef size_t size_type;                             ///< size
+
+ private:
+  /** Number of control bytes compared at once */
+  static const size_t GROUP_SIZE = 16;
+  /** Control byte of an empty slot */
+  static const int8_t EMPTY = -128;
+  /** Control byte of a deleted slot */
+  static const int8_t DELETED = -2;
+
+  int8_t *ctrl_;        ///< control bytes of slots
+  value_type *slots_;   ///< entries (constructed in full slots only)
+  size_t capacity_;     ///< the number of slots (0 or power of 2)
+  size_t size_;         ///< the number of entries
+  size_t growth_left_;  ///< entries to be added before rehash
+  HashType hash_;       ///< hash function
+
+  /**
+   * Base class of iterators: index of a slot.
+   */
+  class iterator_base {
+   protected:
+    size_t index_;  ///< index of a slot
+
+    iterator_base(size_t index) : index_(index) { }
+
+   public:
+    bool operator==(const iterator_base &other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const iterator_base &other) const {
+      return index_ != other.index_;
+    }
+  };
+
+ public:
+  class const_iterator;
+
+  /**
+   * Iterator of entries.
+   */
+  class iterator : public iterator_base {
+    friend class FlatHashMap;
+    friend class const_iterator;
+
+   private:
+    FlatHashMap *map_;  ///< hash map
+
+    iterator(FlatHashMap *map, size_t index)
+      : iterator_base(index), map_(map) {
+      this->index_ = map_->skip_free(this->index_);
+    }
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashMap::value_type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type *pointer;
+    typedef value_type &reference;
+
+    iterator() : iterator_base(0), map_(NULL) { }
+
+    reference operator*() const { return map_->slots_[this->index_]; }
+    pointer operator->() const { return &map_->slots_[this->index_]; }
+
+    iterator &operator++() {
+      this->index_ = map_->skip_free(this->index_ + 1);
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator it(*this);
+      ++(*this);
+      return it;
+    }
+  };
+
+  /**
+   * Iterator of constant entries.
+   */
+  class const_iterator : public iterator_base {
+    friend class FlatHashMap;
+
+   private:
+    const FlatHashMap *map_;  ///< hash map
+
+    const_iterator(const FlatHashMap *map, size_t index)
+      : iterator_base(index), map_(map) {
+      this->index_ = map_->skip_free(this->index_);
+    }
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashMap::value_type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef const value_type &reference;
+
+    const_iterator() : iterator_base(0), map_(NULL) { }
+    const_iterator(const iterator &it)
+      : iterator_base(it.index_), map_(it.map_) { }
+
+    reference operator*() const { return map_->slots_[this->index_]; }
+    pointer operator->() const { return &map_->slots_[this->index_]; }
+
+    const_iterator &operator++() {
+      this->index_ = map_->skip_free(this->index_ + 1);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it(*this);
+      ++(*this);
+      return it;
+    }
+  };
+
+ private:
+  /**
+   * Check whether a slot has an entry.
+   * @param ctrl control byte of a slot
+   * @return true if full
+   */
+  static bool is_full(int8_t ctrl) { return ctrl >= 0; }
+
+  /**
+   * Get the index of the lowest bit set to 1.
+   * @param mask bit mask (not 0)
+   * @return index of the bit
+   */
+  static size_t lowest_bit(uint32_t mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    size_t i = 0;
+    while (!(mask & 1)) {
+      mask >>= 1;
+      i++;
+    }
+    return i;
+#endif
+  }
+
+  /**
+   * Match control bytes of a group with a value.
+   * @param group control bytes of a group
+   * @param value control byte to be matched
+   * @return bit mask of matched slots
+   */
+  static uint32_t match(const int8_t *group, int8_t value) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+      if (group[i] == value) mask |= 1U << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * Match empty or deleted slots of a group.
+   * @param group control bytes of a group
+   * @return bit mask of empty or deleted slots
+   */
+  static uint32_t match_free(const int8_t *group) {
+#ifdef __SSE2__
+    // control bytes of empty and deleted slots are negative
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return _mm_movemask_epi8(ctrl);
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+      if (!is_full(group[i])) mask |= 1U << i;
+    }
+    return mask;
+#endif
+  }
+
+  /**
+   * Get the index of the first full slot from a slot.
+   * @param index index of a slot
+   * @return index of a full slot (capacity_: not found)
+   */
+  size_t skip_free(size_t index) const {
+    while (index < capacity_ && !is_full(ctrl_[index])) index++;
+    return index;
+  }
+
+  /**
+   * Get the maximum number of entries of a capacity (load factor 7/8).
+   * @param capacity the number of slots
+   * @return the number of entries
+   */
+  static size_t max_entries(size_t capacity) { return capacity - capacity / 8; }
+
+  /**
+   * Find the slot of a key.
+   * @param key key
+   * @param hash hash value of the key
+   * @return index of the slot (capacity_: not found)
+   */
+  size_t find_index(const KeyType &key, uint64_t hash) const {
+    if (capacity_ == 0) return capacity_;
+    int8_t h2 = static_cast<int8_t>(hash & 0x7f);
+    size_t mask = capacity_ / GROUP_SIZE - 1;
+    size_t group = static_cast<size_t>(hash >> 7) & mask;
+    // triangular probing visits all groups
+    for (size_t step = 1; ; step++) {
+      const int8_t *ctrl = ctrl_ + group * GROUP_SIZE;
+      for (uint32_t m = match(ctrl, h2); m != 0; m &= m - 1) {
+        size_t index = group * GROUP_SIZE + lowest_bit(m);
+        if (slots_[index].first == key) return index;
+      }
+      if (match(ctrl, EMPTY) != 0) return capacity_;
+      group = (group + step) & mask;
+    }
+  }
+
+  /**
+   * Find a free slot for a hash value.
+   * @param hash hash value of a key
+   * @return index of an empty or deleted slot
+   */
+  size_t find_free(uint64_t hash) const {
+    size_t mask = capacity_ / GROUP_SIZE - 1;
+    size_t group = static_cast<size_t>(hash >> 7) & mask;
+    for (size_t step = 1; ; step++) {
+      uint32_t m = match_free(ctrl_ + group * GROUP_SIZE);
+      if (m != 0) return group * GROUP_SIZE + lowest_bit(m);
+      group = (group + step) & mask;
+    }
+  }
+
+  /**
+   * Add an entry of a key not stored.
+   * @param value entry
+   * @param hash hash value of the key
+   * @return index of the slot
+   */
+  size_t insert_new(const value_type &value, uint64_t hash) {
+    if (growth_left_ == 0) {
+      // tombstones are dropped without growth if under half is full
+      if (capacity_ > 0 && size_ < max_entries(capacity_) / 2) {
+        rehash(capacity_);
+      } else {
+        rehash(capacity_ == 0 ? GROUP_SIZE : capacity_ * 2);
+      }
+    }
+    size_t index = find_free(hash);
+    if (ctrl_[index] == EMPTY) growth_left_--;
+    ctrl_[index] = static_cast<int8_t>(hash & 0x7f);
+    new(&slots_[index]) value_type(value);
+    size_++;
+    return index;
+  }
+
+  /**
+   * Move entries to new slots.
+   * @param capacity the number of new slots
+   */
+  void rehash(size_t capacity) {
+    int8_t *ctrl = ctrl_;
+    value_type *slots = slots_;
+    size_t old_capacity = capacity_;
+    allocate(capacity);
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (!is_full(ctrl[i])) continue;
+      uint64_t hash = hash_(slots[i].first);
+      size_t index = find_free(hash);
+      ctrl_[index] = static_cast<int8_t>(hash & 0x7f);
+      new(&slots_[index]) value_type(slots[i]);
+      slots[i].~value_type();
+    }
+    growth_left_ = max_entries(capacity_) - size_;
+    delete [] ctrl;
+    ::operator delete(slots);
+  }
+
+  /**
+   * Allocate empty slots (entries are not released).
+   * @param capacity the number of slots
+   */
+  void allocate(size_t capacity) {
+    capacity_ = capacity;
+    ctrl_ = new int8_t[capacity];
+    memset(ctrl_, EMPTY, capacity);
+    slots_ = static_cast<value_type *>(
+      ::operator new(capacity * sizeof(value_type)));
+  }
+
+  /**
+   * Release all entries and slots.
+   */
+  void release() {
+    for (size_t i = 0; i < capacity_; i++) {
+      if (is_full(ctrl_[i])) slots_[i].~value_type();
+    }
+    delete [] ctrl_;
+    ::operator delete(slots_);
+    ctrl_ = NULL;
+    slots_ = NULL;
+    capacity_ = 0;
+    size_ = 0;
+    growth_left_ = 0;
+  }
+
+ public:
+  /**
+   * Constructor.
+   */
+  FlatHashMap()
+    : ctrl_(NULL), slots_(NULL), capacity_(0), size_(0), growth_left_(0) { }
+
+  /**
+   * Copy constructor: entries are copied to the same slots.
+   * @param other hash map
+   */
+  FlatHashMap(const FlatHashMap &other)
+    : ctrl_(NULL), slots_(NULL), capacity_(0), size_(other.size_),
+      growth_left_(other.growth_left_), hash_(other.hash_) {
+    if (other.capacity_ == 0) return;
+    allocate(other.capacity_);
+    memcpy(ctrl_, other.ctrl_, capacity_);
+    for (size_t i = 0; i < capacity_; i++) {
+      if (is_full(ctrl_[i])) new(&slots_[i]) value_type(other.slots_[i]);
+    }
+  }
+
+  ~FlatHashMap() { release(); }
+
+  /**
+   * Assignment operator.
+   * @param other hash map
+   * @return this object
+   */
+  FlatHashMap &operator=(const FlatHashMap &other) {
+    if (this != &other) {
+      FlatHashMap copied(other);
+      swap(copied);
+    }
+    return *this;
+  }
+
+  /**
+   * Swap entries with another hash map.
+   * @param other hash map
+   */
+  void swap(FlatHashMap &other) {
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+    std::swap(growth_left_, other.growth_left_);
+    std::swap(hash_, other.hash_);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  /**
+   * Find an entry.
+   * @param key key
+   * @return iterator of the entry (end(): not found)
+   */
+  iterator find(const KeyType &key) {
+    return iterator(this, find_index(key, hash_(key)));
+  }
+  const_iterator find(const KeyType &key) const {
+    return const_iterator(this, find_index(key, hash_(key)));
+  }
+
+  /**
+   * Count entries of a key.
+   * @param key key
+   * @return 1 if found, 0 if not found
+   */
+  size_t count(const KeyType &key) const {
+    return find_index(key, hash_(key)) == capacity_ ? 0 : 1;
+  }
+
+  /**
+   * Add an entry if its key is not stored.
+   * @param value entry
+   * @return iterator of the entry of the key, and true if added
+   */
+  std::pair<iterator, bool> insert(const value_type &value) {
+    uint64_t hash = hash_(value.first);
+    size_t index = find_index(value.first, hash);
+    if (index != capacity_) {
+      return std::pair<iterator, bool>(iterator(this, index), false);
+    }
+    index = insert_new(value, hash);
+    return std::pair<iterator, bool>(iterator(this, index), true);
+  }
+
+  /**
+   * Get the value of a key (added if not stored).
+   * @param key key
+   * @return reference of the value
+   */
+  ValueType &operator[](const KeyType &key) {
+    uint64_t hash = hash_(key);
+    size_t index = find_index(key, hash);
+    if (index == capacity_) {
+      index = insert_new(value_type(key, ValueType()), hash);
+    }
+    return slots_[index].second;
+  }
+
+  /**
+   * Delete an entry.
+   * @param it iterator of the entry
+   */
+  void erase(iterator it) {
+    size_t index = it.index_;
+    slots_[index].~value_type();
+    // lookups never passed through a group which has an empty slot
+    const int8_t *group = ctrl_ + index / GROUP_SIZE * GROUP_SIZE;
+    if (match(group, EMPTY) != 0) {
+      ctrl_[index] = EMPTY;
+      growth_left_++;
+    } else {
+      ctrl_[index] = DELETED;
+    }
+    size_--;
+  }
+
+  /**
+   * Delete the entry of a key.
+   * @param key key
+   * @return the number of deleted entries
+   */
+  size_t erase(const KeyType &key) {
+    size_t index = find_index(key, hash_(key));
+    if (index == capacity_) return 0;
+    erase(iterator(this, index));
+    return 1;
+  }
+
+  /**
+   * Delete all entries.
+   */
+  void clear() { release(); }
+};
+
+template<typename KeyType, typename ValueType, typename HashType>
+const size_t FlatHashMap<KeyType, ValueType, HashType>::GROUP_SIZE;
+template<typename KeyType, typename ValueType, typename HashType>
+const int8_t FlatHashMap<KeyType, ValueType, HashType>::EMPTY;
+template<typename KeyType, typename ValueType, typename HashType>
+const int8_t FlatHashMap<KeyType, ValueType, HashType>::DELETED;
+
+} /* namespace stupa */
+
+#endif  // STUPA_HASH_MAP_H_
@@ -0,0 +1,157 @@
+//
+// Tests for flat hash map class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "hash_map.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_KEY = 10000;  ///< the number of keys
+
+typedef stupa::FlatHashMap<uint64_t, uint64_t> IntegerMap;
+typedef stupa::FlatHashMap<std::string, std::vector<int> > StringMap;
+
+/* check that a hash map has the same entries as std::map */
+template<typename HashMap, typename Map>
+void check_entries(const HashMap &hmap, const Map &expected) {
+  EXPECT_EQ(expected.size(), hmap.size());
+  size_t num = 0;
+  for (typename HashMap::const_iterator it = hmap.begin();
+       it != hmap.end(); ++it) {
+    typename Map::const_iterator eit = expected.find(it->first);
+    ASSERT_TRUE(eit != expected.end());
+    EXPECT_TRUE(eit->second == it->second);
+    num++;
+  }
+  EXPECT_EQ(expected.size(), num);
+  for (typename Map::const_iterator eit = expected.begin();
+       eit != expected.end(); ++eit) {
+    typename HashMap::const_iterator it = hmap.find(eit->first);
+    ASSERT_TRUE(it != hmap.end());
+    EXPECT_TRUE(eit->second == it->second);
+  }
+}
+
+} /* namespace */
+
+/* operator[], find, insert, erase of integer keys */
+TEST(FlatHashMapTest, IntegerKeyTest) {
+  IntegerMap hmap;
+  std::map<uint64_t, uint64_t> expected;
+  EXPECT_TRUE(hmap.empty());
+  EXPECT_TRUE(hmap.begin() == hmap.end());
+  EXPECT_TRUE(hmap.find(0) == hmap.end());
+  EXPECT_EQ(0, hmap.erase(0));
+
+  // sequential keys, including 0 and 1
+  for (uint64_t i = 0; i < NUM_KEY; i++) {
+    hmap[i] = i * 2;
+    expected[i] = i * 2;
+  }
+  check_entries(hmap, expected);
+  EXPECT_EQ(1, hmap.count(NUM_KEY - 1));
+  EXPECT_EQ(0, hmap.count(NUM_KEY));
+
+  // insert does not replace values
+  EXPECT_FALSE(hmap.insert(IntegerMap::value_type(10, 0)).second);
+  EXPECT_EQ(20, hmap[10]);
+  std::pair<IntegerMap::iterator, bool> result =
+    hmap.insert(IntegerMap::value_type(NUM_KEY, 1));
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(NUM_KEY, result.first->first);
+  expected[NUM_KEY] = 1;
+
+  // erase by keys and iterators, while iterating
+  for (uint64_t i = 0; i < NUM_KEY; i += 3) {
+    EXPECT_EQ(1, hmap.erase(i));
+    expected.erase(i);
+  }
+  for (IntegerMap::iterator it = hmap.begin(); it != hmap.end(); ++it) {
+    if (it->first % 3 == 1) {
+      expected.erase(it->first);
+      hmap.erase(it);
+    }
+  }
+  check_entries(hmap, expected);
+
+  // slots of deleted keys are reused
+  for (uint64_t i = 0; i < NUM_KEY * 10; i++) {
+    uint64_t key = NUM_KEY * 2 + i;
+    hmap[key] = i;
+    hmap.erase(key);
+  }
+  check_entries(hmap, expected);
+
+  // copy, assignment, swap
+  IntegerMap copied(hmap);
+  check_entries(copied, expected);
+  copied[NUM_KEY * 3] = 3;
+  EXPECT_TRUE(hmap.find(NUM_KEY * 3) == hmap.end());
+  IntegerMap assigned;
+  assigned = copied;
+  EXPECT_EQ(3, assigned[NUM_KEY * 3]);
+  assigned.swap(hmap);
+  check_entries(assigned, expected);
+
+  hmap.clear();
+  EXPECT_TRUE(hmap.empty());
+  EXPECT_TRUE(hmap.begin() == hmap.end());
+  hmap[1] = 1;
+  EXPECT_EQ(1, hmap.size());
+}
+
+/* string keys and values of classes */
+TEST(FlatHashMapTest, StringKeyTest) {
+  StringMap hmap;
+  std::map<std::string, std::vector<int> > expected;
+  for (size_t i = 0; i < NUM_KEY; i++) {
+    std::ostringstream oss;
+    oss << "key" << i;
+    if (i % 7 == 0) oss << " of a document longer than a word";
+    hmap[oss.str()].push_back(i);
+    expected[oss.str()].push_back(i);
+  }
+  hmap[""].push_back(-1);
+  expected[""].push_back(-1);
+  check_entries(hmap, expected);
+
+  for (size_t i = 0; i < NUM_KEY; i += 2) {
+    std::ostringstream oss;
+    oss << "key" << i;
+    hmap.erase(oss.str());
+    expected.erase(oss.str());
+  }
+  check_entries(hmap, expected);
+
+  // entries are constructed into a vector
+  std::vector<std::pair<std::string, std::vector<int> > > pairs(hmap.begin(),
+                                                                hmap.end());
+  EXPECT_EQ(expected.size(), pairs.size());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
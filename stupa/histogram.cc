@@ -0,0 +1,114 @@
+//
+// Latency histogram
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include "histogram.h"
+
+namespace {
+/** the number of linear sub-buckets in a half range */
+const size_t HALF_COUNT = 1 << (stupa::Histogram::SUB_BUCKET_BITS - 1);
+/** the number of buckets covering [0, MAX_VALUE] */
+const size_t NUM_BUCKETS = (40 - stupa::Histogram::SUB_BUCKET_BITS + 2)
+                           * HALF_COUNT;
+
+/**
+ * Get the position of the most significant bit.
+ * @param value input value (must be more than zero)
+ * @return position of the most significant bit
+ */
+inline int msb(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+} /* namespace */
+
+namespace stupa {
+
+const int Histogram::SUB_BUCKET_BITS;
+const uint64_t Histogram::MAX_VALUE;
+
+/**
+ * Get the index of the bucket of a value.
+ */
+size_t Histogram::bucket_index(uint64_t value) {
+  if (value < 2 * HALF_COUNT) return static_cast<size_t>(value);
+  int shift = msb(value) - (SUB_BUCKET_BITS - 1);
+  size_t sub = static_cast<size_t>(value >> shift);
+  return (shift + 1) * HALF_COUNT + (sub - HALF_COUNT);
+}
+
+/**
+ * Get the highest value counted in a bucket.
+ */
+uint64_t Histogram::bucket_value(size_t index) {
+  if (index < 2 * HALF_COUNT) return index;
+  int shift = static_cast<int>(index / HALF_COUNT) - 1;
+  uint64_t sub = index % HALF_COUNT + HALF_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Constructor.
+ */
+Histogram::Histogram()
+  : counts_(NUM_BUCKETS, 0), total_(0), min_(0), max_(0), sum_(0.0) { }
+
+/**
+ * Add all values recorded in other histogram.
+ */
+void Histogram::merge(const Histogram &other) {
+  if (other.total_ == 0) return;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    counts_[i] += other.counts_[i];
+  }
+  if (total_ == 0 || other.min_ < min_) min_ = other.min_;
+  if (other.max_ > max_) max_ = other.max_;
+  total_ += other.total_;
+  sum_ += other.sum_;
+}
+
+/**
+ * Clear recorded values.
+ */
+void Histogram::clear() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  total_ = min_ = max_ = 0;
+  sum_ = 0.0;
+}
+
+/**
+ * Get a value at the percentile.
+ */
+uint64_t Histogram::percentile(double percentile) const {
+  if (total_ == 0) return 0;
+  if (percentile >= 100.0) return max_;
+  uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total_ + 0.5);
+  if (rank < 1) rank = 1;
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    cumulative += counts_[i];
+    if (cumulative >= rank) {
+      uint64_t value = bucket_value(i);
+      if (value < min_) return min_;
+      return value < max_ ? value : max_;
+    }
+  }
+  return max_;
+}
+
+} /* namespace stupa */
@@ -0,0 +1,135 @@
+//
+// Latency histogram
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_HISTOGRAM_H_
+#define STUPA_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+namespace stupa {
+
+/**
+ * Histogram of integer values (HDR histogram style).
+ *
+ * Values are recorded into log-linear buckets: every power-of-two range
+ * is split into the same number of linear sub-buckets, so the relative
+ * error of a reported value is bounded (less than 1/64) over the whole
+ * range, while the bucket array stays small enough to keep one histogram
+ * per thread and per operation.
+ */
+class Histogram {
+ public:
+  /** the number of bits of linear sub-buckets */
+  static const int SUB_BUCKET_BITS = 7;
+  /** maximum value to be recorded (larger values are clamped) */
+  static const uint64_t MAX_VALUE = (1ULL << 40) - 1;
+
+ private:
+  std::vector<uint64_t> counts_;  ///< counts of buckets
+  uint64_t total_;                ///< total number of recorded values
+  uint64_t min_;                  ///< minimum recorded value
+  uint64_t max_;                  ///< maximum recorded value
+  double sum_;                    ///< sum of recorded values
+
+  /**
+   * Get the index of the bucket of a value.
+   * @param value input value
+   * @return index of bucket
+   */
+  static size_t bucket_index(uint64_t value);
+
+  /**
+   * Get the highest value counted in a bucket.
+   * @param index index of bucket
+   * @return highest value
+   */
+  static uint64_t bucket_value(size_t index);
+
+ public:
+  /**
+   * Constructor.
+   */
+  Histogram();
+
+  /**
+   * Destructor.
+   */
+  ~Histogram() { }
+
+  /**
+   * Record a value.
+   * @param value value to be recorded
+   */
+  void add(uint64_t value) {
+    if (value > MAX_VALUE) value = MAX_VALUE;
+    counts_[bucket_index(value)]++;
+    if (total_ == 0 || value < min_) min_ = value;
+    if (value > max_) max_ = value;
+    total_++;
+    sum_ += value;
+  }
+
+  /**
+   * Add all values recorded in other histogram.
+   * @param other histogram object
+   */
+  void merge(const Histogram &other);
+
+  /**
+   * Clear recorded values.
+   */
+  void clear();
+
+  /**
+   * Get the number of recorded values.
+   * @return the number of recorded values
+   */
+  uint64_t count() const { return total_; }
+
+  /**
+   * Get minimum recorded value.
+   * @return minimum value
+   */
+  uint64_t min() const { return min_; }
+
+  /**
+   * Get maximum recorded value.
+   * @return maximum value
+   */
+  uint64_t max() const { return max_; }
+
+  /**
+   * Get mean of recorded values.
+   * @return mean value
+   */
+  double mean() const { return total_ ? sum_ / total_ : 0.0; }
+
+  /**
+   * Get a value at the percentile.
+   * @param percentile percentile (0.0 - 100.0)
+   * @return value at the percentile
+   */
+  uint64_t percentile(double percentile) const;
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_HISTOGRAM_H_
@@ -0,0 +1,105 @@
+//
+// Tests for Histogram class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include "histogram.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_VALUES = 10000;    ///< number of recorded values
+const uint64_t MAX_RAND = 1000000;  ///< maximum random value
+
+/* check relative error of a reported value */
+static void check_value(uint64_t expected, uint64_t actual) {
+  double error = (static_cast<double>(actual) - expected) / (expected + 1);
+  EXPECT_LE(std::abs(error), 1.0 / 64);
+}
+
+} /* namespace */
+
+/* add, count, min, max */
+TEST(HistogramTest, AddTest) {
+  stupa::Histogram hist;
+  EXPECT_EQ(0, hist.count());
+  EXPECT_EQ(0, hist.percentile(50.0));
+  for (uint64_t i = 1; i <= 100; i++) {
+    hist.add(i);
+  }
+  EXPECT_EQ(100, hist.count());
+  EXPECT_EQ(1, hist.min());
+  EXPECT_EQ(100, hist.max());
+  EXPECT_DOUBLE_EQ(50.5, hist.mean());
+  EXPECT_EQ(50, hist.percentile(50.0));
+  EXPECT_EQ(99, hist.percentile(99.0));
+  EXPECT_EQ(100, hist.percentile(100.0));
+}
+
+/* percentile */
+TEST(HistogramTest, PercentileTest) {
+  stupa::Histogram hist;
+  std::vector<uint64_t> values;
+  for (size_t i = 0; i < NUM_VALUES; i++) {
+    uint64_t value = static_cast<uint64_t>(rand()) % MAX_RAND;
+    values.push_back(value);
+    hist.add(value);
+  }
+  std::sort(values.begin(), values.end());
+  const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    size_t rank = static_cast<size_t>(percentiles[i] / 100.0 * NUM_VALUES + 0.5);
+    check_value(values[rank - 1], hist.percentile(percentiles[i]));
+  }
+  EXPECT_EQ(values.front(), hist.min());
+  EXPECT_EQ(values.back(), hist.max());
+}
+
+/* large values */
+TEST(HistogramTest, LargeValueTest) {
+  stupa::Histogram hist;
+  hist.add(stupa::Histogram::MAX_VALUE + 1);
+  EXPECT_EQ(stupa::Histogram::MAX_VALUE, hist.max());
+  EXPECT_EQ(stupa::Histogram::MAX_VALUE, hist.percentile(50.0));
+}
+
+/* merge, clear */
+TEST(HistogramTest, MergeTest) {
+  stupa::Histogram hist1, hist2;
+  for (uint64_t i = 1; i <= 50; i++) hist1.add(i);
+  for (uint64_t i = 51; i <= 100; i++) hist2.add(i);
+  hist1.merge(hist2);
+  EXPECT_EQ(100, hist1.count());
+  EXPECT_EQ(1, hist1.min());
+  EXPECT_EQ(100, hist1.max());
+  EXPECT_EQ(50, hist1.percentile(50.0));
+
+  hist1.clear();
+  EXPECT_EQ(0, hist1.count());
+  EXPECT_EQ(0, hist1.max());
+}
+
+int main(int argc, char **argv) {
+  srand((unsigned int)time(NULL));
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -21,14 +21,20 @@
 #define STUPA_IDENTIFIER_H_
 
 #include <stdint.h>
+#include "config.h"
 
 namespace stupa {
 
 /** Type definitions */
-typedef uint64_t DocumentId;  ///< type definition of document id
-typedef uint64_t FeatureId;   ///< type definition of feature id
-typedef double   Point;       ///< type definition of point of vectors
-typedef char *   Feature;     ///< type definition of compressed features
+#ifdef USE_ID32
+typedef uint32_t Identifier;  ///< type definition of identifier (--enable-id32)
+#else
+typedef uint64_t Identifier;  ///< type definition of identifier
+#endif
+typedef Identifier DocumentId;  ///< type definition of document id
+typedef Identifier FeatureId;   ///< type definition of feature id
+typedef double     Point;       ///< type definition of point of vectors
+typedef char *     Feature;     ///< type definition of compressed features
 
 /** Constants */
 const FeatureId  FEATURE_EMPTY_ID   = 0;  ///< empty_key of feature id
@@ -37,6 +43,10 @@ const FeatureId  FEATURE_START_ID   = 2;  ///< start number of feature id
 const DocumentId DOC_EMPTY_ID       = 0;  ///< empty_key of document id
 const DocumentId DOC_DELETED_ID     = 1;  ///< deleted_key of document id
 const DocumentId DOC_START_ID       = 2;  ///< start number of document id
+/** maximum number of feature id */
+const FeatureId  FEATURE_MAX_ID     = ~static_cast<FeatureId>(0);
+/** maximum number of document id */
+const DocumentId DOC_MAX_ID         = ~static_cast<DocumentId>(0);
 
 }  /* namespace stupa */
 
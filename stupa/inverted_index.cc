@@ -17,78 +17,275 @@
 // Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //
 
+#include <cmath>
 #include <algorithm>
 #include <utility>
 #include "inverted_index.h"
 
 namespace stupa {
 
+namespace {
+/** flag of the number of posting lists in files of impact-ordered lists */
+const size_t IMPACT_FORMAT = static_cast<size_t>(1) << (sizeof(size_t) * 8 - 1);
+/** flag of the number of posting lists in files of lists with skip tables */
+const size_t SKIP_FORMAT = static_cast<size_t>(1) << (sizeof(size_t) * 8 - 2);
+
+/** type definition of <document id, count> map */
+typedef stupa::HashMap<stupa::DocumentId, size_t>::type CountHash;
+
+/**
+ * Count documents which are not deleted.
+ * @param inv inverted index
+ * @param document_ids document ids
+ * @param count output counts of documents
+ */
+void count_documents(const stupa::InvertedIndex &inv,
+                     const std::vector<stupa::DocumentId> &document_ids,
+                     CountHash &count) {
+  CountHash::iterator cit;
+  for (size_t i = 0; i < document_ids.size(); i++) {
+    if (inv.is_deleted(document_ids[i])) continue;
+    cit = count.find(document_ids[i]);
+    if (cit == count.end()) {
+      count[document_ids[i]] = 1;
+    } else {
+      cit->second++;
+    }
+  }
+}
+} /* namespace */
+
+/**
+ * Get the impact of a document in posting lists.
+ */
+unsigned char InvertedIndex::impact(RetentionPolicy retention,
+                                    size_t num_features, double quality) {
+  double value = 0.0;
+  switch (retention) {
+    case RETAIN_QUALITY:
+      value = quality;
+      break;
+    default:
+      // weight of each feature in a normalized binary vector
+      value = num_features > 0 ? 1.0 / sqrt(num_features) : 0.0;
+      break;
+  }
+  if (value <= 0.0) return 0;
+  if (value >= 1.0) return 255;
+  return static_cast<unsigned char>(value * 255 + 0.5);
+}
+
 /**
  * Add a documnent into inverted index.
  */
 void InvertedIndex::add_document(DocumentId id,
-                                 const std::vector<FeatureId> &feature_ids) {
+                                 const std::vector<FeatureId> &feature_ids,
+                                 double quality) {
+  unsigned char level = impact(retention_, feature_ids.size(), quality);
   IndexHash::iterator it;
+  std::vector<DocumentId> removed;
   for (size_t i = 0; i < feature_ids.size(); i++) {
     it = index_.find(feature_ids[i]);
     if (it != index_.end() && it->second) {
-      if (max_posting_ > 0) {
-        it->second->add(id, max_posting_);
+      removed.clear();
+      if (max_posting_ > 0 && retention_ == RETAIN_RECENT) {
+        it->second->add(id, level);
+        while (it->second->size() > max_posting_) {
+          removed.push_back(it->second->remove_oldest());
+        }
+      } else if (max_posting_ > 0) {
+        it->second->add(id, level, max_posting_, removed);
       } else {
-        it->second->add(id);
+        it->second->add(id, level);
       }
+      if (!removed.empty()) release_garbage(feature_ids[i], removed);
     } else {
       PostingList *plist = new PostingList;
-      plist->add(id);
+      plist->add(id, level);
       index_[feature_ids[i]] = plist;
     }
   }
 }
 
+/**
+ * Forget deleted ids truncated from a posting list over maximum size.
+ */
+void InvertedIndex::release_garbage(FeatureId feature_id,
+                                    const std::vector<DocumentId> &removed) {
+  if (num_garbage_ == 0) return;
+  GarbageHash::iterator git = garbage_.find(feature_id);
+  if (git == garbage_.end()) return;
+  for (size_t i = 0; i < removed.size() && git->second > 0; i++) {
+    if (!is_deleted(removed[i])) continue;
+    git->second--;
+    num_garbage_--;
+  }
+  if (git->second == 0) garbage_.erase(git);
+  // no deleted id is left in posting lists
+  if (garbage_.empty()) {
+    std::vector<uint64_t>().swap(tombstones_);
+  }
+}
+
+/** Default ratio of deleted ids to compact a posting list */
+const double InvertedIndex::DEFAULT_COMPACTION_RATIO = 0.2;
+
 /**
  * Delete document from inverted index.
  */
 void InvertedIndex::delete_document(DocumentId id,
                                     const std::vector<FeatureId> &feature_ids) {
+  if (is_deleted(id)) return;
+  set_tombstone(id);
   IndexHash::iterator vit;
   for (size_t i = 0; i < feature_ids.size(); i++) {
     vit = index_.find(feature_ids[i]);
-    if (vit != index_.end() && vit->second) {
-      vit->second->remove(id);
-      if (vit->second->empty()) {
-        delete vit->second;
-        index_.erase(feature_ids[i]);
-      }
+    if (vit == index_.end() || !vit->second) continue;
+    // the document may have been truncated from a list of maximum size
+    if (max_posting_ > 0 && !vit->second->contains(id)) continue;
+    size_t &count = garbage_[feature_ids[i]];
+    count++;
+    num_garbage_++;
+    // queue the list once when the ratio crosses the threshold
+    double limit = compaction_ratio_ * vit->second->size();
+    if (count > limit && count - 1 <= limit) {
+      compaction_queue_.push_back(feature_ids[i]);
     }
   }
 }
 
+/**
+ * Delete documents from inverted index at once.
+ */
+void InvertedIndex::delete_documents(
+  const std::vector<DocumentId> &ids,
+  const std::vector<std::vector<FeatureId> > &feature_ids) {
+  for (size_t i = 0; i < ids.size(); i++) {
+    delete_document(ids[i], feature_ids[i]);
+  }
+}
+
+/**
+ * Purge deleted ids from a posting list.
+ */
+void InvertedIndex::compact_list(IndexHash::iterator it) {
+  GarbageHash::iterator git = garbage_.find(it->first);
+  if (git != garbage_.end()) {
+    num_garbage_ -= std::min(num_garbage_, git->second);
+    garbage_.erase(git);
+  }
+  std::vector<DocumentId> ids, deleted;
+  it->second->list(ids);
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (is_deleted(ids[i])) deleted.push_back(ids[i]);
+  }
+  if (deleted.size() == ids.size()) {
+    delete it->second;
+    index_.erase(it);
+  } else if (!deleted.empty()) {
+    std::sort(deleted.begin(), deleted.end());
+    it->second->remove(deleted);
+  }
+}
+
+/**
+ * Purge deleted ids from posting lists.
+ */
+size_t InvertedIndex::compact(size_t max_lists) {
+  size_t count = 0;
+  while (!compaction_queue_.empty() && (max_lists == 0 || count < max_lists)) {
+    FeatureId feature_id = compaction_queue_.back();
+    compaction_queue_.pop_back();
+    if (garbage_.find(feature_id) == garbage_.end()) continue;
+    IndexHash::iterator it = index_.find(feature_id);
+    if (it == index_.end() || !it->second) {
+      garbage_.erase(feature_id);
+      continue;
+    }
+    compact_list(it);
+    count++;
+  }
+  // no deleted id is left in posting lists
+  if (garbage_.empty()) {
+    std::vector<uint64_t>().swap(tombstones_);
+  }
+  return count;
+}
+
+/**
+ * Purge all deleted ids from posting lists.
+ */
+size_t InvertedIndex::purge() {
+  compaction_queue_.clear();
+  for (GarbageHash::const_iterator git = garbage_.begin();
+       git != garbage_.end(); ++git) {
+    compaction_queue_.push_back(git->first);
+  }
+  return compact();
+}
+
+/**
+ * Replace the identifiers of documents in posting lists.
+ */
+void InvertedIndex::reassign_ids(const DocumentIdMap &ids) {
+  for (IndexHash::iterator it = index_.begin(); it != index_.end(); ++it) {
+    if (!it->second) continue;
+    it->second->reassign(ids);
+    if (it->second->empty()) {
+      delete it->second;
+      index_.erase(it);
+    }
+  }
+  std::vector<uint64_t>().swap(tombstones_);
+  garbage_.clear();
+  num_garbage_ = 0;
+  compaction_queue_.clear();
+}
+
 /**
  * Look up inverted indexes.
  */
 void InvertedIndex::lookup(const std::vector<FeatureId> &feature_ids,
                            std::vector<DocumentId> &documents,
-                           size_t max) const {
-  HashMap<DocumentId, size_t>::type count;
-  HashMap<DocumentId, size_t>::type::iterator cit;
-  init_hash_map(DOC_EMPTY_ID, count);
+                           size_t max, SearchTrace *trace) const {
+  CountHash count;
+  CountHash::iterator cit;
+  // low-impact tiers of long posting lists:
+  // <index of feature, first segment not read>
+  std::vector<std::pair<size_t, size_t> > low_tiers;
   std::vector<DocumentId> document_ids;
   for (size_t i = 0; i < feature_ids.size(); i++) {
     IndexHash::const_iterator it = index_.find(feature_ids[i]);
-    if (it != index_.end() && it->second) {
-      it->second->list(document_ids);
-      for (size_t j = 0; j < document_ids.size(); j++) {
-        cit = count.find(document_ids[j]);
-        if (cit == count.end()) {
-          count[document_ids[j]] = 1;
-        } else {
-          cit->second++;
-        }
+    if (it == index_.end() || !it->second) continue;
+    const PostingList *plist = it->second;
+    size_t depth = lookup_depth_;
+    if (tier_size_ > 0 && plist->size() > tier_size_
+        && (depth == 0 || depth > tier_size_)) {
+      size_t next = cache_.list(feature_ids[i], *plist, document_ids,
+                                tier_size_, 0);
+      if (next < plist->segments()) {
+        low_tiers.push_back(std::pair<size_t, size_t>(i, next));
       }
-      document_ids.clear();
+    } else {
+      cache_.list(feature_ids[i], *plist, document_ids, depth, 0);
     }
+    if (trace) trace->postings += document_ids.size();
+    count_documents(*this, document_ids, count);
+    document_ids.clear();
+  }
+
+  for (size_t i = 0; i < low_tiers.size() && count.size() < max; i++) {
+    FeatureId feature_id = feature_ids[low_tiers[i].first];
+    const PostingList *plist = index_.find(feature_id)->second;
+    // documents left to the lookup depth (the high tier has tier_size_ or more)
+    size_t depth = lookup_depth_ > 0 ? lookup_depth_ - tier_size_ : 0;
+    cache_.list(feature_id, *plist, document_ids, depth, low_tiers[i].second);
+    if (trace) trace->postings += document_ids.size();
+    count_documents(*this, document_ids, count);
+    document_ids.clear();
   }
 
+  if (trace) trace->candidates += count.size();
   if (count.size() > max) {
     size_t cnt = 0;
     std::vector<std::pair<DocumentId, size_t> > pairs(count.size());
@@ -110,12 +307,46 @@ void InvertedIndex::lookup(const std::vector<FeatureId> &feature_ids,
  * Save inverted indexes to a file.
  */
 void InvertedIndex::save(std::ofstream &ofs) const {
+  // copies of posting lists without deleted ids (NULL: no id is left)
+  IndexHash purged;
   size_t isiz = index_.size();
-  ofs.write((const char *)&isiz, sizeof(isiz));
+  std::vector<DocumentId> ids, deleted;
+  for (GarbageHash::const_iterator git = garbage_.begin();
+       git != garbage_.end(); ++git) {
+    IndexHash::const_iterator it = index_.find(git->first);
+    if (it == index_.end() || !it->second) continue;
+    ids.clear();
+    deleted.clear();
+    it->second->list(ids);
+    for (size_t i = 0; i < ids.size(); i++) {
+      if (is_deleted(ids[i])) deleted.push_back(ids[i]);
+    }
+    PostingList *plist = NULL;
+    if (deleted.size() == ids.size()) {
+      isiz--;
+    } else {
+      std::sort(deleted.begin(), deleted.end());
+      plist = new PostingList(*it->second);
+      plist->remove(deleted);
+    }
+    purged[git->first] = plist;
+  }
+
+  size_t header = isiz | IMPACT_FORMAT | SKIP_FORMAT;
+  ofs.write((const char *)&header, sizeof(header));
   for (IndexHash::const_iterator it = index_.begin();
        it != index_.end(); ++it) {
-    ofs.write((const char *)&it->first, sizeof(it->first));
-    it->second->save(ofs);
+    IndexHash::const_iterator pit = purged.find(it->first);
+    if (pit == purged.end()) {
+      ofs.write((const char *)&it->first, sizeof(it->first));
+      it->second->save(ofs);
+    } else if (pit->second) {
+      ofs.write((const char *)&it->first, sizeof(it->first));
+      pit->second->save(ofs);
+    }
+  }
+  for (IndexHash::iterator it = purged.begin(); it != purged.end(); ++it) {
+    if (it->second) delete it->second;
   }
 }
 
@@ -126,11 +357,19 @@ void InvertedIndex::load(std::ifstream &ifs) {
   clear();
   size_t isiz;
   ifs.read((char *)&isiz, sizeof(isiz));
+  // files saved before impact-ordered lists have VarBytePostingList
+  bool var_byte = !(isiz & IMPACT_FORMAT);
+  bool skip = (isiz & SKIP_FORMAT) != 0;
+  isiz &= ~(IMPACT_FORMAT | SKIP_FORMAT);
   for (size_t i = 0; i < isiz; i++) {
     FeatureId fid;
     ifs.read((char *)&fid, sizeof(fid));
     PostingList *plist = new PostingList;
-    plist->load(ifs);
+    if (var_byte) {
+      plist->load_var_byte(ifs);
+    } else {
+      plist->load(ifs, skip);
+    }
     index_[fid] = plist;
   }
 }
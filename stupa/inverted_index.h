@@ -24,6 +24,8 @@
 #include <vector>
 #include "config.h"
 #include "identifier.h"
+#include "metrics.h"
+#include "posting_cache.h"
 #include "posting_list.h"
 #include "util.h"
 
@@ -31,34 +33,86 @@ namespace stupa {
 
 /**
  * Inverted Index class.
+ *
+ * Deleted documents are marked in a bitmap of tombstones and skipped by
+ * lookup, while their ids stay in posting lists until compact() purges
+ * the lists whose ratio of deleted ids exceeds a threshold.  Therefore
+ * the identifier of a deleted document must not be added again until
+ * purge() removes it from all posting lists.
  */
 class InvertedIndex {
  public:
   /** Type definition of posting list */
-  typedef VarBytePostingList PostingList;
-  // typedef VectorPostingList PostingList;
+  typedef ImpactPostingList PostingList;
+  // typedef VarBytePostingList PostingList;
 
   /** Type definition of <feature id, posting list object> map */
   typedef HashMap<FeatureId, PostingList *>::type IndexHash;
 
+  /** Type definition of <feature id, the number of deleted ids> map */
+  typedef HashMap<FeatureId, size_t>::type GarbageHash;
+
   /** Default value of maximum number of posting lists to be looked up */
   static const size_t MAX_LOOKUP = 1000;
 
+  /** Default ratio of deleted ids to compact a posting list */
+  static const double DEFAULT_COMPACTION_RATIO;
+
+  /** Policies to retain documents in a posting list over maximum size */
+  enum RetentionPolicy {
+    RETAIN_RECENT,   ///< keep the newest documents (impact: weight)
+    RETAIN_QUALITY,  ///< keep documents of high quality score (0.0-1.0)
+    RETAIN_WEIGHT,   ///< keep documents where the feature has high weight
+  };
+
  private:
   IndexHash index_;     ///< posting lists
   size_t max_posting_;  ///< maximum size of posting list
+  std::vector<uint64_t> tombstones_;  ///< bitmap of deleted document ids
+  GarbageHash garbage_;               ///< deleted ids in each posting list
+  size_t num_garbage_;                ///< deleted ids in all posting lists
+  std::vector<FeatureId> compaction_queue_;  ///< lists to be compacted
+  double compaction_ratio_;           ///< ratio of deleted ids to compact
+  RetentionPolicy retention_;         ///< retention policy
+  size_t lookup_depth_;               ///< documents to be read in each list
+  size_t tier_size_;                  ///< size of high-impact tier
+  mutable PostingCache cache_;        ///< cache of decoded posting lists
+
+  /**
+   * Mark a document as deleted.
+   * @param id the identifier of a document
+   */
+  void set_tombstone(DocumentId id) {
+    size_t word = static_cast<size_t>(id >> 6);
+    if (word >= tombstones_.size()) tombstones_.resize(word + 1, 0);
+    tombstones_[word] |= 1ULL << (id & 63);
+  }
+
+  /**
+   * Purge deleted ids from a posting list.
+   * @param it iterator of the posting list
+   */
+  void compact_list(IndexHash::iterator it);
+
+  /**
+   * Forget deleted ids truncated from a posting list over maximum size.
+   * @param feature_id feature id of the posting list
+   * @param removed identifiers of truncated documents
+   */
+  void release_garbage(FeatureId feature_id,
+                       const std::vector<DocumentId> &removed);
 
  public:
   /**
    * Constructor.
    * @param max_posting maximum size of posting list
+   * @param retention retention policy of posting lists
    */
-  explicit InvertedIndex(size_t max_posting = 0) : max_posting_(max_posting) {
-    init_hash_map(FEATURE_EMPTY_ID, index_);
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-    index_.set_deleted_key(FEATURE_DELETED_ID);
-#endif
-  }
+  explicit InvertedIndex(size_t max_posting = 0,
+                         RetentionPolicy retention = RETAIN_RECENT)
+    : max_posting_(max_posting), num_garbage_(0),
+      compaction_ratio_(DEFAULT_COMPACTION_RATIO), retention_(retention),
+      lookup_depth_(0), tier_size_(0) { }
 
   /**
    * Destructor.
@@ -83,21 +137,120 @@ class InvertedIndex {
    */
   void set_max(size_t max) { max_posting_ = max; }
 
+  /**
+   * Get the maximum size of each posting list.
+   * @return maximum size of posting list (0: no limit)
+   */
+  size_t max() const { return max_posting_; }
+
+  /**
+   * Get the retention policy of posting lists.
+   * @return retention policy
+   */
+  RetentionPolicy retention() const { return retention_; }
+
+  /**
+   * Set the number of documents to be read in each posting list.
+   * Posting lists are read in descending order of impact, and the segments
+   * of lower impact are skipped after the number of documents.
+   * @param depth the number of documents (0: all documents)
+   */
+  void set_lookup_depth(size_t depth) { lookup_depth_ = depth; }
+
+  /**
+   * Set the size of high-impact tier of long posting lists.
+   * Lookup reads the high-impact documents of posting lists longer than
+   * the size first, and reads the rest (low-impact tier) only when
+   * the number of candidates is less than the maximum.
+   * @param size the number of high-impact documents (0: no tiers)
+   */
+  void set_tier_size(size_t size) { tier_size_ = size; }
+
+  /**
+   * Set the memory budget of the cache of decoded posting lists.
+   * Long posting lists are decoded once and read from the cache until
+   * they are updated.
+   * @param bytes memory budget (0: no cache)
+   */
+  void set_cache_size(size_t bytes) { cache_.set_max_bytes(bytes); }
+
+  /**
+   * Get the cache of decoded posting lists.
+   * @return the reference of the cache
+   */
+  const PostingCache &cache() const { return cache_; }
+
+  /**
+   * Get the number of documents read by lookup in a posting list.
+   * @param feature_id feature id of the posting list
+   * @return the number of documents (limited by the lookup depth)
+   */
+  size_t postings(FeatureId feature_id) const {
+    IndexHash::const_iterator it = index_.find(feature_id);
+    if (it == index_.end() || !it->second) return 0;
+    size_t size = it->second->size();
+    return (lookup_depth_ > 0 && lookup_depth_ < size) ? lookup_depth_ : size;
+  }
+
+  /**
+   * Get the impact of a document in posting lists.
+   * @param retention retention policy
+   * @param num_features the number of features of the document
+   * @param quality quality score of the document (0.0-1.0)
+   * @return impact (0-255)
+   */
+  static unsigned char impact(RetentionPolicy retention, size_t num_features,
+                              double quality);
+
+  /**
+   * Set the ratio of deleted ids to compact a posting list.
+   * @param ratio ratio of deleted ids in a posting list (0: any deleted id)
+   */
+  void set_compaction_ratio(double ratio) { compaction_ratio_ = ratio; }
+
+  /**
+   * Check whether a document is deleted or not.
+   * @param id the identifier of a document
+   * @return true if deleted
+   */
+  bool is_deleted(DocumentId id) const {
+    size_t word = static_cast<size_t>(id >> 6);
+    return word < tombstones_.size()
+      && (tombstones_[word] & (1ULL << (id & 63)));
+  }
+
+  /**
+   * Get the number of deleted ids remaining in posting lists.
+   * @return the number of deleted ids
+   */
+  size_t garbage() const { return num_garbage_; }
+
   /**
    * Add a documnent into inverted index.
    * @param id the identifier of a document
    * @param feature_ids the feature ids of a document
+   * @param quality quality score of a document (used by RETAIN_QUALITY)
    */
-  void add_document(DocumentId id, const std::vector<FeatureId> &feature_ids);
+  void add_document(DocumentId id, const std::vector<FeatureId> &feature_ids,
+                    double quality = 0.0);
 
   /**
    * Delete a document from inverted index.
+   * The document is marked as deleted and posting lists are not rewritten.
    * @param id the identifier of a document
    * @param feature_ids the feature ids of a document
    */
   void delete_document(DocumentId id,
                        const std::vector<FeatureId> &feature_ids);
 
+  /**
+   * Delete documents from inverted index at once.
+   * @param ids the identifiers of documents
+   * @param feature_ids the feature ids of each document
+   */
+  void delete_documents(const std::vector<DocumentId> &ids,
+                        const std::vector<std::vector<FeatureId> > &feature_ids);
+
   /**
    * Clear all indexes.
    */
@@ -106,20 +259,50 @@ class InvertedIndex {
       if (it->second) delete it->second;
     }
     index_.clear();
+    std::vector<uint64_t>().swap(tombstones_);
+    garbage_.clear();
+    num_garbage_ = 0;
+    compaction_queue_.clear();
+    cache_.clear();
   }
 
+  /**
+   * Purge deleted ids from posting lists whose ratio of deleted ids
+   * exceeds the threshold.  Each posting list is rewritten only once.
+   * @param max_lists maximum number of posting lists to be compacted
+   *                  (0: all of them)
+   * @return the number of compacted posting lists
+   */
+  size_t compact(size_t max_lists = 0);
+
+  /**
+   * Purge all deleted ids from posting lists regardless of the threshold.
+   * The identifiers of deleted documents can be added again after it.
+   * @return the number of compacted posting lists
+   */
+  size_t purge();
+
+  /**
+   * Replace the identifiers of documents in posting lists.
+   * Deleted documents are purged since they are not in the map.
+   * @param ids map of old identifiers to new ones
+   */
+  void reassign_ids(const DocumentIdMap &ids);
+
   /**
    * Look up inverted indexes.
    * @param feature_ids feature ids to be looked up
    * @param documents output list of document ids
    * @param max maximum number of posting lists to be looked up
+   * @param trace output the numbers of postings and candidates (optional)
    */
   void lookup(const std::vector<FeatureId> &feature_ids,
               std::vector<DocumentId> &documents,
-              size_t max = MAX_LOOKUP) const;
+              size_t max = MAX_LOOKUP, SearchTrace *trace = NULL) const;
 
   /**
    * Save inverted indexes to a file.
+   * Deleted ids are not saved.
    * @param ofs output stream
    */
   void save(std::ofstream &ofs) const;
@@ -18,6 +18,7 @@
 //
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <vector>
@@ -121,6 +122,7 @@ TEST(InvertedIndexTest, DeleteDocumentTest) {
   Count feature_count;
   set_input_documents(documents, feature_count);
   stupa::InvertedIndex inv;
+  inv.set_compaction_ratio(0);
   add_documents(inv, documents);
 
   // delete some documents
@@ -145,9 +147,259 @@ TEST(InvertedIndexTest, DeleteDocumentTest) {
     }
   }
 
+  // deleted documents are skipped until posting lists are compacted
+  EXPECT_LT(0, inv.garbage());
+  std::vector<stupa::FeatureId> features;
+  for (Count::iterator fit = feature_count.begin();
+       fit != feature_count.end(); ++fit) {
+    features.push_back(fit->first);
+  }
+  std::vector<stupa::DocumentId> results;
+  inv.lookup(features, results, NUM_DOC);
+  EXPECT_EQ(documents.size() - num_deleted, results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_FALSE(inv.is_deleted(results[i]));
+  }
+
+  EXPECT_LT(0, inv.compact());
+  EXPECT_EQ(0, inv.garbage());
+  EXPECT_EQ(0, inv.compact());
   check_index(inv, documents, feature_count);
 }
 
+/* delete_documents */
+TEST(InvertedIndexTest, DeleteDocumentsTest) {
+  TestSet documents;
+  Count feature_count;
+  set_input_documents(documents, feature_count);
+  stupa::InvertedIndex inv;
+  inv.set_compaction_ratio(0);
+  add_documents(inv, documents);
+
+  // delete the first half at once
+  std::vector<stupa::DocumentId> ids;
+  std::vector<std::vector<stupa::FeatureId> > features;
+  TestSet remain;
+  for (TestSet::const_iterator it = documents.begin();
+       it != documents.end(); ++it) {
+    if (ids.size() < NUM_DOC / 2) {
+      ids.push_back(it->first);
+      features.push_back(it->second);
+    } else {
+      remain[it->first] = it->second;
+    }
+  }
+  inv.delete_documents(ids, features);
+
+  Count remain_count;
+  for (TestSet::const_iterator it = remain.begin(); it != remain.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); i++) {
+      remain_count[it->second[i]].push_back(it->first);
+    }
+  }
+
+  // deleted documents are not saved
+  std::ofstream ofs(SAVE_FILE);
+  inv.save(ofs);
+  ofs.close();
+  stupa::InvertedIndex loaded;
+  std::ifstream ifs(SAVE_FILE);
+  loaded.load(ifs);
+  ifs.close();
+  EXPECT_EQ(0, loaded.garbage());
+  check_index(loaded, remain, remain_count);
+  remove(SAVE_FILE);
+
+  // compact at most one posting list at a time
+  size_t num_lists = inv.size();
+  EXPECT_EQ(1, inv.compact(1));
+  while (inv.compact(1) > 0) { }
+  EXPECT_EQ(0, inv.garbage());
+  EXPECT_GE(num_lists, inv.size());
+  check_index(inv, remain, remain_count);
+}
+
+/* add_document with retention policies */
+TEST(InvertedIndexTest, RetentionTest) {
+  std::vector<stupa::FeatureId> small(1, 10), large;
+  for (stupa::FeatureId fid = 10; fid < 10 + NUM_FEATURE; fid++) {
+    large.push_back(fid);
+  }
+  std::vector<stupa::DocumentId> results;
+
+  // recency: the newest documents are kept
+  stupa::InvertedIndex recent(2);
+  recent.add_document(2, small);
+  recent.add_document(3, large);
+  recent.add_document(4, large);
+  recent.lookup(small, results);
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(2, results.size());
+  EXPECT_EQ(3, results[0]);
+  EXPECT_EQ(4, results[1]);
+
+  // quality: documents of high quality score are kept
+  stupa::InvertedIndex quality(2, stupa::InvertedIndex::RETAIN_QUALITY);
+  quality.add_document(2, small, 0.9);
+  quality.add_document(3, small, 0.1);
+  quality.add_document(4, small, 0.5);
+  results.clear();
+  quality.lookup(small, results);
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(2, results.size());
+  EXPECT_EQ(2, results[0]);
+  EXPECT_EQ(4, results[1]);
+
+  // weight: documents with fewer features are kept
+  stupa::InvertedIndex weight(2, stupa::InvertedIndex::RETAIN_WEIGHT);
+  weight.add_document(2, small);
+  weight.add_document(3, large);
+  weight.add_document(4, large);
+  results.clear();
+  weight.lookup(small, results);
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(2, results.size());
+  EXPECT_EQ(2, results[0]);
+  EXPECT_EQ(4, results[1]);
+
+  // lookup depth: segments of lower impact are skipped
+  weight.set_lookup_depth(1);
+  results.clear();
+  weight.lookup(small, results);
+  EXPECT_EQ(1, results.size());
+  EXPECT_EQ(2, results[0]);
+
+  EXPECT_EQ(128, stupa::InvertedIndex::impact(
+              stupa::InvertedIndex::RETAIN_RECENT, 4, 1.0));
+  EXPECT_EQ(0, stupa::InvertedIndex::impact(
+              stupa::InvertedIndex::RETAIN_QUALITY, 4, 0.0));
+  EXPECT_EQ(255, stupa::InvertedIndex::impact(
+              stupa::InvertedIndex::RETAIN_QUALITY, 4, 2.0));
+  EXPECT_EQ(128, stupa::InvertedIndex::impact(
+              stupa::InvertedIndex::RETAIN_WEIGHT, 4, 0.0));
+}
+
+/* deleted ids truncated from posting lists of maximum size */
+TEST(InvertedIndexTest, TruncateDeletedTest) {
+  std::vector<stupa::FeatureId> small(1, 10);
+
+  // recency: the oldest (deleted) document is truncated
+  stupa::InvertedIndex recent(2);
+  recent.add_document(2, small);
+  recent.add_document(3, small);
+  recent.delete_document(2, small);
+  EXPECT_EQ(1, recent.garbage());
+  recent.add_document(4, small);
+  EXPECT_EQ(0, recent.garbage());
+  EXPECT_FALSE(recent.is_deleted(2));  // no tombstone is left
+
+  // a document already truncated is not counted when deleted
+  recent.add_document(5, small);
+  recent.delete_document(3, small);
+  EXPECT_EQ(0, recent.garbage());
+  EXPECT_EQ(0, recent.compact());
+
+  // quality: a deleted document of low quality is truncated
+  stupa::InvertedIndex quality(2, stupa::InvertedIndex::RETAIN_QUALITY);
+  quality.add_document(2, small, 0.1);
+  quality.add_document(3, small, 0.9);
+  quality.delete_document(2, small);
+  EXPECT_EQ(1, quality.garbage());
+  quality.add_document(4, small, 0.5);
+  EXPECT_EQ(0, quality.garbage());
+
+  // deleted ids never exceed the postings in streaming updates
+  stupa::InvertedIndex stream(NUM_FEATURE);
+  for (stupa::DocumentId did = 2; did < 2 + NUM_DOC * 10; did++) {
+    stream.add_document(did, small);
+    if (did % 3 == 0) stream.delete_document(did, small);
+    ASSERT_GE(NUM_FEATURE, stream.garbage());
+  }
+  std::vector<stupa::DocumentId> results;
+  stream.lookup(small, results);
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_NE(0, results[i] % 3);
+  }
+}
+
+/* lookup with tiers */
+TEST(InvertedIndexTest, TierTest) {
+  std::vector<stupa::FeatureId> small(1, 10), large;
+  for (stupa::FeatureId fid = 10; fid < 10 + NUM_FEATURE; fid++) {
+    large.push_back(fid);
+  }
+  stupa::InvertedIndex inv;
+  inv.set_tier_size(5);
+  for (stupa::DocumentId did = 2; did < 52; did++) {
+    inv.add_document(did, large);
+  }
+  for (stupa::DocumentId did = 52; did < 57; did++) {
+    inv.add_document(did, small);
+  }
+
+  // the high-impact tier fills candidates
+  std::vector<stupa::DocumentId> results;
+  stupa::SearchTrace trace;
+  inv.lookup(small, results, 5, &trace);
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(5, trace.postings);
+  ASSERT_EQ(5, results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(52 + i, results[i]);
+  }
+
+  // the low-impact tier is read for more candidates
+  results.clear();
+  inv.lookup(small, results, NUM_DOC);
+  EXPECT_EQ(55, results.size());
+
+  // short posting lists are read at once
+  inv.set_tier_size(100);
+  results.clear();
+  trace.clear();
+  inv.lookup(small, results, 5, &trace);
+  EXPECT_EQ(55, trace.postings);
+}
+
+/* lookup through the cache of decoded posting lists */
+TEST(InvertedIndexTest, CacheTest) {
+  std::vector<stupa::FeatureId> features(1, 10);
+  // segments of four impacts
+  stupa::InvertedIndex inv(0, stupa::InvertedIndex::RETAIN_QUALITY);
+  stupa::InvertedIndex cached(0, stupa::InvertedIndex::RETAIN_QUALITY);
+  cached.set_cache_size(1024 * 1024);
+  cached.set_tier_size(stupa::PostingCache::MIN_POSTINGS);
+  inv.set_tier_size(stupa::PostingCache::MIN_POSTINGS);
+  size_t size = stupa::PostingCache::MIN_POSTINGS * 2;
+  for (stupa::DocumentId did = 1; did <= size; did++) {
+    inv.add_document(did, features, (did % 4) / 4.0);
+    cached.add_document(did, features, (did % 4) / 4.0);
+  }
+
+  std::vector<stupa::DocumentId> expected, results;
+  inv.lookup(features, expected, size);
+  cached.lookup(features, results, size);
+  cached.lookup(features, results, size);
+  EXPECT_EQ(size * 2, results.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), results.begin()));
+  // both tiers of the list are read from one entry
+  EXPECT_EQ(1, cached.cache().misses());
+  EXPECT_EQ(3, cached.cache().hits());
+
+  // updated lists are decoded again
+  inv.add_document(size + 1, features);
+  cached.add_document(size + 1, features);
+  expected.clear();
+  results.clear();
+  inv.lookup(features, expected, size + 1);
+  cached.lookup(features, results, size + 1);
+  EXPECT_TRUE(expected == results);
+  EXPECT_EQ(2, cached.cache().misses());
+
+  cached.clear();
+  EXPECT_EQ(0, cached.cache().size());
+}
+
 /* clear */
 TEST(InvertedIndexTest, ClearTest) {
   TestSet documents;
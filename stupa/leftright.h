@@ -0,0 +1,183 @@
+//
+// Left-Right concurrency control
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_LEFTRIGHT_H_
+#define STUPA_LEFTRIGHT_H_
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace stupa {
+
+/**
+ * Two instances of an object shared by readers and writers
+ * (Left-Right technique).
+ *
+ * Readers never block: they announce themselves on a read indicator and
+ * read the active instance.  A writer updates the standby instance,
+ * publishes it to readers, waits until no reader is left on the old
+ * instance, and then applies the same update to the old instance.
+ * Writers are serialized by a mutex, and updates cost twice as much as
+ * with a single instance, as does memory.
+ */
+template <typename T>
+class LeftRight {
+ private:
+  /** Read indicator padded to its own cache line */
+  struct Indicator {
+    volatile long readers;  ///< the number of readers
+    char padding[64 - sizeof(long)];  ///< padding
+
+    Indicator() : readers(0) { }
+  };
+
+  T *instances_[2];        ///< instances
+  volatile int active_;    ///< index of the instance read by new readers
+  volatile int version_;   ///< index of the read indicator of new readers
+  Indicator indicators_[2];  ///< read indicators
+  pthread_mutex_t mutex_;  ///< lock of writers
+
+  /**
+   * Wait until no reader is on a read indicator.
+   * @param version index of read indicator
+   */
+  void wait_readers(int version) {
+    while (indicators_[version].readers != 0) sched_yield();
+  }
+
+  /**
+   * Copy constructor (disabled).
+   */
+  LeftRight(const LeftRight &);
+
+  /**
+   * Assignment operator (disabled).
+   */
+  LeftRight &operator=(const LeftRight &);
+
+ public:
+  /**
+   * Guard to read the active instance while it exists.
+   */
+  class ReadGuard {
+   private:
+    LeftRight &lr_;        ///< shared object
+    int version_;          ///< index of read indicator
+    const T *instance_;    ///< instance to be read
+
+   public:
+    /**
+     * Constructor.
+     * @param lr shared object
+     */
+    explicit ReadGuard(LeftRight &lr) : lr_(lr), version_(lr.version_) {
+      __sync_add_and_fetch(&lr_.indicators_[version_].readers, 1);
+      instance_ = lr_.instances_[lr_.active_];
+    }
+
+    /**
+     * Destructor.
+     */
+    ~ReadGuard() {
+      __sync_sub_and_fetch(&lr_.indicators_[version_].readers, 1);
+    }
+
+    /**
+     * Get the instance.
+     * @return instance
+     */
+    const T &operator*() const { return *instance_; }
+
+    /**
+     * Get the instance.
+     * @return instance
+     */
+    const T *operator->() const { return instance_; }
+  };
+
+  /**
+   * Guard of a writer.  Apply an update to standby(), call publish(),
+   * and apply the same update to standby() again.
+   */
+  class WriteGuard {
+   private:
+    LeftRight &lr_;  ///< shared object
+
+   public:
+    /**
+     * Constructor.
+     * @param lr shared object
+     */
+    explicit WriteGuard(LeftRight &lr) : lr_(lr) {
+      pthread_mutex_lock(&lr_.mutex_);
+    }
+
+    /**
+     * Destructor.
+     */
+    ~WriteGuard() {
+      pthread_mutex_unlock(&lr_.mutex_);
+    }
+
+    /**
+     * Get the instance which no reader reads.
+     * @return standby instance
+     */
+    T &standby() { return *lr_.instances_[1 - lr_.active_]; }
+
+    /**
+     * Make the standby instance active and wait for the readers of
+     * the old active instance.
+     */
+    void publish() {
+      lr_.active_ = 1 - lr_.active_;
+      __sync_synchronize();
+      int prev = lr_.version_;
+      int next = 1 - prev;
+      lr_.wait_readers(next);
+      lr_.version_ = next;
+      __sync_synchronize();
+      lr_.wait_readers(prev);
+    }
+  };
+
+  /**
+   * Constructor.
+   * @param left first instance (deleted by this object)
+   * @param right second instance, equal to the first one
+   */
+  LeftRight(T *left, T *right) : active_(0), version_(0) {
+    instances_[0] = left;
+    instances_[1] = right;
+    pthread_mutex_init(&mutex_, NULL);
+  }
+
+  /**
+   * Destructor.
+   */
+  ~LeftRight() {
+    pthread_mutex_destroy(&mutex_);
+    delete instances_[0];
+    delete instances_[1];
+  }
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_LEFTRIGHT_H_
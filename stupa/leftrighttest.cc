@@ -0,0 +1,101 @@
+//
+// Tests for LeftRight class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include "leftright.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_READER = 4;     ///< number of reader threads
+const size_t NUM_WRITE  = 2000;  ///< number of updates
+
+/* object whose two values are always equal when it is not updated */
+struct Pair {
+  volatile size_t first;   ///< first value
+  volatile size_t second;  ///< second value
+  Pair() : first(0), second(0) { }
+};
+
+/* arguments of a reader thread */
+struct ReaderArg {
+  stupa::LeftRight<Pair> *lr;  ///< shared object
+  volatile bool *stop;         ///< stop flag
+  size_t errors;               ///< the number of inconsistent reads
+};
+
+/* read values until stopped */
+static void *read_values(void *arg) {
+  ReaderArg *r = reinterpret_cast<ReaderArg *>(arg);
+  while (!*r->stop) {
+    stupa::LeftRight<Pair>::ReadGuard guard(*r->lr);
+    size_t first = guard->first;
+    sched_yield();
+    if (guard->second != first) r->errors++;
+  }
+  return NULL;
+}
+
+/* update values of standby instance */
+static void update(Pair &pair, size_t value) {
+  pair.first = value;
+  sched_yield();
+  pair.second = value;
+}
+
+} /* namespace */
+
+/* ReadGuard, WriteGuard */
+TEST(LeftRightTest, ReadWriteTest) {
+  stupa::LeftRight<Pair> lr(new Pair, new Pair);
+  volatile bool stop = false;
+  pthread_t threads[NUM_READER];
+  ReaderArg args[NUM_READER];
+  for (size_t i = 0; i < NUM_READER; i++) {
+    args[i].lr = &lr;
+    args[i].stop = &stop;
+    args[i].errors = 0;
+    pthread_create(&threads[i], NULL, read_values, &args[i]);
+  }
+  for (size_t i = 1; i <= NUM_WRITE; i++) {
+    stupa::LeftRight<Pair>::WriteGuard writer(lr);
+    update(writer.standby(), i);
+    writer.publish();
+    update(writer.standby(), i);
+  }
+  stop = true;
+  for (size_t i = 0; i < NUM_READER; i++) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, args[i].errors);
+  }
+
+  {
+    stupa::LeftRight<Pair>::ReadGuard guard(lr);
+    EXPECT_EQ(NUM_WRITE, guard->first);
+  }
+  stupa::LeftRight<Pair>::WriteGuard writer(lr);
+  EXPECT_EQ(NUM_WRITE, writer.standby().first);
+  EXPECT_EQ(NUM_WRITE, writer.standby().second);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
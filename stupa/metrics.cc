@@ -0,0 +1,204 @@
+//
+// Runtime metrics of search servers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <cstdio>
+#include "metrics.h"
+
+namespace {
+/** names of operations */
+const char *OPERATION_NAMES[] = {
+  "add", "delete", "size", "clear", "search_by_document", "search_by_feature",
+  "save", "load", "stats",
+};
+/** names of search stages */
+const char *STAGE_NAMES[] = { "dictionary", "lookup", "scoring", "mapping" };
+/** names of search plans */
+const char *PLAN_NAMES[] = { "lookup", "scan" };
+/** names of lock types */
+const char *LOCK_NAMES[] = { "read", "write" };
+
+/**
+ * Write a value.
+ * @param os output stream
+ * @param name name of the value
+ * @param value value
+ */
+void write_value(std::ostream &os, const std::string &name, uint64_t value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(value));
+  os << name << stupa::DELIMITER << buf << "\n";
+}
+
+/**
+ * Write statistics of a histogram.
+ * @param os output stream
+ * @param name name of the histogram
+ * @param hist histogram
+ * @param unit unit of values (used as the suffix of names)
+ * @param scale divisor of values
+ */
+void write_histogram(std::ostream &os, const std::string &name,
+                     const stupa::Histogram &hist, const char *unit,
+                     double scale) {
+  static const double PERCENTILES[] = { 50.0, 90.0, 99.0, 99.9 };
+  static const char *PERCENTILE_NAMES[] = { "p50", "p90", "p99", "p999" };
+  char buf[64];
+  write_value(os, name + ".count", hist.count());
+  if (hist.count() == 0) return;
+  snprintf(buf, sizeof(buf), "%.3f", hist.mean() / scale);
+  os << name << ".mean" << unit << stupa::DELIMITER << buf << "\n";
+  for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); i++) {
+    snprintf(buf, sizeof(buf), "%.3f", hist.percentile(PERCENTILES[i]) / scale);
+    os << name << "." << PERCENTILE_NAMES[i] << unit
+       << stupa::DELIMITER << buf << "\n";
+  }
+  snprintf(buf, sizeof(buf), "%.3f", hist.max() / scale);
+  os << name << ".max" << unit << stupa::DELIMITER << buf << "\n";
+}
+} /* namespace */
+
+namespace stupa {
+
+/**
+ * Get the name of a search stage.
+ */
+const char *search_stage_name(SearchStage stage) {
+  return STAGE_NAMES[stage];
+}
+
+/**
+ * Get the name of a search plan.
+ */
+const char *search_plan_name(SearchPlan plan) {
+  return PLAN_NAMES[plan];
+}
+
+/**
+ * Write statistics as 'name \t value' lines.
+ */
+void IndexStatistics::write(std::ostream &os) const {
+  write_value(os, "index.documents", documents);
+  write_value(os, "index.features", features);
+  write_value(os, "index.feature_bytes", feature_bytes);
+  write_value(os, "index.feature_free_bytes", feature_free_bytes);
+  write_value(os, "index.posting_bytes", posting_bytes);
+  write_value(os, "index.deleted_postings", deleted_postings);
+  write_value(os, "index.df_cutoff", df_cutoff);
+  write_value(os, "index.dictionary_bytes", dictionary_bytes);
+  write_value(os, "index.posting_cache_max_bytes", posting_cache_max_bytes);
+  write_value(os, "index.posting_cache_bytes", posting_cache_bytes);
+  write_value(os, "index.posting_cache_hits", posting_cache_hits);
+  write_value(os, "index.posting_cache_misses", posting_cache_misses);
+  write_value(os, "index.posting_cache_evictions", posting_cache_evictions);
+  write_histogram(os, "index.posting_length", posting_length, "", 1.0);
+}
+
+/**
+ * Constructor.
+ */
+Metrics::Metrics() {
+  pthread_key_create(&key_, NULL);
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+/**
+ * Destructor.
+ */
+Metrics::~Metrics() {
+  for (size_t i = 0; i < threads_.size(); i++) delete threads_[i];
+  pthread_mutex_destroy(&mutex_);
+  pthread_key_delete(key_);
+}
+
+/**
+ * Allocate counters of the current thread.
+ */
+Metrics::Counters *Metrics::register_thread() {
+  Counters *counters = new Counters;
+  pthread_mutex_lock(&mutex_);
+  threads_.push_back(counters);
+  pthread_mutex_unlock(&mutex_);
+  pthread_setspecific(key_, counters);
+  return counters;
+}
+
+/**
+ * Get the name of an operation.
+ */
+const char *Metrics::operation_name(Operation operation) {
+  return OPERATION_NAMES[operation];
+}
+
+/**
+ * Get aggregated latency of an operation.
+ */
+void Metrics::operation_latency(Operation operation,
+                                Histogram &result) const {
+  pthread_mutex_lock(&mutex_);
+  for (size_t i = 0; i < threads_.size(); i++) {
+    result.merge(threads_[i]->operations[operation]);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Write metrics as 'name \t value' lines.
+ *
+ * Counters of other threads are read while they may be updated,
+ * so the values are not an exact snapshot.
+ */
+void Metrics::write(std::ostream &os) const {
+  Counters *total = new Counters;
+  pthread_mutex_lock(&mutex_);
+  for (size_t i = 0; i < threads_.size(); i++) {
+    for (int j = 0; j < NUM_OPERATIONS; j++) {
+      total->operations[j].merge(threads_[i]->operations[j]);
+    }
+    for (int j = 0; j < NUM_SEARCH_STAGES; j++) {
+      total->stages[j].merge(threads_[i]->stages[j]);
+    }
+    for (int j = 0; j < NUM_LOCK_TYPES; j++) {
+      total->lock_wait[j].merge(threads_[i]->lock_wait[j]);
+    }
+    for (int j = 0; j < NUM_SEARCH_PLANS; j++) {
+      total->plans[j] += threads_[i]->plans[j];
+    }
+  }
+  pthread_mutex_unlock(&mutex_);
+
+  for (int i = 0; i < NUM_OPERATIONS; i++) {
+    write_histogram(os, std::string("operation.") + OPERATION_NAMES[i],
+                    total->operations[i], "_us", 1e3);
+  }
+  for (int i = 0; i < NUM_SEARCH_STAGES; i++) {
+    write_histogram(os, std::string("stage.") + STAGE_NAMES[i],
+                    total->stages[i], "_us", 1e3);
+  }
+  for (int i = 0; i < NUM_LOCK_TYPES; i++) {
+    write_histogram(os, std::string("lock_wait.") + LOCK_NAMES[i],
+                    total->lock_wait[i], "_us", 1e3);
+  }
+  for (int i = 0; i < NUM_SEARCH_PLANS; i++) {
+    write_value(os, std::string("plan.") + PLAN_NAMES[i] + ".count",
+                total->plans[i]);
+  }
+  delete total;
+}
+
+} /* namespace stupa */
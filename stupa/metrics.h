@@ -0,0 +1,299 @@
+//
+// Runtime metrics of search servers
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_METRICS_H_
+#define STUPA_METRICS_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "histogram.h"
+#include "util.h"
+
+namespace stupa {
+
+/**
+ * Stages of a search.
+ */
+enum SearchStage {
+  STAGE_DICTIONARY,  ///< mapping from strings to ids
+  STAGE_LOOKUP,      ///< looking up inverted indexes
+  STAGE_SCORING,     ///< scoring candidates
+  STAGE_MAPPING,     ///< mapping from ids to strings
+  NUM_SEARCH_STAGES,
+};
+
+/**
+ * Plans of a search.
+ */
+enum SearchPlan {
+  PLAN_LOOKUP,  ///< score candidates of inverted indexes
+  PLAN_SCAN,    ///< score all documents
+  NUM_SEARCH_PLANS,
+};
+
+/**
+ * Trace of a search, filled by StupaSearch.
+ */
+struct SearchTrace {
+  uint64_t stage_time[NUM_SEARCH_STAGES];  ///< elapsed time (nsec)
+  uint64_t query_features;  ///< the number of features of queries
+  uint64_t skipped_features;  ///< features not looked up (high frequency)
+  uint64_t postings;        ///< the number of decoded postings
+  uint64_t candidates;      ///< the number of counted candidates
+  uint64_t scored;          ///< the number of scored candidates
+  uint64_t results;         ///< the number of results
+  uint64_t plans[NUM_SEARCH_PLANS];  ///< the number of searches by each plan
+  uint64_t lock_wait;       ///< wait time to acquire a lock (nsec)
+
+  /**
+   * Constructor.
+   */
+  SearchTrace() { clear(); }
+
+  /**
+   * Clear recorded values.
+   */
+  void clear() {
+    for (int i = 0; i < NUM_SEARCH_STAGES; i++) stage_time[i] = 0;
+    query_features = skipped_features = 0;
+    postings = candidates = scored = results = 0;
+    for (int i = 0; i < NUM_SEARCH_PLANS; i++) plans[i] = 0;
+    lock_wait = 0;
+  }
+};
+
+/**
+ * Get the name of a search stage.
+ * @param stage search stage
+ * @return name of stage
+ */
+const char *search_stage_name(SearchStage stage);
+
+/**
+ * Get the name of a search plan.
+ * @param plan search plan
+ * @return name of plan
+ */
+const char *search_plan_name(SearchPlan plan);
+
+/**
+ * Statistics of index, filled by StupaSearch.
+ */
+struct IndexStatistics {
+  uint64_t documents;         ///< the number of documents
+  uint64_t features;          ///< the number of features in index
+  uint64_t feature_bytes;     ///< bytes of the features of documents
+  uint64_t feature_free_bytes;  ///< free bytes left by deleted features
+  uint64_t posting_bytes;     ///< bytes of posting lists
+  uint64_t deleted_postings;  ///< deleted ids left in posting lists
+  uint64_t df_cutoff;         ///< frequency of features not looked up
+  uint64_t dictionary_bytes;  ///< bytes of string-to-id dictionaries
+  uint64_t posting_cache_max_bytes;  ///< budget of posting list cache
+  uint64_t posting_cache_bytes;      ///< bytes of cached posting lists
+  uint64_t posting_cache_hits;       ///< hits of posting list cache
+  uint64_t posting_cache_misses;     ///< misses of posting list cache
+  uint64_t posting_cache_evictions;  ///< evictions of posting list cache
+  Histogram posting_length;   ///< distribution of posting list length
+
+  /**
+   * Constructor.
+   */
+  IndexStatistics()
+    : documents(0), features(0), feature_bytes(0), feature_free_bytes(0),
+      posting_bytes(0), deleted_postings(0), df_cutoff(0), dictionary_bytes(0),
+      posting_cache_max_bytes(0), posting_cache_bytes(0),
+      posting_cache_hits(0), posting_cache_misses(0),
+      posting_cache_evictions(0) { }
+
+  /**
+   * Write statistics as 'name \t value' lines.
+   * @param os output stream
+   */
+  void write(std::ostream &os) const;
+};
+
+/**
+ * Runtime metrics of search servers.
+ *
+ * Each thread records values to its own counters without locks,
+ * and the counters of all threads are aggregated when they are read.
+ */
+class Metrics {
+ public:
+  /** Operations of search servers */
+  enum Operation {
+    ADD,
+    DELETE,
+    SIZE,
+    CLEAR,
+    SEARCH_BY_DOCUMENT,
+    SEARCH_BY_FEATURE,
+    SAVE,
+    LOAD,
+    STATS,
+    NUM_OPERATIONS,
+  };
+
+  /** Types of locks */
+  enum LockType {
+    READ_LOCK,
+    WRITE_LOCK,
+    NUM_LOCK_TYPES,
+  };
+
+  /**
+   * Timer to record latency of an operation when it goes out of scope.
+   */
+  class ScopedTimer {
+   private:
+    Metrics &metrics_;     ///< metrics
+    Operation operation_;  ///< operation
+    uint64_t start_;       ///< start time (nsec)
+
+   public:
+    /**
+     * Constructor.
+     * @param metrics metrics object
+     * @param operation operation to be recorded
+     */
+    ScopedTimer(Metrics &metrics, Operation operation)
+      : metrics_(metrics), operation_(operation), start_(get_time_nsec()) { }
+
+    /**
+     * Destructor.
+     */
+    ~ScopedTimer() {
+      metrics_.record(operation_, get_time_nsec() - start_);
+    }
+  };
+
+ private:
+  /** Counters of a thread */
+  struct Counters {
+    Histogram operations[NUM_OPERATIONS];  ///< latency of operations (nsec)
+    Histogram stages[NUM_SEARCH_STAGES];   ///< latency of stages (nsec)
+    Histogram lock_wait[NUM_LOCK_TYPES];   ///< lock wait time (nsec)
+    uint64_t plans[NUM_SEARCH_PLANS];      ///< searches by each plan
+
+    Counters() {
+      for (int i = 0; i < NUM_SEARCH_PLANS; i++) plans[i] = 0;
+    }
+  };
+
+  pthread_key_t key_;                ///< key of counters of a thread
+  mutable pthread_mutex_t mutex_;    ///< lock of the list of counters
+  std::vector<Counters *> threads_;  ///< counters of all threads
+
+  /**
+   * Get counters of the current thread.
+   * @return counters
+   */
+  Counters &local() {
+    Counters *counters = reinterpret_cast<Counters *>(
+      pthread_getspecific(key_));
+    if (!counters) counters = register_thread();
+    return *counters;
+  }
+
+  /**
+   * Allocate counters of the current thread.
+   * @return counters
+   */
+  Counters *register_thread();
+
+  /**
+   * Copy constructor (disabled).
+   */
+  Metrics(const Metrics &);
+
+  /**
+   * Assignment operator (disabled).
+   */
+  Metrics &operator=(const Metrics &);
+
+ public:
+  /**
+   * Constructor.
+   */
+  Metrics();
+
+  /**
+   * Destructor.
+   */
+  ~Metrics();
+
+  /**
+   * Get the name of an operation.
+   * @param operation operation
+   * @return name of operation
+   */
+  static const char *operation_name(Operation operation);
+
+  /**
+   * Record latency of an operation.
+   * @param operation operation
+   * @param nsec elapsed time (nsec)
+   */
+  void record(Operation operation, uint64_t nsec) {
+    local().operations[operation].add(nsec);
+  }
+
+  /**
+   * Record elapsed time of each stage and the plan of a search.
+   * @param trace trace of a search
+   */
+  void record(const SearchTrace &trace) {
+    Counters &counters = local();
+    for (int i = 0; i < NUM_SEARCH_STAGES; i++) {
+      counters.stages[i].add(trace.stage_time[i]);
+    }
+    for (int i = 0; i < NUM_SEARCH_PLANS; i++) {
+      counters.plans[i] += trace.plans[i];
+    }
+  }
+
+  /**
+   * Record wait time to acquire a lock.
+   * @param type type of lock
+   * @param nsec wait time (nsec)
+   */
+  void record_lock_wait(LockType type, uint64_t nsec) {
+    local().lock_wait[type].add(nsec);
+  }
+
+  /**
+   * Get aggregated latency of an operation.
+   * @param operation operation
+   * @param result output histogram (nsec)
+   */
+  void operation_latency(Operation operation, Histogram &result) const;
+
+  /**
+   * Write metrics as 'name \t value' lines.
+   * @param os output stream
+   */
+  void write(std::ostream &os) const;
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_METRICS_H_
@@ -0,0 +1,107 @@
+//
+// Tests for Metrics class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include "metrics.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_THREAD = 4;     ///< number of threads
+const size_t NUM_RECORD = 1000;  ///< number of records of each thread
+
+/* record values in a thread */
+static void *record_values(void *arg) {
+  stupa::Metrics *metrics = reinterpret_cast<stupa::Metrics *>(arg);
+  for (size_t i = 1; i <= NUM_RECORD; i++) {
+    metrics->record(stupa::Metrics::SEARCH_BY_DOCUMENT, i * 1000);
+    metrics->record_lock_wait(stupa::Metrics::READ_LOCK, i);
+  }
+  return NULL;
+}
+
+} /* namespace */
+
+/* record, operation_latency */
+TEST(MetricsTest, RecordTest) {
+  stupa::Metrics metrics;
+  pthread_t threads[NUM_THREAD];
+  for (size_t i = 0; i < NUM_THREAD; i++) {
+    pthread_create(&threads[i], NULL, record_values, &metrics);
+  }
+  for (size_t i = 0; i < NUM_THREAD; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  {
+    stupa::Metrics::ScopedTimer timer(metrics, stupa::Metrics::ADD);
+  }
+
+  stupa::Histogram hist;
+  metrics.operation_latency(stupa::Metrics::SEARCH_BY_DOCUMENT, hist);
+  EXPECT_EQ(NUM_THREAD * NUM_RECORD, hist.count());
+  EXPECT_EQ(1000, hist.min());
+  EXPECT_EQ(NUM_RECORD * 1000, hist.max());
+
+  hist.clear();
+  metrics.operation_latency(stupa::Metrics::ADD, hist);
+  EXPECT_EQ(1, hist.count());
+  hist.clear();
+  metrics.operation_latency(stupa::Metrics::DELETE, hist);
+  EXPECT_EQ(0, hist.count());
+}
+
+/* write */
+TEST(MetricsTest, WriteTest) {
+  stupa::Metrics metrics;
+  stupa::SearchTrace trace;
+  trace.stage_time[stupa::STAGE_SCORING] = 2000;
+  trace.plans[stupa::PLAN_SCAN] = 1;
+  metrics.record(trace);
+  metrics.record(stupa::Metrics::SEARCH_BY_FEATURE, 3000);
+
+  std::ostringstream oss;
+  metrics.write(oss);
+  std::string str = oss.str();
+  EXPECT_NE(std::string::npos,
+            str.find("operation.search_by_feature.count\t1\n"));
+  EXPECT_NE(std::string::npos,
+            str.find("operation.search_by_feature.p50_us\t3.000\n"));
+  EXPECT_NE(std::string::npos, str.find("stage.scoring.max_us\t2.000\n"));
+  EXPECT_NE(std::string::npos, str.find("operation.add.count\t0\n"));
+  EXPECT_NE(std::string::npos, str.find("lock_wait.write.count\t0\n"));
+  EXPECT_NE(std::string::npos, str.find("plan.scan.count\t1\n"));
+  EXPECT_NE(std::string::npos, str.find("plan.lookup.count\t0\n"));
+
+  stupa::IndexStatistics stats;
+  stats.documents = 3;
+  stats.posting_length.add(5);
+  oss.str("");
+  stats.write(oss);
+  str = oss.str();
+  EXPECT_NE(std::string::npos, str.find("index.documents\t3\n"));
+  EXPECT_NE(std::string::npos, str.find("index.posting_length.max\t5.000\n"));
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
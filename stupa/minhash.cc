@@ -0,0 +1,132 @@
+//
+// MinHash index class (locality sensitive hashing)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include <utility>
+#include "minhash.h"
+
+namespace stupa {
+
+const size_t MinHashIndex::DEFAULT_BANDS;
+const size_t MinHashIndex::DEFAULT_ROWS;
+const size_t MinHashIndex::MAX_LOOKUP;
+
+/**
+ * Get the keys of buckets of a document.
+ */
+void MinHashIndex::band_keys(const std::vector<FeatureId> &feature_ids,
+                             std::vector<uint64_t> &keys) const {
+  size_t nhash = bands_ * rows_;
+  std::vector<uint64_t> signature(nhash, ~static_cast<uint64_t>(0));
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    for (size_t j = 0; j < nhash; j++) {
+      // j-th hash function: features xor-ed with a seed of j
+      uint64_t value = mix_hash(feature_ids[i] ^ mix_hash(j + 1));
+      if (value < signature[j]) signature[j] = value;
+    }
+  }
+  for (size_t i = 0; i < bands_; i++) {
+    uint64_t key = mix_hash(i + 1);
+    for (size_t j = 0; j < rows_; j++) {
+      key = mix_hash(key ^ signature[i * rows_ + j]);
+    }
+    keys.push_back(key);
+  }
+}
+
+/**
+ * Add a document.
+ */
+void MinHashIndex::add_document(DocumentId id,
+                                const std::vector<FeatureId> &feature_ids) {
+  if (feature_ids.empty()) return;
+  std::vector<uint64_t> keys;
+  band_keys(feature_ids, keys);
+  for (size_t i = 0; i < keys.size(); i++) {
+    buckets_[keys[i]].push_back(id);
+  }
+  num_documents_++;
+}
+
+/**
+ * Delete a document.
+ */
+void MinHashIndex::delete_document(DocumentId id,
+                                   const std::vector<FeatureId> &feature_ids) {
+  if (feature_ids.empty()) return;
+  std::vector<uint64_t> keys;
+  band_keys(feature_ids, keys);
+  bool found = false;
+  for (size_t i = 0; i < keys.size(); i++) {
+    BucketHash::iterator it = buckets_.find(keys[i]);
+    if (it == buckets_.end()) continue;
+    Bucket::iterator bit = std::find(it->second.begin(), it->second.end(), id);
+    if (bit == it->second.end()) continue;
+    found = true;
+    it->second.erase(bit);
+    if (it->second.empty()) buckets_.erase(it);
+  }
+  if (found && num_documents_ > 0) num_documents_--;
+}
+
+/**
+ * Look up documents sharing buckets with queries.
+ */
+void MinHashIndex::lookup(const std::vector<std::vector<FeatureId> > &queries,
+                          std::vector<DocumentId> &documents,
+                          size_t max, SearchTrace *trace) const {
+  HashMap<DocumentId, size_t>::type count;
+  HashMap<DocumentId, size_t>::type::iterator cit;
+  std::vector<uint64_t> keys;
+  for (size_t i = 0; i < queries.size(); i++) {
+    if (queries[i].empty()) continue;
+    band_keys(queries[i], keys);
+  }
+  // a bucket shared by several queries is counted once
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  for (size_t i = 0; i < keys.size(); i++) {
+    BucketHash::const_iterator it = buckets_.find(keys[i]);
+    if (it == buckets_.end()) continue;
+    const Bucket &bucket = it->second;
+    if (trace) trace->postings += bucket.size();
+    for (size_t j = 0; j < bucket.size(); j++) {
+      cit = count.find(bucket[j]);
+      if (cit == count.end()) {
+        count[bucket[j]] = 1;
+      } else {
+        cit->second++;
+      }
+    }
+  }
+
+  if (trace) trace->candidates += count.size();
+  if (count.size() > max) {
+    std::vector<std::pair<DocumentId, size_t> > pairs(count.begin(),
+                                                      count.end());
+    std::sort(pairs.begin(), pairs.end(), greater_pair<DocumentId, size_t>);
+    for (size_t i = 0; i < max; i++) documents.push_back(pairs[i].first);
+  } else {
+    for (cit = count.begin(); cit != count.end(); ++cit) {
+      documents.push_back(cit->first);
+    }
+  }
+}
+
+} /* namespace stupa */
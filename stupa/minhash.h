@@ -0,0 +1,140 @@
+//
+// MinHash index class (locality sensitive hashing)
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_MINHASH_H_
+#define STUPA_MINHASH_H_
+
+#include <vector>
+#include "config.h"
+#include "identifier.h"
+#include "metrics.h"
+#include "util.h"
+
+namespace stupa {
+
+/**
+ * MinHash index class.
+ *
+ * A document is hashed to a signature of bands * rows minimum hash values
+ * of its features, and each band of rows values is hashed to a bucket.
+ * Two documents of Jaccard similarity s share at least one bucket with
+ * probability 1 - (1 - s^rows)^bands, so more bands give higher recall
+ * and more rows give fewer (and more similar) candidates.
+ */
+class MinHashIndex {
+ public:
+  /** Type definition of documents in a bucket */
+  typedef std::vector<DocumentId> Bucket;
+  /** Type definition of <band key, bucket> map */
+  typedef HashMap<uint64_t, Bucket>::type BucketHash;
+
+  /** Default number of bands */
+  static const size_t DEFAULT_BANDS = 16;
+  /** Default number of rows in a band */
+  static const size_t DEFAULT_ROWS  = 4;
+  /** Default value of maximum number of candidates */
+  static const size_t MAX_LOOKUP    = 1000;
+
+ private:
+  size_t bands_;         ///< the number of bands
+  size_t rows_;          ///< the number of rows in a band
+  BucketHash buckets_;   ///< buckets of documents
+  size_t num_documents_; ///< the number of documents
+
+  /**
+   * Get the keys of buckets of a document.
+   * @param feature_ids feature ids of a document
+   * @param keys output keys of each band
+   */
+  void band_keys(const std::vector<FeatureId> &feature_ids,
+                 std::vector<uint64_t> &keys) const;
+
+ public:
+  /**
+   * Constructor.
+   * @param bands the number of bands
+   * @param rows the number of rows in a band
+   */
+  explicit MinHashIndex(size_t bands = DEFAULT_BANDS,
+                        size_t rows = DEFAULT_ROWS)
+    : bands_(bands), rows_(rows), num_documents_(0) { }
+
+  /**
+   * Get the number of bands.
+   * @return the number of bands
+   */
+  size_t bands() const { return bands_; }
+
+  /**
+   * Get the number of rows in a band.
+   * @return the number of rows
+   */
+  size_t rows() const { return rows_; }
+
+  /**
+   * Get the number of documents.
+   * @return the number of documents
+   */
+  size_t size() const { return num_documents_; }
+
+  /**
+   * Get the number of buckets.
+   * @return the number of buckets
+   */
+  size_t buckets() const { return buckets_.size(); }
+
+  /**
+   * Add a document.
+   * @param id the identifier of a document
+   * @param feature_ids the feature ids of a document
+   */
+  void add_document(DocumentId id, const std::vector<FeatureId> &feature_ids);
+
+  /**
+   * Delete a document.
+   * @param id the identifier of a document
+   * @param feature_ids the feature ids of a document (same as added)
+   */
+  void delete_document(DocumentId id,
+                       const std::vector<FeatureId> &feature_ids);
+
+  /**
+   * Clear all buckets.
+   */
+  void clear() {
+    buckets_.clear();
+    num_documents_ = 0;
+  }
+
+  /**
+   * Look up documents sharing buckets with queries.
+   * Candidates are ordered by the number of shared buckets.
+   * @param queries feature ids of each query
+   * @param documents output list of document ids
+   * @param max maximum number of candidates
+   * @param trace output the numbers of postings and candidates (optional)
+   */
+  void lookup(const std::vector<std::vector<FeatureId> > &queries,
+              std::vector<DocumentId> &documents,
+              size_t max = MAX_LOOKUP, SearchTrace *trace = NULL) const;
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_MINHASH_H_
@@ -0,0 +1,132 @@
+//
+// Tests for MinHash index class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include "identifier.h"
+#include "minhash.h"
+
+namespace {
+
+/* constants */
+const size_t NUM_DOC     = 100;  ///< the number of documents
+const size_t NUM_FEATURE = 20;   ///< the number of features
+
+/* features of a document: (NUM_FEATURE - shift) features are shared
+   with the document of the next id */
+void set_features(stupa::DocumentId id, size_t shift,
+                  std::vector<stupa::FeatureId> &features) {
+  for (size_t i = 0; i < NUM_FEATURE; i++) {
+    features.push_back(id * shift + i + stupa::FEATURE_START_ID);
+  }
+}
+
+} /* namespace */
+
+/* add_document, lookup */
+TEST(MinHashIndexTest, LookupTest) {
+  stupa::MinHashIndex index(16, 2);
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    std::vector<stupa::FeatureId> features;
+    // no features are shared between documents
+    set_features(i, NUM_FEATURE, features);
+    index.add_document(i + stupa::DOC_START_ID, features);
+  }
+  EXPECT_EQ(NUM_DOC, index.size());
+
+  // a query of the same features shares all buckets
+  std::vector<std::vector<stupa::FeatureId> > queries(1);
+  set_features(10, NUM_FEATURE, queries[0]);
+  std::vector<stupa::DocumentId> results;
+  stupa::SearchTrace trace;
+  index.lookup(queries, results, stupa::MinHashIndex::MAX_LOOKUP, &trace);
+  ASSERT_LT(0, results.size());
+  EXPECT_TRUE(std::find(results.begin(), results.end(),
+                        10 + stupa::DOC_START_ID) != results.end());
+  EXPECT_EQ(results.size(), trace.candidates);
+  // no other document shares features
+  EXPECT_EQ(1, results.size());
+
+  // the most similar document comes first within the maximum
+  results.clear();
+  index.lookup(queries, results, 1);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(10 + stupa::DOC_START_ID, results[0]);
+
+  // no candidates of unknown features
+  queries[0].clear();
+  queries[0].push_back(NUM_DOC * NUM_FEATURE * 2);
+  results.clear();
+  index.lookup(queries, results);
+  EXPECT_EQ(0, results.size());
+}
+
+/* similar documents are found with high probability */
+TEST(MinHashIndexTest, SimilarDocumentsTest) {
+  stupa::MinHashIndex index;
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    std::vector<stupa::FeatureId> features;
+    // Jaccard similarity of neighbors: 18 / 22
+    set_features(i, 2, features);
+    index.add_document(i + stupa::DOC_START_ID, features);
+  }
+  size_t found = 0;
+  for (size_t i = 1; i < NUM_DOC - 1; i++) {
+    std::vector<std::vector<stupa::FeatureId> > queries(1);
+    set_features(i, 2, queries[0]);
+    std::vector<stupa::DocumentId> results;
+    index.lookup(queries, results);
+    if (std::find(results.begin(), results.end(), i + stupa::DOC_START_ID + 1)
+        != results.end()) {
+      found++;
+    }
+  }
+  // probability of a collision is 1 - (1 - 0.82^4)^16 > 0.99
+  EXPECT_LT(NUM_DOC * 9 / 10, found);
+}
+
+/* delete_document */
+TEST(MinHashIndexTest, DeleteDocumentTest) {
+  stupa::MinHashIndex index;
+  std::vector<stupa::FeatureId> features;
+  set_features(0, NUM_FEATURE, features);
+  index.add_document(stupa::DOC_START_ID, features);
+  index.add_document(stupa::DOC_START_ID + 1, features);
+  EXPECT_EQ(2, index.size());
+  EXPECT_EQ(stupa::MinHashIndex::DEFAULT_BANDS, index.buckets());
+
+  index.delete_document(stupa::DOC_START_ID, features);
+  EXPECT_EQ(1, index.size());
+  std::vector<std::vector<stupa::FeatureId> > queries(1, features);
+  std::vector<stupa::DocumentId> results;
+  index.lookup(queries, results);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(stupa::DOC_START_ID + 1, results[0]);
+
+  // empty buckets are removed
+  index.delete_document(stupa::DOC_START_ID + 1, features);
+  EXPECT_EQ(0, index.size());
+  EXPECT_EQ(0, index.buckets());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,9 +18,11 @@
 //
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <vector>
 #include "search_model.h"
@@ -85,10 +87,13 @@ class SearchModelTest {
       TestSet::const_iterator tit = documents.find(dit->first);
       EXPECT_TRUE(tit != documents.end());
       std::vector<stupa::FeatureId> feature_ids;
-      stupa::decompress_diff(dit->second, feature_ids);
-      EXPECT_EQ(tit->second.size(), feature_ids.size());
-      for (size_t i = 0; i < tit->second.size(); i++) {
-        EXPECT_EQ(tit->second[i], feature_ids[i]);
+      model.feature(dit->first, feature_ids);
+      // features of weighted documents are sorted
+      std::vector<stupa::FeatureId> expected(tit->second);
+      if (model.weighted()) std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(expected.size(), feature_ids.size());
+      for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i], feature_ids[i]);
       }
     }
     // check feature count
@@ -272,6 +277,54 @@ class SearchModelTest {
     }
   }
 
+  /* score candidates of the nearest signatures */
+  void prefilter_test() {
+    set_input_documents();
+    Model model;
+    add_documents(model, documents);
+
+    std::vector<stupa::DocumentId> queries(1, stupa::DOC_START_ID);
+    std::vector<stupa::DocumentId> candidate_ids;
+    for (TestSet::const_iterator it = documents.begin();
+         it != documents.end(); ++it) {
+      candidate_ids.push_back(it->first);
+    }
+    std::vector<std::pair<stupa::DocumentId, stupa::Point> > all, filtered;
+    model.search_by_document(queries, candidate_ids, all, model.size());
+
+    model.set_prefilter(128, NUM_CANDIDATE);
+    EXPECT_EQ(NUM_CANDIDATE, model.num_scored(candidate_ids.size()));
+    model.search_by_document(queries, candidate_ids, filtered, model.size());
+    EXPECT_GE(NUM_CANDIDATE, filtered.size());
+    // the query document has the same signature
+    ASSERT_LT(0, filtered.size());
+    EXPECT_TRUE(filtered[0] == all[0]);
+
+    // searches from all documents are not filtered
+    filtered.clear();
+    model.search_by_document(queries, filtered, model.size());
+    EXPECT_TRUE(filtered == all);
+
+    // signatures are kept by updates and loading
+    model.add_document(stupa::DOC_START_ID + NUM_DOC, documents[queries[0]]);
+    const char filename[] = "modeltest_prefilter.tmp";
+    std::ofstream ofs(filename);
+    model.save(ofs);
+    ofs.close();
+    std::ifstream ifs(filename);
+    model.load(ifs);
+    ifs.close();
+    remove(filename);
+    candidate_ids.push_back(stupa::DOC_START_ID + NUM_DOC);
+    filtered.clear();
+    model.search_by_document(queries, candidate_ids, filtered, 2);
+    ASSERT_EQ(2, filtered.size());
+    EXPECT_EQ(filtered[0].second, filtered[1].second);
+
+    model.set_prefilter(0, 0);
+    EXPECT_EQ(candidate_ids.size(), model.num_scored(candidate_ids.size()));
+  }
+
   /* save/load */
   void save_load_test() {
     set_input_documents();
@@ -302,8 +355,55 @@ class SearchModelTest {
     search_all_test();
     search_candidates_test();
     search_limited_results_test();
+    prefilter_test();
     save_load_test();
   }
+
+  /* scores and ranking agree with SearchModelCosine */
+  void ranking_agreement_test(stupa::Point tolerance) {
+    set_input_documents();
+    stupa::SearchModelCosine reference;
+    Model model;
+    add_documents(reference, documents);
+    add_documents(model, documents);
+
+    for (size_t i = 0; i < NUM_DOC; i += NUM_DOC / 10) {
+      std::vector<stupa::DocumentId> queries(1, stupa::DOC_START_ID + i);
+      std::vector<std::pair<stupa::DocumentId, stupa::Point> > expected;
+      std::vector<std::pair<stupa::DocumentId, stupa::Point> > results;
+      reference.search_by_document(queries, expected, reference.size());
+      model.search_by_document(queries, results, model.size());
+      ASSERT_EQ(expected.size(), results.size());
+      std::map<stupa::DocumentId, stupa::Point> scores;
+      for (size_t j = 0; j < expected.size(); j++) {
+        scores[expected[j].first] = expected[j].second;
+      }
+      for (size_t j = 0; j < results.size(); j++) {
+        ASSERT_TRUE(scores.find(results[j].first) != scores.end());
+        EXPECT_NEAR(scores[results[j].first], results[j].second, tolerance);
+        // documents are ranked in the same order except near ties
+        if (j > 0) {
+          EXPECT_LE(scores[results[j].first],
+                    scores[results[j-1].first] + tolerance * 2);
+        }
+      }
+    }
+
+    // weights follow updates
+    model.delete_document(stupa::DOC_START_ID);
+    reference.delete_document(stupa::DOC_START_ID);
+    model.add_document(stupa::DOC_START_ID + NUM_DOC,
+                       documents[stupa::DOC_START_ID + 1]);
+    reference.add_document(stupa::DOC_START_ID + NUM_DOC,
+                           documents[stupa::DOC_START_ID + 1]);
+    std::vector<stupa::DocumentId> queries(1, stupa::DOC_START_ID + 1);
+    std::vector<std::pair<stupa::DocumentId, stupa::Point> > expected, results;
+    reference.search_by_document(queries, expected, 2);
+    model.search_by_document(queries, results, 2);
+    ASSERT_EQ(2, results.size());
+    EXPECT_NEAR(expected[0].second, results[0].second, tolerance);
+    EXPECT_NEAR(expected[1].second, results[1].second, tolerance);
+  }
 };
 
 } /* namespace */
@@ -316,6 +416,222 @@ TEST(SearchModelTest, SearchModelCosineTest) {
   SearchModelTest<stupa::SearchModelCosine> test;
     test.do_all_test();
 }
+TEST(SearchModelTest, SearchModelCosineFloatTest) {
+  SearchModelTest<stupa::SearchModelCosineFloat> test;
+  test.do_all_test();
+  test.ranking_agreement_test(1e-5);
+}
+TEST(SearchModelTest, SearchModelCosineQuantizedTest) {
+  SearchModelTest<stupa::SearchModelCosineQuantized> test;
+  test.do_all_test();
+  test.ranking_agreement_test(1e-3);
+}
+TEST(SearchModelTest, SearchModelCosineQuantized8Test) {
+  SearchModelTest<stupa::SearchModelCosineQuantized8> test;
+  test.do_all_test();
+  test.ranking_agreement_test(5e-2);
+}
+
+TEST(SearchModelTest, SearchModelTfIdfTest) {
+  SearchModelTest<stupa::SearchModelTfIdf> test;
+  test.do_all_test();
+}
+TEST(SearchModelTest, SearchModelBM25Test) {
+  SearchModelTest<stupa::SearchModelBM25> test;
+  test.do_all_test();
+}
+
+/* weights of features are kept by updates and loading */
+TEST(SearchModelTest, WeightedFeatureTest) {
+  stupa::SearchModelTfIdf model;
+  std::vector<stupa::FeatureId> features;
+  features.push_back(stupa::FEATURE_START_ID + 1);
+  features.push_back(stupa::FEATURE_START_ID);
+  features.push_back(stupa::FEATURE_START_ID + 1);
+  std::vector<stupa::Point> weights;
+  weights.push_back(1.5);
+  weights.push_back(1.0);
+  weights.push_back(2.0);
+  model.add_document(stupa::DOC_START_ID, features, weights);
+  // repeated features are merged
+  model.add_document(stupa::DOC_START_ID + 1, features);
+  EXPECT_DOUBLE_EQ((4.5 + 3.0) / 2, model.average_length());
+
+  const char filename[] = "modeltest_weighted.tmp";
+  std::ofstream ofs(filename);
+  model.save(ofs);
+  ofs.close();
+  std::ifstream ifs(filename);
+  model.load(ifs);
+  ifs.close();
+  remove(filename);
+
+  std::vector<stupa::FeatureId> feature_ids;
+  std::vector<stupa::Point> feature_weights;
+  model.feature(stupa::DOC_START_ID, feature_ids, feature_weights);
+  ASSERT_EQ(2, feature_ids.size());
+  EXPECT_EQ(stupa::FEATURE_START_ID, feature_ids[0]);
+  EXPECT_EQ(stupa::FEATURE_START_ID + 1, feature_ids[1]);
+  EXPECT_DOUBLE_EQ(1.0, feature_weights[0]);
+  EXPECT_DOUBLE_EQ(3.5, feature_weights[1]);
+  EXPECT_EQ(2, model.feature_count().find(stupa::FEATURE_START_ID)->second);
+  EXPECT_DOUBLE_EQ((4.5 + 3.0) / 2, model.average_length());
+
+  model.delete_document(stupa::DOC_START_ID);
+  EXPECT_DOUBLE_EQ(3.0, model.average_length());
+}
+
+/* BM25 ranks frequent and short documents higher */
+TEST(SearchModelTest, BM25RankingTest) {
+  stupa::SearchModelBM25 model;
+  std::vector<stupa::FeatureId> query(1, stupa::FEATURE_START_ID);
+  std::vector<stupa::DocumentId> candidates;
+  for (size_t i = 0; i < 4; i++) {
+    std::vector<stupa::FeatureId> features(1, stupa::FEATURE_START_ID);
+    std::vector<stupa::Point> weights(1, i == 1 ? 3.0 : 1.0);
+    // the last document is long
+    for (size_t j = 0; j < (i == 3 ? 10 : 2); j++) {
+      features.push_back(stupa::FEATURE_START_ID + 10 * (i + 1) + j);
+      weights.push_back(1.0);
+    }
+    model.add_document(stupa::DOC_START_ID + i, features, weights);
+    candidates.push_back(stupa::DOC_START_ID + i);
+  }
+  // a document without the query feature
+  model.add_document(stupa::DOC_START_ID + 4,
+                     std::vector<stupa::FeatureId>(1, stupa::FEATURE_START_ID + 1));
+  candidates.push_back(stupa::DOC_START_ID + 4);
+
+  std::vector<std::pair<stupa::DocumentId, stupa::Point> > results;
+  model.search_by_feature(query, candidates, results, candidates.size());
+  ASSERT_EQ(4, results.size());
+  EXPECT_EQ(stupa::DOC_START_ID + 1, results[0].first);
+  EXPECT_DOUBLE_EQ(results[1].second, results[2].second);
+  EXPECT_EQ(stupa::DOC_START_ID + 3, results[3].first);
+
+  // weights of queries
+  std::vector<stupa::Point> weights(1, 2.0);
+  std::vector<std::pair<stupa::DocumentId, stupa::Point> > weighted;
+  model.search_by_feature(query, weights, candidates, weighted, 1);
+  ASSERT_EQ(1, weighted.size());
+  EXPECT_DOUBLE_EQ(results[0].second * 2, weighted[0].second);
+
+  // no normalization by length
+  model.set_parameters(stupa::SearchModelBM25::DEFAULT_K1, 0.0);
+  results.clear();
+  model.search_by_feature(query, candidates, results, candidates.size());
+  ASSERT_EQ(4, results.size());
+  EXPECT_DOUBLE_EQ(results[1].second, results[3].second);
+}
+
+/* features in Elias-Fano code give the same scores as Variable Byte code */
+TEST(SearchModelTest, EliasFanoTest) {
+  stupa::SearchModelInnerProduct model, ef_model;
+  ef_model.set_elias_fano(true);
+  std::vector<stupa::DocumentId> candidates;
+  for (size_t i = 0; i < NUM_DOC; i++) {
+    std::vector<stupa::FeatureId> features;
+    // long documents over samples of Elias-Fano code, with duplicates
+    for (size_t j = 0; j < NUM_FEATURE * (i % 10 + 1); j++) {
+      features.push_back(stupa::FEATURE_START_ID
+                         + rand() % (MAX_FEATURE_ID * 10));
+    }
+    model.add_document(stupa::DOC_START_ID + i, features);
+    ef_model.add_document(stupa::DOC_START_ID + i, features);
+    candidates.push_back(stupa::DOC_START_ID + i);
+  }
+  // features are sorted
+  std::vector<stupa::FeatureId> feature_ids;
+  ef_model.feature(stupa::DOC_START_ID + 9, feature_ids);
+  EXPECT_EQ(NUM_FEATURE * 10, feature_ids.size());
+  EXPECT_TRUE(std::adjacent_find(feature_ids.begin(), feature_ids.end(),
+                                 std::greater<stupa::FeatureId>())
+              == feature_ids.end());
+
+  std::vector<stupa::FeatureId> query;
+  for (size_t i = 0; i < NUM_FEATURE; i++) {
+    query.push_back(stupa::FEATURE_START_ID + rand() % (MAX_FEATURE_ID * 10));
+  }
+  std::vector<std::pair<stupa::DocumentId, stupa::Point> > expected, results;
+  model.search_by_feature(query, candidates, expected, NUM_DOC);
+  ef_model.search_by_feature(query, candidates, results, NUM_DOC);
+  ASSERT_EQ(expected.size(), results.size());
+  std::map<stupa::DocumentId, stupa::Point> scores(expected.begin(),
+                                                   expected.end());
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_NEAR(scores[results[i].first], results[i].second, 1e-9);
+  }
+
+  // saved in Variable Byte code
+  const char filename[] = "modeltest_elias_fano.tmp";
+  std::ofstream ofs(filename);
+  ef_model.save(ofs);
+  ofs.close();
+  std::ifstream ifs(filename);
+  model.load(ifs);
+  ifs.close();
+  ifs.open(filename);
+  ef_model.load(ifs);
+  ifs.close();
+  remove(filename);
+  std::vector<stupa::FeatureId> loaded;
+  model.feature(stupa::DOC_START_ID + 9, loaded);
+  EXPECT_TRUE(loaded == feature_ids);
+  loaded.clear();
+  ef_model.feature(stupa::DOC_START_ID + 9, loaded);
+  EXPECT_TRUE(loaded == feature_ids);
+
+  // stored documents are converted
+  ef_model.set_elias_fano(false);
+  EXPECT_FALSE(ef_model.elias_fano());
+  loaded.clear();
+  ef_model.feature(stupa::DOC_START_ID + 9, loaded);
+  EXPECT_TRUE(loaded == feature_ids);
+  stupa::SearchModelTfIdf weighted;
+  weighted.set_elias_fano(true);
+  EXPECT_FALSE(weighted.elias_fano());
+}
+
+/* searches from all documents by threads */
+TEST(SearchModelTest, ScanTest) {
+  stupa::SearchModelCosine model;
+  std::vector<stupa::DocumentId> candidates;
+  size_t num = stupa::SearchModel::SCAN_BLOCK * 4 + 7;
+  for (size_t i = 0; i < num; i++) {
+    std::vector<stupa::FeatureId> features;
+    for (size_t j = 0; j < 5; j++) {
+      features.push_back(stupa::FEATURE_START_ID + rand() % MAX_FEATURE_ID);
+    }
+    model.add_document(stupa::DOC_START_ID + i, features);
+    candidates.push_back(stupa::DOC_START_ID + i);
+  }
+  // gaps of deleted documents
+  for (size_t i = 0; i < num; i += 3) {
+    model.delete_document(stupa::DOC_START_ID + i);
+  }
+
+  std::vector<stupa::DocumentId> queries(1, stupa::DOC_START_ID + 1);
+  std::vector<std::pair<stupa::DocumentId, stupa::Point> > expected, results;
+  model.search_by_document(queries, candidates, expected, NUM_DOC);
+  EXPECT_EQ(1, model.scan_threads());
+  model.search_by_document(queries, results, NUM_DOC);
+  EXPECT_TRUE(expected == results);
+
+  model.set_scan_threads(4);
+  EXPECT_EQ(4, model.scan_threads());
+  results.clear();
+  model.search_by_document(queries, results, NUM_DOC);
+  EXPECT_TRUE(expected == results);
+
+  // more threads than blocks of documents
+  model.set_scan_threads(100);
+  std::vector<stupa::FeatureId> query(1, stupa::FEATURE_START_ID);
+  expected.clear();
+  results.clear();
+  model.search_by_feature(query, candidates, expected, NUM_DOC);
+  model.search_by_feature(query, results, NUM_DOC);
+  EXPECT_TRUE(expected == results);
+}
 
 int main(int argc, char **argv) {
   srand((unsigned int)time(NULL));
@@ -29,12 +29,12 @@ namespace {
 const char *SAVE_FILE = "postest_saved.tmp";
 
 /* function prototypes */
-static void random_integers(size_t size, std::vector<uint64_t> &v);
+static void random_integers(size_t size, std::vector<stupa::DocumentId> &v);
 template <typename PostingList>
 static void do_tests(PostingList &plist);
 
 /* set random integers */
-static void random_integers(size_t size, std::vector<uint64_t> &v) {
+static void random_integers(size_t size, std::vector<stupa::DocumentId> &v) {
   std::map<uint64_t, bool> check;
   size_t cnt = 0;
   while (cnt < size) {
@@ -53,7 +53,7 @@ static void random_integers(size_t size, std::vector<uint64_t> &v) {
 template <typename PostingList>
 static void do_tests(PostingList &plist) {
   const size_t size = 1000;
-  std::vector<uint64_t> input, v;
+  std::vector<stupa::DocumentId> input, v;
   random_integers(size, input);
 
   // add
@@ -62,10 +62,13 @@ static void do_tests(PostingList &plist) {
   }
   plist.list(v);
   EXPECT_TRUE(v == input);
+  EXPECT_EQ(input.size(), plist.size());
+  EXPECT_LT(0, plist.bytes());
 
   // clear
   plist.clear();
   EXPECT_TRUE(plist.empty());
+  EXPECT_EQ(0, plist.size());
   v.clear();
   plist.list(v);
   EXPECT_TRUE(v.empty());
@@ -83,7 +86,7 @@ static void do_tests(PostingList &plist) {
 
   // remove
   size_t cnt = 0;
-  std::vector<uint64_t> remain;
+  std::vector<stupa::DocumentId> remain;
   for (size_t i = 0; i < v.size(); i++) {
     if (i % 2 == 0) {
       plist.remove(v[i]);
@@ -96,6 +99,28 @@ static void do_tests(PostingList &plist) {
   plist.list(v);
   EXPECT_TRUE(remain.size() == v.size());
 
+  // remove many at once
+  std::vector<stupa::DocumentId> removed, kept;
+  for (size_t i = 0; i < remain.size(); i++) {
+    if (i % 3 == 0) {
+      removed.push_back(remain[i]);
+    } else {
+      kept.push_back(remain[i]);
+    }
+  }
+  plist.remove(removed);
+  v.clear();
+  plist.list(v);
+  EXPECT_TRUE(v == kept);
+  plist.remove(kept);
+  EXPECT_TRUE(plist.empty());
+
+  // assign
+  plist.assign(kept);
+  v.clear();
+  plist.list(v);
+  EXPECT_TRUE(v == kept);
+
   // save, load
   plist.clear();
   for (size_t i = 0; i < input.size(); i++) {
@@ -129,6 +154,188 @@ TEST(PostingListTest, VarBytePostingListTest) {
   do_tests(plist);
 }
 
+/* test for ImpactPostingList class */
+TEST(PostingListTest, ImpactPostingListTest) {
+  const size_t size = 1000;
+  std::vector<stupa::DocumentId> input, v;
+  random_integers(size, input);
+
+  // documents of higher impact come first, sorted in each impact
+  stupa::ImpactPostingList plist;
+  std::vector<stupa::DocumentId> high, low;
+  for (size_t i = 0; i < input.size(); i++) {
+    if (i % 4 == 0) {
+      plist.add(input[i], 200);
+      high.push_back(input[i]);
+    } else {
+      plist.add(input[i], 10);
+      low.push_back(input[i]);
+    }
+  }
+  EXPECT_EQ(input.size(), plist.size());
+  EXPECT_LT(0, plist.bytes());
+  std::vector<stupa::DocumentId> expected(high);
+  expected.insert(expected.end(), low.begin(), low.end());
+  plist.list(v);
+  EXPECT_TRUE(v == expected);
+
+  // read only the segment of high impact, and the rest
+  v.clear();
+  EXPECT_EQ(2, plist.segments());
+  EXPECT_EQ(1, plist.list(v, high.size(), 0));
+  EXPECT_TRUE(v == high);
+  v.clear();
+  EXPECT_EQ(2, plist.list(v, 0, 1));
+  EXPECT_TRUE(v == low);
+
+  // the oldest documents of the lowest impact are deleted
+  stupa::ImpactPostingList copied(plist);
+  std::vector<stupa::DocumentId> removed;
+  copied.add(input[0] + 1, 255, size - 1, removed);
+  ASSERT_EQ(2, removed.size());
+  EXPECT_EQ(low[0], removed[0]);
+  EXPECT_EQ(low[1], removed[1]);
+  v.clear();
+  copied.list(v, 1);
+  EXPECT_EQ(1, v.size());
+  EXPECT_EQ(input[0] + 1, v[0]);
+  v.clear();
+  copied.list(v);
+  EXPECT_EQ(size - 1, v.size());
+  EXPECT_TRUE(std::find(v.begin(), v.end(), low[0]) == v.end());
+  EXPECT_TRUE(std::find(v.begin(), v.end(), low[1]) == v.end());
+  EXPECT_TRUE(std::find(v.begin(), v.end(), high[0]) != v.end());
+
+  // the oldest document of all segments
+  stupa::ImpactPostingList oldest(plist);
+  EXPECT_EQ(input[0], oldest.remove_oldest());
+  v.clear();
+  oldest.list(v);
+  EXPECT_EQ(size - 1, v.size());
+  EXPECT_TRUE(std::find(v.begin(), v.end(), input[0]) == v.end());
+
+  // documents are found in skip tables
+  for (size_t i = 0; i < input.size(); i++) {
+    EXPECT_TRUE(plist.contains(input[i]));
+  }
+  EXPECT_FALSE(plist.contains(input.back() + 1));
+
+  // remove
+  plist.remove(high);
+  v.clear();
+  plist.list(v);
+  EXPECT_TRUE(v == low);
+  EXPECT_FALSE(plist.contains(high[0]));
+  plist.remove(high[0]);
+  EXPECT_EQ(low.size(), plist.size());
+  plist.remove(low[0]);
+  EXPECT_EQ(low.size() - 1, plist.size());
+
+  // save, load
+  std::ofstream ofs(SAVE_FILE);
+  copied.save(ofs);
+  ofs.close();
+  std::ifstream ifs(SAVE_FILE);
+  plist.load(ifs);
+  ifs.close();
+  std::vector<stupa::DocumentId> loaded;
+  plist.list(loaded);
+  v.clear();
+  copied.list(v);
+  EXPECT_TRUE(loaded == v);
+
+  // load segments saved before skip tables
+  char *diff = stupa::compress_diff(input);
+  size_t num = 1;
+  size_t bytes = stupa::sizeof_compressed(diff);
+  unsigned char impact = 1;
+  ofs.open(SAVE_FILE);
+  ofs.write((const char *)&num, sizeof(num));
+  ofs.write((const char *)&impact, sizeof(impact));
+  ofs.write((const char *)&bytes, sizeof(bytes));
+  ofs.write(diff, bytes);
+  ofs.close();
+  delete [] diff;
+  ifs.open(SAVE_FILE);
+  plist.load(ifs, false);
+  ifs.close();
+  v.clear();
+  plist.list(v);
+  EXPECT_TRUE(v == input);
+  EXPECT_TRUE(plist.contains(input[size / 2]));
+
+  // load VarBytePostingList
+  stupa::VarBytePostingList vbplist;
+  for (size_t i = 0; i < input.size(); i++) vbplist.add(input[i]);
+  ofs.open(SAVE_FILE);
+  vbplist.save(ofs);
+  ofs.close();
+  ifs.open(SAVE_FILE);
+  plist.load_var_byte(ifs);
+  ifs.close();
+  v.clear();
+  plist.list(v);
+  EXPECT_TRUE(v == input);
+  remove(SAVE_FILE);
+
+  plist.clear();
+  EXPECT_TRUE(plist.empty());
+  EXPECT_EQ(0, plist.size());
+}
+
+/* test for ImpactPostingList class with dense documents */
+TEST(PostingListTest, DenseImpactPostingListTest) {
+  // every other document over containers of a bitmap
+  std::vector<stupa::DocumentId> input, v;
+  for (stupa::DocumentId id = 65000; id < 90000; id += 2) input.push_back(id);
+  stupa::VarBytePostingList vbplist;
+  vbplist.assign(input);
+  std::ofstream ofs(SAVE_FILE);
+  vbplist.save(ofs);
+  ofs.close();
+  std::ifstream ifs(SAVE_FILE);
+  stupa::ImpactPostingList plist;
+  plist.load_var_byte(ifs);
+  ifs.close();
+  EXPECT_EQ(input.size(), plist.size());
+  EXPECT_GT(vbplist.bytes(), plist.bytes());
+  plist.list(v);
+  EXPECT_TRUE(v == input);
+
+  // add, remove
+  plist.add(65001);
+  plist.remove(65002);
+  plist.remove_oldest();
+  v.clear();
+  plist.list(v);
+  EXPECT_EQ(input.size() - 1, v.size());
+  EXPECT_EQ(65001, v[0]);
+  EXPECT_EQ(65004, v[1]);
+  EXPECT_TRUE(plist.contains(65004));
+  EXPECT_FALSE(plist.contains(65002));
+  EXPECT_FALSE(plist.contains(65003));
+
+  // saved in Variable Byte code
+  ofs.open(SAVE_FILE);
+  plist.save(ofs);
+  ofs.close();
+  ifs.open(SAVE_FILE);
+  stupa::ImpactPostingList loaded;
+  loaded.load(ifs);
+  ifs.close();
+  remove(SAVE_FILE);
+  std::vector<stupa::DocumentId> lv;
+  loaded.list(lv);
+  EXPECT_TRUE(lv == v);
+  EXPECT_EQ(plist.bytes(), loaded.bytes());
+
+  // copy
+  stupa::ImpactPostingList copied(plist);
+  lv.clear();
+  copied.list(lv);
+  EXPECT_TRUE(lv == v);
+}
+
 int main(int argc, char **argv) {
   srand((unsigned int)time(NULL));
   testing::InitGoogleTest(&argc, argv);
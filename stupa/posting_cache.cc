@@ -0,0 +1,209 @@
+//
+// Cache of decoded posting lists
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include "posting_cache.h"
+
+namespace stupa {
+
+const size_t PostingCache::MIN_POSTINGS;
+
+/**
+ * Constructor.
+ */
+PostingCache::PostingCache(size_t max_bytes)
+  : max_bytes_(max_bytes), bytes_(0), hits_(0), misses_(0), evictions_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+/**
+ * Destructor.
+ */
+PostingCache::~PostingCache() {
+  clear();
+  pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Read documents of a decoded posting list.
+ */
+size_t PostingCache::read(const Entry &entry, std::vector<DocumentId> &v,
+                          size_t max, size_t from) {
+  size_t num = entry.offsets.size();
+  if (from >= num) return from;
+  size_t i = from;
+  size_t count = 0;
+  while (i < num && (max == 0 || count < max)) {
+    size_t end = i + 1 < num ? entry.offsets[i + 1] : entry.ids.size();
+    count += end - entry.offsets[i];
+    i++;
+  }
+  size_t begin = entry.offsets[from];
+  v.insert(v.end(), entry.ids.begin() + begin,
+           entry.ids.begin() + begin + count);
+  return i;
+}
+
+/**
+ * Delete an entry.
+ */
+void PostingCache::erase(EntryHash::iterator it) {
+  Entry *entry = it->second;
+  bytes_ -= sizeof_entry(*entry);
+  lru_.erase(entry->lru);
+  delete entry;
+  entries_.erase(it);
+}
+
+/**
+ * Evict least recently used entries.
+ */
+void PostingCache::evict() {
+  while (bytes_ > max_bytes_ && !lru_.empty()) {
+    erase(entries_.find(lru_.back()));
+    evictions_++;
+  }
+}
+
+/**
+ * Set the memory budget.
+ */
+void PostingCache::set_max_bytes(size_t max_bytes) {
+  pthread_mutex_lock(&mutex_);
+  max_bytes_ = max_bytes;
+  evict();
+  pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Get the identifiers of documents of a posting list through the cache.
+ */
+size_t PostingCache::list(FeatureId feature_id,
+                          const ImpactPostingList &plist,
+                          std::vector<DocumentId> &v,
+                          size_t max, size_t from) {
+  if (max_bytes_ == 0 || plist.size() < MIN_POSTINGS) {
+    return plist.list(v, max, from);
+  }
+
+  pthread_mutex_lock(&mutex_);
+  EntryHash::iterator it = entries_.find(feature_id);
+  if (it != entries_.end() && it->second->version == plist.version()) {
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second->lru);
+    size_t next = read(*it->second, v, max, from);
+    pthread_mutex_unlock(&mutex_);
+    return next;
+  }
+  misses_++;
+  pthread_mutex_unlock(&mutex_);
+
+  // decode all segments without the lock
+  Entry *entry = new Entry;
+  entry->version = plist.version();
+  entry->ids.reserve(plist.size());
+  entry->offsets.reserve(plist.segments());
+  for (size_t i = 0; i < plist.segments(); i++) {
+    entry->offsets.push_back(entry->ids.size());
+    plist.list(entry->ids, 1, i);
+  }
+  size_t next = read(*entry, v, max, from);
+
+  pthread_mutex_lock(&mutex_);
+  if (sizeof_entry(*entry) > max_bytes_) {
+    delete entry;
+  } else {
+    // an old version, or the same one decoded by another thread
+    it = entries_.find(feature_id);
+    if (it != entries_.end()) erase(it);
+    lru_.push_front(feature_id);
+    entry->lru = lru_.begin();
+    entries_.insert(std::pair<FeatureId, Entry *>(feature_id, entry));
+    bytes_ += sizeof_entry(*entry);
+    evict();
+  }
+  pthread_mutex_unlock(&mutex_);
+  return next;
+}
+
+/**
+ * Delete all entries.
+ */
+void PostingCache::clear() {
+  pthread_mutex_lock(&mutex_);
+  for (EntryHash::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    delete it->second;
+  }
+  entries_.clear();
+  lru_.clear();
+  bytes_ = 0;
+  pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Get the number of cached posting lists.
+ */
+size_t PostingCache::size() const {
+  pthread_mutex_lock(&mutex_);
+  size_t size = entries_.size();
+  pthread_mutex_unlock(&mutex_);
+  return size;
+}
+
+/**
+ * Get bytes of cached posting lists.
+ */
+size_t PostingCache::bytes() const {
+  pthread_mutex_lock(&mutex_);
+  size_t bytes = bytes_;
+  pthread_mutex_unlock(&mutex_);
+  return bytes;
+}
+
+/**
+ * Get the number of hits.
+ */
+uint64_t PostingCache::hits() const {
+  pthread_mutex_lock(&mutex_);
+  uint64_t hits = hits_;
+  pthread_mutex_unlock(&mutex_);
+  return hits;
+}
+
+/**
+ * Get the number of misses.
+ */
+uint64_t PostingCache::misses() const {
+  pthread_mutex_lock(&mutex_);
+  uint64_t misses = misses_;
+  pthread_mutex_unlock(&mutex_);
+  return misses;
+}
+
+/**
+ * Get the number of evicted entries.
+ */
+uint64_t PostingCache::evictions() const {
+  pthread_mutex_lock(&mutex_);
+  uint64_t evictions = evictions_;
+  pthread_mutex_unlock(&mutex_);
+  return evictions;
+}
+
+} /* namespace stupa */
@@ -0,0 +1,188 @@
+//
+// Cache of decoded posting lists
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_POSTING_CACHE_H_
+#define STUPA_POSTING_CACHE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include "identifier.h"
+#include "posting_list.h"
+#include "util.h"
+
+namespace stupa {
+
+/**
+ * Cache of decoded posting lists.
+ *
+ * The documents of all segments of a long posting list are kept decoded
+ * with the version of the list, and an entry whose version differs from
+ * the list (the list was updated after decoding) is decoded again.
+ * Least recently used entries are evicted when the entries exceed
+ * the memory budget.  Lists are read by many threads at once (e.g. under
+ * a shared lock of a server), so that entries are guarded by a mutex.
+ * Caching is disabled until a memory budget is set.
+ */
+class PostingCache {
+ public:
+  /** minimum number of documents of a posting list to be cached */
+  static const size_t MIN_POSTINGS = 256;
+
+ private:
+  /** Decoded posting list */
+  struct Entry {
+    uint64_t version;               ///< version of the posting list
+    std::vector<DocumentId> ids;    ///< documents of all segments
+    std::vector<size_t> offsets;    ///< first document of each segment
+    std::list<FeatureId>::iterator lru;  ///< position in the LRU list
+  };
+
+  /** Type definition of <feature id, entry> map */
+  typedef HashMap<FeatureId, Entry *>::type EntryHash;
+
+  EntryHash entries_;              ///< decoded posting lists
+  std::list<FeatureId> lru_;       ///< features in order of recent use
+  size_t max_bytes_;               ///< memory budget (0: no cache)
+  size_t bytes_;                   ///< bytes of entries
+  uint64_t hits_;                  ///< the number of hits
+  uint64_t misses_;                ///< the number of misses
+  uint64_t evictions_;             ///< the number of evicted entries
+  mutable pthread_mutex_t mutex_;  ///< lock of entries and counters
+
+  /**
+   * Get bytes of an entry.
+   * @param entry entry
+   * @return bytes
+   */
+  static size_t sizeof_entry(const Entry &entry) {
+    return sizeof(Entry) + sizeof(FeatureId)
+      + sizeof(DocumentId) * entry.ids.capacity()
+      + sizeof(size_t) * entry.offsets.capacity();
+  }
+
+  /**
+   * Read documents of a decoded posting list.
+   * @param entry entry
+   * @param v output list (appended)
+   * @param max minimum number of documents to be read (0: all documents)
+   * @param from index of the first segment to be read
+   * @return index of the first segment not read
+   */
+  static size_t read(const Entry &entry, std::vector<DocumentId> &v,
+                     size_t max, size_t from);
+
+  /**
+   * Delete an entry.
+   * @param it iterator of the entry
+   */
+  void erase(EntryHash::iterator it);
+
+  /**
+   * Evict least recently used entries until the bytes are within budget.
+   */
+  void evict();
+
+  /**
+   * Copy constructor (disabled).
+   */
+  PostingCache(const PostingCache &);
+
+  /**
+   * Assignment operator (disabled).
+   */
+  PostingCache &operator=(const PostingCache &);
+
+ public:
+  /**
+   * Constructor.
+   * @param max_bytes memory budget (0: no cache)
+   */
+  explicit PostingCache(size_t max_bytes = 0);
+
+  /**
+   * Destructor.
+   */
+  ~PostingCache();
+
+  /**
+   * Set the memory budget.  Entries over the budget are evicted.
+   * @param max_bytes memory budget (0: no cache)
+   */
+  void set_max_bytes(size_t max_bytes);
+
+  /**
+   * Get the memory budget.
+   * @return memory budget
+   */
+  size_t max_bytes() const { return max_bytes_; }
+
+  /**
+   * Get the identifiers of documents of a posting list through the cache.
+   * It is the same as ImpactPostingList::list(v, max, from).
+   * @param feature_id feature id of the posting list
+   * @param plist posting list
+   * @param v output list (appended)
+   * @param max minimum number of documents to be read (0: all documents)
+   * @param from index of the first segment to be read
+   * @return index of the first segment not read
+   */
+  size_t list(FeatureId feature_id, const ImpactPostingList &plist,
+              std::vector<DocumentId> &v, size_t max, size_t from);
+
+  /**
+   * Delete all entries.  Counters of hits and misses are kept.
+   */
+  void clear();
+
+  /**
+   * Get the number of cached posting lists.
+   * @return the number of entries
+   */
+  size_t size() const;
+
+  /**
+   * Get bytes of cached posting lists.
+   * @return bytes
+   */
+  size_t bytes() const;
+
+  /**
+   * Get the number of lookups of cached posting lists.
+   * @return the number of hits
+   */
+  uint64_t hits() const;
+
+  /**
+   * Get the number of lookups of posting lists decoded again.
+   * @return the number of misses
+   */
+  uint64_t misses() const;
+
+  /**
+   * Get the number of evicted entries.
+   * @return the number of evictions
+   */
+  uint64_t evictions() const;
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_POSTING_CACHE_H_
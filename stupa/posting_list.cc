@@ -21,6 +21,6 @@
 
 namespace stupa {
 
-/* no implementaion */
+volatile uint64_t ImpactPostingList::last_version_ = 0;
 
 } /* namespace stupa */
@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <fstream>
 #include <vector>
+#include "bitmap.h"
 #include "util.h"
 
 namespace stupa {
@@ -33,7 +34,7 @@ namespace stupa {
  */
 class VectorPostingList {
  private:
-  std::vector<uint64_t> plist_;  ///< list of document ids
+  std::vector<DocumentId> plist_;  ///< list of document ids
 
  public:
   /** Constructor */
@@ -46,7 +47,7 @@ class VectorPostingList {
    * Add the identifier of a document id.
    * @param id the identifier of a document
    */
-  void add(uint64_t id) {
+  void add(DocumentId id) {
     plist_.insert(lower_bound(plist_.begin(), plist_.end(), id), id);
   }
 
@@ -57,7 +58,7 @@ class VectorPostingList {
    * @param id the identifier of a document
    * @param max maximum size of posting list
    */
-  void add(uint64_t id, size_t max) {
+  void add(DocumentId id, size_t max) {
     plist_.insert(lower_bound(plist_.begin(), plist_.end(), id), id);
     if (plist_.size() > max) {
       std::copy(plist_.begin() + plist_.size() - max,
@@ -70,12 +71,43 @@ class VectorPostingList {
    * Delete the identifier of a document from posting list.
    * @param id the identifier of a document
    */
-  void remove(uint64_t id) {
-    std::vector<uint64_t>::iterator it =
+  void remove(DocumentId id) {
+    std::vector<DocumentId>::iterator it =
       lower_bound(plist_.begin(), plist_.end(), id);
     if (*it == id) plist_.erase(it);
   }
 
+  /**
+   * Delete the identifiers of documents from posting list at once.
+   * @param ids sorted identifiers of documents
+   */
+  void remove(const std::vector<DocumentId> &ids) {
+    std::vector<DocumentId> v;
+    std::set_difference(plist_.begin(), plist_.end(), ids.begin(), ids.end(),
+                        back_inserter(v));
+    plist_.swap(v);
+  }
+
+  /**
+   * Replace stored documents.
+   * @param ids sorted identifiers of documents
+   */
+  void assign(const std::vector<DocumentId> &ids) { plist_ = ids; }
+
+  /**
+   * Replace the identifiers of documents.
+   * @param ids map of old identifiers to new ones (others are deleted)
+   */
+  void reassign(const DocumentIdMap &ids) {
+    std::vector<DocumentId> v;
+    for (size_t i = 0; i < plist_.size(); i++) {
+      DocumentIdMap::const_iterator it = ids.find(plist_[i]);
+      if (it != ids.end()) v.push_back(it->second);
+    }
+    std::sort(v.begin(), v.end());
+    plist_.swap(v);
+  }
+
   /**
    * Clear positing list.
    */
@@ -85,7 +117,7 @@ class VectorPostingList {
    * Get the list of the identifiers of stored documents.
    * @param v output list
    */
-  void list(std::vector<uint64_t> &v) const {
+  void list(std::vector<DocumentId> &v) const {
     std::copy(plist_.begin(), plist_.end(), back_inserter(v));
   }
 
@@ -95,6 +127,18 @@ class VectorPostingList {
    */
   bool empty() const { return plist_.empty(); }
 
+  /**
+   * Get the number of stored documents.
+   * @return the number of stored documents
+   */
+  size_t size() const { return plist_.size(); }
+
+  /**
+   * Get allocated bytes of posting list.
+   * @return allocated bytes
+   */
+  size_t bytes() const { return sizeof(plist_[0]) * plist_.capacity(); }
+
   /**
    * Save posting list to a file.
    * @param ofs output stream
@@ -141,8 +185,8 @@ class VarBytePostingList {
    * Add the identifier of a document id.
    * @param id the identifier of a document
    */
-  void add(uint64_t id) {
-    std::vector<uint64_t> v;
+  void add(DocumentId id) {
+    std::vector<DocumentId> v;
     if (plist_) {
       decompress_diff(plist_, v);
       v.insert(lower_bound(v.begin(), v.end(), id), id);
@@ -160,8 +204,8 @@ class VarBytePostingList {
    * @param id the identifier of a document
    * @param max maximum size of posting list
    */
-  void add(uint64_t id, size_t max) {
-    std::vector<uint64_t> v;
+  void add(DocumentId id, size_t max) {
+    std::vector<DocumentId> v;
     if (plist_) {
       decompress_diff(plist_, v);
       v.insert(lower_bound(v.begin(), v.end(), id), id);
@@ -178,11 +222,11 @@ class VarBytePostingList {
    * Delete the identifier of a document from posting list.
    * @param id the identifier of a document
    */
-  void remove(uint64_t id) {
+  void remove(DocumentId id) {
     if (!plist_) return;
-    std::vector<uint64_t> v;
+    std::vector<DocumentId> v;
     decompress_diff(plist_, v);
-    std::vector<uint64_t>::iterator dit = lower_bound(v.begin(), v.end(), id);
+    std::vector<DocumentId>::iterator dit = lower_bound(v.begin(), v.end(), id);
     if (*dit == id) {
       v.erase(dit);
       delete [] plist_;
@@ -190,6 +234,47 @@ class VarBytePostingList {
     }
   }
 
+  /**
+   * Delete the identifiers of documents from posting list at once.
+   * @param ids sorted identifiers of documents
+   */
+  void remove(const std::vector<DocumentId> &ids) {
+    if (!plist_) return;
+    std::vector<DocumentId> v, remain;
+    decompress_diff(plist_, v);
+    std::set_difference(v.begin(), v.end(), ids.begin(), ids.end(),
+                        back_inserter(remain));
+    if (remain.size() < v.size()) {
+      delete [] plist_;
+      plist_ = (remain.size() > 0) ? compress_diff(remain) : NULL;
+    }
+  }
+
+  /**
+   * Replace stored documents.
+   * @param ids sorted identifiers of documents
+   */
+  void assign(const std::vector<DocumentId> &ids) {
+    clear();
+    if (!ids.empty()) plist_ = compress_diff(ids);
+  }
+
+  /**
+   * Replace the identifiers of documents.
+   * @param ids map of old identifiers to new ones (others are deleted)
+   */
+  void reassign(const DocumentIdMap &ids) {
+    if (!plist_) return;
+    std::vector<DocumentId> v, reassigned;
+    decompress_diff(plist_, v);
+    for (size_t i = 0; i < v.size(); i++) {
+      DocumentIdMap::const_iterator it = ids.find(v[i]);
+      if (it != ids.end()) reassigned.push_back(it->second);
+    }
+    std::sort(reassigned.begin(), reassigned.end());
+    assign(reassigned);
+  }
+
   /**
    * Clear positing list.
    */
@@ -204,7 +289,7 @@ class VarBytePostingList {
    * Get the list of the identifiers of stored documents.
    * @param v output list
    */
-  void list(std::vector<uint64_t> &v) const {
+  void list(std::vector<DocumentId> &v) const {
     if (plist_) decompress_diff(plist_, v);
   }
 
@@ -216,6 +301,20 @@ class VarBytePostingList {
     return plist_ ? false : true;
   }
 
+  /**
+   * Get the number of stored documents.
+   * @return the number of stored documents
+   */
+  size_t size() const {
+    return plist_ ? static_cast<size_t>(count_compressed(plist_)) : 0;
+  }
+
+  /**
+   * Get allocated bytes of posting list.
+   * @return allocated bytes
+   */
+  size_t bytes() const { return plist_ ? sizeof_compressed(plist_) : 0; }
+
   /**
    * Save posting list to a file.
    * @param ofs output stream
@@ -241,6 +340,468 @@ class VarBytePostingList {
   }
 };
 
+/**
+ * Posting list ordered by impact.
+ *
+ * Documents are grouped into segments by their impact (0-255), and the
+ * segments are kept in descending order of impact.  Each segment is a
+ * sorted list compressed with Variable Byte code and a skip table
+ * (see compress_skip), so documents are found without decoding whole
+ * segments.  Readers can stop after the segments of high impact.
+ *
+ * A segment of dense documents (common features) is stored as a Roaring
+ * bitmap instead when it is smaller than Variable Byte code.  The format
+ * is chosen whenever a segment is rewritten, and segments are always saved
+ * in Variable Byte code with skip tables.
+ */
+class ImpactPostingList {
+ private:
+  /** Documents of the same impact */
+  struct Segment {
+    unsigned char impact;  ///< impact of documents
+    bool bitmap;           ///< true if ids are a bitmap
+    char *ids;             ///< compressed list of document ids
+  };
+
+  std::vector<Segment> segments_;  ///< segments in descending order of impact
+  uint64_t version_;               ///< version changed by every update
+  static volatile uint64_t last_version_;  ///< last version of all lists
+
+  /**
+   * Give a new version to posting list.
+   * Versions are unique among all lists, so that a list created again
+   * never has the version of a deleted one.
+   */
+  void touch() { version_ = __sync_add_and_fetch(&last_version_, 1); }
+
+  /**
+   * Find the position of the segment of an impact.
+   * @param impact impact
+   * @return index of the segment, or the position to insert it
+   */
+  size_t find(unsigned char impact) const {
+    size_t i = 0;
+    while (i < segments_.size() && segments_[i].impact > impact) i++;
+    return i;
+  }
+
+  /**
+   * Compress documents of a segment into the smaller format.
+   * @param v sorted identifiers of documents
+   * @param segment output segment (impact is not changed)
+   */
+  static void encode(const std::vector<DocumentId> &v, Segment &segment) {
+    segment.bitmap = false;
+    segment.ids = compress_skip(v);
+    // bitmaps are larger than Variable Byte code unless documents are dense
+    if (v.size() <= BITMAP_ARRAY_MAX) return;
+    if (sizeof_bitmap(v) < sizeof_skip(segment.ids)) {
+      delete [] segment.ids;
+      segment.bitmap = true;
+      segment.ids = compress_bitmap(v);
+    }
+  }
+
+  /**
+   * Decompress documents of a segment.
+   * @param segment segment
+   * @param v output sorted identifiers of documents (should be empty)
+   */
+  static void decode(const Segment &segment, std::vector<DocumentId> &v) {
+    if (segment.bitmap) {
+      decompress_bitmap(segment.ids, v);
+    } else {
+      decompress_skip(segment.ids, v);
+    }
+  }
+
+  /**
+   * Check whether a segment has a document without decompression.
+   * @param segment segment
+   * @param id the identifier of a document
+   * @return true if found
+   */
+  static bool contains(const Segment &segment, DocumentId id) {
+    return segment.bitmap ? find_bitmap(segment.ids, id)
+                          : find_skip(segment.ids, id);
+  }
+
+  /**
+   * Get the number of documents of a segment.
+   * @param segment segment
+   * @return the number of documents
+   */
+  static size_t count(const Segment &segment) {
+    return segment.bitmap ? count_bitmap(segment.ids)
+                          : static_cast<size_t>(count_compressed(segment.ids));
+  }
+
+  /**
+   * Get bytes of compressed documents of a segment.
+   * @param segment segment
+   * @return bytes of compressed documents
+   */
+  static size_t sizeof_segment(const Segment &segment) {
+    return segment.bitmap ? sizeof_bitmap(segment.ids)
+                          : sizeof_skip(segment.ids);
+  }
+
+  /**
+   * Replace the documents of a segment (the segment is erased if empty).
+   * @param i index of the segment
+   * @param v sorted identifiers of documents
+   */
+  void replace(size_t i, const std::vector<DocumentId> &v) {
+    touch();
+    delete [] segments_[i].ids;
+    if (v.empty()) {
+      segments_.erase(segments_.begin() + i);
+    } else {
+      encode(v, segments_[i]);
+    }
+  }
+
+  /**
+   * Get the first (oldest) document of a segment without decompression.
+   * @param segment segment
+   * @return the identifier of the document
+   */
+  static DocumentId first(const Segment &segment) {
+    return segment.bitmap ? first_bitmap(segment.ids)
+                          : first_skip(segment.ids);
+  }
+
+  /**
+   * Rewrite a loaded segment into the smaller format.
+   * @param segment segment
+   * @param skip true if the segment has a skip table (false: saved before
+   *             skip tables)
+   */
+  static void adapt(Segment &segment, bool skip) {
+    segment.bitmap = false;
+    if (skip && count_compressed(segment.ids) <= BITMAP_ARRAY_MAX) return;
+    std::vector<DocumentId> v;
+    if (skip) {
+      decompress_skip(segment.ids, v);
+    } else {
+      decompress_diff(segment.ids, v);
+    }
+    delete [] segment.ids;
+    encode(v, segment);
+  }
+
+  /**
+   * Copy segments of other posting list.
+   * @param other posting list
+   */
+  void copy(const ImpactPostingList &other) {
+    segments_ = other.segments_;
+    for (size_t i = 0; i < segments_.size(); i++) {
+      size_t size = sizeof_segment(other.segments_[i]);
+      segments_[i].ids = new char[size];
+      std::copy(other.segments_[i].ids, other.segments_[i].ids + size,
+                segments_[i].ids);
+    }
+  }
+
+ public:
+  /** Constructor */
+  ImpactPostingList() { touch(); }
+
+  /** Copy constructor */
+  ImpactPostingList(const ImpactPostingList &other) {
+    touch();
+    copy(other);
+  }
+
+  /** Assignment operator */
+  ImpactPostingList &operator=(const ImpactPostingList &other) {
+    if (this != &other) {
+      clear();
+      copy(other);
+    }
+    return *this;
+  }
+
+  /** Destructor */
+  ~ImpactPostingList() { clear(); }
+
+  /**
+   * Add the identifier of a document.
+   * @param id the identifier of a document
+   * @param impact impact of the document
+   */
+  void add(DocumentId id, unsigned char impact = 0) {
+    size_t i = find(impact);
+    std::vector<DocumentId> v;
+    if (i < segments_.size() && segments_[i].impact == impact) {
+      decode(segments_[i], v);
+      v.insert(lower_bound(v.begin(), v.end(), id), id);
+      replace(i, v);
+    } else {
+      v.push_back(id);
+      Segment segment;
+      segment.impact = impact;
+      encode(v, segment);
+      segments_.insert(segments_.begin() + i, segment);
+      touch();
+    }
+  }
+
+  /**
+   * Add the identifier of a document to posting list.
+   * If the number of stored documents is more than maximum size,
+   * the oldest document of the lowest impact would be deleted.
+   * @param id the identifier of a document
+   * @param impact impact of the document
+   * @param max maximum size of posting list
+   * @param removed output list of deleted documents (appended)
+   */
+  void add(DocumentId id, unsigned char impact, size_t max,
+           std::vector<DocumentId> &removed) {
+    add(id, impact);
+    while (size() > max) {
+      std::vector<DocumentId> v;
+      decode(segments_.back(), v);
+      removed.push_back(v.front());
+      v.erase(v.begin());
+      replace(segments_.size() - 1, v);
+    }
+  }
+
+  /**
+   * Delete the oldest document of all segments.
+   * @return the identifier of the deleted document (0: no document)
+   */
+  DocumentId remove_oldest() {
+    if (segments_.empty()) return 0;
+    size_t oldest = 0;
+    for (size_t i = 1; i < segments_.size(); i++) {
+      if (first(segments_[i]) < first(segments_[oldest])) oldest = i;
+    }
+    std::vector<DocumentId> v;
+    decode(segments_[oldest], v);
+    DocumentId id = v.front();
+    v.erase(v.begin());
+    replace(oldest, v);
+    return id;
+  }
+
+  /**
+   * Delete the identifier of a document from posting list.
+   * @param id the identifier of a document
+   */
+  void remove(DocumentId id) {
+    std::vector<DocumentId> ids(1, id);
+    remove(ids);
+  }
+
+  /**
+   * Delete the identifiers of documents from posting list at once.
+   * Segments without the documents are not rewritten.
+   * @param ids sorted identifiers of documents
+   */
+  void remove(const std::vector<DocumentId> &ids) {
+    size_t i = 0;
+    while (i < segments_.size()) {
+      // look up a few documents in the skip table before decoding
+      if (ids.size() * SKIP_INTERVAL < count(segments_[i])) {
+        size_t j = 0;
+        while (j < ids.size() && !contains(segments_[i], ids[j])) j++;
+        if (j == ids.size()) {
+          i++;
+          continue;
+        }
+      }
+      std::vector<DocumentId> v, remain;
+      decode(segments_[i], v);
+      std::set_difference(v.begin(), v.end(), ids.begin(), ids.end(),
+                          back_inserter(remain));
+      if (remain.size() < v.size()) replace(i, remain);
+      if (!remain.empty()) i++;
+    }
+  }
+
+  /**
+   * Check whether a document is stored.
+   * @param id the identifier of a document
+   * @return true if stored
+   */
+  bool contains(DocumentId id) const {
+    for (size_t i = 0; i < segments_.size(); i++) {
+      if (contains(segments_[i], id)) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Replace the identifiers of documents.  Impacts are kept.
+   * @param ids map of old identifiers to new ones (others are deleted)
+   */
+  void reassign(const DocumentIdMap &ids) {
+    size_t i = 0;
+    while (i < segments_.size()) {
+      std::vector<DocumentId> v, reassigned;
+      decode(segments_[i], v);
+      for (size_t j = 0; j < v.size(); j++) {
+        DocumentIdMap::const_iterator it = ids.find(v[j]);
+        if (it != ids.end()) reassigned.push_back(it->second);
+      }
+      std::sort(reassigned.begin(), reassigned.end());
+      replace(i, reassigned);
+      if (!reassigned.empty()) i++;
+    }
+  }
+
+  /**
+   * Clear positing list.
+   */
+  void clear() {
+    touch();
+    for (size_t i = 0; i < segments_.size(); i++) delete [] segments_[i].ids;
+    segments_.clear();
+  }
+
+  /**
+   * Get the version of posting list.
+   * It is changed whenever documents are added or removed.
+   * @return version
+   */
+  uint64_t version() const { return version_; }
+
+  /**
+   * Get the list of the identifiers of stored documents
+   * in descending order of impact.
+   * @param v output list
+   */
+  void list(std::vector<DocumentId> &v) const { list(v, 0); }
+
+  /**
+   * Get the identifiers of documents of high impact.
+   * Whole segments are read until the number of documents reaches max.
+   * @param v output list
+   * @param max minimum number of documents to be read (0: all documents)
+   */
+  void list(std::vector<DocumentId> &v, size_t max) const { list(v, max, 0); }
+
+  /**
+   * Get the identifiers of documents from a segment.
+   * Whole segments are read until the number of documents reaches max.
+   * @param v output list
+   * @param max minimum number of documents to be read (0: all documents)
+   * @param from index of the first segment to be read
+   * @return index of the first segment not read
+   */
+  size_t list(std::vector<DocumentId> &v, size_t max, size_t from) const {
+    std::vector<DocumentId> segment;
+    size_t start = v.size();
+    size_t i = from;
+    for (; i < segments_.size(); i++) {
+      if (max > 0 && v.size() - start >= max) break;
+      segment.clear();
+      decode(segments_[i], segment);
+      v.insert(v.end(), segment.begin(), segment.end());
+    }
+    return i;
+  }
+
+  /**
+   * Get the number of segments.
+   * @return the number of segments
+   */
+  size_t segments() const { return segments_.size(); }
+
+  /**
+   * Check whether posting list is empty or not.
+   * @return if empty return true
+   */
+  bool empty() const { return segments_.empty(); }
+
+  /**
+   * Get the number of stored documents.
+   * @return the number of stored documents
+   */
+  size_t size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < segments_.size(); i++) {
+      size += count(segments_[i]);
+    }
+    return size;
+  }
+
+  /**
+   * Get allocated bytes of posting list.
+   * @return allocated bytes
+   */
+  size_t bytes() const {
+    size_t bytes = sizeof(Segment) * segments_.capacity();
+    for (size_t i = 0; i < segments_.size(); i++) {
+      bytes += sizeof_segment(segments_[i]);
+    }
+    return bytes;
+  }
+
+  /**
+   * Save posting list to a file.
+   * @param ofs output stream
+   */
+  void save(std::ofstream &ofs) const {
+    size_t num = segments_.size();
+    ofs.write((const char *)&num, sizeof(num));
+    for (size_t i = 0; i < segments_.size(); i++) {
+      const char *ids = segments_[i].ids;
+      if (segments_[i].bitmap) {
+        std::vector<DocumentId> v;
+        decode(segments_[i], v);
+        ids = compress_skip(v);
+      }
+      size_t size = sizeof_skip(ids);
+      ofs.write((const char *)&segments_[i].impact,
+                sizeof(segments_[i].impact));
+      ofs.write((const char *)&size, sizeof(size));
+      ofs.write((const char *)ids, size);
+      if (segments_[i].bitmap) delete [] ids;
+    }
+  }
+
+  /**
+   * Load posting list from a file.
+   * @param ifs input stream
+   * @param skip true if segments have skip tables (false: saved before
+   *             skip tables)
+   */
+  void load(std::ifstream &ifs, bool skip = true) {
+    clear();
+    size_t num;
+    ifs.read((char *)&num, sizeof(num));
+    segments_.resize(num);
+    for (size_t i = 0; i < num; i++) {
+      size_t size;
+      ifs.read((char *)&segments_[i].impact, sizeof(segments_[i].impact));
+      ifs.read((char *)&size, sizeof(size));
+      segments_[i].ids = new char[size];
+      ifs.read((char *)segments_[i].ids, size);
+      adapt(segments_[i], skip);
+    }
+  }
+
+  /**
+   * Load posting list saved by VarBytePostingList (impact is 0).
+   * @param ifs input stream
+   */
+  void load_var_byte(std::ifstream &ifs) {
+    clear();
+    Segment segment;
+    size_t size;
+    ifs.read((char *)&size, sizeof(size));
+    segment.impact = 0;
+    segment.ids = new char[size];
+    ifs.read((char *)segment.ids, size);
+    adapt(segment, false);
+    segments_.push_back(segment);
+  }
+};
+
 /**
  * Posting list using pfor delta compression.
  *
@@ -252,13 +813,25 @@ class PforPostingList {
    * Add the identifier of a document id.
    * @param id the identifier of a document
    */
-  void add(uint64_t id) {
+  void add(DocumentId id) {
   }
   /**
    * Delete the identifier of a document from posting list.
    * @param id the identifier of a document
    */
-  void remove(uint64_t id) {
+  void remove(DocumentId id) {
+  }
+  /**
+   * Delete the identifiers of documents from posting list at once.
+   * @param ids sorted identifiers of documents
+   */
+  void remove(const std::vector<DocumentId> &ids) {
+  }
+  /**
+   * Replace stored documents.
+   * @param ids sorted identifiers of documents
+   */
+  void assign(const std::vector<DocumentId> &ids) {
   }
   /**
    * Clear positing list.
@@ -269,7 +842,7 @@ class PforPostingList {
    * Get the list of the identifiers of stored documents.
    * @param v output list
    */
-  void list(std::vector<uint64_t> &v) const {
+  void list(std::vector<DocumentId> &v) const {
   }
   /**
    * Check whether posting list is empty or not.
@@ -278,6 +851,20 @@ class PforPostingList {
   bool empty() const {
     return false;
   }
+  /**
+   * Get the number of stored documents.
+   * @return the number of stored documents
+   */
+  size_t size() const {
+    return 0;
+  }
+  /**
+   * Get allocated bytes of posting list.
+   * @return allocated bytes
+   */
+  size_t bytes() const {
+    return 0;
+  }
   /**
    * Save posting list to a file.
    * @param ofs output stream
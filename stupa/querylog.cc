@@ -0,0 +1,193 @@
+//
+// Slow-query log
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <time.h>
+#include <cstdio>
+#include "querylog.h"
+
+namespace {
+
+/**
+ * Append a 'name=value' field of time.
+ * @param entry output entry
+ * @param name name of the field
+ * @param nsec time (nsec)
+ */
+void append_time(std::string &entry, const char *name, uint64_t nsec) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\t%s_us=%.3f", name, nsec / 1e3);
+  entry.append(buf);
+}
+
+/**
+ * Append a 'name=value' field of a counter.
+ * @param entry output entry
+ * @param name name of the field
+ * @param value value
+ */
+void append_count(std::string &entry, const char *name, uint64_t value) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\t%s=%llu", name,
+           static_cast<unsigned long long>(value));
+  entry.append(buf);
+}
+
+} /* namespace */
+
+namespace stupa {
+
+const size_t SlowQueryLog::DEFAULT_MAX_BYTES;
+const size_t SlowQueryLog::DEFAULT_NUM_FILES;
+const size_t SlowQueryLog::NUM_RECENT;
+const size_t SlowQueryLog::MAX_QUERIES;
+
+/**
+ * Constructor.
+ */
+SlowQueryLog::SlowQueryLog()
+  : threshold_(0), sample_rate_(0), count_(0), max_bytes_(DEFAULT_MAX_BYTES),
+    num_files_(DEFAULT_NUM_FILES), fp_(NULL), bytes_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+/**
+ * Destructor.
+ */
+SlowQueryLog::~SlowQueryLog() {
+  if (fp_) fclose(fp_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Open a log file.
+ */
+bool SlowQueryLog::open(const std::string &path, size_t max_bytes,
+                        size_t num_files) {
+  pthread_mutex_lock(&mutex_);
+  if (fp_) fclose(fp_);
+  path_ = path;
+  max_bytes_ = max_bytes;
+  num_files_ = num_files;
+  fp_ = fopen(path_.c_str(), "a");
+  if (fp_) {
+    fseek(fp_, 0, SEEK_END);
+    bytes_ = static_cast<size_t>(ftell(fp_));
+  }
+  pthread_mutex_unlock(&mutex_);
+  return fp_ != NULL;
+}
+
+/**
+ * Rotate log files.
+ */
+void SlowQueryLog::rotate() {
+  fclose(fp_);
+  char from[1024], to[1024];
+  for (size_t i = num_files_; i > 0; i--) {
+    if (i > 1) {
+      snprintf(from, sizeof(from), "%s.%d", path_.c_str(),
+               static_cast<int>(i - 1));
+    } else {
+      snprintf(from, sizeof(from), "%s", path_.c_str());
+    }
+    snprintf(to, sizeof(to), "%s.%d", path_.c_str(), static_cast<int>(i));
+    rename(from, to);
+  }
+  if (num_files_ == 0) remove(path_.c_str());
+  fp_ = fopen(path_.c_str(), "w");
+  bytes_ = 0;
+}
+
+/**
+ * Log a query if it is slow or sampled.
+ */
+bool SlowQueryLog::record(const char *operation,
+                          const std::vector<std::string> &queries,
+                          const SearchTrace &trace, uint64_t nsec) {
+  const char *reason = NULL;
+  if (threshold_ > 0 && nsec >= threshold_) {
+    reason = "slow";
+  } else if (sample_rate_ > 0
+             && __sync_add_and_fetch(&count_, 1) % sample_rate_ == 0) {
+    reason = "sampled";
+  }
+  if (!reason) return false;
+
+  char buf[64];
+  time_t now = time(NULL);
+  struct tm tm;
+  strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", localtime_r(&now, &tm));
+  std::string entry = std::string("time=") + buf;
+  entry.append("\treason=").append(reason);
+  entry.append("\toperation=").append(operation);
+  append_time(entry, "total", nsec);
+  append_time(entry, "lock_wait", trace.lock_wait);
+  for (int i = 0; i < NUM_SEARCH_STAGES; i++) {
+    append_time(entry, search_stage_name(static_cast<SearchStage>(i)),
+                trace.stage_time[i]);
+  }
+  append_count(entry, "query_features", trace.query_features);
+  append_count(entry, "skipped_features", trace.skipped_features);
+  append_count(entry, "postings", trace.postings);
+  append_count(entry, "candidates", trace.candidates);
+  append_count(entry, "scored", trace.scored);
+  append_count(entry, "results", trace.results);
+  for (int i = 0; i < NUM_SEARCH_PLANS; i++) {
+    if (trace.plans[i] == 0) continue;
+    entry.append("\tplan=");
+    entry.append(search_plan_name(static_cast<SearchPlan>(i)));
+  }
+  entry.append("\tqueries=");
+  for (size_t i = 0; i < queries.size() && i < MAX_QUERIES; i++) {
+    if (i > 0) entry.push_back(',');
+    for (size_t j = 0; j < queries[i].size(); j++) {
+      char c = queries[i][j];
+      entry.push_back(c == '\t' || c == '\n' || c == '\r' ? ' ' : c);
+    }
+  }
+  if (queries.size() > MAX_QUERIES) entry.append(",...");
+
+  pthread_mutex_lock(&mutex_);
+  if (fp_) {
+    if (bytes_ > 0 && bytes_ + entry.size() + 1 > max_bytes_) rotate();
+    if (fp_) {
+      fprintf(fp_, "%s\n", entry.c_str());
+      fflush(fp_);
+      bytes_ += entry.size() + 1;
+    }
+  }
+  recent_.push_back(entry);
+  if (recent_.size() > NUM_RECENT) recent_.pop_front();
+  pthread_mutex_unlock(&mutex_);
+  return true;
+}
+
+/**
+ * Get the latest entries.
+ */
+void SlowQueryLog::recent(std::string &result) const {
+  pthread_mutex_lock(&mutex_);
+  for (std::deque<std::string>::const_iterator it = recent_.begin();
+       it != recent_.end(); ++it) {
+    result.append(*it).push_back('\n');
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+} /* namespace stupa */
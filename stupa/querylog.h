@@ -0,0 +1,140 @@
+//
+// Slow-query log
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#ifndef STUPA_QUERYLOG_H_
+#define STUPA_QUERYLOG_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+#include "metrics.h"
+
+namespace stupa {
+
+/**
+ * Log of slow and sampled search queries.
+ *
+ * A query is logged when its latency is not less than the threshold or
+ * when it is picked by sampling (every N-th query).  Each entry is a line
+ * of 'name=value' fields separated by tabs, holding the trace of the
+ * query.  Entries are appended to a log file, which is rotated when it
+ * grows over the limit, and the latest entries are also kept in memory.
+ * Logging is disabled until a threshold or a sample rate is set.
+ */
+class SlowQueryLog {
+ public:
+  /** default maximum size of a log file (bytes) */
+  static const size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+  /** default number of rotated log files */
+  static const size_t DEFAULT_NUM_FILES = 4;
+  /** number of entries kept in memory */
+  static const size_t NUM_RECENT = 100;
+  /** maximum number of queries written in an entry */
+  static const size_t MAX_QUERIES = 16;
+
+ private:
+  uint64_t threshold_;             ///< threshold of latency (nsec, 0: off)
+  size_t sample_rate_;             ///< log every N-th query (0: off)
+  volatile size_t count_;          ///< the number of checked queries
+  std::string path_;               ///< path of log file
+  size_t max_bytes_;               ///< maximum size of a log file
+  size_t num_files_;               ///< the number of rotated files
+  FILE *fp_;                       ///< log file
+  size_t bytes_;                   ///< size of current log file
+  std::deque<std::string> recent_; ///< latest entries
+  mutable pthread_mutex_t mutex_;  ///< lock of file and latest entries
+
+  /**
+   * Rotate log files: path.(N-1) -> path.N, ..., path -> path.1.
+   */
+  void rotate();
+
+  /**
+   * Copy constructor (disabled).
+   */
+  SlowQueryLog(const SlowQueryLog &);
+
+  /**
+   * Assignment operator (disabled).
+   */
+  SlowQueryLog &operator=(const SlowQueryLog &);
+
+ public:
+  /**
+   * Constructor.
+   */
+  SlowQueryLog();
+
+  /**
+   * Destructor.
+   */
+  ~SlowQueryLog();
+
+  /**
+   * Open a log file (entries are kept only in memory without a file).
+   * @param path path of log file
+   * @param max_bytes maximum size of a log file
+   * @param num_files the number of rotated files
+   * @return true if the file was opened
+   */
+  bool open(const std::string &path, size_t max_bytes = DEFAULT_MAX_BYTES,
+            size_t num_files = DEFAULT_NUM_FILES);
+
+  /**
+   * Set the threshold of latency.
+   * @param nsec threshold (nsec, 0: no threshold)
+   */
+  void set_threshold(uint64_t nsec) { threshold_ = nsec; }
+
+  /**
+   * Set the sample rate.
+   * @param rate log every N-th query (0: no sampling)
+   */
+  void set_sample_rate(size_t rate) { sample_rate_ = rate; }
+
+  /**
+   * Check whether logging is enabled.
+   * @return true if enabled
+   */
+  bool enabled() const { return threshold_ > 0 || sample_rate_ > 0; }
+
+  /**
+   * Log a query if it is slow or sampled.
+   * @param operation name of operation
+   * @param queries input queries
+   * @param trace trace of the search
+   * @param nsec latency of the query (nsec)
+   * @return true if the query was logged
+   */
+  bool record(const char *operation, const std::vector<std::string> &queries,
+              const SearchTrace &trace, uint64_t nsec);
+
+  /**
+   * Get the latest entries.
+   * @param result output entries (one entry per line)
+   */
+  void recent(std::string &result) const;
+};
+
+} /* namespace stupa */
+
+#endif  // STUPA_QUERYLOG_H_
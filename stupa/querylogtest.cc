@@ -0,0 +1,123 @@
+//
+// Tests for SlowQueryLog class
+//
+// Copyright(C) 2010  Mizuki Fujisawa <fujisawa@bayon.cc>
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+//
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "querylog.h"
+
+namespace {
+
+/* constants */
+const char *LOG_FILE = "querylogtest_slow.tmp";  ///< log filename
+
+/* count lines of a file */
+static size_t count_lines(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) return 0;
+  size_t count = 0;
+  int c;
+  while ((c = fgetc(fp)) != EOF) {
+    if (c == '\n') count++;
+  }
+  fclose(fp);
+  return count;
+}
+
+} /* namespace */
+
+/* record, recent */
+TEST(SlowQueryLogTest, RecordTest) {
+  stupa::SlowQueryLog log;
+  std::vector<std::string> queries;
+  queries.push_back("doc1");
+  queries.push_back("doc2");
+  stupa::SearchTrace trace;
+  trace.query_features = 3;
+  trace.postings = 10;
+  trace.candidates = 5;
+  trace.scored = 5;
+  trace.results = 2;
+  trace.stage_time[stupa::STAGE_SCORING] = 1500;
+
+  EXPECT_FALSE(log.enabled());
+  EXPECT_FALSE(log.record("search_by_document", queries, trace, 1000000));
+
+  log.set_threshold(1000000);
+  EXPECT_TRUE(log.enabled());
+  EXPECT_FALSE(log.record("search_by_document", queries, trace, 999999));
+  EXPECT_TRUE(log.record("search_by_document", queries, trace, 1000000));
+
+  std::string result;
+  log.recent(result);
+  EXPECT_NE(std::string::npos, result.find("\treason=slow\t"));
+  EXPECT_NE(std::string::npos, result.find("\toperation=search_by_document\t"));
+  EXPECT_NE(std::string::npos, result.find("\ttotal_us=1000.000\t"));
+  EXPECT_NE(std::string::npos, result.find("\tscoring_us=1.500\t"));
+  EXPECT_NE(std::string::npos, result.find("\tquery_features=3\t"));
+  EXPECT_NE(std::string::npos, result.find("\tpostings=10\t"));
+  EXPECT_NE(std::string::npos, result.find("\tresults=2\t"));
+  EXPECT_NE(std::string::npos, result.find("\tqueries=doc1,doc2\n"));
+
+  log.set_threshold(0);
+  log.set_sample_rate(3);
+  size_t count = 0;
+  for (size_t i = 0; i < 9; i++) {
+    if (log.record("search_by_feature", queries, trace, 10)) count++;
+  }
+  EXPECT_EQ(3, count);
+
+  log.set_sample_rate(1);
+  for (size_t i = 0; i < stupa::SlowQueryLog::NUM_RECENT; i++) {
+    log.record("search_by_feature", queries, trace, 10);
+  }
+  result.clear();
+  log.recent(result);
+  EXPECT_EQ(std::string::npos, result.find("\treason=slow\t"));
+}
+
+/* open, rotate */
+TEST(SlowQueryLogTest, RotateTest) {
+  std::string rotated = std::string(LOG_FILE) + ".1";
+  remove(LOG_FILE);
+  remove(rotated.c_str());
+
+  stupa::SlowQueryLog log;
+  EXPECT_TRUE(log.open(LOG_FILE, 1024, 1));
+  log.set_sample_rate(1);
+  std::vector<std::string> queries(1, "query");
+  stupa::SearchTrace trace;
+  for (size_t i = 0; i < 20; i++) {
+    EXPECT_TRUE(log.record("search_by_feature", queries, trace, 10));
+  }
+  size_t current = count_lines(LOG_FILE);
+  size_t old = count_lines(rotated);
+  EXPECT_LT(0, current);
+  EXPECT_LT(0, old);
+  EXPECT_GT(20, current + old);
+
+  remove(LOG_FILE);
+  remove(rotated.c_str());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -17,19 +17,53 @@
 // Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //
 
+#include <cstdio>
 #include <algorithm>
+#include <functional>
+#include <map>
 #include <set>
 #include "search.h"
 
 namespace stupa {
 
+namespace {
+/** flag of the first field in files of 32-bit identifiers */
+const uint64_t ID32_FORMAT = static_cast<uint64_t>(1) << 63;
+
+/**
+ * Get the minimum hash values of features by two hash functions.
+ * Documents sorted by them have similar features close together.
+ * @param feature_ids feature ids of a document
+ * @return the pair of minimum hash values
+ */
+std::pair<uint64_t, uint64_t> minhash_key(
+  const std::vector<FeatureId> &feature_ids) {
+  std::pair<uint64_t, uint64_t> key(~static_cast<uint64_t>(0),
+                                    ~static_cast<uint64_t>(0));
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    key.first = std::min(key.first, mix_hash(feature_ids[i] ^ mix_hash(1)));
+    key.second = std::min(key.second, mix_hash(feature_ids[i] ^ mix_hash(2)));
+  }
+  return key;
+}
+} /* namespace */
+
 /**
  * Look up inverted indexes.
  */
-void StupaSearch::lookup_inverted_index_by_document(
+SearchPlan StupaSearch::lookup_inverted_index_by_document(
   const std::vector<DocumentId> &queries,
-  std::vector<DocumentId> &results) const {
+  std::vector<DocumentId> &results, SearchTrace *trace) const {
   std::set<FeatureId> fidset;
+  if (minhash_) {
+    std::vector<std::vector<FeatureId> > features(queries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+      model_->feature(queries[i], features[i]);
+      if (trace) trace->query_features += features[i].size();
+    }
+    minhash_->lookup(features, results, MinHashIndex::MAX_LOOKUP, trace);
+    return PLAN_LOOKUP;
+  }
   std::vector<FeatureId> feature_ids;
   for (size_t i = 0; i < queries.size(); i++) {
     model_->feature(queries[i], feature_ids);
@@ -42,66 +76,353 @@ void StupaSearch::lookup_inverted_index_by_document(
        it != fidset.end(); ++it) {
     feature_ids.push_back(*it);
   }
-  inv_.lookup(feature_ids, results);
+  if (trace) trace->query_features += feature_ids.size();
+  skip_frequent_features(feature_ids, trace);
+  if (choose_plan(feature_ids) == PLAN_SCAN) return PLAN_SCAN;
+  inv_.lookup(feature_ids, results, InvertedIndex::MAX_LOOKUP, trace);
+  return PLAN_LOOKUP;
+}
+
+/**
+ * Choose the plan of a search.
+ */
+SearchPlan StupaSearch::choose_plan(
+  const std::vector<FeatureId> &feature_ids) const {
+  if (planner_ == PLANNER_LOOKUP) return PLAN_LOOKUP;
+  if (planner_ == PLANNER_SCAN) return PLAN_SCAN;
+  double ndocs = static_cast<double>(model_->size());
+  if (ndocs == 0) return PLAN_LOOKUP;
+  const SearchModel::FeatureCount &count = model_->feature_count();
+  SearchModel::FeatureCount::const_iterator it;
+  double postings = 0.0;
+  double unmatched = 1.0;  // ratio of documents without any of the features
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    postings += inv_.postings(feature_ids[i]);
+    it = count.find(feature_ids[i]);
+    if (it != count.end() && it->second > 0) {
+      unmatched *= 1.0 - std::min(1.0, it->second / ndocs);
+    }
+  }
+  // lookup counts candidates in postings, and scores the most counted ones
+  double candidates = std::min(ndocs * (1.0 - unmatched), postings);
+  size_t scored = model_->num_scored(static_cast<size_t>(
+    std::min(candidates, static_cast<double>(InvertedIndex::MAX_LOOKUP))));
+  double length = std::max(1.0, static_cast<double>(model_->average_length()));
+  double lookup_cost = postings + scored * length;
+  double scan_cost = ndocs * length / model_->scan_threads();
+  return scan_cost < lookup_cost ? PLAN_SCAN : PLAN_LOOKUP;
+}
+
+/**
+ * Generate candidates by MinHash index instead of inverted indexes.
+ */
+void StupaSearch::set_minhash(size_t bands, size_t rows) {
+  if (minhash_) {
+    delete minhash_;
+    minhash_ = NULL;
+  }
+  if (bands == 0 || rows == 0) return;
+  minhash_ = new MinHashIndex(bands, rows);
+  index_minhash();
+}
+
+/**
+ * Add all documents to MinHash index.
+ */
+void StupaSearch::index_minhash() {
+  minhash_->clear();
+  std::vector<FeatureId> feature_ids;
+  const SearchModel::DocumentMap &documents = model_->documents();
+  for (SearchModel::DocumentMap::const_iterator it = documents.begin();
+       it != documents.end(); ++it) {
+    if (!it->second) continue;
+    feature_ids.clear();
+    model_->feature(it->first, feature_ids);
+    minhash_->add_document(it->first, feature_ids);
+  }
+}
+
+/**
+ * Remove features of high document frequency from a query.
+ */
+void StupaSearch::skip_frequent_features(std::vector<FeatureId> &feature_ids,
+                                         SearchTrace *trace) const {
+  size_t cutoff = df_cutoff();
+  if (cutoff == 0 || feature_ids.empty()) return;
+  const SearchModel::FeatureCount &count = model_->feature_count();
+  SearchModel::FeatureCount::const_iterator it;
+  size_t num = 0;
+  FeatureId rarest = FEATURE_EMPTY_ID;
+  size_t rarest_df = 0;
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    it = count.find(feature_ids[i]);
+    size_t df = (it != count.end() && it->second > 0) ? it->second : 0;
+    if (df <= cutoff) {
+      feature_ids[num++] = feature_ids[i];
+    } else if (rarest == FEATURE_EMPTY_ID || df < rarest_df) {
+      rarest = feature_ids[i];
+      rarest_df = df;
+    }
+  }
+  // a query of frequent features only is looked up by the rarest one
+  if (num == 0) feature_ids[num++] = rarest;
+  if (trace) trace->skipped_features += feature_ids.size() - num;
+  feature_ids.resize(num);
+}
+
+/**
+ * Get the document frequency over which features are not looked up.
+ */
+size_t StupaSearch::df_cutoff() const {
+  if (max_df_ratio_ > 0.0) {
+    size_t cutoff = static_cast<size_t>(max_df_ratio_ * model_->size());
+    return cutoff > 0 ? cutoff : 1;
+  }
+  return skip_postings_ > 0.0 ? tuned_df_cutoff_ : 0;
+}
+
+/**
+ * Tune the cutoff of document frequency automatically.
+ */
+void StupaSearch::set_skip_postings(double ratio) {
+  skip_postings_ = ratio;
+  tuned_df_cutoff_ = 0;
+  tuned_size_ = 0;
+  retune_df_cutoff();
+}
+
+/**
+ * Tune the cutoff of document frequency again.
+ */
+void StupaSearch::retune_df_cutoff() {
+  if (skip_postings_ <= 0.0) return;
+  size_t size = model_->size();
+  if (tuned_size_ > 0 && size * 10 <= tuned_size_ * 11
+      && size * 10 >= tuned_size_ * 9) return;
+  tuned_size_ = size;
+  tuned_df_cutoff_ = 0;
+
+  std::vector<int> counts;
+  uint64_t total = 0;
+  const SearchModel::FeatureCount &count = model_->feature_count();
+  for (SearchModel::FeatureCount::const_iterator it = count.begin();
+       it != count.end(); ++it) {
+    if (it->second <= 0) continue;
+    counts.push_back(it->second);
+    total += it->second;
+  }
+  if (counts.empty()) return;
+  std::sort(counts.begin(), counts.end(), std::greater<int>());
+  // skip the most frequent features while their postings are in budget
+  uint64_t budget = static_cast<uint64_t>(skip_postings_ * total);
+  uint64_t skipped = 0;
+  size_t i = 0;
+  while (i < counts.size() && skipped + counts[i] <= budget) {
+    skipped += counts[i++];
+  }
+  if (i > 0) {
+    tuned_df_cutoff_ = (i < counts.size()) ? counts[i] : counts.back();
+  }
+}
+
+/**
+ * Map document ids of search results to identifier strings.
+ */
+void StupaSearch::map_document_ids(
+  const std::vector<std::pair<DocumentId, Point> > &pairs,
+  std::vector<std::pair<std::string, Point> > &results) const {
+  for (size_t i = 0; i < pairs.size(); i++) {
+    DocId2Str::const_iterator it = did2str_.find(pairs[i].first);
+    if (it != did2str_.end()) {
+      results.push_back(
+        std::pair<std::string, Point>(it->second, pairs[i].second));
+    }
+  }
+}
+
+/**
+ * Get a new document id.
+ */
+DocumentId StupaSearch::new_document_id() {
+  if (did2str_.size() > static_cast<size_t>(max_document_id_ - DOC_START_ID)) {
+    return DOC_EMPTY_ID;
+  }
+  for (;;) {
+    if (current_document_id_ < DOC_START_ID
+        || current_document_id_ > max_document_id_) {
+      // deleted ids are left in posting lists until they are purged, and
+      // ids follow insertion order for posting lists of recent documents
+      inv_.purge();
+      reassign_document_ids(REASSIGN_BY_ID);
+      current_document_id_ =
+        static_cast<DocumentId>(DOC_START_ID + did2str_.size());
+    }
+    DocumentId id = current_document_id_++;
+    if (did2str_.find(id) == did2str_.end() && !inv_.is_deleted(id)) {
+      return id;
+    }
+  }
 }
 
 /**
- * Delete the oldest document.
+ * Get a new feature id.
  */
-void StupaSearch::delete_oldest_document() {
-  std::vector<FeatureId> features;
-  model_->feature(oldest_document_id_, features);
-  inv_.delete_document(oldest_document_id_, features);
-  model_->delete_document(oldest_document_id_);
-  str2did_.erase(did2str_[oldest_document_id_]);
-  did2str_.erase(oldest_document_id_);
-  oldest_document_id_++;
-  while (oldest_document_id_ <= current_document_id_
-         && did2str_.find(oldest_document_id_) == did2str_.end()) {
-    oldest_document_id_++;
+FeatureId StupaSearch::new_feature_id(const std::vector<FeatureId> &pending) {
+  if (current_feature_id_ >= FEATURE_START_ID
+      && current_feature_id_ <= max_feature_id_) {
+    return current_feature_id_++;
+  }
+  if (free_feature_ids_.empty()) {
+    // posting lists of features only in deleted documents are dropped
+    inv_.purge();
+    const SearchModel::FeatureCount &count = model_->feature_count();
+    std::set<FeatureId> used(pending.begin(), pending.end());
+    for (Str2FeatureId::iterator it = str2fid_.begin();
+         it != str2fid_.end(); ++it) {
+      if (count.find(it->second) == count.end()
+          && used.find(it->second) == used.end()) {
+        free_feature_ids_.push_back(it->second);
+        str2fid_.erase(it);
+      }
+    }
   }
+  if (free_feature_ids_.empty()) return FEATURE_EMPTY_ID;
+  FeatureId id = free_feature_ids_.back();
+  free_feature_ids_.pop_back();
+  return id;
+}
+
+/**
+ * Append a document to the end of the insertion order.
+ */
+void StupaSearch::push_order(DocumentId id) {
+  OrderLink &link = order_[id];
+  link.prev = newest_document_id_;
+  link.next = DOC_EMPTY_ID;
+  if (newest_document_id_ != DOC_EMPTY_ID) {
+    order_[newest_document_id_].next = id;
+  } else {
+    oldest_document_id_ = id;
+  }
+  newest_document_id_ = id;
+}
+
+/**
+ * Remove a document from the insertion order.
+ */
+void StupaSearch::remove_order(DocumentId id) {
+  OrderMap::iterator it = order_.find(id);
+  if (it == order_.end()) return;
+  OrderLink link = it->second;
+  order_.erase(it);
+  if (link.prev != DOC_EMPTY_ID) {
+    order_[link.prev].next = link.next;
+  } else {
+    oldest_document_id_ = link.next;
+  }
+  if (link.next != DOC_EMPTY_ID) {
+    order_[link.next].prev = link.prev;
+  } else {
+    newest_document_id_ = link.prev;
+  }
+}
+
+/**
+ * Delete the oldest documents at once.
+ */
+void StupaSearch::delete_oldest_documents(size_t num) {
+  std::vector<DocumentId> ids;
+  std::vector<std::vector<FeatureId> > features;
+  while (num-- > 0 && oldest_document_id_ != DOC_EMPTY_ID) {
+    DocumentId id = oldest_document_id_;
+    ids.push_back(id);
+    features.push_back(std::vector<FeatureId>());
+    model_->feature(id, features.back());
+    if (minhash_) minhash_->delete_document(id, features.back());
+    remove_order(id);
+    model_->delete_document(id);
+    DocId2Str::iterator dsit = did2str_.find(id);
+    if (dsit != did2str_.end()) {
+      str2did_.erase(dsit->second);
+      did2str_.erase(dsit);
+    }
+  }
+  inv_.delete_documents(ids, features);
+  retune_df_cutoff();
 }
 
 /**
  * Add a document to search model object and inverted indexes.
  */
 void StupaSearch::add_document(const std::string &document_id,
-                                const std::vector<std::string> &features) {
-  if (document_id.empty() || features.empty()) return;
-  while (max_documents_ && model_->size() >= max_documents_) {
-    delete_oldest_document();
+                                const std::vector<std::string> &features,
+                                double quality) {
+  if (model_->weighted()) {
+    std::vector<std::string> names;
+    std::vector<Point> weights;
+    split_weighted(features, names, weights);
+    add_document(document_id, names, weights, quality);
+  } else {
+    add_document(document_id, features, std::vector<Point>(), quality);
   }
+}
 
+/**
+ * Add a document of weighted features.
+ */
+void StupaSearch::add_document(const std::string &document_id,
+                                const std::vector<std::string> &features,
+                                const std::vector<Point> &weights,
+                                double quality) {
+  if (document_id.empty() || features.empty()) return;
   std::vector<FeatureId> feature_ids;
+  std::vector<Point> feature_weights;
   Str2FeatureId::iterator fit;
   for (size_t i = 0; i < features.size(); i++) {
     if (features[i].empty()) continue;
     fit = str2fid_.find(features[i]);
     FeatureId feature_id;
     if (fit == str2fid_.end()) {
-      feature_id = current_feature_id_++;
+      feature_id = new_feature_id(feature_ids);
+      if (feature_id == FEATURE_EMPTY_ID) {
+        fprintf(stderr, "[ERROR]No feature id is left: %s\n",
+                features[i].c_str());
+        return;
+      }
       str2fid_[features[i]] = feature_id;
     } else {
       feature_id = fit->second;
     }
     feature_ids.push_back(feature_id);
+    if (!weights.empty()) feature_weights.push_back(weights[i]);
   }
-  std::sort(feature_ids.begin(), feature_ids.end());
-
-  Str2DocId::iterator dit = str2did_.find(document_id);
-  if (dit != str2did_.end()) {
-    std::vector<FeatureId> old_feature;
-    model_->feature(dit->second, old_feature);
-    inv_.delete_document(dit->second, old_feature);
-    model_->add_document(dit->second, feature_ids);
-    inv_.add_document(dit->second, feature_ids);
+  if (model_->weighted()) {
+    // repeated features are merged into their frequencies
+    merge_weighted(feature_ids, feature_weights);
   } else {
-    str2did_[document_id] = current_document_id_;
-    did2str_[current_document_id_] = document_id;
-    model_->add_document(current_document_id_, feature_ids);
-    inv_.add_document(current_document_id_, feature_ids);
-    current_document_id_++;
+    std::sort(feature_ids.begin(), feature_ids.end());
   }
+
+  if (str2did_.find(document_id) != str2did_.end()) {
+    // old postings are deleted lazily, so an updated document gets a new id
+    delete_document(document_id);
+  } else if (max_documents_ && model_->size() >= max_documents_) {
+    delete_oldest_documents(model_->size() - max_documents_ + 1);
+  }
+  DocumentId id = new_document_id();
+  if (id == DOC_EMPTY_ID) {
+    fprintf(stderr, "[ERROR]No document id is left: %s\n",
+            document_id.c_str());
+    return;
+  }
+  str2did_[document_id] = id;
+  did2str_[id] = document_id;
+  model_->add_document(id, feature_ids, feature_weights);
+  inv_.add_document(id, feature_ids, quality);
+  if (minhash_) minhash_->add_document(id, feature_ids);
+  push_order(id);
+  similar_ids_ = false;
+  retune_df_cutoff();
 }
 
 /**
@@ -111,18 +432,88 @@ void StupaSearch::add_document(const std::string &document_id,
 void StupaSearch::delete_document(const std::string &document_id) {
   Str2DocId::iterator sdit = str2did_.find(document_id);
   if (sdit != str2did_.end()) {
-    if (sdit->second == oldest_document_id_) {
-      delete_oldest_document();
-    } else {
-      std::vector<FeatureId> features;
-      model_->feature(sdit->second, features);
-      inv_.delete_document(sdit->second, features);
-      model_->delete_document(sdit->second);
-      DocId2Str::iterator dsit = did2str_.find(sdit->second);
-      if (dsit != did2str_.end()) did2str_.erase(dsit);
-      str2did_.erase(sdit);
+    std::vector<FeatureId> features;
+    model_->feature(sdit->second, features);
+    inv_.delete_document(sdit->second, features);
+    if (minhash_) minhash_->delete_document(sdit->second, features);
+    model_->delete_document(sdit->second);
+    remove_order(sdit->second);
+    DocId2Str::iterator dsit = did2str_.find(sdit->second);
+    if (dsit != did2str_.end()) did2str_.erase(dsit);
+    str2did_.erase(sdit);
+    similar_ids_ = false;
+    retune_df_cutoff();
+  }
+}
+
+/**
+ * Reassign identifiers to documents.
+ */
+bool StupaSearch::reassign_document_ids(ReassignOrder order) {
+  size_t num = did2str_.size();
+  if (order == REASSIGN_BY_SIMILARITY && inv_.max() > 0
+      && inv_.retention() == InvertedIndex::RETAIN_RECENT) {
+    fprintf(stderr, "[WARNING]Ids by similarity break the retention of "
+            "recent documents: ids in insertion order\n");
+    order = REASSIGN_BY_ID;
+  }
+  if (order == REASSIGN_BY_SIMILARITY && similar_ids_) return false;
+  // documents in insertion order
+  std::vector<DocumentId> ordered;
+  ordered.reserve(num);
+  for (DocumentId did = oldest_document_id_; did != DOC_EMPTY_ID;
+       did = order_.find(did)->second.next) {
+    ordered.push_back(did);
+  }
+  if (order == REASSIGN_BY_ID) {
+    // ids are already from the start in insertion order
+    size_t i = 0;
+    while (i < num && ordered[i] == DOC_START_ID + i) i++;
+    if (i == num) return false;
+  }
+
+  // documents sorted by <key, insertion order>
+  std::vector<std::pair<std::pair<uint64_t, uint64_t>, size_t> > keys;
+  keys.reserve(num);
+  std::vector<FeatureId> feature_ids;
+  for (size_t i = 0; i < num; i++) {
+    std::pair<uint64_t, uint64_t> key(0, 0);
+    if (order == REASSIGN_BY_SIMILARITY) {
+      feature_ids.clear();
+      model_->feature(ordered[i], feature_ids);
+      key = minhash_key(feature_ids);
     }
+    keys.push_back(std::make_pair(key, i));
+  }
+  std::sort(keys.begin(), keys.end());
+  DocumentIdMap ids;
+  for (size_t i = 0; i < keys.size(); i++) {
+    ids[ordered[keys[i].second]] = static_cast<DocumentId>(DOC_START_ID + i);
   }
+
+  model_->reassign_ids(ids);
+  inv_.reassign_ids(ids);
+  if (minhash_) index_minhash();
+  DocId2Str did2str;
+  for (DocId2Str::const_iterator it = did2str_.begin();
+       it != did2str_.end(); ++it) {
+    did2str[ids.find(it->first)->second] = it->second;
+  }
+  did2str_.swap(did2str);
+  for (Str2DocId::iterator it = str2did_.begin(); it != str2did_.end(); ++it) {
+    it->second = ids.find(it->second)->second;
+  }
+  // the insertion order is kept
+  for (size_t i = 0; i < ordered.size(); i++) {
+    ordered[i] = ids.find(ordered[i])->second;
+  }
+  order_.clear();
+  oldest_document_id_ = DOC_EMPTY_ID;
+  newest_document_id_ = DOC_EMPTY_ID;
+  for (size_t i = 0; i < ordered.size(); i++) push_order(ordered[i]);
+  current_document_id_ = static_cast<DocumentId>(DOC_START_ID + num);
+  similar_ids_ = order == REASSIGN_BY_SIMILARITY;
+  return true;
 }
 
 /**
@@ -130,24 +521,37 @@ void StupaSearch::delete_document(const std::string &document_id) {
  */
 void StupaSearch::search_by_document(
   const std::vector<std::string> &queries,
-  std::vector<std::pair<std::string, Point> > &results, size_t max) const {
+  std::vector<std::pair<std::string, Point> > &results, size_t max,
+  SearchTrace *trace) const {
+  uint64_t time = trace ? get_time_nsec() : 0;
   std::vector<DocumentId> document_ids;
   for (size_t i = 0; i < queries.size(); i++) {
     Str2DocId::const_iterator it = str2did_.find(queries[i]);
     if (it != str2did_.end()) document_ids.push_back(it->second);
   }
+  if (trace) trace_stage(trace, STAGE_DICTIONARY, time);
   if (document_ids.empty()) return;
 
   std::vector<DocumentId> candidates;
-  lookup_inverted_index_by_document(document_ids, candidates);
+  SearchPlan plan = lookup_inverted_index_by_document(document_ids,
+                                                      candidates, trace);
+  if (trace) {
+    trace_stage(trace, STAGE_LOOKUP, time);
+    trace->plans[plan]++;
+    trace->scored += plan == PLAN_SCAN ? model_->size()
+                                       : model_->num_scored(candidates.size());
+  }
   std::vector<std::pair<DocumentId, Point> > pairs;
-  model_->search_by_document(document_ids, candidates, pairs, max);
-  for (size_t i = 0; i < pairs.size(); i++) {
-    DocId2Str::const_iterator it = did2str_.find(pairs[i].first);
-    if (it != did2str_.end()) {
-      results.push_back(
-        std::pair<std::string, Point>(it->second, pairs[i].second));
-    }
+  if (plan == PLAN_SCAN) {
+    model_->search_by_document(document_ids, pairs, max);
+  } else {
+    model_->search_by_document(document_ids, candidates, pairs, max);
+  }
+  if (trace) trace_stage(trace, STAGE_SCORING, time);
+  map_document_ids(pairs, results);
+  if (trace) {
+    trace_stage(trace, STAGE_MAPPING, time);
+    trace->results += pairs.size();
   }
 }
 
@@ -156,29 +560,119 @@ void StupaSearch::search_by_document(
  */
 void StupaSearch::search_by_feature(
   const std::vector<std::string> &queries,
-  std::vector<std::pair<std::string, Point> > &results, size_t max) const {
-  std::set<FeatureId> fidset;
-  for (size_t i = 0; i < queries.size(); i++) {
-    Str2FeatureId::const_iterator it = str2fid_.find(queries[i]);
-    if (it != str2fid_.end()) fidset.insert(it->second);
+  std::vector<std::pair<std::string, Point> > &results, size_t max,
+  SearchTrace *trace) const {
+  uint64_t time = trace ? get_time_nsec() : 0;
+  std::vector<std::string> names;
+  std::vector<Point> weights;
+  if (model_->weighted()) {
+    split_weighted(queries, names, weights);
+  } else {
+    names = queries;
+  }
+  std::map<FeatureId, Point> fidmap;
+  for (size_t i = 0; i < names.size(); i++) {
+    Str2FeatureId::const_iterator it = str2fid_.find(names[i]);
+    if (it == str2fid_.end()) continue;
+    if (weights.empty()) {
+      fidmap[it->second] = 1.0;
+    } else {
+      fidmap[it->second] += weights[i];
+    }
   }
   std::vector<FeatureId> feature_ids;
-  for (std::set<FeatureId>::iterator it = fidset.begin();
-       it != fidset.end(); ++it) {
-    feature_ids.push_back(*it);
+  std::vector<Point> feature_weights;
+  for (std::map<FeatureId, Point>::iterator it = fidmap.begin();
+       it != fidmap.end(); ++it) {
+    feature_ids.push_back(it->first);
+    feature_weights.push_back(it->second);
   }
+  if (trace) trace_stage(trace, STAGE_DICTIONARY, time);
   if (feature_ids.empty()) return;
 
   std::vector<DocumentId> candidates;
-  inv_.lookup(feature_ids, candidates);
+  if (trace) trace->query_features += feature_ids.size();
+  // skipped features are not looked up, but still scored
+  std::vector<FeatureId> lookup_ids(feature_ids);
+  skip_frequent_features(lookup_ids, trace);
+  SearchPlan plan = choose_plan(lookup_ids);
+  if (plan == PLAN_LOOKUP) {
+    inv_.lookup(lookup_ids, candidates, InvertedIndex::MAX_LOOKUP, trace);
+  }
+  if (trace) {
+    trace_stage(trace, STAGE_LOOKUP, time);
+    trace->plans[plan]++;
+    trace->scored += plan == PLAN_SCAN ? model_->size()
+                                       : model_->num_scored(candidates.size());
+  }
   std::vector<std::pair<DocumentId, Point> > pairs;
-  model_->search_by_feature(feature_ids, candidates, pairs, max);
-  for (size_t i = 0; i < pairs.size(); i++) {
-    DocId2Str::const_iterator it = did2str_.find(pairs[i].first);
-    if (it != did2str_.end()) {
-      results.push_back(
-        std::pair<std::string, Point>(it->second, pairs[i].second));
-    }
+  if (plan == PLAN_SCAN) {
+    model_->search_by_feature(feature_ids, feature_weights, pairs, max);
+  } else {
+    model_->search_by_feature(feature_ids, feature_weights, candidates, pairs,
+                              max);
+  }
+  if (trace) trace_stage(trace, STAGE_SCORING, time);
+  map_document_ids(pairs, results);
+  if (trace) {
+    trace_stage(trace, STAGE_MAPPING, time);
+    trace->results += pairs.size();
+  }
+}
+
+/**
+ * Search related documents from all documents without inverted indexes.
+ */
+void StupaSearch::exhaustive_search_by_document(
+  const std::vector<std::string> &queries,
+  std::vector<std::pair<std::string, Point> > &results, size_t max) const {
+  std::vector<DocumentId> document_ids;
+  for (size_t i = 0; i < queries.size(); i++) {
+    Str2DocId::const_iterator it = str2did_.find(queries[i]);
+    if (it != str2did_.end()) document_ids.push_back(it->second);
+  }
+  if (document_ids.empty()) return;
+  std::vector<std::pair<DocumentId, Point> > pairs;
+  model_->search_by_document(document_ids, pairs, max);
+  map_document_ids(pairs, results);
+}
+
+/**
+ * Get statistics of index.
+ */
+void StupaSearch::statistics(IndexStatistics &stats) const {
+  stats.documents = model_->size();
+  stats.features = inv_.size();
+  stats.deleted_postings = inv_.garbage();
+  stats.df_cutoff = df_cutoff();
+  const SearchModel::DocumentMap &documents = model_->documents();
+  stats.feature_bytes = documents.bytes() - documents.free_bytes();
+  stats.feature_free_bytes = documents.free_bytes();
+  const InvertedIndex::IndexHash &index = inv_.index();
+  for (InvertedIndex::IndexHash::const_iterator it = index.begin();
+       it != index.end(); ++it) {
+    if (!it->second) continue;
+    stats.posting_bytes += it->second->bytes();
+    stats.posting_length.add(it->second->size());
+  }
+  const PostingCache &cache = inv_.cache();
+  stats.posting_cache_max_bytes = cache.max_bytes();
+  stats.posting_cache_bytes = cache.bytes();
+  stats.posting_cache_hits = cache.hits();
+  stats.posting_cache_misses = cache.misses();
+  stats.posting_cache_evictions = cache.evictions();
+  // approximate: contents of entries without overhead of hash tables
+  for (DocId2Str::const_iterator it = did2str_.begin();
+       it != did2str_.end(); ++it) {
+    stats.dictionary_bytes += sizeof(*it) + it->second.size();
+  }
+  for (Str2DocId::const_iterator it = str2did_.begin();
+       it != str2did_.end(); ++it) {
+    stats.dictionary_bytes += sizeof(*it) + it->first.size();
+  }
+  for (Str2FeatureId::const_iterator it = str2fid_.begin();
+       it != str2fid_.end(); ++it) {
+    stats.dictionary_bytes += sizeof(*it) + it->first.size();
   }
 }
 
@@ -186,7 +680,10 @@ void StupaSearch::search_by_feature(
  * Save status (search model object, inverted indexes, ..) to a file.
  */
 void StupaSearch::save(std::ofstream &ofs) const {
-  ofs.write((const char *)&current_feature_id_, sizeof(current_feature_id_));
+  // the first field tells the size of identifiers
+  uint64_t header = current_feature_id_;
+  if (sizeof(Identifier) == sizeof(uint32_t)) header |= ID32_FORMAT;
+  ofs.write((const char *)&header, sizeof(header));
   ofs.write((const char *)&current_document_id_, sizeof(current_document_id_));
   ofs.write((const char *)&oldest_document_id_, sizeof(oldest_document_id_));
   model_->save(ofs);
@@ -222,6 +719,13 @@ void StupaSearch::save(std::ofstream &ofs) const {
     ofs.write((const char *)&it->first[0], sizeof(it->first[0]) * ssize);
     ofs.write((const char *)&it->second, sizeof(it->second));
   }
+
+  size = order_.size();
+  ofs.write((const char *)&size, sizeof(size));
+  for (DocumentId did = oldest_document_id_; did != DOC_EMPTY_ID;
+       did = order_.find(did)->second.next) {
+    ofs.write((const char *)&did, sizeof(did));
+  }
 }
 
 /**
@@ -229,7 +733,16 @@ void StupaSearch::save(std::ofstream &ofs) const {
  */
 void StupaSearch::load(std::ifstream &ifs) {
   clear();
-  ifs.read((char *)&current_feature_id_, sizeof(current_feature_id_));
+  uint64_t header;
+  ifs.read((char *)&header, sizeof(header));
+  bool id32 = (header & ID32_FORMAT) != 0;
+  if (id32 != (sizeof(Identifier) == sizeof(uint32_t))) {
+    fprintf(stderr, "[ERROR]Cannot load a file of %d-bit identifiers\n",
+            id32 ? 32 : 64);
+    ifs.setstate(std::ios::failbit);
+    return;
+  }
+  current_feature_id_ = static_cast<FeatureId>(header & ~ID32_FORMAT);
   ifs.read((char *)&current_document_id_, sizeof(current_document_id_));
   ifs.read((char *)&oldest_document_id_, sizeof(oldest_document_id_));
   model_->load(ifs);
@@ -272,9 +785,30 @@ void StupaSearch::load(std::ifstream &ifs) {
     str2did_[str] = did;
   }
 
-  while (max_documents_ && model_->size() > max_documents_) {
-    delete_oldest_document();
+  oldest_document_id_ = DOC_EMPTY_ID;
+  if (ifs.read((char *)&size, sizeof(size))) {
+    for (size_t i = 0; i < size; i++) {
+      DocumentId did;
+      ifs.read((char *)&did, sizeof(did));
+      push_order(did);
+    }
+  } else {
+    // files saved without insertion order: order documents by id
+    ifs.clear();
+    std::vector<DocumentId> ids;
+    for (DocId2Str::const_iterator it = did2str_.begin();
+         it != did2str_.end(); ++it) {
+      ids.push_back(it->first);
+    }
+    std::sort(ids.begin(), ids.end());
+    for (size_t i = 0; i < ids.size(); i++) push_order(ids[i]);
+  }
+
+  if (max_documents_ && model_->size() > max_documents_) {
+    delete_oldest_documents(model_->size() - max_documents_);
   }
+  if (minhash_) index_minhash();
+  retune_df_cutoff();
 }
 
 /**
@@ -27,6 +27,8 @@
 #include "identifier.h"
 #include "search_model.h"
 #include "inverted_index.h"
+#include "minhash.h"
+#include "metrics.h"
 #include "util.h"
 
 namespace stupa {
@@ -35,6 +37,20 @@ namespace stupa {
  * Stupa Search class
  */
 class StupaSearch {
+ public:
+  /** Orders of documents to reassign their identifiers */
+  enum ReassignOrder {
+    REASSIGN_BY_ID,          ///< ids in the order of insertion
+    REASSIGN_BY_SIMILARITY,  ///< documents of similar features get close ids
+  };
+
+  /** Planners to choose the plan of searches */
+  enum Planner {
+    PLANNER_LOOKUP,  ///< always score candidates of inverted indexes
+    PLANNER_SCAN,    ///< always score all documents
+    PLANNER_COST,    ///< choose the plan of lower estimated cost
+  };
+
  private:
   /** Type definition of <document id, string> map */
   typedef HashMap<DocumentId, std::string>::type DocId2Str;
@@ -43,6 +59,14 @@ class StupaSearch {
   /** Type definition of <string, feature id> map */
   typedef HashMap<std::string, FeatureId>::type Str2FeatureId;
 
+  /** Links of a document in the list of documents in insertion order */
+  struct OrderLink {
+    DocumentId prev;  ///< previous (older) document (DOC_EMPTY_ID: none)
+    DocumentId next;  ///< next (newer) document (DOC_EMPTY_ID: none)
+  };
+  /** Type definition of <document id, links> map */
+  typedef HashMap<DocumentId, OrderLink>::type OrderMap;
+
   /** maximum number of search results */
   static const size_t MAX_RESULT      = 20;
   /** maximum size of inverted index */
@@ -50,27 +74,120 @@ class StupaSearch {
 
   SearchModel *model_;              ///< search model
   InvertedIndex inv_;               ///< inverted index
-  FeatureId current_feature_id_;    ///< current(highest) feature id
-  DocumentId current_document_id_;  ///< current(highest) document id
+  MinHashIndex *minhash_;           ///< MinHash index (NULL: not used)
+  FeatureId current_feature_id_;    ///< next feature id
+  DocumentId current_document_id_;  ///< next document id
+  FeatureId max_feature_id_;        ///< largest feature id to be assigned
+  DocumentId max_document_id_;      ///< largest document id to be assigned
+  std::vector<FeatureId> free_feature_ids_;  ///< feature ids to be reused
   DocumentId oldest_document_id_;   ///< oldest document id
+  DocumentId newest_document_id_;   ///< newest document id
+  OrderMap order_;                  ///< documents in insertion order
   DocId2Str did2str_;               ///< mapping from document id to string
   Str2DocId str2did_;               ///< mapping from string to document id
   Str2FeatureId str2fid_;           ///< mapping from string to feature id
   size_t max_documents_;            ///< maximum number of documents
+  double max_df_ratio_;             ///< ratio of documents to skip features
+  double skip_postings_;            ///< ratio of postings of skipped features
+  size_t tuned_df_cutoff_;          ///< cutoff tuned by skip_postings_
+  size_t tuned_size_;               ///< documents when the cutoff was tuned
+  Planner planner_;                 ///< planner of searches
+  bool similar_ids_;                ///< ids are ordered by similarity and
+                                    ///< no document is added or deleted
 
   /**
-   * Look up inverted index.
+   * Look up inverted index unless the planner chooses to scan all
+   * documents.
    * @param queries list of document ids of input queries
    * @paran results list of document ids of output candidates
+   * @param trace output trace of the search (NULL: not traced)
+   * @return plan of the search
    */
-  void lookup_inverted_index_by_document(
+  SearchPlan lookup_inverted_index_by_document(
     const std::vector<DocumentId> &queries,
-    std::vector<DocumentId> &results) const;
+    std::vector<DocumentId> &results, SearchTrace *trace = NULL) const;
+
+  /**
+   * Choose the plan of a search.
+   * The cost is counted in features visited: looking up reads postings
+   * of the features and scores the candidates, and scanning scores all
+   * documents by threads at once.  Candidates are estimated by
+   * the frequencies of the features, assuming that they are independent.
+   * @param feature_ids feature ids to be looked up
+   * @return plan of the search
+   */
+  SearchPlan choose_plan(const std::vector<FeatureId> &feature_ids) const;
+
+  /**
+   * Add all documents to MinHash index.
+   */
+  void index_minhash();
+
+  /**
+   * Remove features of high document frequency from a query.
+   * The feature of the lowest frequency is kept if all are removed.
+   * @param feature_ids feature ids of a query
+   * @param trace output trace of the search (NULL: not traced)
+   */
+  void skip_frequent_features(std::vector<FeatureId> &feature_ids,
+                              SearchTrace *trace) const;
 
   /**
-   * Delete the oldest document.
+   * Tune the cutoff of document frequency again if the number of
+   * documents has changed by more than 10% since the last tuning.
    */
-  void delete_oldest_document();
+  void retune_df_cutoff();
+
+  /**
+   * Map document ids of search results to identifier strings.
+   * @param pairs list of the pairs of document id and points
+   * @param results list of the pairs of document-identifier string and points
+   */
+  void map_document_ids(
+    const std::vector<std::pair<DocumentId, Point> > &pairs,
+    std::vector<std::pair<std::string, Point> > &results) const;
+
+  /**
+   * Record elapsed time of a search stage and restart the clock.
+   * @param trace trace of a search
+   * @param stage finished stage
+   * @param time start time of the stage, set to current time
+   */
+  static void trace_stage(SearchTrace *trace, SearchStage stage,
+                          uint64_t &time) {
+    uint64_t now = get_time_nsec();
+    trace->stage_time[stage] += now - time;
+    time = now;
+  }
+
+  /**
+   * Get a new document id.  After the largest id has been assigned,
+   * deleted ids are purged from posting lists, and documents are given
+   * ids from the start in insertion order (see reassign_document_ids),
+   * so that the ids after them are reused.
+   * @return document id (DOC_EMPTY_ID: no id is left)
+   */
+  DocumentId new_document_id();
+
+  /**
+   * Get a new feature id.  After the largest id has been assigned,
+   * ids of features which no document has are reused.
+   * @param pending feature ids of a document being added (not reused)
+   * @return feature id (FEATURE_EMPTY_ID: no id is left)
+   */
+  FeatureId new_feature_id(const std::vector<FeatureId> &pending);
+
+  /**
+   * Append a document to the end of the insertion order.
+   * @param id document id
+   */
+  void push_order(DocumentId id);
+
+  /**
+   * Remove a document from the insertion order.
+   * @param id document id
+   */
+  void remove_order(DocumentId id);
 
  public:
   /**
@@ -78,35 +195,47 @@ class StupaSearch {
    * @param type type of search model
    * @param invsize maximum size of inverted indexes
    * @param max_doc maximum number of documents
+   * @param retention retention policy of inverted indexes
    */
   StupaSearch(SearchModel::Type type = SearchModel::INNER_PRODUCT,
-              size_t invsize = MAX_INVERT_SIZE, size_t max_doc = 0)
-    : inv_(invsize),
+              size_t invsize = MAX_INVERT_SIZE, size_t max_doc = 0,
+              InvertedIndex::RetentionPolicy retention
+                = InvertedIndex::RETAIN_RECENT)
+    : inv_(invsize, retention), minhash_(NULL),
       current_feature_id_(FEATURE_START_ID),
       current_document_id_(DOC_START_ID),
-      oldest_document_id_(DOC_START_ID),
-      max_documents_(max_doc) {
+      max_feature_id_(FEATURE_MAX_ID), max_document_id_(DOC_MAX_ID),
+      oldest_document_id_(DOC_EMPTY_ID),
+      newest_document_id_(DOC_EMPTY_ID),
+      max_documents_(max_doc), max_df_ratio_(0.0), skip_postings_(0.0),
+      tuned_df_cutoff_(0), tuned_size_(0), planner_(PLANNER_LOOKUP),
+      similar_ids_(false) {
     if (type == SearchModel::INNER_PRODUCT) {
       model_ = new SearchModelInnerProduct();
     } else if (type == SearchModel::COSINE) {
       model_ = new SearchModelCosine();
+    } else if (type == SearchModel::COSINE_FLOAT) {
+      model_ = new SearchModelCosineFloat();
+    } else if (type == SearchModel::COSINE_QUANTIZED) {
+      model_ = new SearchModelCosineQuantized();
+    } else if (type == SearchModel::COSINE_QUANTIZED8) {
+      model_ = new SearchModelCosineQuantized8();
+    } else if (type == SearchModel::TF_IDF) {
+      model_ = new SearchModelTfIdf();
+    } else if (type == SearchModel::BM25) {
+      model_ = new SearchModelBM25();
     } else {
       model_ = new SearchModelCosine();
     }
-    init_hash_map(DOC_EMPTY_ID, did2str_);
-    init_hash_map("", str2did_);
-    init_hash_map("", str2fid_);
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-    did2str_.set_deleted_key(DOC_DELETED_ID);
-    str2did_.set_deleted_key(DELIMITER);
-    str2fid_.set_deleted_key(DELIMITER);
-#endif
   }
 
   /**
    * Destructor.
    */
-  ~StupaSearch() { delete model_; }
+  ~StupaSearch() {
+    delete model_;
+    if (minhash_) delete minhash_;
+  }
 
   /**
    * Get the number of stored documents.
@@ -116,11 +245,31 @@ class StupaSearch {
 
   /**
    * Add a document to search model object and inverted indexes.
+   * Features of "feature:weight" have weights if the search model keeps
+   * weights (SearchModel::TF_IDF, SearchModel::BM25).
    * @param document_id identifier string of a document
    * @param features feature strings of a document
+   * @param quality quality score of a document (0.0-1.0, used by
+   *                InvertedIndex::RETAIN_QUALITY)
    */
   void add_document(const std::string& document_id,
-                    const std::vector<std::string> &features);
+                    const std::vector<std::string> &features,
+                    double quality = 0.0);
+
+  /**
+   * Add a document of weighted features to search model object and
+   * inverted indexes.
+   * @param document_id identifier string of a document
+   * @param features feature strings of a document
+   * @param weights weights of each feature (empty: all 1, ignored if the
+   *                search model does not keep weights)
+   * @param quality quality score of a document (0.0-1.0, used by
+   *                InvertedIndex::RETAIN_QUALITY)
+   */
+  void add_document(const std::string& document_id,
+                    const std::vector<std::string> &features,
+                    const std::vector<Point> &weights,
+                    double quality = 0.0);
 
   /**
    * Delete a document from search model object and inverted indexes.
@@ -128,6 +277,145 @@ class StupaSearch {
    */
   void delete_document(const std::string& document_id);
 
+  /**
+   * Delete the oldest documents at once.
+   * Documents are ordered by the time when they were added or updated.
+   * @param num the number of documents to be deleted
+   */
+  void delete_oldest_documents(size_t num);
+
+  /**
+   * Purge deleted documents from posting lists.
+   * @param max_lists maximum number of posting lists to be compacted
+   *                  (0: all lists over the threshold)
+   * @return the number of compacted posting lists
+   */
+  size_t compact(size_t max_lists = 0) { return inv_.compact(max_lists); }
+
+  /**
+   * Reassign identifiers to documents from the start without gaps of
+   * deleted documents, which makes differences in posting lists smaller.
+   * Forward index, posting lists and mappings of identifier strings are
+   * rewritten, and deleted documents are purged from posting lists.
+   * Identifiers by similarity would break the order of ids which posting
+   * lists of maximum size of RETAIN_RECENT assume to be the order of
+   * insertion, so that ids in insertion order are assigned for such lists.
+   * @param order order of documents
+   * @return true if identifiers are reassigned (false: already in order)
+   */
+  bool reassign_document_ids(ReassignOrder order = REASSIGN_BY_ID);
+
+  /**
+   * Set the largest identifiers to be assigned to documents and features
+   * (default: the maximum of the type of identifiers).  Identifiers are
+   * never reused until the largest one has been assigned, and reused ids
+   * look older than they are to posting lists of RETAIN_RECENT.
+   * @param max_document_id largest document id
+   * @param max_feature_id largest feature id
+   */
+  void set_max_id(DocumentId max_document_id, FeatureId max_feature_id) {
+    max_document_id_ = max_document_id;
+    max_feature_id_ = max_feature_id;
+  }
+
+  /**
+   * Set the ratio of deleted documents to compact a posting list.
+   * @param ratio ratio of deleted documents in a posting list
+   */
+  void set_compaction_ratio(double ratio) {
+    inv_.set_compaction_ratio(ratio);
+  }
+
+  /**
+   * Set the number of documents to be read in each posting list
+   * (see InvertedIndex::set_lookup_depth).
+   * @param depth the number of documents (0: all documents)
+   */
+  void set_lookup_depth(size_t depth) { inv_.set_lookup_depth(depth); }
+
+  /**
+   * Set the size of high-impact tier of long posting lists
+   * (see InvertedIndex::set_tier_size).
+   * @param size the number of high-impact documents (0: no tiers)
+   */
+  void set_tier_size(size_t size) { inv_.set_tier_size(size); }
+
+  /**
+   * Set the memory budget of the cache of decoded posting lists
+   * (see InvertedIndex::set_cache_size).
+   * @param bytes memory budget (0: no cache)
+   */
+  void set_posting_cache(size_t bytes) { inv_.set_cache_size(bytes); }
+
+  /**
+   * Set the planner of searches.  Scanning all documents finds exact
+   * results, and is chosen by PLANNER_COST for queries whose features
+   * are so frequent that most documents are candidates.  Searches by
+   * MinHash index are not planned.
+   * @param planner planner
+   * @param threads the number of threads to scan all documents
+   *                (see SearchModel::set_scan_threads)
+   */
+  void set_planner(Planner planner, size_t threads = 1) {
+    planner_ = planner;
+    model_->set_scan_threads(threads);
+  }
+
+  /**
+   * Generate candidates of search_by_document by MinHash index instead of
+   * inverted indexes (see MinHashIndex).  The index is built from all
+   * documents and updated by adding and deleting documents.
+   * @param bands the number of bands (0: use inverted indexes)
+   * @param rows the number of rows in a band
+   */
+  void set_minhash(size_t bands, size_t rows = MinHashIndex::DEFAULT_ROWS);
+
+  /**
+   * Score only candidates of the nearest SimHash signatures to the query
+   * (see SearchModel::set_prefilter).
+   * @param bits bits of a signature (64, 128 or 256, 0: not used)
+   * @param max the number of candidates to be scored
+   */
+  void set_prefilter(size_t bits, size_t max) {
+    model_->set_prefilter(bits, max);
+  }
+
+  /**
+   * Store features of documents in Elias-Fano code
+   * (see SearchModel::set_elias_fano).
+   * @param elias_fano true if Elias-Fano code is used
+   */
+  void set_elias_fano(bool elias_fano) { model_->set_elias_fano(elias_fano); }
+
+  /**
+   * Get MinHash index.
+   * @return MinHash index (NULL: not used)
+   */
+  const MinHashIndex *minhash() const { return minhash_; }
+
+  /**
+   * Set the ratio of documents over which a feature is not looked up
+   * in inverted indexes.  Skipped features still count for scoring
+   * of candidates found by the other features.
+   * @param ratio ratio of documents which have a feature (0: off)
+   */
+  void set_max_df(double ratio) { max_df_ratio_ = ratio; }
+
+  /**
+   * Tune the cutoff of document frequency automatically: the most
+   * frequent features are not looked up as long as their postings are
+   * within the ratio of all postings.  The cutoff is tuned again when
+   * the number of documents changes by more than 10%.
+   * @param ratio ratio of postings of skipped features (0: off)
+   */
+  void set_skip_postings(double ratio);
+
+  /**
+   * Get the document frequency over which features are not looked up.
+   * @return document frequency (0: all features are looked up)
+   */
+  size_t df_cutoff() const;
+
   /**
    * Clear documents from search model object and inverted index, mapping,
    * and initialize identifiers of documents and features.
@@ -135,12 +423,19 @@ class StupaSearch {
   void clear() {
     model_->clear();
     inv_.clear();
+    if (minhash_) minhash_->clear();
     did2str_.clear();
     str2did_.clear();
     str2fid_.clear();
+    order_.clear();
     current_feature_id_ = FEATURE_START_ID;
     current_document_id_ = DOC_START_ID;
-    oldest_document_id_ = DOC_START_ID;
+    free_feature_ids_.clear();
+    oldest_document_id_ = DOC_EMPTY_ID;
+    newest_document_id_ = DOC_EMPTY_ID;
+    tuned_df_cutoff_ = 0;
+    tuned_size_ = 0;
+    similar_ids_ = false;
   }
 
   /**
@@ -148,20 +443,44 @@ class StupaSearch {
    * @param queries list of query strings as document identifiers
    * @param results list of the pairs of document-identifier string and points
    * @param max maximum number of output pairs
+   * @param trace output trace of the search (NULL: not traced)
    */
   void search_by_document(const std::vector<std::string> &queries,
                           std::vector<std::pair<std::string, Point> > &results,
-                          size_t max = MAX_RESULT) const;
+                          size_t max = MAX_RESULT,
+                          SearchTrace *trace = NULL) const;
 
   /**
    * Search related documents using queries of feature ids.
+   * Queries of "feature:weight" have weights if the search model keeps
+   * weights.
    * @param queries list of query strings as feature identifiers
    * @param results list of the pairs of document-identifier string and points
    * @param max maximum number of output pairs
+   * @param trace output trace of the search (NULL: not traced)
    */
   void search_by_feature(const std::vector<std::string> &queries,
                          std::vector<std::pair<std::string, Point> > &results,
-                         size_t max = MAX_RESULT) const;
+                         size_t max = MAX_RESULT,
+                         SearchTrace *trace = NULL) const;
+
+  /**
+   * Search related documents from all documents without inverted indexes.
+   * It is slow, and used to measure recall of search_by_document.
+   * @param queries list of query strings as document identifiers
+   * @param results list of the pairs of document-identifier string and points
+   * @param max maximum number of output pairs
+   */
+  void exhaustive_search_by_document(
+    const std::vector<std::string> &queries,
+    std::vector<std::pair<std::string, Point> > &results,
+    size_t max = MAX_RESULT) const;
+
+  /**
+   * Get statistics of index (it scans all documents and posting lists).
+   * @param stats output statistics
+   */
+  void statistics(IndexStatistics &stats) const;
 
   /**
    * Save status (search model object, inverted indexes, ..) to a file.
@@ -17,18 +17,43 @@
 // Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //
 
+#include <pthread.h>
 #include <cmath>
 #include <cassert>
 #include <algorithm>
+#include <numeric>
 #include "search_model.h"
 
 namespace stupa {
 
+const double SearchModelBM25::DEFAULT_K1 = 1.2;
+const double SearchModelBM25::DEFAULT_B  = 0.75;
+const size_t SearchModel::PREFETCH_DISTANCE;
+const size_t SearchModel::SCAN_BLOCK;
+
 /**
  * Deconstructor.
  */
 SearchModel::~SearchModel() { }
 
+/**
+ * Compress features of a document without weights.
+ */
+Feature SearchModel::compress(const std::vector<FeatureId> &feature_ids,
+                              bool elias_fano, size_t &size) {
+  Feature f;
+  if (elias_fano) {
+    std::vector<FeatureId> sorted(feature_ids);
+    std::sort(sorted.begin(), sorted.end());
+    f = compress_elias_fano(sorted);
+    size = f ? sizeof_elias_fano(f) : 0;
+  } else {
+    f = compress_diff(feature_ids);
+    size = f ? sizeof_compressed(f) : 0;
+  }
+  return f;
+}
+
 /**
  * Update count of feature ids.
  */
@@ -36,13 +61,13 @@ void SearchModel::update_feature_count(const std::vector<FeatureId> &features,
                                        int flag) {
   FeatureCount::iterator it;
   for (size_t i = 0; i < features.size(); i++) {
-    int val = flag;
     it = feature_count_.find(features[i]);
-    if (it != feature_count_.end()) val += it->second;
-    if (val > 0) {
-      feature_count_[features[i]] = val;
+    if (it == feature_count_.end()) {
+      if (flag > 0) feature_count_[features[i]] = flag;
+    } else if (it->second + flag > 0) {
+      it->second += flag;
     } else {
-      feature_count_.erase(features[i]);
+      feature_count_.erase(it);
     }
   }
 }
@@ -53,15 +78,15 @@ void SearchModel::update_feature_count(const std::vector<FeatureId> &features,
 void SearchModel::make_query_vector(const std::vector<DocumentId> &queries,
                                     Vector &query_vector) const {
   Vector::iterator vit;
-  DocumentMap::const_iterator dit;
   for (size_t i = 0; i < queries.size(); i++) {
-    dit = documents_.find(queries[i]);
-    if (dit == documents_.end()) continue;
+    const char *feature = documents_.get(queries[i]);
+    if (!feature) continue;
 
     std::vector<FeatureId> feature_ids;
-    decompress_diff(dit->second, feature_ids);
+    std::vector<Point> weights;
+    decompress(feature, feature_ids, &weights);
     for (size_t j = 0; j < feature_ids.size(); j++) {
-      Point val = 1;
+      Point val = weights[j];
       vit = query_vector.find(feature_ids[j]);
       if (vit != query_vector.end()) val += vit->second;
       query_vector[feature_ids[j]] = val;
@@ -69,24 +94,249 @@ void SearchModel::make_query_vector(const std::vector<DocumentId> &queries,
   }
 }
 
+/**
+ * Make a SimHash signature of weighted features.
+ */
+void SearchModel::make_signature(const std::vector<FeatureId> &feature_ids,
+                                 const std::vector<Point> &weights,
+                                 uint64_t *signature) const {
+  std::vector<Point> votes(signature_words_ * 64, 0.0);
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    Point weight = (weights.empty() ? 1.0 : weights[i])
+                   * idf_weight(feature_ids[i]);
+    for (size_t w = 0; w < signature_words_; w++) {
+      uint64_t hash = mix_hash(feature_ids[i] ^ mix_hash(w + 1));
+      for (size_t b = 0; b < 64; b++) {
+        votes[w * 64 + b] += ((hash >> b) & 1) ? weight : -weight;
+      }
+    }
+  }
+  for (size_t w = 0; w < signature_words_; w++) {
+    uint64_t word = 0;
+    for (size_t b = 0; b < 64; b++) {
+      if (votes[w * 64 + b] > 0) word |= 1ULL << b;
+    }
+    signature[w] = word;
+  }
+}
+
+/**
+ * Set the signature of a document.
+ */
+void SearchModel::set_signature(DocumentId id,
+                                const std::vector<FeatureId> &feature_ids) {
+  if (signature_words_ == 0) return;
+  size_t offset = static_cast<size_t>(id) * signature_words_;
+  if (offset + signature_words_ > signatures_.size()) {
+    signatures_.resize(offset + signature_words_, 0);
+  }
+  make_signature(feature_ids, std::vector<Point>(), &signatures_[offset]);
+}
+
+/**
+ * Set the signatures of all documents.
+ */
+void SearchModel::set_signatures() {
+  signatures_.clear();
+  std::vector<FeatureId> feature_ids;
+  for (DocumentMap::const_iterator it = documents_.begin();
+       it != documents_.end(); ++it) {
+    feature_ids.clear();
+    decompress(it->second, feature_ids);
+    set_signature(it->first, feature_ids);
+  }
+}
+
+/**
+ * Score only candidates of the nearest SimHash signatures to the query.
+ */
+void SearchModel::set_prefilter(size_t bits, size_t max) {
+  size_t words = (bits + 63) / 64;
+  prefilter_max_ = max;
+  if (words == signature_words_) return;
+  signature_words_ = words;
+  set_signatures();
+  if (words == 0) std::vector<uint64_t>().swap(signatures_);
+}
+
+/**
+ * Store features of documents in Elias-Fano code.
+ */
+void SearchModel::set_elias_fano(bool elias_fano) {
+  if (weighted_ || elias_fano == elias_fano_) return;
+  DocumentMap documents;
+  std::vector<FeatureId> feature_ids;
+  for (DocumentMap::const_iterator it = documents_.begin();
+       it != documents_.end(); ++it) {
+    feature_ids.clear();
+    decompress(it->second, feature_ids);
+    size_t fsiz;
+    Feature f = compress(feature_ids, elias_fano, fsiz);
+    documents.set(it->first, f, fsiz);
+    if (f) delete [] f;
+  }
+  documents_.swap(documents);
+  elias_fano_ = elias_fano;
+}
+
+/**
+ * Select candidates of the nearest signatures to the query.
+ */
+void SearchModel::prefilter(const Vector &query_vector,
+                            const std::vector<DocumentId> &candidates,
+                            std::vector<DocumentId> &filtered) const {
+  std::vector<FeatureId> feature_ids;
+  std::vector<Point> weights;
+  for (Vector::const_iterator it = query_vector.begin();
+       it != query_vector.end(); ++it) {
+    feature_ids.push_back(it->first);
+    weights.push_back(it->second);
+  }
+  std::vector<uint64_t> query(signature_words_);
+  make_signature(feature_ids, weights, &query[0]);
+
+  // documents without signatures are the farthest
+  int farthest = static_cast<int>(signature_words_ * 64) + 1;
+  std::vector<std::pair<int, DocumentId> > distances(candidates.size());
+  for (size_t i = 0; i < candidates.size(); i++) {
+    size_t offset = static_cast<size_t>(candidates[i]) * signature_words_;
+    int distance = farthest;
+    if (offset + signature_words_ <= signatures_.size()) {
+      const uint64_t *signature = &signatures_[offset];
+      distance = 0;
+      for (size_t w = 0; w < signature_words_; w++) {
+        distance += popcount64(signature[w] ^ query[w]);
+      }
+    }
+    distances[i] = std::pair<int, DocumentId>(distance, candidates[i]);
+  }
+  std::nth_element(distances.begin(), distances.begin() + prefilter_max_,
+                   distances.end());
+  for (size_t i = 0; i < prefilter_max_; i++) {
+    filtered.push_back(distances[i].second);
+  }
+}
+
+/**
+ * Search related documents in a range.
+ */
+void *SearchModel::scan_range(void *arg) {
+  ScanRange *range = reinterpret_cast<ScanRange *>(arg);
+  const ForwardIndex &documents = range->model->documents_;
+  std::vector<DocumentId> candidates;
+  candidates.reserve(static_cast<size_t>(range->end - range->begin));
+  for (DocumentId id = range->begin; id < range->end; id++) {
+    if (documents.get(id)) candidates.push_back(id);
+  }
+  range->model->search(range->query_vector, candidates, range->results,
+                       range->max);
+  return NULL;
+}
+
+/**
+ * Search related documents from all documents.
+ */
+void SearchModel::scan(Vector &query_vector,
+                       std::vector<std::pair<DocumentId, Point> > &results,
+                       size_t max) const {
+  DocumentId first = documents_.first_id();
+  size_t num = static_cast<size_t>(documents_.end_id() - first);
+  size_t threads = std::min(scan_threads_, num / SCAN_BLOCK);
+  if (threads < 1) threads = 1;
+  std::vector<ScanRange> ranges(threads);
+  for (size_t i = 0; i < threads; i++) {
+    ranges[i].model = this;
+    ranges[i].query_vector = query_vector;
+    ranges[i].begin = static_cast<DocumentId>(first + num * i / threads);
+    ranges[i].end = static_cast<DocumentId>(first + num * (i + 1) / threads);
+    ranges[i].max = max;
+  }
+  // the first range is scanned by the calling thread
+  std::vector<pthread_t> tids(threads);
+  std::vector<bool> started(threads, false);
+  for (size_t i = 1; i < threads; i++) {
+    started[i] = pthread_create(&tids[i], NULL, scan_range, &ranges[i]) == 0;
+  }
+  scan_range(&ranges[0]);
+  std::vector<std::pair<DocumentId, Point> > pairs;
+  for (size_t i = 0; i < threads; i++) {
+    if (i > 0) {
+      if (started[i]) {
+        pthread_join(tids[i], NULL);
+      } else {
+        scan_range(&ranges[i]);
+      }
+    }
+    pairs.insert(pairs.end(), ranges[i].results.begin(),
+                 ranges[i].results.end());
+  }
+  select_top(pairs, results, max);
+}
+
+/**
+ * Search related documents from candidates after prefilter.
+ */
+void SearchModel::search_candidates(
+  Vector &query_vector, const std::vector<DocumentId> &candidates,
+  std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
+  std::vector<DocumentId> scored;
+  if (num_scored(candidates.size()) == candidates.size()) {
+    scored = candidates;
+  } else {
+    prefilter(query_vector, candidates, scored);
+  }
+  // features of documents are stored in the order of ids
+  std::sort(scored.begin(), scored.end());
+  search(query_vector, scored, results, max);
+}
+
 /**
  * Add a document.
  */
 void SearchModel::add_document(DocumentId id,
                                const std::vector<FeatureId> &feature) {
+  add_document(id, feature, std::vector<Point>());
+}
+
+/**
+ * Add a document of weighted features.
+ */
+void SearchModel::add_document(DocumentId id,
+                               const std::vector<FeatureId> &feature,
+                               const std::vector<Point> &weights) {
   assert(id != DOC_EMPTY_ID);
   assert(id != DOC_DELETED_ID);
 
-  DocumentMap::iterator it = documents_.find(id);
+  DocumentMap::const_iterator it = documents_.find(id);
+  std::vector<FeatureId> old_ids;
+  std::vector<Point> old_weights;
   if (it != documents_.end()) {
-    std::vector<FeatureId> feature_ids;
-    decompress_diff(it->second, feature_ids);
-    update_feature_count(feature_ids, -1);
-    if (it->second) delete [] it->second;
+    decompress(it->second, old_ids, &old_weights);
+    update_feature_count(old_ids, -1);
+    total_weight_ -= std::accumulate(old_weights.begin(), old_weights.end(),
+                                     0.0);
+  }
+  std::vector<FeatureId> feature_ids(feature);
+  std::vector<Point> feature_weights;
+  Feature f;
+  size_t fsiz;
+  if (weighted_) {
+    feature_weights = weights;
+    merge_weighted(feature_ids, feature_weights);
+    total_weight_ += std::accumulate(feature_weights.begin(),
+                                     feature_weights.end(), 0.0);
+    f = compress_weighted(feature_ids, feature_weights);
+    fsiz = sizeof_weighted(f);
+  } else {
+    total_weight_ += feature_ids.size();
+    f = compress(feature_ids, elias_fano_, fsiz);
   }
-  update_feature_count(feature, 1);
-  Feature f = compress_diff(feature);
-  documents_[id] = f;
+  documents_.set(id, f, fsiz);
+  if (f) delete [] f;
+  update_feature_count(feature_ids, 1);
+  set_signature(id, feature_ids);
+  if (!old_ids.empty()) update_weights(old_ids);
+  if (!feature_ids.empty()) update_weights(feature_ids);
 }
 
 /**
@@ -96,28 +346,46 @@ void SearchModel::delete_document(DocumentId id) {
   assert(id != DOC_EMPTY_ID);
   assert(id != DOC_DELETED_ID);
 
-  DocumentMap::iterator it = documents_.find(id);
+  DocumentMap::const_iterator it = documents_.find(id);
   if (it != documents_.end()) {
     std::vector<FeatureId> feature_ids;
-    decompress_diff(it->second, feature_ids);
+    std::vector<Point> weights;
+    decompress(it->second, feature_ids, &weights);
     update_feature_count(feature_ids, -1);
-    if (it->second) delete [] it->second;
+    total_weight_ -= std::accumulate(weights.begin(), weights.end(), 0.0);
     documents_.erase(id);
+    if (!feature_ids.empty()) update_weights(feature_ids);
   }
 }
 
+/**
+ * Replace the identifiers of documents.
+ */
+void SearchModel::reassign_ids(const DocumentIdMap &ids) {
+  std::vector<std::pair<DocumentId, DocumentId> > pairs;  // <new, old>
+  for (DocumentIdMap::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+    pairs.push_back(std::pair<DocumentId, DocumentId>(it->second, it->first));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  DocumentMap documents;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    DocumentMap::const_iterator it = documents_.find(pairs[i].second);
+    if (it == documents_.end()) continue;
+    documents.set(pairs[i].first, it->second, feature_size(it->second));
+  }
+  documents_.swap(documents);
+  if (signature_words_ > 0) set_signatures();
+}
+
 /**
  * Search related documents using queries of document ids
  */
 void SearchModel::search_by_document(
   const std::vector<DocumentId> &queries,
   std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
-  std::vector<DocumentId> candidates;
-  for (DocumentMap::const_iterator it = documents_.begin();
-       it != documents_.end(); ++it) {
-    candidates.push_back(it->first);
-  }
-  search_by_document(queries, candidates, results, max);
+  Vector query_vector;
+  make_query_vector(queries, query_vector);
+  scan(query_vector, results, max);
 }
 
 /**
@@ -128,9 +396,8 @@ void SearchModel::search_by_document(
   const std::vector<DocumentId> &candidates,
   std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
   Vector query_vector;
-  init_hash_map(FEATURE_EMPTY_ID, query_vector);
   make_query_vector(queries, query_vector);
-  search(query_vector, candidates, results, max);
+  search_candidates(query_vector, candidates, results, max);
 }
 
 /**
@@ -139,12 +406,21 @@ void SearchModel::search_by_document(
 void SearchModel::search_by_feature(
   const std::vector<FeatureId> &feature_ids,
   std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
-  std::vector<DocumentId> candidates;
-  for (DocumentMap::const_iterator it = documents_.begin();
-       it != documents_.end(); ++it) {
-    candidates.push_back(it->first);
+  search_by_feature(feature_ids, std::vector<Point>(), results, max);
+}
+
+/**
+ * Search related documents using queries of weighted feature ids.
+ */
+void SearchModel::search_by_feature(
+  const std::vector<FeatureId> &feature_ids,
+  const std::vector<Point> &weights,
+  std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
+  Vector query_vector;
+  for (size_t i = 0; i < feature_ids.size(); i++) {
+    query_vector[feature_ids[i]] = weights.empty() ? 1.0 : weights[i];
   }
-  search_by_feature(feature_ids, candidates, results, max);
+  scan(query_vector, results, max);
 }
 
 /**
@@ -154,12 +430,23 @@ void SearchModel::search_by_feature(
   const std::vector<FeatureId> &feature_ids,
   const std::vector<DocumentId> &candidates,
   std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
+  search_by_feature(feature_ids, std::vector<Point>(), candidates, results,
+                    max);
+}
+
+/**
+ * Search related documents using queries of weighted feature ids.
+ */
+void SearchModel::search_by_feature(
+  const std::vector<FeatureId> &feature_ids,
+  const std::vector<Point> &weights,
+  const std::vector<DocumentId> &candidates,
+  std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
   Vector query_vector;
-  init_hash_map(FEATURE_EMPTY_ID, query_vector);
   for (size_t i = 0; i < feature_ids.size(); i++) {
-    query_vector[feature_ids[i]] = 1.0;
+    query_vector[feature_ids[i]] = weights.empty() ? 1.0 : weights[i];
   }
-  search(query_vector, candidates, results, max);
+  search_candidates(query_vector, candidates, results, max);
 }
 
 /**
@@ -171,9 +458,16 @@ void SearchModel::save(std::ofstream &ofs) const {
   for (DocumentMap::const_iterator it = documents_.begin();
        it != documents_.end(); ++it) {
     ofs.write((const char *)&it->first, sizeof(it->first));
-    size_t fsiz = sizeof_compressed(it->second);
+    const char *feature = it->second;
+    size_t fsiz = feature_size(feature);
+    if (elias_fano_ && feature) {
+      std::vector<FeatureId> feature_ids;
+      decompress_elias_fano(feature, feature_ids);
+      feature = compress(feature_ids, false, fsiz);
+    }
     ofs.write((const char *)&fsiz, sizeof(fsiz));
-    ofs.write((const char *)it->second, fsiz);
+    ofs.write(feature, fsiz);
+    if (elias_fano_ && feature) delete [] feature;
   }
   size_t fcsiz = feature_count_.size();
   ofs.write((const char *)&fcsiz, sizeof(fcsiz));
@@ -191,14 +485,36 @@ void SearchModel::load(std::ifstream &ifs) {
   clear();
   size_t dsiz;
   ifs.read((char *)&dsiz, sizeof(dsiz));
+  std::vector<char> buffer;
   for (size_t i = 0; i < dsiz; i++) {
     DocumentId did;
     ifs.read((char *)&did, sizeof(did));
     size_t fsiz;
     ifs.read((char *)&fsiz, sizeof(fsiz));
-    Feature feature = new char[fsiz];
-    ifs.read((char *)feature, fsiz);
-    documents_[did] = feature;
+    buffer.resize(fsiz);
+    if (fsiz > 0) ifs.read(&buffer[0], fsiz);
+    const char *feature = fsiz > 0 ? &buffer[0] : NULL;
+    if (!feature) {
+      documents_.set(did, feature, fsiz);
+      continue;
+    }
+    if (weighted_) {
+      std::vector<FeatureId> feature_ids;
+      std::vector<Point> weights;
+      decompress_weighted(feature, feature_ids, &weights);
+      total_weight_ += std::accumulate(weights.begin(), weights.end(), 0.0);
+      documents_.set(did, feature, fsiz);
+    } else if (elias_fano_) {
+      std::vector<FeatureId> feature_ids;
+      decompress_diff(feature, feature_ids);
+      total_weight_ += feature_ids.size();
+      Feature f = compress(feature_ids, true, fsiz);
+      documents_.set(did, f, fsiz);
+      delete [] f;
+    } else {
+      total_weight_ += count_compressed(feature);
+      documents_.set(did, feature, fsiz);
+    }
   }
   size_t fcsiz;
   ifs.read((char *)&fcsiz, sizeof(fcsiz));
@@ -209,6 +525,52 @@ void SearchModel::load(std::ifstream &ifs) {
     ifs.read((char *)&count, sizeof(count));
     feature_count_[fid] = count;
   }
+  if (signature_words_ > 0) set_signatures();
+  update_weights(std::vector<FeatureId>());
+}
+
+/**
+ * Search related documents by BM25.
+ */
+void SearchModelBM25::search(
+  Vector &query_vector, const std::vector<DocumentId> &candidates,
+  std::vector<std::pair<DocumentId, Point> > &results, size_t max) const {
+  // IDF of BM25 is applied to the query once
+  Point ndocs = static_cast<Point>(documents_.size());
+  FeatureCount::const_iterator fit;
+  for (Vector::iterator vit = query_vector.begin();
+       vit != query_vector.end(); ++vit) {
+    fit = feature_count_.find(vit->first);
+    Point df = (fit == feature_count_.end()) ? 0.0 : fit->second;
+    vit->second *= log((ndocs - df + 0.5) / (df + 0.5) + 1.0);
+  }
+
+  Point avgdl = average_length();
+  std::vector<FeatureId> feature_ids;
+  std::vector<Point> frequencies;
+  std::vector<std::pair<DocumentId, Point> > pairs;
+  Vector::const_iterator vit;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const char *feature = candidate_feature(candidates, i);
+    if (!feature) continue;
+    feature_ids.clear();
+    frequencies.clear();
+    decompress(feature, feature_ids, &frequencies);
+    Point length = std::accumulate(frequencies.begin(), frequencies.end(),
+                                   0.0);
+    Point norm = k1_ * (1.0 - b_ + (avgdl > 0.0 ? b_ * length / avgdl : 0.0));
+    Point score = 0.0;
+    for (size_t j = 0; j < feature_ids.size(); j++) {
+      vit = query_vector.find(feature_ids[j]);
+      if (vit == query_vector.end()) continue;
+      Point tf = frequencies[j];
+      score += vit->second * tf * (k1_ + 1.0) / (tf + norm);
+    }
+    if (score != 0) {
+      pairs.push_back(std::pair<DocumentId, Point>(candidates[i], score));
+    }
+  }
+  select_top(pairs, results, max);
 }
 
 } /* namespace stupa */
@@ -21,10 +21,14 @@
 #define STUPA_SEARCH_MODEL_H_
 
 #include <stdint.h>
+#include <algorithm>
 #include <fstream>
+#include <limits>
 #include <utility>
 #include <vector>
 #include "config.h"
+#include "elias_fano.h"
+#include "forward_index.h"
 #include "identifier.h"
 #include "util.h"
 
@@ -36,7 +40,7 @@ namespace stupa {
 class SearchModel {
  public:
   /** type definition of <document id, compressed feature> map */
-  typedef HashMap<DocumentId, Feature>::type DocumentMap;
+  typedef ForwardIndex DocumentMap;
   /** type definition of <feature id, count of feature id> map */
   typedef HashMap<FeatureId, int>::type FeatureCount;
   /** type definition of the vector of a document */
@@ -45,11 +49,61 @@ class SearchModel {
   enum Type {
     INNER_PRODUCT,
     COSINE,
+    COSINE_FLOAT,
+    COSINE_QUANTIZED,
+    COSINE_QUANTIZED8,
+    TF_IDF,
+    BM25,
   };
 
+  /** Number of candidates whose features are prefetched ahead of scoring */
+  static const size_t PREFETCH_DISTANCE = 8;
+  /** Minimum number of documents scanned by a thread */
+  static const size_t SCAN_BLOCK = 4096;
+
  protected:
   DocumentMap documents_;       ///< Documents
   FeatureCount feature_count_;  ///< Count of the features of input documents
+  std::vector<uint64_t> signatures_;  ///< SimHash signatures (by document id)
+  size_t signature_words_;      ///< 64-bit words of a signature (0: not used)
+  size_t prefilter_max_;        ///< candidates to be scored after prefilter
+  bool weighted_;               ///< features of documents have weights
+  bool elias_fano_;             ///< features are stored in Elias-Fano code
+  Point total_weight_;          ///< sum of weights of features of documents
+  size_t scan_threads_;         ///< threads to scan all documents
+
+  /**
+   * Decompress features of a document.
+   * @param feature compressed features
+   * @param feature_ids output feature ids
+   * @param weights output weights of each feature (optional, all 1 if
+   *                documents have no weights)
+   */
+  void decompress(const char *feature, std::vector<FeatureId> &feature_ids,
+                  std::vector<Point> *weights = NULL) const {
+    if (!feature) return;
+    if (weighted_) {
+      decompress_weighted(feature, feature_ids, weights);
+    } else if (elias_fano_) {
+      decompress_elias_fano(feature, feature_ids);
+      if (weights) weights->assign(feature_ids.size(), 1.0);
+    } else {
+      decompress_diff(feature, feature_ids);
+      if (weights) weights->assign(feature_ids.size(), 1.0);
+    }
+  }
+
+  /**
+   * Get size of compressed features of a document.
+   * @param feature compressed features
+   * @return size of compressed features
+   */
+  size_t feature_size(const char *feature) const {
+    if (!feature) return 0;
+    if (weighted_) return sizeof_weighted(feature);
+    return elias_fano_ ? sizeof_elias_fano(feature)
+                       : sizeof_compressed(feature);
+  }
 
   /**
    * Apply IDF(inverse document frequency) weighting.
@@ -67,6 +121,17 @@ class SearchModel {
     }
   }
 
+  /**
+   * Get IDF weight of a feature.
+   * @param feature_id feature id
+   * @return IDF weight (1: unknown feature)
+   */
+  Point idf_weight(FeatureId feature_id) const {
+    FeatureCount::const_iterator fit = feature_count_.find(feature_id);
+    if (fit == feature_count_.end() || fit->second <= 0) return 1.0;
+    return log(documents_.size() / fit->second) + 1;
+  }
+
   /**
    * Get norm value.
    * @param vec input vector
@@ -93,6 +158,41 @@ class SearchModel {
     }
   }
 
+  /**
+   * Get compressed features of a candidate, and prefetch features of the
+   * candidate PREFETCH_DISTANCE ahead into caches.
+   * @param candidates candidates in the order of scoring
+   * @param i index of the candidate to be scored
+   * @return compressed features (NULL: not stored or no features)
+   */
+  const char *candidate_feature(const std::vector<DocumentId> &candidates,
+                                size_t i) const {
+    if (i + PREFETCH_DISTANCE < candidates.size()) {
+      documents_.prefetch(candidates[i + PREFETCH_DISTANCE]);
+    }
+    return documents_.get(candidates[i]);
+  }
+
+  /**
+   * Append documents of the highest scores to results.
+   * @param pairs scored documents (reordered)
+   * @param results output documents
+   * @param max the maximum number of output documents
+   */
+  static void select_top(std::vector<std::pair<DocumentId, Point> > &pairs,
+                         std::vector<std::pair<DocumentId, Point> > &results,
+                         size_t max) {
+    if (pairs.size() <= max) {
+      std::sort(pairs.begin(), pairs.end(),
+                greater_pair<DocumentId, Point>);
+      std::copy(pairs.begin(), pairs.end(), back_inserter(results));
+    } else {
+      std::partial_sort(pairs.begin(), pairs.begin() + max, pairs.end(),
+                        greater_pair<DocumentId, Point>);
+      std::copy(pairs.begin(), pairs.begin() + max, back_inserter(results));
+    }
+  }
+
   /**
    * Calculate inner product value between input vectors.
    * @param vec1 input vector
@@ -123,6 +223,13 @@ class SearchModel {
   }
 
  private:
+  /**
+   * Update precomputed weights after counts of features are changed
+   * (for models which keep weights of features).
+   * @param features features of changed counts (empty: all features)
+   */
+  virtual void update_weights(const std::vector<FeatureId> &features) { }
+
   /**
    * Search related documents.
    * @param query_vector the vector created from input queries
@@ -135,6 +242,16 @@ class SearchModel {
                       std::vector<std::pair<DocumentId, Point> > &results,
                       size_t max) const = 0;
 
+  /**
+   * Compress features of a document without weights.
+   * @param feature_ids feature ids
+   * @param elias_fano true if features are sorted in Elias-Fano code
+   * @param size output size of compressed features
+   * @return compressed features (NULL: no features), must be deleted later
+   */
+  static Feature compress(const std::vector<FeatureId> &feature_ids,
+                          bool elias_fano, size_t &size);
+
   /**
    * Update count of feature ids.
    * @param features list of features to be updated
@@ -150,18 +267,86 @@ class SearchModel {
   void make_query_vector(const std::vector<DocumentId> &queries,
                          Vector &query_vector) const;
 
+  /**
+   * Make a SimHash signature of features weighted by IDF.
+   * @param feature_ids feature ids
+   * @param weights weights of each feature before IDF (empty: all 1)
+   * @param signature output signature of signature_words_ words
+   */
+  void make_signature(const std::vector<FeatureId> &feature_ids,
+                      const std::vector<Point> &weights,
+                      uint64_t *signature) const;
+
+  /**
+   * Set the signature of a document.
+   * @param id the identifier of a document
+   * @param feature_ids feature ids of a document
+   */
+  void set_signature(DocumentId id, const std::vector<FeatureId> &feature_ids);
+
+  /**
+   * Set the signatures of all documents.
+   */
+  void set_signatures();
+
+  /**
+   * Select candidates of the nearest signatures (in Hamming distance)
+   * to the query.
+   * @param query_vector the vector created from input queries
+   * @param candidates the candidates of output documents
+   * @param filtered output prefilter_max_ candidates
+   */
+  void prefilter(const Vector &query_vector,
+                 const std::vector<DocumentId> &candidates,
+                 std::vector<DocumentId> &filtered) const;
+
+  /** Range of documents scanned by a thread */
+  struct ScanRange {
+    const SearchModel *model;  ///< search model
+    Vector query_vector;       ///< query vector (weighted by each thread)
+    DocumentId begin;          ///< the first document id
+    DocumentId end;            ///< the document id past the range
+    size_t max;                ///< maximum number of output documents
+    std::vector<std::pair<DocumentId, Point> > results;  ///< output
+  };
+
+  /**
+   * Search related documents in a range (thread function).
+   * @param arg range of documents (ScanRange)
+   * @return NULL
+   */
+  static void *scan_range(void *arg);
+
+  /**
+   * Search related documents from all documents.  Documents are split
+   * into ranges of consecutive ids, which are scanned by threads at once.
+   * @param query_vector the vector created from input queries
+   * @param results output documents
+   * @param max the maximum number of output documents
+   */
+  void scan(Vector &query_vector,
+            std::vector<std::pair<DocumentId, Point> > &results,
+            size_t max) const;
+
+  /**
+   * Search related documents from candidates after prefilter.
+   * @param query_vector the vector created from input queries
+   * @param candidates the candidates of output documents
+   * @param results output documents
+   * @param max the maximum number of output documents
+   */
+  void search_candidates(Vector &query_vector,
+                         const std::vector<DocumentId> &candidates,
+                         std::vector<std::pair<DocumentId, Point> > &results,
+                         size_t max) const;
+
  public:
   /**
    * Constructor.
    */
-  SearchModel() {
-    init_hash_map(DOC_EMPTY_ID, documents_);
-    init_hash_map(FEATURE_EMPTY_ID, feature_count_);
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-    documents_.set_deleted_key(DOC_DELETED_ID);
-    feature_count_.set_deleted_key(FEATURE_DELETED_ID);
-#endif
-  }
+  SearchModel()
+    : signature_words_(0), prefilter_max_(0), weighted_(false),
+      elias_fano_(false), total_weight_(0.0), scan_threads_(1) { }
 
   /**
    * Destructor.
@@ -172,12 +357,10 @@ class SearchModel {
    * Clear documents.
    */
   void clear() {
-    for (DocumentMap::iterator it = documents_.begin();
-         it != documents_.end(); ++it) {
-      if (it->second) delete [] it->second;
-    }
     documents_.clear();
     feature_count_.clear();
+    signatures_.clear();
+    total_weight_ = 0.0;
   }
 
   /**
@@ -198,15 +381,88 @@ class SearchModel {
    */
   const FeatureCount &feature_count() const { return feature_count_; }
 
+  /**
+   * Check whether features of documents have weights.
+   * @return true if features have weights (frequencies)
+   */
+  bool weighted() const { return weighted_; }
+
+  /**
+   * Get the average length (sum of weights of features) of documents.
+   * @return average length of documents
+   */
+  Point average_length() const {
+    return documents_.empty() ? 0.0 : total_weight_ / documents_.size();
+  }
+
+  /**
+   * Score only candidates of the nearest SimHash signatures to the query.
+   * Signatures of bits are kept in an array indexed by document ids.
+   * Searches from all documents are not filtered.
+   * @param bits bits of a signature (64, 128 or 256, 0: not used)
+   * @param max the number of candidates to be scored
+   */
+  void set_prefilter(size_t bits, size_t max);
+
+  /**
+   * Store features of documents without weights in Elias-Fano code instead
+   * of Variable Byte code.  Features of each document are sorted, and the
+   * inner product method looks up the query features in them without
+   * decoding whole lists.  Stored documents are converted, and files are
+   * always written in Variable Byte code.
+   * @param elias_fano true if Elias-Fano code is used
+   */
+  void set_elias_fano(bool elias_fano);
+
+  /**
+   * Check whether features are stored in Elias-Fano code.
+   * @return true if Elias-Fano code is used
+   */
+  bool elias_fano() const { return elias_fano_; }
+
+  /**
+   * Set the number of threads to search from all documents.
+   * Each thread scans SCAN_BLOCK documents or more.
+   * @param threads the number of threads (1: scan in the calling thread)
+   */
+  void set_scan_threads(size_t threads) {
+    scan_threads_ = threads > 0 ? threads : 1;
+  }
+
+  /**
+   * Get the number of threads to search from all documents.
+   * @return the number of threads
+   */
+  size_t scan_threads() const { return scan_threads_; }
+
+  /**
+   * Get the number of candidates to be scored.
+   * @param num the number of candidates
+   * @return the number of candidates after prefilter
+   */
+  size_t num_scored(size_t num) const {
+    return (signature_words_ > 0 && prefilter_max_ > 0 && num > prefilter_max_)
+      ? prefilter_max_ : num;
+  }
+
   /**
    * Get the feature ids of target document.
    * @param id the identifier of target document
    * @param feature_ids output feature ids
    */
   void feature(DocumentId id, std::vector<FeatureId> &feature_ids) const {
-    DocumentMap::const_iterator it = documents_.find(id);
-    if (it == documents_.end()) return;
-    decompress_diff(it->second, feature_ids);
+    decompress(documents_.get(id), feature_ids);
+  }
+
+  /**
+   * Get the feature ids and their weights of target document.
+   * @param id the identifier of target document
+   * @param feature_ids output feature ids
+   * @param weights output weights of each feature
+   */
+  void feature(DocumentId id, std::vector<FeatureId> &feature_ids,
+               std::vector<Point> &weights) const {
+    decompress(documents_.get(id), feature_ids, &weights);
   }
 
   /**
@@ -216,12 +472,30 @@ class SearchModel {
    */
   void add_document(DocumentId id, const std::vector<FeatureId> &feature);
 
+  /**
+   * Add a document of weighted features.
+   * Duplicated features are merged into their weights (frequencies).
+   * Weights are ignored by models without weights.
+   * @param id the identifier of input document
+   * @param feature feature ids of input document
+   * @param weights weights of each feature (empty: all 1)
+   */
+  void add_document(DocumentId id, const std::vector<FeatureId> &feature,
+                    const std::vector<Point> &weights);
+
   /**
    * Delete a document.
    * @param id the identifier of target document
    */
   void delete_document(DocumentId id);
 
+  /**
+   * Replace the identifiers of documents.
+   * Features are stored again in the order of new identifiers.
+   * @param ids map of old identifiers to new ones (others are deleted)
+   */
+  void reassign_ids(const DocumentIdMap &ids);
+
   /**
    * Search related documents from all documents using queries of document ids.
    * @param queries the list of document ids
@@ -254,6 +528,19 @@ class SearchModel {
                          std::vector<std::pair<DocumentId, Point> > &results,
                          size_t max) const;
 
+  /**
+   * Search related documents from all documents using queries of weighted
+   * feature ids.
+   * @param feature_ids the list of feature ids
+   * @param weights weights of each feature id (empty: all 1)
+   * @param results output document ids
+   * @param max maximum number of output document ids
+   */
+  void search_by_feature(const std::vector<FeatureId> &feature_ids,
+                         const std::vector<Point> &weights,
+                         std::vector<std::pair<DocumentId, Point> > &results,
+                         size_t max) const;
+
   /**
    * Search related documents from candidates using queries of feature ids.
    * @param feature_ids the list of feature ids
@@ -266,6 +553,21 @@ class SearchModel {
                          std::vector<std::pair<DocumentId, Point> > &results,
                          size_t max) const;
 
+  /**
+   * Search related documents from candidates using queries of weighted
+   * feature ids.
+   * @param feature_ids the list of feature ids
+   * @param weights weights of each feature id (empty: all 1)
+   * @param candidates the candidates of output documents
+   * @param results output document ids
+   * @param max maximum number of output document ids
+   */
+  void search_by_feature(const std::vector<FeatureId> &feature_ids,
+                         const std::vector<Point> &weights,
+                         const std::vector<DocumentId> &candidates,
+                         std::vector<std::pair<DocumentId, Point> > &results,
+                         size_t max) const;
+
   /**
    * Save documents to a file.
    * @param ofs output stream object
@@ -281,7 +583,8 @@ class SearchModel {
   static void print_vector(const Vector &vec) {
     for (Vector::const_iterator it = vec.begin(); it != vec.end(); ++it) {
       if (it != vec.begin()) printf("\t");
-      printf("%ld:%.4f", it->first, it->second);
+      printf("%llu:%.4f", static_cast<unsigned long long>(it->first),
+             it->second);
     }
     printf("\n");
   }
@@ -289,10 +592,125 @@ class SearchModel {
 
 
 /**
- * Search model using IDF weighting and inner product method
+ * Score of inner product method: the sum of the squared weights of the
+ * query features in a document.
+ */
+class InnerProductScore {
+ private:
+  Point score_;  ///< score
+
+ public:
+  /** Normalize the query vector */
+  static const bool NORMALIZE_QUERY = false;
+  /** Weight features of a document by IDF */
+  static const bool DOCUMENT_WEIGHT = false;
+
+  InnerProductScore() : score_(0.0) { }
+
+  /**
+   * Add a feature of a document.
+   * @param weight IDF weight of the feature
+   */
+  void add_document(Point weight) { }
+
+  /**
+   * Add a feature of a document in the query.
+   * @param weight IDF weight of the feature
+   * @param query weight of the feature in the query
+   */
+  void add_query(Point weight, Point query) { score_ += query * query; }
+
+  /**
+   * Get the score.
+   * @return score (0: not related)
+   */
+  Point score() const { return score_; }
+};
+
+/**
+ * Score of cosine similarity method.
+ */
+class CosineScore {
+ private:
+  Point score_;  ///< inner product with the query
+  Point norm_;   ///< squared norm of a document
+
+ public:
+  /** Normalize the query vector */
+  static const bool NORMALIZE_QUERY = true;
+  /** Weight features of a document by IDF */
+  static const bool DOCUMENT_WEIGHT = true;
+
+  CosineScore() : score_(0.0), norm_(0.0) { }
+
+  /**
+   * Add a feature of a document.
+   * @param weight IDF weight of the feature
+   */
+  void add_document(Point weight) { norm_ += weight * weight; }
+
+  /**
+   * Add a feature of a document in the query.
+   * @param weight IDF weight of the feature
+   * @param query weight of the feature in the query
+   */
+  void add_query(Point weight, Point query) { score_ += weight * query; }
+
+  /**
+   * Get the score.
+   * @return score (0: not related)
+   */
+  Point score() const {
+    return (norm_ != 0 && score_ != 0) ? score_ / sqrt(norm_) : 0.0;
+  }
+};
+
+/**
+ * Search model using IDF weighting and a score policy.
+ * The score of each candidate is accumulated by Score (InnerProductScore or
+ * CosineScore), whose methods are inlined in the loop over features.
  */
-class SearchModelInnerProduct : public SearchModel {
+template <typename Score>
+class BasicSearchModel : public SearchModel {
  private:
+  /**
+   * Search related documents by skipping to the query features in features
+   * of Elias-Fano code (for scores without document weights).
+   * @param query_vector the vector created from input queries
+   * @param candidates the candidates of output documents
+   * @param results output documents
+   * @param max the maximum number of output documents
+   */
+  void search_sorted(const Vector &query_vector,
+                     const std::vector<DocumentId> &candidates,
+                     std::vector<std::pair<DocumentId, Point> > &results,
+                     size_t max) const {
+    std::vector<std::pair<FeatureId, Point> > query(query_vector.begin(),
+                                                    query_vector.end());
+    std::sort(query.begin(), query.end());
+    std::vector<std::pair<DocumentId, Point> > pairs;
+    for (size_t i = 0; i < candidates.size(); i++) {
+      const char *feature = candidate_feature(candidates, i);
+      if (!feature) continue;
+      EliasFanoReader reader(feature);
+      Score score;
+      for (size_t j = 0; j < query.size(); j++) {
+        // features of a document may be duplicated
+        while (reader.next_geq(query[j].first)
+               && reader.value() == query[j].first) {
+          score.add_query(1.0, query[j].second);
+          reader.next();
+        }
+        if (reader.end()) break;
+      }
+      Point value = score.score();
+      if (value != 0) {
+        pairs.push_back(std::pair<DocumentId, Point>(candidates[i], value));
+      }
+    }
+    select_top(pairs, results, max);
+  }
+
   /**
    * Search related documents.
    * @param query_vector the vector created from input queries
@@ -305,45 +723,206 @@ class SearchModelInnerProduct : public SearchModel {
               std::vector<std::pair<DocumentId, Point> > &results,
               size_t max) const {
     idf(query_vector);
+    if (Score::NORMALIZE_QUERY) normalize(query_vector);
+    if (!Score::DOCUMENT_WEIGHT && elias_fano_) {
+      search_sorted(query_vector, candidates, results, max);
+      return;
+    }
+
+    size_t ndocs = documents_.size();
     std::vector<FeatureId> feature_ids;
+    std::vector<Point> weights;
     std::vector<std::pair<DocumentId, Point> > pairs;
-    DocumentMap::const_iterator dit;
     Vector::const_iterator vit;
+    FeatureCount::const_iterator fit;
     for (size_t i = 0; i < candidates.size(); i++) {
-      dit = documents_.find(candidates[i]);
-      if (dit != documents_.end()) {
-        decompress_diff(dit->second, feature_ids);
-        Point score = 0.0;
-        for (size_t j = 0; j < feature_ids.size(); j++) {
-          vit = query_vector.find(feature_ids[j]);
-          if (vit != query_vector.end()) score += vit->second * vit->second;
-        }
-        if (score != 0) {
-          pairs.push_back(std::pair<DocumentId, Point>(dit->first, score));
+      const char *feature = candidate_feature(candidates, i);
+      if (!feature) continue;
+      feature_ids.clear();
+      weights.clear();
+      // frequencies are decoded in the same pass as feature ids
+      decompress(feature, feature_ids, weighted_ ? &weights : NULL);
+      Score score;
+      for (size_t j = 0; j < feature_ids.size(); j++) {
+        Point weight = 1.0;
+        if (Score::DOCUMENT_WEIGHT) {
+          fit = feature_count_.find(feature_ids[j]);
+          if (fit == feature_count_.end() || fit->second <= 0) continue;
+          weight = log(ndocs / fit->second) + 1;
+          if (weighted_) weight *= weights[j];
+          score.add_document(weight);
         }
-        feature_ids.clear();
+        vit = query_vector.find(feature_ids[j]);
+        if (vit != query_vector.end()) score.add_query(weight, vit->second);
+      }
+      Point value = score.score();
+      if (value != 0) {
+        pairs.push_back(std::pair<DocumentId, Point>(candidates[i], value));
       }
     }
-    if (pairs.size() <= max) {
-      std::sort(pairs.begin(), pairs.end(),
-                greater_pair<DocumentId, Point>);
-      std::copy(pairs.begin(), pairs.end(), back_inserter(results));
-    } else {
-      std::partial_sort(pairs.begin(), pairs.begin() + max, pairs.end(),
-                        greater_pair<DocumentId, Point>);
-      std::copy(pairs.begin(), pairs.begin() + max, back_inserter(results));
-    }
+    select_top(pairs, results, max);
   }
 
  public:
-  ~SearchModelInnerProduct() { clear(); }
+  ~BasicSearchModel() { clear(); }
+};
+
+/** Search model using IDF weighting and inner product method */
+typedef BasicSearchModel<InnerProductScore> SearchModelInnerProduct;
+/** Search model using IDF weighting and cosine similarity method */
+typedef BasicSearchModel<CosineScore> SearchModelCosine;
+
+/**
+ * Search model using TF-IDF weighting and cosine similarity method.
+ * Features of documents keep their weights (term frequencies).
+ */
+class SearchModelTfIdf : public BasicSearchModel<CosineScore> {
+ public:
+  SearchModelTfIdf() { weighted_ = true; }
+};
+
+/**
+ * Search model using Okapi BM25.
+ * Features of documents keep their weights (term frequencies).
+ */
+class SearchModelBM25 : public SearchModel {
+ public:
+  /** Default value of parameter k1 (saturation of term frequencies) */
+  static const double DEFAULT_K1;
+  /** Default value of parameter b (normalization by document length) */
+  static const double DEFAULT_B;
+
+ private:
+  Point k1_;  ///< saturation of term frequencies
+  Point b_;   ///< normalization by document length
+
+  /**
+   * Search related documents.
+   * @param query_vector the vector created from input queries
+   * @param candidates the candidates of output documents
+   * @param results output documents
+   * @param max the maximum number of output documents
+   */
+  void search(Vector &query_vector,
+              const std::vector<DocumentId> &candidates,
+              std::vector<std::pair<DocumentId, Point> > &results,
+              size_t max) const;
+
+ public:
+  /**
+   * Constructor.
+   */
+  SearchModelBM25() : k1_(DEFAULT_K1), b_(DEFAULT_B) { weighted_ = true; }
+
+  ~SearchModelBM25() { clear(); }
+
+  /**
+   * Set parameters of BM25.
+   * @param k1 saturation of term frequencies
+   * @param b normalization by document length (0.0-1.0)
+   */
+  void set_parameters(Point k1, Point b) {
+    k1_ = k1;
+    b_ = b;
+  }
+};
+
+/** Maximum IDF weight stored by quantized search models */
+const float MAX_IDF_WEIGHT = 32.0f;
+
+/**
+ * Codec of IDF weights in compact search models.
+ * Weights of unsigned integer types are quantized in [0, MAX_IDF_WEIGHT].
+ */
+template <typename Weight>
+struct WeightCodec {
+  /**
+   * Encode a weight.
+   * @param value weight
+   * @return encoded weight
+   */
+  static Weight encode(float value) {
+    float max = static_cast<float>(std::numeric_limits<Weight>::max());
+    float scaled = value * (max / MAX_IDF_WEIGHT) + 0.5f;
+    if (scaled <= 0.0f) return 0;
+    return scaled >= max ? std::numeric_limits<Weight>::max()
+                         : static_cast<Weight>(scaled);
+  }
+
+  /**
+   * Decode a weight.
+   * @param value encoded weight
+   * @return weight
+   */
+  static float decode(Weight value) {
+    return value * (MAX_IDF_WEIGHT /
+                    static_cast<float>(std::numeric_limits<Weight>::max()));
+  }
+};
+
+/**
+ * Codec of IDF weights of float32.
+ */
+template <>
+struct WeightCodec<float> {
+  static float encode(float value) { return value; }
+  static float decode(float value) { return value; }
 };
 
 /**
- * Search model using IDF weighting and cosine similarity method
+ * Search model using cosine similarity method with compact IDF weights.
+ *
+ * IDF weights are precomputed as Weight (float, uint16_t or uint8_t) in an
+ * array indexed by feature ids, so feature ids should be dense (as given by
+ * StupaSearch).  Weights of changed features are updated by each update,
+ * and all weights are recomputed when the number of documents changes by
+ * more than 1%.  Scores are dot products of gathered float arrays.
  */
-class SearchModelCosine : public SearchModel {
+template <typename Weight>
+class SearchModelCosineCompact : public SearchModel {
  private:
+  std::vector<Weight> weights_;  ///< IDF weights (by feature id)
+  size_t weight_documents_;      ///< the number of documents of IDF weights
+
+  /**
+   * Set the IDF weight of a feature.
+   * @param id feature id
+   * @param count count of the feature
+   */
+  void set_weight(FeatureId id, int count) {
+    if (id >= weights_.size()) {
+      if (count <= 0) return;
+      weights_.resize(static_cast<size_t>(id) + 1, Weight());
+    }
+    weights_[id] = count > 0
+      ? WeightCodec<Weight>::encode(
+          static_cast<float>(log(weight_documents_ / count) + 1))
+      : Weight();
+  }
+
+  /**
+   * Update IDF weights after counts of features are changed.
+   * @param features features of changed counts (empty: all features)
+   */
+  void update_weights(const std::vector<FeatureId> &features) {
+    size_t ndocs = documents_.size();
+    if (features.empty() || ndocs * 100 > weight_documents_ * 101
+        || ndocs * 100 < weight_documents_ * 99) {
+      weight_documents_ = ndocs;
+      std::fill(weights_.begin(), weights_.end(), Weight());
+      for (FeatureCount::const_iterator it = feature_count_.begin();
+           it != feature_count_.end(); ++it) {
+        set_weight(it->first, it->second);
+      }
+      return;
+    }
+    FeatureCount::const_iterator it;
+    for (size_t i = 0; i < features.size(); i++) {
+      it = feature_count_.find(features[i]);
+      set_weight(features[i], it == feature_count_.end() ? 0 : it->second);
+    }
+  }
+
   /**
    * Search related documents.
    * @param query_vector the vector created from input queries
@@ -357,52 +936,71 @@ class SearchModelCosine : public SearchModel {
               size_t max) const {
     idf(query_vector);
     normalize(query_vector);
+    std::vector<std::pair<FeatureId, float> > query(query_vector.begin(),
+                                                    query_vector.end());
+    std::sort(query.begin(), query.end());
+    const float lowest = -std::numeric_limits<float>::max();
 
-    size_t ndocs = documents_.size();
     std::vector<FeatureId> feature_ids;
+    std::vector<float> document_weights;
+    std::vector<float> query_weights;
     std::vector<std::pair<DocumentId, Point> > pairs;
-    DocumentMap::const_iterator dit;
-    Vector::iterator vit;
-    FeatureCount::const_iterator fit;
+    std::vector<std::pair<FeatureId, float> >::const_iterator qit;
     for (size_t i = 0; i < candidates.size(); i++) {
-      dit = documents_.find(candidates[i]);
-      if (dit == documents_.end()) continue;
-      decompress_diff(dit->second, feature_ids);
-      Point score = 0.0;
-      Point norm = 0.0;
-      for (size_t j = 0; j < feature_ids.size(); j++) {
-        fit = feature_count_.find(feature_ids[j]);
-        if (fit != feature_count_.end() && fit->second > 0) {
-          Point val = log(ndocs / fit->second) + 1;
-          norm += val * val;
-          vit = query_vector.find(feature_ids[j]);
-          if (vit != query_vector.end()) {
-            score += val * vit->second;
-          }
+      const char *feature = candidate_feature(candidates, i);
+      if (!feature) continue;
+      feature_ids.clear();
+      decompress(feature, feature_ids);
+      size_t nfeatures = feature_ids.size();
+      if (nfeatures == 0) continue;
+      // gather weights of the document and the query
+      document_weights.resize(nfeatures);
+      query_weights.assign(nfeatures, 0.0f);
+      for (size_t j = 0; j < nfeatures; j++) {
+        FeatureId fid = feature_ids[j];
+        document_weights[j] = fid < weights_.size()
+          ? WeightCodec<Weight>::decode(weights_[fid]) : 0.0f;
+        qit = std::lower_bound(query.begin(), query.end(),
+                               std::pair<FeatureId, float>(fid, lowest));
+        if (qit != query.end() && qit->first == fid) {
+          query_weights[j] = qit->second;
         }
       }
+      float norm = dot_product(&document_weights[0], &document_weights[0],
+                               nfeatures);
+      float score = dot_product(&document_weights[0], &query_weights[0],
+                                nfeatures);
       if (norm != 0 && score != 0) {
-        score /= sqrt(norm);
-        pairs.push_back(std::pair<DocumentId, Point>(dit->first, score));
+        pairs.push_back(std::pair<DocumentId, Point>(
+                          candidates[i], score / sqrt(norm)));
       }
-      feature_ids.clear();
     }
 
-    if (pairs.size() <= max) {
-      std::sort(pairs.begin(), pairs.end(),
-                greater_pair<DocumentId, Point>);
-      std::copy(pairs.begin(), pairs.end(), back_inserter(results));
-    } else {
-      std::partial_sort(pairs.begin(), pairs.begin() + max, pairs.end(),
-                        greater_pair<DocumentId, Point>);
-      std::copy(pairs.begin(), pairs.begin() + max, back_inserter(results));
-    }
+    select_top(pairs, results, max);
   }
 
  public:
-  ~SearchModelCosine() { clear(); }
+  /**
+   * Constructor.
+   */
+  SearchModelCosineCompact() : weight_documents_(0) { }
+
+  ~SearchModelCosineCompact() { clear(); }
+
+  /**
+   * Get the number of bytes of IDF weights.
+   * @return the number of bytes
+   */
+  size_t weight_bytes() const { return weights_.size() * sizeof(Weight); }
 };
 
+/** Search model of cosine similarity with IDF weights of float32 */
+typedef SearchModelCosineCompact<float> SearchModelCosineFloat;
+/** Search model of cosine similarity with IDF weights of 16-bit integers */
+typedef SearchModelCosineCompact<uint16_t> SearchModelCosineQuantized;
+/** Search model of cosine similarity with IDF weights of 8-bit integers */
+typedef SearchModelCosineCompact<uint8_t> SearchModelCosineQuantized8;
+
 } /* namespace stupa */
 
 #endif  // STUPA_SEARCH_MODEL_H_
@@ -18,6 +18,7 @@
 //
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include "search.h"
@@ -117,6 +118,263 @@ TEST(StupaSearchTest, AddDocumentLimitTest) {
   }
 }
 
+/* add_document, delete_document, delete_oldest_documents */
+TEST(StupaSearchTest, InsertionOrderTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  std::vector<std::string> ids;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    ids.push_back(it->first);
+  }
+  size_t max_doc = 10;
+  stupa::StupaSearch stpsearch(stupa::SearchModel::INNER_PRODUCT,
+                               100, max_doc);
+  for (size_t i = 0; i < max_doc; i++) {
+    stpsearch.add_document(ids[i], documents[ids[i]]);
+  }
+  // re-added document becomes the newest, deleted one leaves no gap
+  stpsearch.add_document(ids[0], documents[ids[0]]);
+  stpsearch.delete_document(ids[1]);
+  stpsearch.add_document(ids[max_doc], documents[ids[max_doc]]);
+  stpsearch.add_document(ids[max_doc + 1], documents[ids[max_doc + 1]]);
+  EXPECT_EQ(max_doc, stpsearch.size());
+
+  std::vector<std::string> queries(1);
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  for (size_t i = 0; i < max_doc + 2; i++) {
+    queries[0] = ids[i];
+    results.clear();
+    stpsearch.search_by_document(queries, results);
+    if (i == 1 || i == 2) {
+      EXPECT_EQ(0, results.size());
+    } else {
+      EXPECT_LT(0, results.size());
+    }
+  }
+
+  // insertion order is kept by save and load
+  std::ofstream ofs(SAVE_FILE);
+  stpsearch.save(ofs);
+  ofs.close();
+  stupa::StupaSearch stpsearch_lim(stupa::SearchModel::INNER_PRODUCT,
+                                   100, 2);
+  std::ifstream ifs(SAVE_FILE);
+  stpsearch_lim.load(ifs);
+  ifs.close();
+  EXPECT_EQ(2, stpsearch_lim.size());
+  for (size_t i = 0; i < max_doc + 2; i++) {
+    queries[0] = ids[i];
+    results.clear();
+    stpsearch_lim.search_by_document(queries, results);
+    if (i == max_doc || i == max_doc + 1) {
+      EXPECT_LT(0, results.size());
+    } else {
+      EXPECT_EQ(0, results.size());
+    }
+  }
+
+  stpsearch_lim.delete_oldest_documents(5);
+  EXPECT_EQ(0, stpsearch_lim.size());
+  remove(SAVE_FILE);
+}
+
+/* delete_document, compact */
+TEST(StupaSearchTest, CompactTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  stupa::StupaSearch stpsearch;
+  stpsearch.set_compaction_ratio(0);
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    stpsearch.add_document(it->first, it->second);
+  }
+  // update the first document with the features of the second one
+  TestSet::iterator first = documents.begin();
+  TestSet::iterator second = first;
+  ++second;
+  stpsearch.add_document(first->first, second->second);
+  stpsearch.delete_document(second->first);
+  EXPECT_EQ(documents.size() - 1, stpsearch.size());
+
+  stupa::IndexStatistics stats;
+  stpsearch.statistics(stats);
+  EXPECT_EQ(2 * NUM_FEATURE, stats.deleted_postings);
+
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_feature(second->second, results, NUM_DOC);
+  ASSERT_LT(0, results.size());
+  EXPECT_EQ(first->first, results[0].first);
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_NE(second->first, results[i].first);
+  }
+
+  EXPECT_LT(0, stpsearch.compact());
+  stats = stupa::IndexStatistics();
+  stpsearch.statistics(stats);
+  EXPECT_EQ(0, stats.deleted_postings);
+  std::vector<std::pair<std::string, stupa::Point> > compacted;
+  stpsearch.search_by_feature(second->second, compacted, NUM_DOC);
+  EXPECT_TRUE(results == compacted);
+}
+
+/* recycling identifiers */
+TEST(StupaSearchTest, RecycleIdTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  // ids for half of documents and their features (and ones being added)
+  stupa::StupaSearch stpsearch(stupa::SearchModel::COSINE, 100, NUM_DOC / 2);
+  stpsearch.set_max_id(
+    stupa::DOC_START_ID + NUM_DOC / 2 - 1,
+    stupa::FEATURE_START_ID + (NUM_DOC / 2 + 1) * NUM_FEATURE - 1);
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    stpsearch.add_document(it->first, it->second);
+  }
+  EXPECT_EQ(NUM_DOC / 2, stpsearch.size());
+
+  // documents of recycled ids are found by their features
+  size_t count = 0;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    std::vector<std::pair<std::string, stupa::Point> > results;
+    stpsearch.search_by_feature(it->second, results, 1);
+    if (count++ < NUM_DOC / 2) {
+      if (!results.empty()) {
+        EXPECT_NE(it->first, results[0].first);
+      }
+    } else {
+      ASSERT_EQ(1, results.size());
+      EXPECT_EQ(it->first, results[0].first);
+    }
+  }
+
+  // no id is left until a document is deleted
+  stupa::StupaSearch full;
+  full.set_max_id(stupa::DOC_START_ID + 1, stupa::FEATURE_MAX_ID);
+  TestSet::iterator it = documents.begin();
+  for (size_t i = 0; i < 3; i++, ++it) full.add_document(it->first, it->second);
+  EXPECT_EQ(2, full.size());
+  full.delete_document(documents.begin()->first);
+  --it;
+  full.add_document(it->first, it->second);
+  EXPECT_EQ(2, full.size());
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  full.search_by_feature(it->second, results, 1);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(it->first, results[0].first);
+
+  // posting lists of recent documents keep the newest after recycling
+  const char *ids[] = {"a", "b", "c", "d", "e", "f", "g", "h", "i"};
+  stupa::StupaSearch recent(stupa::SearchModel::INNER_PRODUCT, 2, 0);
+  recent.set_max_id(8, 1000);
+  std::vector<std::string> common(1, "common");
+  for (size_t i = 0; i < 4; i++) recent.add_document(ids[i], common);
+  recent.delete_document("a");
+  recent.delete_document("b");
+  for (size_t i = 4; i < 9; i++) recent.add_document(ids[i], common);
+  EXPECT_EQ(7, recent.size());
+  results.clear();
+  recent.search_by_feature(common, results, 10);
+  ASSERT_EQ(2, results.size());
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ("h", results[0].first);
+  EXPECT_EQ("i", results[1].first);
+}
+
+/* reassign_document_ids */
+TEST(StupaSearchTest, ReassignDocumentIdsTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  stupa::StupaSearch stpsearch(stupa::SearchModel::COSINE, 0);
+  std::vector<std::string> queries;
+  size_t count = 0;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    stpsearch.add_document(it->first, it->second);
+    if (count % 3 == 0) queries.push_back(it->first);
+    if (count++ % 3 == 1) stpsearch.delete_document(it->first);
+  }
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_document(queries, results, NUM_DOC);
+  ASSERT_LT(0, results.size());
+  stupa::IndexStatistics stats;
+  stpsearch.statistics(stats);
+  EXPECT_LT(0, stats.deleted_postings);
+
+  stupa::StupaSearch::ReassignOrder orders[] = {
+    stupa::StupaSearch::REASSIGN_BY_ID,
+    stupa::StupaSearch::REASSIGN_BY_SIMILARITY
+  };
+  for (size_t i = 0; i < 2; i++) {
+    stpsearch.reassign_document_ids(orders[i]);
+    EXPECT_EQ(documents.size() - NUM_DOC / 3, stpsearch.size());
+    stupa::IndexStatistics reassigned;
+    stpsearch.statistics(reassigned);
+    EXPECT_EQ(0, reassigned.deleted_postings);
+    EXPECT_GE(stats.posting_bytes, reassigned.posting_bytes);
+    std::vector<std::pair<std::string, stupa::Point> > reassigned_results;
+    stpsearch.search_by_document(queries, reassigned_results, NUM_DOC);
+    ASSERT_EQ(results.size(), reassigned_results.size());
+    std::sort(results.begin(), results.end());
+    std::sort(reassigned_results.begin(), reassigned_results.end());
+    for (size_t j = 0; j < results.size(); j++) {
+      EXPECT_EQ(results[j].first, reassigned_results[j].first);
+      EXPECT_DOUBLE_EQ(results[j].second, reassigned_results[j].second);
+    }
+  }
+
+  // ids are not reassigned again without updates
+  EXPECT_FALSE(stpsearch.reassign_document_ids(
+                 stupa::StupaSearch::REASSIGN_BY_SIMILARITY));
+  // ids by similarity are put back in insertion order
+  EXPECT_TRUE(stpsearch.reassign_document_ids(
+                stupa::StupaSearch::REASSIGN_BY_ID));
+  EXPECT_FALSE(stpsearch.reassign_document_ids(
+                 stupa::StupaSearch::REASSIGN_BY_ID));
+
+  // documents are deleted in insertion order after reassignment
+  TestSet::iterator first = documents.begin();
+  stpsearch.delete_oldest_documents(1);
+  EXPECT_EQ(documents.size() - NUM_DOC / 3 - 1, stpsearch.size());
+  results.clear();
+  stpsearch.search_by_feature(first->second, results, 1);
+  if (!results.empty()) {
+    EXPECT_NE(first->first, results[0].first);
+  }
+  stpsearch.add_document(first->first, first->second);
+  results.clear();
+  stpsearch.search_by_feature(first->second, results, 1);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(first->first, results[0].first);
+  EXPECT_TRUE(stpsearch.reassign_document_ids(
+                stupa::StupaSearch::REASSIGN_BY_SIMILARITY));
+}
+
+/* reassign_document_ids with posting lists of recent documents */
+TEST(StupaSearchTest, ReassignRecentTest) {
+  const char *ids[] = {"d0", "d1", "d2", "d3", "d4", "d5", "d6"};
+  stupa::StupaSearch stpsearch(stupa::SearchModel::COSINE, 5);
+  std::vector<std::string> features(2, "common");
+  for (size_t i = 0; i < 5; i++) {
+    features[1] = ids[i];
+    stpsearch.add_document(ids[i], features);
+  }
+  // the order of ids is kept, or old documents would be kept in lists
+  stpsearch.reassign_document_ids(stupa::StupaSearch::REASSIGN_BY_SIMILARITY);
+  for (size_t i = 5; i < 7; i++) {
+    features[1] = ids[i];
+    stpsearch.add_document(ids[i], features);
+  }
+  std::vector<std::string> queries(1, "common");
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_feature(queries, results, 10);
+  ASSERT_EQ(5, results.size());
+  std::vector<std::string> found;
+  for (size_t i = 0; i < results.size(); i++) {
+    found.push_back(results[i].first);
+  }
+  std::sort(found.begin(), found.end());
+  for (size_t i = 0; i < found.size(); i++) {
+    EXPECT_EQ(ids[i + 2], found[i]);
+  }
+}
+
 /* search_by_document */
 TEST(StupaSearchTest, SearchByDocumentTest) {
   TestSet documents;
@@ -159,6 +417,95 @@ TEST(StupaSearchTest, SearchByFeatureTest) {
   }
 }
 
+/* features of "feature:weight" */
+TEST(StupaSearchTest, WeightedFeatureTest) {
+  stupa::StupaSearch stpsearch(stupa::SearchModel::BM25);
+  std::vector<std::string> features;
+  features.push_back("a:3");
+  features.push_back("b");
+  stpsearch.add_document("frequent", features);
+  features.clear();
+  features.push_back("a");
+  features.push_back("a");
+  features.push_back("c");
+  stpsearch.add_document("repeated", features);
+  features.clear();
+  features.push_back("a");
+  features.push_back("d");
+  stpsearch.add_document("once", features);
+
+  std::vector<std::string> queries(1, "a");
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_feature(queries, results);
+  ASSERT_EQ(3, results.size());
+  EXPECT_EQ("frequent", results[0].first);
+  EXPECT_EQ("repeated", results[1].first);
+  EXPECT_EQ("once", results[2].first);
+
+  // weights are kept by saving and loading
+  std::ofstream ofs(SAVE_FILE);
+  stpsearch.save(ofs);
+  ofs.close();
+  stupa::StupaSearch loaded(stupa::SearchModel::BM25);
+  std::ifstream ifs(SAVE_FILE);
+  loaded.load(ifs);
+  ifs.close();
+  remove(SAVE_FILE);
+  std::vector<std::pair<std::string, stupa::Point> > loaded_results;
+  loaded.search_by_feature(queries, loaded_results);
+  EXPECT_TRUE(results == loaded_results);
+
+  // a weight of a query
+  queries[0] = "c:2";
+  results.clear();
+  stpsearch.search_by_feature(queries, results);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ("repeated", results[0].first);
+
+  // weights are names of features of models without weights
+  stupa::StupaSearch unweighted(stupa::SearchModel::COSINE);
+  unweighted.add_document("frequent", std::vector<std::string>(1, "a:3"));
+  queries[0] = "a";
+  results.clear();
+  unweighted.search_by_feature(queries, results);
+  EXPECT_EQ(0, results.size());
+}
+
+/* search with trace, statistics */
+TEST(StupaSearchTest, StatisticsTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  stupa::StupaSearch stpsearch;
+  std::vector<std::string> queries;
+  size_t nfeatures = 0;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    if (queries.empty()) queries.push_back(it->first);
+    stpsearch.add_document(it->first, it->second);
+    nfeatures += it->second.size();
+  }
+
+  stupa::SearchTrace trace;
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_document(queries, results, 20, &trace);
+  EXPECT_LT(0, results.size());
+  EXPECT_LT(0, trace.stage_time[stupa::STAGE_LOOKUP]
+               + trace.stage_time[stupa::STAGE_SCORING]);
+  EXPECT_EQ(documents[queries[0]].size(), trace.query_features);
+  EXPECT_LE(trace.candidates, trace.postings);
+  EXPECT_LE(trace.scored, trace.candidates);
+  EXPECT_EQ(results.size(), trace.results);
+
+  stupa::IndexStatistics stats;
+  stpsearch.statistics(stats);
+  EXPECT_EQ(documents.size(), stats.documents);
+  EXPECT_LT(0, stats.features);
+  EXPECT_EQ(stats.features, stats.posting_length.count());
+  EXPECT_NEAR(nfeatures, stats.posting_length.mean() * stats.features, 0.5);
+  EXPECT_LT(0, stats.feature_bytes);
+  EXPECT_LT(0, stats.posting_bytes);
+  EXPECT_LT(0, stats.dictionary_bytes);
+}
+
 /* save, load */
 TEST(StupaSearchTest, SaveLoadTest) {
   TestSet documents;
@@ -194,6 +541,37 @@ TEST(StupaSearchTest, SaveLoadTest) {
   remove(SAVE_FILE);
 }
 
+/* save, load of the other size of identifiers */
+TEST(StupaSearchTest, SaveLoadIdSizeTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  stupa::StupaSearch stpsearch;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    stpsearch.add_document(it->first, it->second);
+  }
+  std::ofstream ofs(SAVE_FILE);
+  stpsearch.save(ofs);
+  ofs.close();
+
+  // the highest bit of the first field tells 32-bit identifiers
+  std::fstream fs(SAVE_FILE, std::ios::in | std::ios::out | std::ios::binary);
+  uint64_t header;
+  fs.read((char *)&header, sizeof(header));
+  EXPECT_EQ(sizeof(stupa::Identifier) == sizeof(uint32_t), header >> 63);
+  header ^= static_cast<uint64_t>(1) << 63;
+  fs.seekp(0);
+  fs.write((const char *)&header, sizeof(header));
+  fs.close();
+
+  stupa::StupaSearch loaded;
+  std::ifstream ifs(SAVE_FILE);
+  loaded.load(ifs);
+  EXPECT_TRUE(ifs.fail());
+  EXPECT_EQ(0, loaded.size());
+  ifs.close();
+  remove(SAVE_FILE);
+}
+
 /* save, load */
 TEST(StupaSearchTest, SaveLoadLimitTest) {
   TestSet documents;
@@ -242,3 +620,166 @@ int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
 }
+
+/* skip features of high document frequency in lookup */
+TEST(StupaSearchTest, SkipFrequentFeaturesTest) {
+  const char *features[][2] = {
+    {"common", "a"}, {"common", "a"}, {"common", "b"}, {"common", NULL},
+  };
+  const char *ids[] = {"d1", "d2", "d3", "d4"};
+  stupa::StupaSearch stpsearch;
+  for (size_t i = 0; i < 4; i++) {
+    std::vector<std::string> feature;
+    for (size_t j = 0; j < 2 && features[i][j]; j++) {
+      feature.push_back(features[i][j]);
+    }
+    stpsearch.add_document(ids[i], feature);
+  }
+  EXPECT_EQ(0, stpsearch.df_cutoff());
+
+  // 'common' is not looked up, but scored
+  stpsearch.set_max_df(0.5);
+  EXPECT_EQ(2, stpsearch.df_cutoff());
+  std::vector<std::string> queries;
+  queries.push_back("common");
+  queries.push_back("a");
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stupa::SearchTrace trace;
+  stpsearch.search_by_feature(queries, results, 10, &trace);
+  EXPECT_EQ(2, trace.query_features);
+  EXPECT_EQ(1, trace.skipped_features);
+  ASSERT_EQ(2, results.size());
+  EXPECT_EQ(results[0].second, results[1].second);
+
+  // the rarest feature is looked up if all features are frequent
+  queries.clear();
+  queries.push_back("common");
+  results.clear();
+  trace.clear();
+  stpsearch.search_by_feature(queries, results, 10, &trace);
+  EXPECT_EQ(0, trace.skipped_features);
+  EXPECT_EQ(4, results.size());
+
+  // search_by_document finds the top result of exhaustive search
+  queries.clear();
+  queries.push_back("d1");
+  results.clear();
+  std::vector<std::pair<std::string, stupa::Point> > exhaustive;
+  stpsearch.search_by_document(queries, results, 1);
+  stpsearch.exhaustive_search_by_document(queries, exhaustive, 1);
+  ASSERT_EQ(1, exhaustive.size());
+  EXPECT_TRUE(results == exhaustive);
+
+  // automatic cutoff: postings of 'common' (4) are within 60% of 7
+  stpsearch.set_max_df(0);
+  stpsearch.set_skip_postings(0.6);
+  EXPECT_EQ(2, stpsearch.df_cutoff());
+  stupa::IndexStatistics stats;
+  stpsearch.statistics(stats);
+  EXPECT_EQ(2, stats.df_cutoff);
+  stpsearch.set_skip_postings(0.5);
+  EXPECT_EQ(0, stpsearch.df_cutoff());
+}
+
+/* candidates of search_by_document by MinHash index */
+TEST(StupaSearchTest, MinHashTest) {
+  TestSet documents;
+  set_input_documents(documents);
+  stupa::StupaSearch stpsearch;
+  for (TestSet::iterator it = documents.begin(); it != documents.end(); ++it) {
+    stpsearch.add_document(it->first, it->second);
+  }
+  // a near-duplicate of the first document
+  TestSet::iterator first = documents.begin();
+  std::vector<std::string> features(first->second);
+  features.pop_back();
+  stpsearch.add_document("duplicate", features);
+
+  stpsearch.set_minhash(16, 4);
+  ASSERT_TRUE(stpsearch.minhash() != NULL);
+  EXPECT_EQ(documents.size() + 1, stpsearch.minhash()->size());
+  std::vector<std::string> queries(1, first->first);
+  std::vector<std::pair<std::string, stupa::Point> > results;
+  stpsearch.search_by_document(queries, results);
+  // the query document itself and the duplicate come first
+  ASSERT_LT(1, results.size());
+  EXPECT_TRUE(results[0].first == "duplicate"
+              || results[1].first == "duplicate");
+
+  // documents are deleted from MinHash index
+  stpsearch.delete_document("duplicate");
+  EXPECT_EQ(documents.size(), stpsearch.minhash()->size());
+  results.clear();
+  stpsearch.search_by_document(queries, results);
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_NE("duplicate", results[i].first);
+  }
+
+  // MinHash index is built again after loading
+  stpsearch.add_document("duplicate", features);
+  std::ofstream ofs(SAVE_FILE);
+  stpsearch.save(ofs);
+  ofs.close();
+  std::ifstream ifs(SAVE_FILE);
+  stpsearch.load(ifs);
+  ifs.close();
+  remove(SAVE_FILE);
+  EXPECT_EQ(documents.size() + 1, stpsearch.minhash()->size());
+  results.clear();
+  stpsearch.search_by_document(queries, results);
+  ASSERT_LT(1, results.size());
+  EXPECT_TRUE(results[0].first == "duplicate"
+              || results[1].first == "duplicate");
+
+  stpsearch.set_minhash(0);
+  EXPECT_TRUE(stpsearch.minhash() == NULL);
+}
+
+/* plans of search by inverted index and by scan of documents */
+TEST(StupaSearchTest, PlannerTest) {
+  const char *features[][2] = {
+    {"common", "a"}, {"common", "a"}, {"common", "b"}, {"common", NULL},
+  };
+  const char *ids[] = {"d1", "d2", "d3", "d4"};
+  stupa::StupaSearch stpsearch;
+  for (size_t i = 0; i < 4; i++) {
+    std::vector<std::string> feature;
+    for (size_t j = 0; j < 2 && features[i][j]; j++) {
+      feature.push_back(features[i][j]);
+    }
+    stpsearch.add_document(ids[i], feature);
+  }
+
+  // inverted index by default
+  std::vector<std::string> queries(1, "d1");
+  std::vector<std::pair<std::string, stupa::Point> > lookup, scan, exhaustive;
+  stupa::SearchTrace trace;
+  stpsearch.search_by_document(queries, lookup, 10, &trace);
+  EXPECT_EQ(1, trace.plans[stupa::PLAN_LOOKUP]);
+  EXPECT_EQ(0, trace.plans[stupa::PLAN_SCAN]);
+
+  // scan finds the same documents as exhaustive search
+  stpsearch.set_planner(stupa::StupaSearch::PLANNER_SCAN, 2);
+  trace.clear();
+  stpsearch.search_by_document(queries, scan, 10, &trace);
+  stpsearch.exhaustive_search_by_document(queries, exhaustive, 10);
+  EXPECT_EQ(1, trace.plans[stupa::PLAN_SCAN]);
+  EXPECT_EQ(4, trace.scored);
+  EXPECT_TRUE(scan == exhaustive);
+  EXPECT_TRUE(scan == lookup);
+
+  // cost: a feature of all documents is scanned, a rare one is looked up
+  stpsearch.set_planner(stupa::StupaSearch::PLANNER_COST);
+  std::vector<std::string> common(1, "common"), rare(1, "b");
+  scan.clear();
+  trace.clear();
+  stpsearch.search_by_feature(common, scan, 10, &trace);
+  EXPECT_EQ(1, trace.plans[stupa::PLAN_SCAN]);
+  EXPECT_EQ(4, scan.size());
+  lookup.clear();
+  trace.clear();
+  stpsearch.search_by_feature(rare, lookup, 10, &trace);
+  EXPECT_EQ(1, trace.plans[stupa::PLAN_LOOKUP]);
+  ASSERT_EQ(1, lookup.size());
+  EXPECT_EQ("d3", lookup[0].first);
+}
@@ -45,7 +45,7 @@ int main(int argc, char **argv) {
   std::string command(argv[1]);
   if (command == "search") {
     return run_search(argc, argv);
-  } else if (command == "save") {
+  } else if (command == "save" || command == "reassign") {
     return run_save(argc, argv);
   } else {
     usage(argv[0]);
@@ -63,6 +63,7 @@ static void load_file(stupa::StupaSearch &stpsearch,
     printf("Reading input documents (Binary, invsize:ignored) ... ");
     fflush(stdout);
     stpsearch.load(ifs);
+    if (!ifs) std::exit(EXIT_FAILURE);
   } else {
     printf("Reading input documents (Text, invsize:%d) ... ",
            static_cast<int>(invsize));
@@ -81,10 +82,15 @@ static void usage(const char *progname) {
   fprintf(stderr, "Usage:\n");
   fprintf(stderr, " %% %s search [-b][-f] file [invsize]\n", progname);
   fprintf(stderr, " %% %s save [-b] infile outfile [invsize]\n", progname);
+  fprintf(stderr, " %% %s reassign [-b][-s] infile outfile [invsize]\n",
+          progname);
   fprintf(stderr, "    -b        read binary format file\n");
   fprintf(stderr, "    -f        search by feature strings\n");
   fprintf(stderr, "              (default: search by document identifier strings)\n");
-  fprintf(stderr, "    invsize   maximum size of inverted indexes (default:%d)\n",
+  fprintf(stderr, "    -s        reassign ids by similarity of features\n");
+  fprintf(stderr, "              (invsize 0 only, default: insertion order)\n");
+  fprintf(stderr, "    invsize   maximum size of inverted indexes\n");
+  fprintf(stderr, "              (default:%d, 0: no limit)\n",
           static_cast<int>(DEFAULT_INV_SIZE));
   std::exit(EXIT_FAILURE);
 }
@@ -100,7 +106,7 @@ static int run_search(int argc, char **argv) {
   bool is_binary = false;
   bool by_feature = false;
   const char *path = NULL;
-  size_t invsize = 0;
+  const char *size = NULL;
   for (int i = 2; i < argc; i++) {
     if (argv[i][0] == '-') {
       if (!strcmp(argv[i], "-b")) {
@@ -110,14 +116,14 @@ static int run_search(int argc, char **argv) {
       }
     } else if (!path) {
       path = argv[i];
-    } else if (!invsize) {
-      invsize = atoi(argv[i]);
+    } else if (!size) {
+      size = argv[i];
     } else {
       usage(progname);
     }
   }
   if (!path) usage(progname);
-  if (invsize <= 0) invsize = DEFAULT_INV_SIZE;
+  size_t invsize = size ? atoi(size) : DEFAULT_INV_SIZE;
   stupa::StupaSearch stpsearch(stupa::SearchModel::INNER_PRODUCT, invsize);
   load_file(stpsearch, path, is_binary, invsize);
 
@@ -148,25 +154,30 @@ static int run_search(int argc, char **argv) {
 
 /**
  * Save documents and inverted indexes, ... to a file.
+ * The command "reassign" reassigns ids of documents before saving.
  * @param argc the number of arguments
  * @param argv argument strings
  */
 static int run_save(int argc, char **argv) {
   const char *progname = argv[0];
   if (argc < 4) usage(progname);
+  bool reassign = !strcmp(argv[1], "reassign");
   bool is_binary = false;
+  stupa::StupaSearch::ReassignOrder order = stupa::StupaSearch::REASSIGN_BY_ID;
   const char *inpath = NULL;
   const char *outpath = NULL;
-  size_t invsize = 0;
+  const char *size = NULL;
   for (int i = 2; i < argc; i++) {
     if (!strcmp(argv[i], "-b")) {
       is_binary = true;
+    } else if (reassign && !strcmp(argv[i], "-s")) {
+      order = stupa::StupaSearch::REASSIGN_BY_SIMILARITY;
     } else if (!inpath) {
       inpath = argv[i];
     } else if (!outpath) {
       outpath = argv[i];
-    } else if (!invsize) {
-      invsize = atoi(argv[i]);
+    } else if (!size) {
+      size = argv[i];
     } else {
       usage(progname);
     }
@@ -178,9 +189,21 @@ static int run_save(int argc, char **argv) {
     fprintf(stderr, "[ERROR]Cannot open file: %s\n", outpath);
     return EXIT_FAILURE;
   }
-  if (invsize <= 0) invsize = DEFAULT_INV_SIZE;
+  size_t invsize = size ? atoi(size) : DEFAULT_INV_SIZE;
   stupa::StupaSearch stpsearch(stupa::SearchModel::INNER_PRODUCT, invsize);
   load_file(stpsearch, inpath, is_binary, invsize);
+  if (reassign) {
+    printf("Reassigning document ids ... ");
+    fflush(stdout);
+    stupa::IndexStatistics before;
+    stpsearch.statistics(before);
+    stpsearch.reassign_document_ids(order);
+    stupa::IndexStatistics after;
+    stpsearch.statistics(after);
+    printf("posting lists: %llu -> %llu bytes\n",
+           static_cast<unsigned long long>(before.posting_bytes),
+           static_cast<unsigned long long>(after.posting_bytes));
+  }
   printf("Writing data to the output file ... ");
   fflush(stdout);
   stpsearch.save(ofs);
@@ -17,108 +17,548 @@
 // Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //
 
+#include <pthread.h>
+#include <sys/resource.h>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <ctime>
+#include <deque>
+#include <fstream>
 #include <map>
+#include <set>
+#include <string>
 #include <vector>
 #include "stupa.h"
 #include <sstream>
 
+/** Operations of load test */
+enum Operation {
+  OP_SEARCH,
+  OP_ADD,
+  OP_DELETE,
+  NUM_OPERATIONS,
+};
+
+/** names of operations */
+const char *OP_NAMES[NUM_OPERATIONS] = { "search", "add", "delete" };
+
+const size_t MAX_RESULT = 20;   ///< maximum number of search results
+const size_t NUM_LOOP   = 100;  ///< default number of operations of a trial
+const size_t STR_LENGTH = 10;   ///< maximum length of a feature string
+
 /**
  * Load-test setting.
  */
 struct Setting {
-  uint64_t dnum;  ///< the number of documents
-  uint64_t fnum;  ///< the number of features of each document
-  uint64_t qnum;  ///< the number of queries
-  uint64_t isiz;  ///< maximum size of posting list of inverted index
+  uint64_t dnum;   ///< the number of documents
+  uint64_t fnum;   ///< the number of features of each document
+  uint64_t qnum;   ///< the number of queries
+  uint64_t isiz;   ///< maximum size of posting list of inverted index
+  size_t loop;     ///< the number of operations of a trial
+  size_t warmup;   ///< the number of warmup operations (not measured)
+  size_t trial;    ///< the number of trials
+  size_t nthread;  ///< the number of threads
+  size_t mix[NUM_OPERATIONS];  ///< ratio of operations (all zero: phased)
+  bool text;       ///< use identifiers of strings
+  bool json;       ///< output results as JSON
+  bool zipf;       ///< features of strings follow zipf's law
+  double maxdf;    ///< ratio of documents to skip features in lookup
+  double skip;     ///< ratio of postings of skipped features (auto cutoff)
+  size_t recall;   ///< the number of searches to measure recall
+  size_t bands;    ///< the number of bands of MinHash index (0: not used)
+  size_t rows;     ///< the number of rows in a band of MinHash index
+  size_t sigbits;  ///< bits of SimHash signatures (0: not used)
+  size_t scored;   ///< candidates to be scored after SimHash prefilter
+  stupa::SearchModel::Type model;  ///< type of search model
+  const char *path;  ///< path of input tsv file
+
+  Setting() : dnum(0), fnum(0), qnum(0), isiz(0), loop(NUM_LOOP), warmup(0),
+              trial(1), nthread(1), text(false), json(false), zipf(false),
+              maxdf(0.0), skip(0.0), recall(0), bands(0), rows(0),
+              sigbits(0), scored(0),
+              model(stupa::SearchModel::INNER_PRODUCT), path(NULL) {
+    for (int i = 0; i < NUM_OPERATIONS; i++) mix[i] = 0;
+  }
+
+  /**
+   * Check whether operations are mixed.
+   * @return true if mixed
+   */
+  bool is_mixed() const {
+    return mix[OP_SEARCH] + mix[OP_ADD] + mix[OP_DELETE] > 0;
+  }
 
   /**
    * Check setting parameters.
    */
   void check() {
-    if (dnum <= 0 || fnum <= 0 || qnum <= 0 || isiz < 0) {
+    if ((!path && (dnum <= 0 || fnum <= 0)) || qnum <= 0 || isiz < 0) {
       fprintf(stderr, "[ERROR]dnum/fnum/qnum/isiz must be more than zero.\n");
       exit(1);
     }
-    if (dnum < qnum) {
+    if (!path && dnum < qnum) {
       fprintf(stderr, "[ERROR]qnum must be less than dnum.");
       exit(1);
     }
+    if (loop <= 0 || trial <= 0 || nthread <= 0) {
+      fprintf(stderr, "[ERROR]loop/trial/thread must be more than zero.\n");
+      exit(1);
+    }
   }
   /**
    * Set setting parameters.
+   * @param argc the number of positional arguments
+   * @param argv positional arguments
+   * @return false if the number of arguments is wrong
    */
-  void set(char **argv) {
+  bool set(int argc, char **argv) {
     char *ptr;
-    dnum = strtoull(argv[0], &ptr, 10);
-    fnum = strtoull(argv[1], &ptr, 10);
-    qnum = strtoull(argv[2], &ptr, 10);
-    isiz = strtoull(argv[3], &ptr, 10);
+    if (path) {
+      if (argc != 2) return false;
+      qnum = strtoull(argv[0], &ptr, 10);
+      isiz = strtoull(argv[1], &ptr, 10);
+    } else {
+      if (argc != 4) return false;
+      dnum = strtoull(argv[0], &ptr, 10);
+      fnum = strtoull(argv[1], &ptr, 10);
+      qnum = strtoull(argv[2], &ptr, 10);
+      isiz = strtoull(argv[3], &ptr, 10);
+    }
     check();
+    return true;
+  }
+  /**
+   * Set ratio of operations.
+   * @param str ratio string (search:add:delete)
+   */
+  void set_mix(const char *str) {
+    std::vector<std::string> ratios;
+    stupa::split_string(str, ":", ratios);
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      mix[i] = i < static_cast<int>(ratios.size())
+               ? strtoul(ratios[i].c_str(), NULL, 10) : 0;
+    }
+    if (!is_mixed()) {
+      fprintf(stderr, "[ERROR]Invalid ratio of operations: %s\n", str);
+      exit(1);
+    }
+  }
+  /**
+   * Set the size of MinHash index.
+   * @param str size string (bands:rows)
+   */
+  void set_minhash(const char *str) {
+    std::vector<std::string> values;
+    stupa::split_string(str, ":", values);
+    bands = values.empty() ? 0 : strtoul(values[0].c_str(), NULL, 10);
+    rows = values.size() > 1 ? strtoul(values[1].c_str(), NULL, 10)
+                             : stupa::MinHashIndex::DEFAULT_ROWS;
+    if (bands == 0 || rows == 0) {
+      fprintf(stderr, "[ERROR]Invalid size of MinHash index: %s\n", str);
+      exit(1);
+    }
+  }
+  /**
+   * Set SimHash prefilter.
+   * @param str prefilter string (bits:scored)
+   */
+  void set_simhash(const char *str) {
+    std::vector<std::string> values;
+    stupa::split_string(str, ":", values);
+    sigbits = values.empty() ? 0 : strtoul(values[0].c_str(), NULL, 10);
+    scored = values.size() > 1 ? strtoul(values[1].c_str(), NULL, 10) : 0;
+    if (sigbits == 0 || scored == 0) {
+      fprintf(stderr, "[ERROR]Invalid SimHash prefilter: %s\n", str);
+      exit(1);
+    }
+  }
+  /**
+   * Set the type of search model.
+   * @param str name of search model (inner, cosine, float, quantized,
+   *            quantized8, tfidf or bm25)
+   */
+  void set_model(const char *str) {
+    if (!strcmp(str, "inner")) {
+      model = stupa::SearchModel::INNER_PRODUCT;
+    } else if (!strcmp(str, "cosine")) {
+      model = stupa::SearchModel::COSINE;
+    } else if (!strcmp(str, "float")) {
+      model = stupa::SearchModel::COSINE_FLOAT;
+    } else if (!strcmp(str, "quantized")) {
+      model = stupa::SearchModel::COSINE_QUANTIZED;
+    } else if (!strcmp(str, "quantized8")) {
+      model = stupa::SearchModel::COSINE_QUANTIZED8;
+    } else if (!strcmp(str, "tfidf")) {
+      model = stupa::SearchModel::TF_IDF;
+    } else if (!strcmp(str, "bm25")) {
+      model = stupa::SearchModel::BM25;
+    } else {
+      fprintf(stderr, "[ERROR]Invalid search model: %s\n", str);
+      exit(1);
+    }
+  }
+  /**
+   * Get the name of search model.
+   * @return name of search model
+   */
+  const char *model_name() const {
+    switch (model) {
+      case stupa::SearchModel::COSINE:            return "cosine";
+      case stupa::SearchModel::COSINE_FLOAT:      return "float";
+      case stupa::SearchModel::COSINE_QUANTIZED:  return "quantized";
+      case stupa::SearchModel::COSINE_QUANTIZED8: return "quantized8";
+      case stupa::SearchModel::TF_IDF:            return "tfidf";
+      case stupa::SearchModel::BM25:              return "bm25";
+      default:                                    return "inner";
+    }
   }
   /**
    * Show setting parameters.
+   * @param fp output stream
    */
-  void show() {
-    printf("[Load-test Setting]\n");
-    printf(" number of documents                        = %lld\n",
-           static_cast<unsigned long long>(dnum));
-    printf(" number of the features of each document    = %lld\n",
-           static_cast<unsigned long long>(fnum));
-    printf(" number of search queries                   = %lld\n",
-           static_cast<unsigned long long>(qnum));
-    printf(" max size of posting list of inverted index = %lld\n\n",
-           static_cast<unsigned long long>(isiz));
+  void show(FILE *fp) const {
+    fprintf(fp, "[Load-test Setting]\n");
+    if (path) {
+      fprintf(fp, " input file                                 = %s\n", path);
+    }
+    fprintf(fp, " number of documents                        = %lld\n",
+            static_cast<unsigned long long>(dnum));
+    fprintf(fp, " number of the features of each document    = %lld\n",
+            static_cast<unsigned long long>(fnum));
+    fprintf(fp, " number of search queries                   = %lld\n",
+            static_cast<unsigned long long>(qnum));
+    fprintf(fp, " max size of posting list of inverted index = %lld\n",
+            static_cast<unsigned long long>(isiz));
+    fprintf(fp, " operations / warmup / trials / threads     = %d / %d / %d / %d\n",
+            static_cast<int>(loop), static_cast<int>(warmup),
+            static_cast<int>(trial), static_cast<int>(nthread));
+    if (is_mixed()) {
+      fprintf(fp, " ratio of search:add:delete                 = %d:%d:%d\n",
+              static_cast<int>(mix[OP_SEARCH]), static_cast<int>(mix[OP_ADD]),
+              static_cast<int>(mix[OP_DELETE]));
+    }
+    if (maxdf > 0.0) {
+      fprintf(fp, " skip features in documents over            = %.3f\n", maxdf);
+    }
+    if (skip > 0.0) {
+      fprintf(fp, " skip frequent features of postings up to   = %.3f\n", skip);
+    }
+    if (bands > 0) {
+      fprintf(fp, " bands:rows of MinHash index                = %d:%d\n",
+              static_cast<int>(bands), static_cast<int>(rows));
+    }
+    if (sigbits > 0) {
+      fprintf(fp, " bits:scored of SimHash prefilter           = %d:%d\n",
+              static_cast<int>(sigbits), static_cast<int>(scored));
+    }
+    if (model != stupa::SearchModel::INNER_PRODUCT) {
+      fprintf(fp, " search model                               = %s\n",
+              model_name());
+    }
+    fprintf(fp, "\n");
+  }
+  /**
+   * Write setting parameters as JSON.
+   * @param fp output stream
+   */
+  void write_json(FILE *fp) const {
+    fprintf(fp, "  \"setting\": {\"mode\": \"%s\", ",
+            path ? "file" : (text ? "text" : "id"));
+    if (path) fprintf(fp, "\"file\": \"%s\", ", path);
+    fprintf(fp, "\"documents\": %llu, \"features\": %llu, \"queries\": %llu, "
+            "\"invsize\": %llu, \"operations\": %d, \"warmup\": %d, "
+            "\"trials\": %d, \"threads\": %d, \"mix\": [%d, %d, %d], "
+            "\"max_df\": %.3f, \"skip_postings\": %.3f, "
+            "\"minhash\": [%d, %d], \"simhash\": [%d, %d], "
+            "\"model\": \"%s\"},\n",
+            static_cast<unsigned long long>(dnum),
+            static_cast<unsigned long long>(fnum),
+            static_cast<unsigned long long>(qnum),
+            static_cast<unsigned long long>(isiz),
+            static_cast<int>(loop), static_cast<int>(warmup),
+            static_cast<int>(trial), static_cast<int>(nthread),
+            static_cast<int>(mix[OP_SEARCH]), static_cast<int>(mix[OP_ADD]),
+            static_cast<int>(mix[OP_DELETE]), maxdf, skip,
+            static_cast<int>(bands), static_cast<int>(rows),
+            static_cast<int>(sigbits), static_cast<int>(scored),
+            model_name());
   }
 };
 
-const size_t MAX_RESULT = 20;   ///< maximum number of search results
-const size_t NUM_LOOP   = 100;  ///< the number of times searching
-const size_t STR_LENGTH = 10;   ///< maximum length of a feature string
+/**
+ * Result of a trial.
+ */
+struct TrialResult {
+  stupa::Histogram hist[NUM_OPERATIONS];  ///< latency (nsec)
+  double elapsed[NUM_OPERATIONS];         ///< elapsed time (sec)
+
+  TrialResult() {
+    for (int i = 0; i < NUM_OPERATIONS; i++) elapsed[i] = 0.0;
+  }
+
+  /**
+   * Get throughput of an operation.
+   * @param op operation
+   * @return operations per second
+   */
+  double throughput(int op) const {
+    return elapsed[op] > 0 ? hist[op].count() / elapsed[op] : 0.0;
+  }
+};
 
 // function prototypes
 int main(int argc, char **argv);
 static void usage(const char *progname);
 static uint64_t zipf_rand(uint64_t nkinds, uint64_t min);
+static void get_rss(size_t &rss_kb, size_t &peak_kb);
 
 /**
  * Abstract class for load test.
  */
 class LoadTest {
  private:
+  /** Context of a worker thread */
+  struct Worker {
+    LoadTest *test;                         ///< load test
+    int op;                                 ///< operation (-1: mixed)
+    size_t nops;                            ///< the number of operations
+    unsigned int seed;                      ///< seed of random numbers
+    stupa::Histogram hist[NUM_OPERATIONS];  ///< latency (nsec)
+  };
+
+  pthread_rwlock_t lock_;  ///< lock between readers and writers
+
   /**
    * Set data for load test.
    */
   virtual void set_testset() = 0;
   /**
-   * Do searching for some times.
+   * Search related documents once.
+   * @param seed seed of random numbers
+   */
+  virtual void search(unsigned int *seed) = 0;
+  /**
+   * Add a document of the test set.
+   * @return false if no document to be added
+   */
+  virtual bool add() = 0;
+  /**
+   * Delete the oldest document added by add().
+   * @return false if no document to be deleted
    */
-  virtual void search_loop() = 0;
+  virtual bool remove() = 0;
   /**
-   * Do adding a document for some times.
+   * Measure recall of search against exhaustive search.
+   * @param num the number of searches
+   * @param cutoff output document frequency over which features are skipped
+   * @return recall of search results (negative: not supported)
    */
-  virtual void add_loop() = 0;
+  virtual double recall(size_t num, size_t &cutoff) {
+    cutoff = 0;
+    return -1.0;
+  }
+
   /**
-   * Do deleting a document for some times.
+   * Choose an operation according to the ratio.
+   * @param seed seed of random numbers
+   * @return operation
    */
-  virtual void delete_loop() = 0;
+  int choose_operation(unsigned int *seed) const {
+    size_t total = 0;
+    for (int i = 0; i < NUM_OPERATIONS; i++) total += setting_.mix[i];
+    size_t r = static_cast<size_t>(stupa::myrand(seed)) % total;
+    for (int i = 0; i < NUM_OPERATIONS; i++) {
+      if (r < setting_.mix[i]) return i;
+      r -= setting_.mix[i];
+    }
+    return OP_SEARCH;
+  }
+
+  /**
+   * Do operations in a worker thread.
+   * @param worker context of the worker
+   */
+  void work(Worker &worker) {
+    for (size_t i = 0; i < worker.nops; i++) {
+      int op = worker.op >= 0 ? worker.op : choose_operation(&worker.seed);
+      uint64_t start = stupa::get_time_nsec();
+      bool done = true;
+      if (op == OP_SEARCH) {
+        pthread_rwlock_rdlock(&lock_);
+        search(&worker.seed);
+      } else {
+        pthread_rwlock_wrlock(&lock_);
+        done = (op == OP_ADD) ? add() : remove();
+      }
+      pthread_rwlock_unlock(&lock_);
+      if (done) worker.hist[op].add(stupa::get_time_nsec() - start);
+    }
+  }
+
+  /**
+   * Entry point of worker threads.
+   * @param arg context of the worker
+   */
+  static void *run_worker(void *arg) {
+    Worker *worker = reinterpret_cast<Worker *>(arg);
+    worker->test->work(*worker);
+    return NULL;
+  }
+
+  /**
+   * Do operations with threads.
+   * @param op operation (-1: mixed)
+   * @param nops the number of operations
+   * @param nthread the number of threads
+   * @param result output result (NULL: not recorded)
+   */
+  void run(int op, size_t nops, size_t nthread, TrialResult *result) {
+    std::vector<Worker> workers(nthread);
+    std::vector<pthread_t> threads(nthread);
+    for (size_t i = 0; i < nthread; i++) {
+      workers[i].test = this;
+      workers[i].op = op;
+      workers[i].nops = nops / nthread + (i < nops % nthread ? 1 : 0);
+      workers[i].seed = static_cast<unsigned int>(rand());
+    }
+    double start = stupa::get_time();
+    for (size_t i = 0; i < nthread; i++) {
+      pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < nthread; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    double elapsed = stupa::get_time() - start;
+    if (!result) return;
+    for (int j = 0; j < NUM_OPERATIONS; j++) {
+      if (op >= 0 && j != op) continue;
+      result->elapsed[j] = elapsed;
+      for (size_t i = 0; i < nthread; i++) {
+        result->hist[j].merge(workers[i].hist[j]);
+      }
+    }
+  }
+
+  /**
+   * Do a trial.
+   * @param result output result (NULL: warmup)
+   */
+  void trial(TrialResult *result) {
+    size_t nops = result ? setting_.loop : setting_.warmup;
+    if (setting_.is_mixed()) {
+      run(-1, nops, setting_.nthread, result);
+    } else {
+      run(OP_SEARCH, nops, setting_.nthread, result);
+      run(OP_ADD, nops, 1, result);
+      run(OP_DELETE, nops, 1, result);
+    }
+  }
 
   /**
    * Show load-test result.
-   * @param search_time time spent on searching loop
-   * @param add_time time spent on adding time
-   * @param delete_time time spent on deleting time
+   * @param fp output stream
+   * @param results results of trials
+   * @param recall recall of search results (negative: not measured)
+   * @param cutoff document frequency over which features are skipped
+   */
+  void show_result(FILE *fp, const std::vector<TrialResult> &results,
+                   double recall, size_t cutoff) const {
+    fprintf(fp, "[Load-test Result]\n");
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results.size() > 1) fprintf(fp, " Trial %d\n", static_cast<int>(i+1));
+      for (int op = 0; op < NUM_OPERATIONS; op++) {
+        const stupa::Histogram &h = results[i].hist[op];
+        if (h.count() == 0) continue;
+        fprintf(fp, "  %-6s : %10.2f (op/sec)  p50 %.1f  p99 %.1f  p999 %.1f"
+                "  max %.1f (usec)\n", OP_NAMES[op], results[i].throughput(op),
+                h.percentile(50.0) / 1e3, h.percentile(99.0) / 1e3,
+                h.percentile(99.9) / 1e3, h.max() / 1e3);
+      }
+    }
+    size_t rss_kb, peak_kb;
+    get_rss(rss_kb, peak_kb);
+    fprintf(fp, "\n[Memory]\n");
+    fprintf(fp, "  RSS    : %lu KB (peak %lu KB)\n",
+            static_cast<unsigned long>(rss_kb),
+            static_cast<unsigned long>(peak_kb));
+    if (recall >= 0.0) {
+      fprintf(fp, "\n[Recall against exhaustive search]\n");
+      fprintf(fp, "  recall@%d : %.4f  (%d searches, df cutoff %lu)\n",
+              static_cast<int>(MAX_RESULT), recall,
+              static_cast<int>(setting_.recall),
+              static_cast<unsigned long>(cutoff));
+    }
+  }
+
+  /**
+   * Write load-test result as JSON.
+   * @param fp output stream
+   * @param results results of trials
+   * @param recall recall of search results (negative: not measured)
+   * @param cutoff document frequency over which features are skipped
+   */
+  void write_json(FILE *fp, const std::vector<TrialResult> &results,
+                  double recall, size_t cutoff) const {
+    fprintf(fp, "{\n");
+    setting_.write_json(fp);
+    size_t rss_kb, peak_kb;
+    get_rss(rss_kb, peak_kb);
+    fprintf(fp, "  \"memory\": {\"rss_kb\": %lu, \"peak_rss_kb\": %lu},\n",
+            static_cast<unsigned long>(rss_kb),
+            static_cast<unsigned long>(peak_kb));
+    if (recall >= 0.0) {
+      fprintf(fp, "  \"recall\": {\"searches\": %d, \"at\": %d, "
+              "\"recall\": %.4f, \"df_cutoff\": %lu},\n",
+              static_cast<int>(setting_.recall), static_cast<int>(MAX_RESULT),
+              recall, static_cast<unsigned long>(cutoff));
+    }
+    fprintf(fp, "  \"trials\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+      fprintf(fp, "    {");
+      bool first = true;
+      for (int op = 0; op < NUM_OPERATIONS; op++) {
+        if (results[i].hist[op].count() == 0) continue;
+        fprintf(fp, "%s\"%s\": ", first ? "" : ", ", OP_NAMES[op]);
+        write_json_stats(fp, results[i].hist[op], results[i].throughput(op));
+        first = false;
+      }
+      fprintf(fp, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ],\n");
+    fprintf(fp, "  \"summary\": {");
+    bool first = true;
+    for (int op = 0; op < NUM_OPERATIONS; op++) {
+      stupa::Histogram total;
+      double qps = 0.0;
+      for (size_t i = 0; i < results.size(); i++) {
+        total.merge(results[i].hist[op]);
+        qps += results[i].throughput(op);
+      }
+      if (total.count() == 0) continue;
+      fprintf(fp, "%s\"%s\": ", first ? "" : ", ", OP_NAMES[op]);
+      write_json_stats(fp, total, qps / results.size());
+      first = false;
+    }
+    fprintf(fp, "}\n}\n");
+  }
+
+  /**
+   * Write statistics of an operation as JSON.
+   * @param fp output stream
+   * @param h histogram of latency (nsec)
+   * @param throughput operations per second
    */
-  void show_result(double search_time, double add_time,
-                   double delete_time) const {
-    printf("[Load-test Result]\n");
-    printf(" Search : %.2f (qry/sec)\n", NUM_LOOP / search_time);
-    printf(" Add    : %.2f (add/sec)\n", NUM_LOOP / add_time);
-    printf(" Delete : %.2f (del/sec)\n", NUM_LOOP / delete_time);
+  static void write_json_stats(FILE *fp, const stupa::Histogram &h,
+                               double throughput) {
+    fprintf(fp, "{\"count\": %llu, \"ops_per_sec\": %.2f, \"mean_us\": %.3f, "
+            "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+            "\"p999_us\": %.3f, \"max_us\": %.3f}",
+            static_cast<unsigned long long>(h.count()), throughput,
+            h.mean() / 1e3, h.percentile(50.0) / 1e3,
+            h.percentile(90.0) / 1e3, h.percentile(99.0) / 1e3,
+            h.percentile(99.9) / 1e3, h.max() / 1e3);
   }
 
  protected:
@@ -129,45 +569,55 @@ class LoadTest {
    * Constructor.
    * @param setting load-test setting
    */
-  explicit LoadTest(const Setting &setting) : setting_(setting) { }
+  explicit LoadTest(const Setting &setting) : setting_(setting) {
+    pthread_rwlock_init(&lock_, NULL);
+  }
   /**
    * Destructor.
    */
-  virtual ~LoadTest() { }
+  virtual ~LoadTest() {
+    pthread_rwlock_destroy(&lock_);
+  }
 
   /**
    * Execute load-test and show result.
    */
   void execute() {
-    printf(" Setting inputs ... ");
-    fflush(stdout);
+    FILE *log = setting_.json ? stderr : stdout;
+    fprintf(log, " Setting inputs ... ");
+    fflush(log);
     set_testset();
-    printf("done\n");
-
-    double start, search_time, add_time, delete_time;
-
-    printf(" Search loop    ... ");
-    fflush(stdout);
-    start = stupa::get_time();
-    search_loop();
-    search_time = stupa::get_time() - start;
-    printf("done\n");
+    fprintf(log, "done\n");
+    if (!setting_.json) setting_.show(log);
 
-    printf(" Add loop       ... ");
-    fflush(stdout);
-    start = stupa::get_time();
-    add_loop();
-    add_time = stupa::get_time() - start;
-    printf("done\n");
-
-    printf(" Delete loop    ... ");
-    fflush(stdout);
-    start = stupa::get_time();
-    delete_loop();
-    delete_time = stupa::get_time() - start;
-    printf("done\n\n");
+    if (setting_.warmup > 0) {
+      fprintf(log, " Warmup         ... ");
+      fflush(log);
+      trial(NULL);
+      fprintf(log, "done\n");
+    }
+    std::vector<TrialResult> results(setting_.trial);
+    for (size_t i = 0; i < setting_.trial; i++) {
+      fprintf(log, " Trial %-8d ... ", static_cast<int>(i+1));
+      fflush(log);
+      trial(&results[i]);
+      fprintf(log, "done\n");
+    }
+    double recall = -1.0;
+    size_t cutoff = 0;
+    if (setting_.recall > 0) {
+      fprintf(log, " Recall         ... ");
+      fflush(log);
+      recall = this->recall(setting_.recall, cutoff);
+      fprintf(log, "done\n");
+    }
+    fprintf(log, "\n");
 
-    show_result(search_time, add_time, delete_time);
+    if (setting_.json) {
+      write_json(stdout, results, recall, cutoff);
+    } else {
+      show_result(stdout, results, recall, cutoff);
+    }
   }
 };
 
@@ -177,14 +627,17 @@ class LoadTest {
 class LoadTestId : public LoadTest {
  private:
   /**
-   * Type definition of <document id, list of feature id> map
+   * Type definition of <document id, list of feature id> pairs
    */
-  typedef stupa::HashMap<stupa::DocumentId,
-                       std::vector<stupa::FeatureId> *>::type TestSetId;
+  typedef std::vector<std::pair<stupa::DocumentId,
+                                std::vector<stupa::FeatureId> > > TestSetId;
 
   TestSetId ts_;                          ///< test data
   stupa::SearchModelInnerProduct model_;  ///< search model
   stupa::InvertedIndex inv_;              ///< inverted index
+  size_t next_add_;                       ///< next document to be added
+  std::deque<size_t> added_;              ///< added documents of test data
+  std::vector<bool> in_index_;            ///< whether added or not
 
   /**
    * Set random features.
@@ -208,15 +661,17 @@ class LoadTestId : public LoadTest {
   /**
    * Set random queries.
    * @param queries output queries to be set random document ids
+   * @param seed seed of random numbers
    */
-  void random_queries(std::vector<stupa::DocumentId> &queries) const {
+  void random_queries(std::vector<stupa::DocumentId> &queries,
+                      unsigned int *seed) const {
     std::map<stupa::DocumentId, bool> check;
     check[stupa::DOC_EMPTY_ID] = true;
     check[stupa::DOC_DELETED_ID] = true;
     uint64_t cnt = 0;
     while (cnt < setting_.qnum) {
       stupa::DocumentId did =
-        static_cast<stupa::DocumentId>(rand()) % setting_.dnum
+        static_cast<stupa::DocumentId>(stupa::myrand(seed)) % setting_.dnum
         + stupa::DOC_START_ID;
       if (check.find(did) == check.end()) {
         queries.push_back(did);
@@ -234,7 +689,6 @@ class LoadTestId : public LoadTest {
   void lookup_inverted_index(const std::vector<stupa::DocumentId> &queries,
                              std::vector<stupa::DocumentId> &result) {
     stupa::HashMap<stupa::FeatureId, bool>::type fidmap;
-    stupa::init_hash_map(stupa::FEATURE_EMPTY_ID, fidmap);
     std::vector<stupa::FeatureId> feature_ids;
     for (size_t i = 0; i < queries.size(); i++) {
       model_.feature(queries[i], feature_ids);
@@ -279,52 +733,58 @@ class LoadTestId : public LoadTest {
       model_.add_document(did, features);
       inv_.add_document(did, features);
     }
-    while (did++ < setting_.dnum + stupa::DOC_START_ID + NUM_LOOP) {
-      std::vector<stupa::FeatureId> *features =
-        new std::vector<stupa::FeatureId>;
-      random_features(*features);
-      ts_[did] = features;
+    while (did++ < setting_.dnum + stupa::DOC_START_ID + setting_.loop) {
+      std::vector<stupa::FeatureId> features;
+      random_features(features);
+      ts_.push_back(std::make_pair(did, features));
     }
+    in_index_.resize(ts_.size(), false);
   }
 
   /**
-   * Do searching for some times.
+   * Search related documents once.
    */
-  void search_loop() {
+  void search(unsigned int *seed) {
     std::vector<stupa::DocumentId> queries;
     std::vector<stupa::DocumentId> candidates;
     std::vector<std::pair<stupa::DocumentId, stupa::Point> > results;
-    for (size_t i = 0; i < NUM_LOOP; i++) {
-      queries.clear();
-      candidates.clear();
-      results.clear();
-      random_queries(queries);
-      lookup_inverted_index(queries, candidates);
-      model_.search_by_document(queries, candidates, results, MAX_RESULT);
-    }
+    random_queries(queries, seed);
+    lookup_inverted_index(queries, candidates);
+    model_.search_by_document(queries, candidates, results, MAX_RESULT);
   }
 
   /**
-   * Do adding a document for some times.
+   * Add a document of the test set.
    */
-  void add_loop() {
-    for (TestSetId::const_iterator it = ts_.begin(); it != ts_.end(); ++it) {
-      model_.add_document(it->first, *it->second);
-      inv_.add_document(it->first, *it->second);
+  bool add() {
+    if (ts_.empty()) return false;
+    size_t index = next_add_++ % ts_.size();
+    if (in_index_[index]) {
+      std::vector<stupa::FeatureId> features;
+      model_.feature(ts_[index].first, features);
+      inv_.delete_document(ts_[index].first, features);
+    } else {
+      added_.push_back(index);
+      in_index_[index] = true;
     }
+    model_.add_document(ts_[index].first, ts_[index].second);
+    inv_.add_document(ts_[index].first, ts_[index].second);
+    return true;
   }
 
   /**
-   * Do deleting a document for some times.
+   * Delete the oldest document added by add().
    */
-  void delete_loop() {
+  bool remove() {
+    if (added_.empty()) return false;
+    size_t index = added_.front();
+    added_.pop_front();
+    in_index_[index] = false;
     std::vector<stupa::FeatureId> features;
-    for (TestSetId::const_iterator it = ts_.begin(); it != ts_.end(); ++it) {
-      model_.feature(it->first, features);
-      model_.delete_document(it->first);
-      inv_.delete_document(it->first, features);
-      features.clear();
-    }
+    model_.feature(ts_[index].first, features);
+    model_.delete_document(ts_[index].first);
+    inv_.delete_document(ts_[index].first, features);
+    return true;
   }
 
  public:
@@ -333,18 +793,12 @@ class LoadTestId : public LoadTest {
    * @param setting load-test setting
    */
   explicit LoadTestId(const Setting &setting)
-    : LoadTest(setting), inv_(setting.isiz) {
-    stupa::init_hash_map(stupa::DOC_EMPTY_ID, ts_);
-  }
+    : LoadTest(setting), inv_(setting.isiz), next_add_(0) { }
 
   /**
    * Destructor.
    */
-  ~LoadTestId() {
-    for (TestSetId::iterator it = ts_.begin(); it != ts_.end(); ++it) {
-      if (it->second) delete it->second;
-    }
-  }
+  ~LoadTestId() { }
 };
 
 /**
@@ -353,13 +807,17 @@ class LoadTestId : public LoadTest {
 class LoadTestText : public LoadTest {
  private:
   /**
-   * Type definition of <string identifier, list of feature strings> map
+   * Type definition of <string identifier, list of feature strings> pairs
    */
-  typedef stupa::HashMap<std::string, std::vector<std::string> *>::type TestSetText;
+  typedef std::vector<std::pair<std::string,
+                                std::vector<std::string> > > TestSetText;
 
   TestSetText ts_;                      ///< test data
   stupa::StupaSearch stpsearch_;        ///< search
   std::vector<std::string> documents_;  ///< identifier string of documents
+  size_t next_add_;                     ///< next document to be added
+  std::deque<size_t> added_;            ///< added documents of test data
+  std::vector<bool> in_index_;          ///< whether added or not
 
   /**
    * Set random features.
@@ -370,8 +828,9 @@ class LoadTestText : public LoadTest {
     std::map<uint64_t, bool> check;
     size_t cnt = 0;
     while (cnt < setting_.fnum) {
-      uint64_t n = rand() % setting_.dnum + stupa::FEATURE_START_ID;
-      // uint64_t n = zipf_rand(setting_.dnum, stupa::FEATURE_START_ID);
+      uint64_t n = setting_.zipf
+                   ? zipf_rand(setting_.dnum, stupa::FEATURE_START_ID)
+                   : rand() % setting_.dnum + stupa::FEATURE_START_ID;
       if (check.find(n) == check.end()) {
         ss << n;
         features.push_back(ss.str());
@@ -383,77 +842,169 @@ class LoadTestText : public LoadTest {
   }
 
   /**
-   * Set data for load test.
+   * Set random data for load test.
    */
-  void set_testset() {
+  void set_random_testset() {
     stupa::DocumentId did = 0;
     std::map<std::string, bool> check;
-    while (did < setting_.dnum + NUM_LOOP) {
+    while (did < setting_.dnum + setting_.loop) {
       std::string didstr;
       do {
-        /*
-        std::stringstream ss;
-        ss << did;
-        didstr = ss.str();
-        */
         stupa::random_string(STR_LENGTH, didstr);
       } while (check.find(didstr) != check.end());
       check[didstr] = true;
-      std::vector<std::string> *features = new std::vector<std::string>;
-      random_features(*features);
+      std::vector<std::string> features;
+      random_features(features);
       if (did < setting_.dnum) {
-        stpsearch_.add_document(didstr, *features);
+        stpsearch_.add_document(didstr, features);
         documents_.push_back(didstr);
-        delete features;
       } else {
-        ts_[didstr] = features;
+        ts_.push_back(std::make_pair(didstr, features));
       }
       did++;
     }
   }
 
   /**
-   * Do searching for some times.
+   * Read data for load test from a tsv file.
+   * Documents at the end of the file are held out for adding.
+   */
+  void read_testset() {
+    std::ifstream ifs(setting_.path);
+    if (!ifs) {
+      fprintf(stderr, "[ERROR]Cannot open file: %s\n", setting_.path);
+      exit(1);
+    }
+    TestSetText documents;
+    std::string line;
+    uint64_t nfeatures = 0;
+    while (std::getline(ifs, line)) {
+      size_t p = line.find(stupa::DELIMITER);
+      if (line.empty() || p == 0 || p == std::string::npos) continue;
+      std::vector<std::string> features;
+      stupa::split_string(line.substr(p + stupa::DELIMITER.size()),
+                          stupa::DELIMITER, features);
+      if (features.empty()) continue;
+      nfeatures += features.size();
+      documents.push_back(std::make_pair(line.substr(0, p), features));
+    }
+    size_t nheld = std::min(setting_.loop, documents.size() / 2);
+    for (size_t i = 0; i < documents.size(); i++) {
+      if (i < documents.size() - nheld) {
+        stpsearch_.add_document(documents[i].first, documents[i].second);
+        documents_.push_back(documents[i].first);
+      } else {
+        ts_.push_back(documents[i]);
+      }
+    }
+    setting_.dnum = documents.size();
+    setting_.fnum = documents.empty() ? 0 : nfeatures / documents.size();
+    if (documents_.size() < setting_.qnum) {
+      fprintf(stderr, "[ERROR]qnum must be less than the number of documents.\n");
+      exit(1);
+    }
+  }
+
+  /**
+   * Set data for load test.
+   */
+  void set_testset() {
+    if (setting_.path) {
+      read_testset();
+    } else {
+      set_random_testset();
+    }
+    in_index_.resize(ts_.size(), false);
+    if (setting_.maxdf > 0.0) stpsearch_.set_max_df(setting_.maxdf);
+    if (setting_.skip > 0.0) stpsearch_.set_skip_postings(setting_.skip);
+    if (setting_.bands > 0) {
+      stpsearch_.set_minhash(setting_.bands, setting_.rows);
+    }
+    if (setting_.sigbits > 0) {
+      stpsearch_.set_prefilter(setting_.sigbits, setting_.scored);
+    }
+  }
+
+  /**
+   * Set random queries.
+   * @param queries output queries to be set random document identifiers
+   * @param seed seed of random numbers
    */
-  void search_loop() {
+  void random_queries(std::vector<std::string> &queries,
+                      unsigned int *seed) const {
     std::map<size_t, bool> check;
+    size_t cnt = 0;
+    while (cnt < setting_.qnum) {
+      size_t index = static_cast<size_t>(stupa::myrand(seed))
+                     % documents_.size();
+      if (check.find(index) == check.end()) {
+        queries.push_back(documents_[index]);
+        check[index] = true;
+        cnt++;
+      }
+    }
+  }
+
+  /**
+   * Search related documents once.
+   */
+  void search(unsigned int *seed) {
     std::vector<std::string> queries;
     std::vector<std::pair<std::string, stupa::Point> > results;
-    for (size_t i = 0; i < NUM_LOOP; i++) {
-      results.clear();
-      queries.clear();
-      check.clear();
-      size_t cnt = 0;
-      while (cnt < setting_.qnum) {
-        size_t index = static_cast<size_t>(rand() % documents_.size());
-        if (check.find(index) == check.end()) {
-          queries.push_back(documents_[index]);
-          check[index] = true;
-          cnt++;
-        }
-      }
+    random_queries(queries, seed);
+    stpsearch_.search_by_document(queries, results, MAX_RESULT);
+  }
+
+  /**
+   * Measure recall of search against exhaustive search.
+   */
+  double recall(size_t num, size_t &cutoff) {
+    cutoff = stpsearch_.df_cutoff();
+    unsigned int seed = static_cast<unsigned int>(rand());
+    size_t found = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < num; i++) {
+      std::vector<std::string> queries;
+      std::vector<std::pair<std::string, stupa::Point> > results, expected;
+      random_queries(queries, &seed);
       stpsearch_.search_by_document(queries, results, MAX_RESULT);
+      stpsearch_.exhaustive_search_by_document(queries, expected, MAX_RESULT);
+      std::set<std::string> check;
+      for (size_t j = 0; j < expected.size(); j++) {
+        check.insert(expected[j].first);
+      }
+      for (size_t j = 0; j < results.size(); j++) {
+        if (check.find(results[j].first) != check.end()) found++;
+      }
+      total += expected.size();
     }
+    return total > 0 ? static_cast<double>(found) / total : 1.0;
   }
 
   /**
-   * Do adding a document for some times.
+   * Add a document of the test set.
    */
-  void add_loop() {
-    for (TestSetText::const_iterator it = ts_.begin();
-         it != ts_.end(); ++it) {
-      stpsearch_.add_document(it->first, *it->second);
+  bool add() {
+    if (ts_.empty()) return false;
+    size_t index = next_add_++ % ts_.size();
+    if (!in_index_[index]) {
+      added_.push_back(index);
+      in_index_[index] = true;
     }
+    stpsearch_.add_document(ts_[index].first, ts_[index].second);
+    return true;
   }
 
   /**
-   * Do deleting a document for some times.
+   * Delete the oldest document added by add().
    */
-  void delete_loop() {
-    for (TestSetText::const_iterator it = ts_.begin();
-         it != ts_.end(); ++it) {
-      stpsearch_.delete_document(it->first);
-    }
+  bool remove() {
+    if (added_.empty()) return false;
+    size_t index = added_.front();
+    added_.pop_front();
+    in_index_[index] = false;
+    stpsearch_.delete_document(ts_[index].first);
+    return true;
   }
 
  public:
@@ -463,42 +1014,75 @@ class LoadTestText : public LoadTest {
    */
   explicit LoadTestText(const Setting &setting)
     : LoadTest(setting),
-      stpsearch_(stupa::SearchModel::INNER_PRODUCT, setting.isiz) {
-    stupa::init_hash_map("", ts_);
-  }
+      stpsearch_(setting.model, setting.isiz),
+      next_add_(0) { }
 
   /**
    * Destructor.
    */
-  ~LoadTestText() {
-    for (TestSetText::iterator it = ts_.begin(); it != ts_.end(); ++it) {
-      if (it->second) delete it->second;
-    }
-  }
+  ~LoadTestText() { }
 };
 
 
 int main(int argc, char **argv) {
-  if (argc < 5) {
+  Setting setting;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-text")) {
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-json")) {
+      setting.json = true;
+    } else if (!strcmp(argv[i], "-zipf")) {
+      setting.zipf = true;
+    } else if (i + 1 >= argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    } else if (!strcmp(argv[i], "-file")) {
+      setting.path = argv[++i];
+    } else if (!strcmp(argv[i], "-loop")) {
+      setting.loop = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-warmup")) {
+      setting.warmup = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-trial")) {
+      setting.trial = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-thread")) {
+      setting.nthread = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "-mix")) {
+      setting.set_mix(argv[++i]);
+    } else if (!strcmp(argv[i], "-maxdf")) {
+      setting.maxdf = strtod(argv[++i], NULL);
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-skip")) {
+      setting.skip = strtod(argv[++i], NULL);
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-minhash")) {
+      setting.set_minhash(argv[++i]);
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-simhash")) {
+      setting.set_simhash(argv[++i]);
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-model")) {
+      setting.set_model(argv[++i]);
+      setting.text = true;
+    } else if (!strcmp(argv[i], "-recall")) {
+      setting.recall = strtoul(argv[++i], NULL, 10);
+      setting.text = true;
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (!setting.set(argc - i, argv + i)) {
     usage(argv[0]);
     return EXIT_FAILURE;
   }
   srand((unsigned int)time(NULL));
-  if (argc == 5) {
-    Setting setting;
-    setting.set(argv+1);
-    setting.show();
-    LoadTestId test(setting);
-    test.execute();
-  } else if (argc == 6 && !strcmp(argv[1], "-text")) {
-    Setting setting;
-    setting.set(argv+2);
-    setting.show();
+  if (setting.text || setting.path) {
     LoadTestText test(setting);
     test.execute();
   } else {
-    usage(argv[0]);
-    return EXIT_FAILURE;
+    LoadTestId test(setting);
+    test.execute();
   }
   return EXIT_SUCCESS;
 }
@@ -510,11 +1094,34 @@ int main(int argc, char **argv) {
 static void usage(const char *progname) {
   fprintf(stderr, "%s : Stupa load-test tool\n\n", progname);
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, " %% %s [-text] dnum fnum qnum isiz\n", progname);
+  fprintf(stderr, " %% %s [options] [-text] dnum fnum qnum isiz\n", progname);
+  fprintf(stderr, " %% %s [options] -file file qnum isiz\n", progname);
   fprintf(stderr, "     dnum : number of documents\n");
   fprintf(stderr, "     fnum : number of the features of each document\n");
   fprintf(stderr, "     qnum : number of search queries\n");
   fprintf(stderr, "     isiz : max size of posting list of inverted index\n");
+  fprintf(stderr, "     -text          use identifiers of strings\n");
+  fprintf(stderr, "     -file file     replay documents of a tsv file\n");
+  fprintf(stderr, "     -loop num      number of operations of a trial (default:%d)\n",
+          static_cast<int>(NUM_LOOP));
+  fprintf(stderr, "     -warmup num    number of warmup operations (default:0)\n");
+  fprintf(stderr, "     -trial num     number of trials (default:1)\n");
+  fprintf(stderr, "     -thread num    number of threads (default:1)\n");
+  fprintf(stderr, "     -mix s:a:d     mix operations by ratio of search:add:delete\n");
+  fprintf(stderr, "                    (default: search, add, delete in turn)\n");
+  fprintf(stderr, "     -zipf          features of -text follow zipf's law\n");
+  fprintf(stderr, "     -maxdf ratio   skip features in over ratio of documents in lookup\n");
+  fprintf(stderr, "     -skip ratio    skip frequent features of up to ratio of postings\n");
+  fprintf(stderr, "     -minhash b:r   find candidates by MinHash index of b bands of r rows\n");
+  fprintf(stderr, "     -simhash b:m   score m candidates of the nearest b-bit SimHash\n");
+  fprintf(stderr, "     -model name    search model: inner, cosine, float, quantized,\n");
+  fprintf(stderr, "                    quantized8, tfidf or bm25 (default: inner)\n");
+  fprintf(stderr, "                    (features of tfidf and bm25 may be feature:weight)\n");
+  fprintf(stderr, "     -recall num    measure recall@%d against exhaustive search\n",
+          static_cast<int>(MAX_RESULT));
+  fprintf(stderr, "                    (-maxdf, -skip, -minhash, -simhash, -model, -recall\n");
+  fprintf(stderr, "                     use -text)\n");
+  fprintf(stderr, "     -json          output results as JSON\n");
 }
 
 /**
@@ -528,3 +1135,30 @@ static uint64_t zipf_rand(uint64_t nkinds, uint64_t min) {
     pow(M_E, (static_cast<double>(rand()) / RAND_MAX * log(nkinds + 1.0)))
     - 1.0) + min;
 }
+
+/**
+ * Get resident set size of this process.
+ * @param rss_kb output current size (KB)
+ * @param peak_kb output peak size (KB)
+ */
+static void get_rss(size_t &rss_kb, size_t &peak_kb) {
+  rss_kb = peak_kb = 0;
+  std::ifstream ifs("/proc/self/status");
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (!line.compare(0, 6, "VmRSS:")) {
+      rss_kb = strtoul(line.c_str() + 6, NULL, 10);
+    } else if (!line.compare(0, 6, "VmHWM:")) {
+      peak_kb = strtoul(line.c_str() + 6, NULL, 10);
+    }
+  }
+  if (peak_kb == 0) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    peak_kb = usage.ru_maxrss;
+#ifdef __APPLE__
+    peak_kb /= 1024;
+#endif
+  }
+  if (rss_kb == 0) rss_kb = peak_kb;
+}
@@ -22,11 +22,21 @@
 
 #include "config.h"
 #include "identifier.h"
+#include "forward_index.h"
 #include "search_model.h"
 #include "inverted_index.h"
 #include "posting_list.h"
+#include "posting_cache.h"
+#include "bitmap.h"
+#include "elias_fano.h"
+#include "minhash.h"
 #include "search.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "querylog.h"
+#include "leftright.h"
 #include "util.h"
+#include "hash_map.h"
 
 #endif  // STUPA_STUPA_H_
 
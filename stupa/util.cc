@@ -18,13 +18,19 @@
 //
 
 #include <sys/time.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <cstdlib>
+#include <utility>
 #include "util.h"
 
 namespace {
 /** characters for random string generation. */
 const std::string CHARACTERS(
   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz123456789");
+/** scale of fixed-point weights of compress_weighted */
+const double WEIGHT_SCALE = 256.0;
 } /* namespace */
 
 namespace stupa {
@@ -92,7 +98,8 @@ static char *variable_byte_encode(const std::vector<uint64_t> &v,
  * @param v output array of integers
  * @return the number of decoded array of integers
  */
-static size_t variable_byte_decode(const char *ptr, std::vector<uint64_t> &v) {
+static size_t variable_byte_decode(const char *ptr,
+                                  std::vector<Identifier> &v) {
   size_t byte_size = 0;
   uint64_t siz = 0;
   uint64_t c = *(unsigned char *)ptr++;
@@ -115,16 +122,47 @@ static size_t variable_byte_decode(const char *ptr, std::vector<uint64_t> &v) {
       byte_size++;
     }
     n = 128 * n + (c - 128);
-    v.push_back(n);
+    v.push_back(static_cast<Identifier>(n));
     cnt++;
   }
   return byte_size;
 }
 
+/**
+ * Append an integer encoded by Variable Byte code.
+ * @param num input integer to be encoded
+ * @param buf output encoded data
+ */
+static void variable_byte_append(uint64_t num, std::vector<char> &buf) {
+  unsigned char bytes[10];
+  int size = 0;
+  do {
+    bytes[size++] = num % 128;
+    num /= 128;
+  } while (num);
+  bytes[0] += 128;
+  while (size > 0) buf.push_back(static_cast<char>(bytes[--size]));
+}
+
+/**
+ * Read an integer encoded by Variable Byte code.
+ * @param ptr encoded data (moved to the next integer)
+ * @return decoded integer
+ */
+static uint64_t variable_byte_read(const char *&ptr) {
+  uint64_t n = 0;
+  uint64_t c = *(unsigned char *)ptr++;
+  while (c < 128) {
+    n = 128 * n + c;
+    c = *(unsigned char *)ptr++;
+  }
+  return 128 * n + (c - 128);
+}
+
 /**
  * Delta compression.
  */
-char *compress_diff(const std::vector<uint64_t> &v) {
+char *compress_diff(const std::vector<Identifier> &v) {
   if (v.empty()) return NULL;
   std::vector<uint64_t> differences(v.size()+1);
   differences[0] = v.size();
@@ -157,8 +195,8 @@ char *compress_diff(const std::vector<uint64_t> &v) {
 /**
  * Delta compression.
  */
-char *compress_diff(const std::vector<uint64_t>::iterator &begin,
-                    const std::vector<uint64_t>::iterator &end) {
+char *compress_diff(const std::vector<Identifier>::iterator &begin,
+                    const std::vector<Identifier>::iterator &end) {
   if (begin == end) return NULL;
   std::vector<uint64_t> differences;
   std::vector<int> sizes;
@@ -168,7 +206,7 @@ char *compress_diff(const std::vector<uint64_t>::iterator &begin,
 
   uint64_t prev = 0;
   size_t idx = 0;
-  for (std::vector<uint64_t>::const_iterator it = begin; it != end; ++it) {
+  for (std::vector<Identifier>::const_iterator it = begin; it != end; ++it) {
     uint64_t diff = *it - prev;
     prev = *it;
     differences.push_back(diff);
@@ -194,7 +232,7 @@ char *compress_diff(const std::vector<uint64_t>::iterator &begin,
 /**
  * Delta decompression.
  */
-void decompress_diff(const char *ptr, std::vector<uint64_t> &v) {
+void decompress_diff(const char *ptr, std::vector<Identifier> &v) {
   variable_byte_decode(ptr, v);
   for (size_t i = 1; i < v.size(); i++) {
     v[i] += v[i-1];
@@ -205,10 +243,242 @@ void decompress_diff(const char *ptr, std::vector<uint64_t> &v) {
  * Get size of compressed data.
  */
 size_t sizeof_compressed(const char *ptr) {
-  std::vector<uint64_t> v;
+  std::vector<Identifier> v;
   return variable_byte_decode(ptr, v);
 }
 
+namespace {
+/**
+ * Header of compressed data with a skip table.
+ */
+struct SkipHeader {
+  uint64_t size;         ///< the number of integers
+  uint64_t entries;      ///< the number of skip entries
+  uint64_t bytes;        ///< bytes of the differences
+  const char *table;     ///< skip entries
+  const char *data;      ///< differences
+  size_t header_bytes;   ///< bytes before the differences
+
+  /**
+   * Constructor.
+   * @param ptr compressed data
+   */
+  explicit SkipHeader(const char *ptr) {
+    const char *p = ptr;
+    size = variable_byte_read(p);
+    entries = variable_byte_read(p);
+    bytes = variable_byte_read(p);
+    table = p;
+    data = p + entries * 2 * sizeof(uint64_t);
+    header_bytes = data - ptr;
+  }
+
+  /**
+   * Read a skip entry.
+   * @param i index of the entry
+   * @param value output the integer before the entry
+   * @param offset output byte offset of the entry in the differences
+   */
+  void entry(size_t i, uint64_t &value, uint64_t &offset) const {
+    const char *p = table + i * 2 * sizeof(uint64_t);
+    std::memcpy(&value, p, sizeof(value));
+    std::memcpy(&offset, p + sizeof(value), sizeof(offset));
+  }
+};
+} /* namespace */
+
+/**
+ * Delta compression with a skip table.
+ */
+char *compress_skip(const std::vector<Identifier> &v) {
+  if (v.empty()) return NULL;
+  std::vector<char> data;
+  std::vector<uint64_t> table;
+  uint64_t prev = 0;
+  for (size_t i = 0; i < v.size(); i++) {
+    if (i > 0 && i % SKIP_INTERVAL == 0) {
+      table.push_back(prev);
+      table.push_back(data.size());
+    }
+    variable_byte_append(static_cast<uint64_t>(v[i]) - prev, data);
+    prev = v[i];
+  }
+  std::vector<char> buf;
+  variable_byte_append(v.size(), buf);
+  variable_byte_append(table.size() / 2, buf);
+  variable_byte_append(data.size(), buf);
+  size_t table_bytes = table.size() * sizeof(uint64_t);
+  char *ptr = new char[buf.size() + table_bytes + data.size()];
+  std::copy(buf.begin(), buf.end(), ptr);
+  if (!table.empty()) std::memcpy(ptr + buf.size(), &table[0], table_bytes);
+  std::copy(data.begin(), data.end(), ptr + buf.size() + table_bytes);
+  return ptr;
+}
+
+/**
+ * Delta decompression with a skip table.
+ */
+void decompress_skip(const char *ptr, std::vector<Identifier> &v) {
+  if (!ptr) return;
+  SkipHeader header(ptr);
+  const char *p = header.data;
+  v.reserve(v.size() + static_cast<size_t>(header.size));
+  uint64_t prev = 0;
+  for (uint64_t i = 0; i < header.size; i++) {
+    prev += variable_byte_read(p);
+    v.push_back(static_cast<Identifier>(prev));
+  }
+}
+
+/**
+ * Get size of compressed data with a skip table.
+ */
+size_t sizeof_skip(const char *ptr) {
+  if (!ptr) return 0;
+  SkipHeader header(ptr);
+  return header.header_bytes + static_cast<size_t>(header.bytes);
+}
+
+/**
+ * Get the first integer of compressed data with a skip table.
+ */
+Identifier first_skip(const char *ptr) {
+  const char *p = SkipHeader(ptr).data;
+  return static_cast<Identifier>(variable_byte_read(p));
+}
+
+/**
+ * Check whether compressed data with a skip table has an integer.
+ */
+bool find_skip(const char *ptr, Identifier id) {
+  if (!ptr) return false;
+  SkipHeader header(ptr);
+  // the last entry after an integer less than id
+  size_t low = 0;
+  size_t high = static_cast<size_t>(header.entries);
+  uint64_t value, offset;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    header.entry(mid, value, offset);
+    if (value < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  uint64_t prev = 0;
+  const char *p = header.data;
+  uint64_t remain = header.size;
+  if (low > 0) {
+    header.entry(low - 1, prev, offset);
+    p += offset;
+    remain -= low * SKIP_INTERVAL;
+  }
+  for (uint64_t i = 0; i < remain && i < SKIP_INTERVAL; i++) {
+    prev += variable_byte_read(p);
+    if (prev >= id) return prev == id;
+  }
+  return false;
+}
+
+/**
+ * Delta compression with weights.
+ */
+char *compress_weighted(const std::vector<Identifier> &v,
+                        const std::vector<double> &weights) {
+  if (v.empty()) return NULL;
+  std::vector<char> buf;
+  variable_byte_append(v.size(), buf);
+  uint64_t one = static_cast<uint64_t>(WEIGHT_SCALE);
+  uint64_t prev = 0;
+  for (size_t i = 0; i < v.size(); i++) {
+    uint64_t diff = v[i] - prev;
+    prev = v[i];
+    uint64_t scaled = one;
+    if (!weights.empty()) {
+      scaled = weights[i] > 0.0
+        ? static_cast<uint64_t>(weights[i] * WEIGHT_SCALE + 0.5) : 0;
+      if (scaled == 0) scaled = 1;
+    }
+    // the lowest bit of a difference tells whether a weight follows
+    if (scaled == one) {
+      variable_byte_append(diff << 1, buf);
+    } else {
+      variable_byte_append((diff << 1) | 1, buf);
+      variable_byte_append(scaled, buf);
+    }
+  }
+  char *data = new char[buf.size()];
+  std::copy(buf.begin(), buf.end(), data);
+  return data;
+}
+
+/**
+ * Delta decompression with weights.
+ */
+void decompress_weighted(const char *ptr, std::vector<Identifier> &v,
+                         std::vector<double> *weights) {
+  if (!ptr) return;
+  uint64_t siz = variable_byte_read(ptr);
+  uint64_t prev = 0;
+  for (uint64_t i = 0; i < siz; i++) {
+    uint64_t n = variable_byte_read(ptr);
+    prev += n >> 1;
+    v.push_back(static_cast<Identifier>(prev));
+    double weight = 1.0;
+    if (n & 1) weight = variable_byte_read(ptr) / WEIGHT_SCALE;
+    if (weights) weights->push_back(weight);
+  }
+}
+
+/**
+ * Get size of compressed data with weights.
+ */
+size_t sizeof_weighted(const char *ptr) {
+  if (!ptr) return 0;
+  const char *begin = ptr;
+  uint64_t siz = variable_byte_read(ptr);
+  for (uint64_t i = 0; i < siz; i++) {
+    if (variable_byte_read(ptr) & 1) variable_byte_read(ptr);
+  }
+  return ptr - begin;
+}
+
+/**
+ * Sort integers and merge duplicated integers into their weights.
+ */
+void merge_weighted(std::vector<Identifier> &v, std::vector<double> &weights) {
+  std::vector<std::pair<Identifier, double> > pairs(v.size());
+  for (size_t i = 0; i < v.size(); i++) {
+    pairs[i].first = v[i];
+    pairs[i].second = weights.empty() ? 1.0 : weights[i];
+  }
+  std::sort(pairs.begin(), pairs.end());
+  v.clear();
+  weights.clear();
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (!v.empty() && v.back() == pairs[i].first) {
+      weights.back() += pairs[i].second;
+    } else {
+      v.push_back(pairs[i].first);
+      weights.push_back(pairs[i].second);
+    }
+  }
+}
+
+/**
+ * Get the number of integers of compressed data without decompression.
+ */
+uint64_t count_compressed(const char *ptr) {
+  uint64_t siz = 0;
+  uint64_t c = *(unsigned char *)ptr++;
+  while (c < 128) {
+    siz = 128 * siz + c;
+    c = *(unsigned char *)ptr++;
+  }
+  return 128 * siz + (c - 128);
+}
+
 /**
  * Get current time.
  */
@@ -218,6 +488,21 @@ double get_time() {
   return tv.tv_sec + static_cast<double>(tv.tv_usec) * 1e-6;
 }
 
+/**
+ * Get current time of a monotonic clock in nanoseconds.
+ */
+uint64_t get_time_nsec() {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000000ULL + tv.tv_usec * 1000;
+#endif
+}
+
 /**
  * Get random ASCII string
  */
@@ -259,5 +544,27 @@ void split_string(const std::string &s, const std::string &delimiter,
   }
 }
 
+/**
+ * Split weights from strings of "feature:weight".
+ */
+void split_weighted(const std::vector<std::string> &strings,
+                    std::vector<std::string> &features,
+                    std::vector<double> &weights) {
+  for (size_t i = 0; i < strings.size(); i++) {
+    size_t p = strings[i].rfind(WEIGHT_DELIMITER);
+    if (p != std::string::npos && p > 0 && p + 1 < strings[i].size()) {
+      const char *str = strings[i].c_str() + p + 1;
+      char *end;
+      double weight = strtod(str, &end);
+      if (*end == '\0' && weight > 0.0 && weight < HUGE_VAL) {
+        features.push_back(strings[i].substr(0, p));
+        weights.push_back(weight);
+        continue;
+      }
+    }
+    features.push_back(strings[i]);
+    weights.push_back(1.0);
+  }
+}
 
 } /* namespace stupa */
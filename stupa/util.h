@@ -26,14 +26,12 @@
 #include <vector>
 
 #include "config.h"
+#include "hash_map.h"
+#include "identifier.h"
 
-/* include hash_map header */
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-#include <google/dense_hash_map>
-#elif HAVE_EXT_HASH_MAP
-#include <ext/hash_map>
-#else
-#include <map>
+/* include SIMD intrinsics */
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
 #endif
 
 /* isnan */
@@ -46,61 +44,23 @@
 #endif
 #endif
 
-/* hash function of string key for __gnu_cxx::hash_map */
-#if (defined(_WIN32) || !defined(HAVE_GOOGLE_DENSE_HASH_MAP)) && defined(HAVE_EXT_HASH_MAP)
-namespace __gnu_cxx {
-  template<> struct hash<std::string> {
-    size_t operator() (const std::string &x) const {
-      return hash<const char *>()(x.c_str());
-    }
-  };
-
-  template<> struct hash<long long> { 
-    size_t operator()(long long __x) const {
-      return __x;
-    }
-  };
-  template<> struct hash<unsigned long long> { 
-    size_t operator()(unsigned long  long __x) const {
-      return __x;
-    }
-  };
-}
-#endif
-
 
 namespace stupa {
 
 /**
- * Type definistion of hash map, 
- * 'google::dense_hash_map' or '__gnu__cxx::hash_map' or 'std::map'.
+ * Type definistion of hash map (FlatHashMap).
  */
 template<typename KeyType, typename ValueType>
 struct HashMap {
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-  typedef google::dense_hash_map<KeyType, ValueType> type;
-#elif HAVE_EXT_HASH_MAP
-  typedef __gnu_cxx::hash_map<KeyType, ValueType> type;
-#else
-  typedef std::map<KeyType, ValueType> type;
-#endif
+  typedef FlatHashMap<KeyType, ValueType> type;
 };
 
+/** Type definition of <old document id, new document id> map */
+typedef HashMap<DocumentId, DocumentId>::type DocumentIdMap;
+
 const unsigned int DEFAULT_SEED = 12345;  ///< default seed value
 const std::string DELIMITER("\t");        ///< delimiter string
-
-/**
- * Initialize hash_map object (for google::dense_hash_map).
- * @param empty_key key of empty entry
- * @param hmap hash_map object
- */
-template<typename KeyType, typename HashType>
-void init_hash_map(const KeyType &empty_key, HashType &hmap) {
-#ifdef HAVE_GOOGLE_DENSE_HASH_MAP
-  hmap.max_load_factor(0.9);
-  hmap.set_empty_key(empty_key);
-#endif
-}
+const char WEIGHT_DELIMITER = ':';        ///< delimiter of feature and weight
 
 /**
  * Compare pair items.
@@ -153,12 +113,68 @@ void mysrand(unsigned int seed);
  */
 int myrand(unsigned int *seed);
 
+/**
+ * Count bits set to 1.
+ * It is an instruction (POPCNT) on CPUs which have it, when CFLAGS
+ * specifies the CPU (e.g. -march=native or -mpopcnt).
+ * @param x input integer
+ * @return the number of bits set to 1
+ */
+inline int popcount64(uint64_t x) {
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * Count trailing bits set to 0.
+ * @param x input integer (not 0)
+ * @return the index of the lowest bit set to 1
+ */
+inline int ctz64(uint64_t x) {
+#ifdef __GNUC__
+  return __builtin_ctzll(x);
+#else
+  return popcount64((x & (~x + 1)) - 1);
+#endif
+}
+
+/**
+ * Dot product of float arrays.
+ * It is computed with AVX2 FMA instructions when CFLAGS specifies the
+ * CPU (e.g. -march=native or -mavx2 -mfma).
+ * @param a input array
+ * @param b input array
+ * @param n the number of elements
+ * @return dot product value
+ */
+inline float dot_product(const float *a, const float *b, size_t n) {
+  float sum = 0.0f;
+  size_t i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  for (size_t j = 0; j < 8; j++) sum += lanes[j];
+#endif
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
 /**
  * Delta compression.
  * @param v input array of integer
  * @return compressed data
  */
-char *compress_diff(const std::vector<uint64_t> &v);
+char *compress_diff(const std::vector<Identifier> &v);
 
 /**
  * Delta compression.
@@ -166,15 +182,15 @@ char *compress_diff(const std::vector<uint64_t> &v);
  * @param end end iterator of input array of integer
  * @return compressed data
  */
-char *compress_diff(const std::vector<uint64_t>::iterator &begin,
-                    const std::vector<uint64_t>::iterator &end);
+char *compress_diff(const std::vector<Identifier>::iterator &begin,
+                    const std::vector<Identifier>::iterator &end);
 
 /**
  * Delta decompression.
  * @param ptr compressed data
  * @param v output array of integer
  */
-void decompress_diff(const char *ptr, std::vector<uint64_t> &v);
+void decompress_diff(const char *ptr, std::vector<Identifier> &v);
 
 /**
  * Get size of compressed data.
@@ -183,12 +199,104 @@ void decompress_diff(const char *ptr, std::vector<uint64_t> &v);
  */
 size_t sizeof_compressed(const char *ptr);
 
+/** Interval of integers between skip entries of compress_skip */
+const size_t SKIP_INTERVAL = 128;
+
+/**
+ * Delta compression with a skip table.
+ * The differences of sorted integers are Variable Byte code as
+ * compress_diff, and every SKIP_INTERVAL integers are indexed by
+ * <the previous integer, byte offset> in a table, so that integers can be
+ * found without decoding from the beginning.
+ * @param v input array of sorted integers
+ * @return compressed data (NULL: empty input), must be deleted later
+ */
+char *compress_skip(const std::vector<Identifier> &v);
+
+/**
+ * Delta decompression with a skip table.
+ * @param ptr compressed data
+ * @param v output array of integers
+ */
+void decompress_skip(const char *ptr, std::vector<Identifier> &v);
+
+/**
+ * Get size of compressed data with a skip table.
+ * The number of integers is read by count_compressed.
+ * @param ptr compressed data
+ * @return size of compressed data
+ */
+size_t sizeof_skip(const char *ptr);
+
+/**
+ * Get the first integer of compressed data with a skip table.
+ * @param ptr compressed data
+ * @return the first integer
+ */
+Identifier first_skip(const char *ptr);
+
+/**
+ * Check whether compressed data with a skip table has an integer.
+ * At most SKIP_INTERVAL integers are decoded.
+ * @param ptr compressed data
+ * @param id integer
+ * @return true if found
+ */
+bool find_skip(const char *ptr, Identifier id);
+
+/**
+ * Delta compression with weights.
+ * Each weight follows the difference of its integer only if it is not 1,
+ * and it is stored in fixed point of 1/256.
+ * @param v input array of sorted integers
+ * @param weights weights of each integer (empty: all 1)
+ * @return compressed data
+ */
+char *compress_weighted(const std::vector<Identifier> &v,
+                        const std::vector<double> &weights);
+
+/**
+ * Delta decompression with weights.
+ * @param ptr compressed data
+ * @param v output array of integers
+ * @param weights output weights of each integer (optional)
+ */
+void decompress_weighted(const char *ptr, std::vector<Identifier> &v,
+                         std::vector<double> *weights = NULL);
+
+/**
+ * Get size of compressed data with weights.
+ * @param ptr compressed data
+ * @return size of compressed data
+ */
+size_t sizeof_weighted(const char *ptr);
+
+/**
+ * Sort integers and merge duplicated integers into their weights.
+ * @param v input and output array of integers
+ * @param weights input and output weights of each integer (empty: all 1)
+ */
+void merge_weighted(std::vector<Identifier> &v, std::vector<double> &weights);
+
+/**
+ * Get the number of integers of compressed data without decompression.
+ * @param ptr compressed data
+ * @return the number of integers
+ */
+uint64_t count_compressed(const char *ptr);
+
 /**
  * Get current time.
  * @return current time
  */
 double get_time();
 
+/**
+ * Get current time of a monotonic clock in nanoseconds.
+ * @return current time
+ */
+uint64_t get_time_nsec();
+
 /**
  * Get random ASCII string.
  * @param max max size of output string
@@ -212,6 +320,17 @@ std::string get_extension(const std::string filename);
 void split_string(const std::string &s, const std::string &delimiter,
                   std::vector<std::string> &splited);
 
+/**
+ * Split weights from strings of "feature:weight".
+ * A string without a positive number after the last ':' has weight 1.
+ * @param strings input strings
+ * @param features output features
+ * @param weights output weights of each feature
+ */
+void split_weighted(const std::vector<std::string> &strings,
+                    std::vector<std::string> &features,
+                    std::vector<double> &weights);
+
 
 /**
  * Random number generator class.
@@ -35,7 +35,7 @@ const uint64_t MAX_INTEGER = 100000;  ///< maximum integer
 /* function prototypes */
 static void random_pairs(size_t size,
                          std::vector<std::pair<int, double> > &pairs);
-static void random_integers(size_t size, std::vector<uint64_t> &v);
+static void random_integers(size_t size, std::vector<stupa::Identifier> &v);
 
 /* set random pairs */
 static void random_pairs(size_t size,
@@ -50,7 +50,7 @@ static void random_pairs(size_t size,
 }
 
 /* set random integers */
-static void random_integers(size_t size, std::vector<uint64_t> &v) {
+static void random_integers(size_t size, std::vector<stupa::Identifier> &v) {
   std::map<uint64_t, bool> check;
   size_t cnt = 0;
   while (cnt < size) {
@@ -107,10 +107,10 @@ TEST(UtilTest, ComparePairItemsAbsSameKeyTest) {
 
 /* compress_diff */
 TEST(UtilTest, CompressDiffTest) {
-  std::vector<uint64_t> input;
+  std::vector<stupa::Identifier> input;
   random_integers(NUM_INTEGERS, input);
   char *enc = stupa::compress_diff(input);
-  std::vector<uint64_t> output;
+  std::vector<stupa::Identifier> output;
   stupa::decompress_diff(enc, output);
   EXPECT_TRUE(input == output);
   delete [] enc;
@@ -118,14 +118,14 @@ TEST(UtilTest, CompressDiffTest) {
 
 /* compress_diff */
 TEST(UtilTest, CompressDiffPowerNumTest) {
-  std::vector<uint64_t> input;
-  uint64_t prev = 0;
+  std::vector<stupa::Identifier> input;
+  stupa::Identifier prev = 0;
   for (int i = 0; i < 5; i++) {
-    input.push_back(prev + static_cast<uint64_t>(::pow(128, i)));
+    input.push_back(prev + static_cast<stupa::Identifier>(::pow(128, i)));
     prev = input[i];
   }
   char *enc = stupa::compress_diff(input);
-  std::vector<uint64_t> output;
+  std::vector<stupa::Identifier> output;
   stupa::decompress_diff(enc, output);
   EXPECT_TRUE(input == output);
   delete [] enc;
@@ -133,15 +133,109 @@ TEST(UtilTest, CompressDiffPowerNumTest) {
 
 /* compress_diff with iterator inputs */
 TEST(UtilTest, CompressDiffIterator) {
-  std::vector<uint64_t> input;
+  std::vector<stupa::Identifier> input;
   random_integers(NUM_INTEGERS, input);
   char *enc = stupa::compress_diff(input.begin(), input.end());
-  std::vector<uint64_t> output;
+  std::vector<stupa::Identifier> output;
   stupa::decompress_diff(enc, output);
   EXPECT_TRUE(input == output);
   delete [] enc;
 }
 
+/* compress_skip */
+TEST(UtilTest, CompressSkipTest) {
+  std::vector<stupa::Identifier> input;
+  random_integers(stupa::SKIP_INTERVAL * 3 + 1, input);
+  char *enc = stupa::compress_skip(input);
+  std::vector<stupa::Identifier> output;
+  stupa::decompress_skip(enc, output);
+  EXPECT_TRUE(input == output);
+  EXPECT_EQ(input.size(), stupa::count_compressed(enc));
+  EXPECT_EQ(input[0], stupa::first_skip(enc));
+
+  // the skip table takes 16 bytes per SKIP_INTERVAL integers
+  char *diff = stupa::compress_diff(input);
+  EXPECT_LT(stupa::sizeof_compressed(diff) + 3 * 16, stupa::sizeof_skip(enc));
+  EXPECT_GT(stupa::sizeof_compressed(diff) + 3 * 16 + 8,
+            stupa::sizeof_skip(enc));
+  delete [] diff;
+
+  // integers in every block and between them
+  for (size_t i = 0; i < input.size(); i++) {
+    EXPECT_TRUE(stupa::find_skip(enc, input[i]));
+    if (i == 0 || input[i - 1] + 1 < input[i]) {
+      EXPECT_FALSE(stupa::find_skip(enc, input[i] - 1));
+    }
+  }
+  EXPECT_FALSE(stupa::find_skip(enc, input.back() + 1));
+  EXPECT_FALSE(stupa::find_skip(NULL, input[0]));
+  delete [] enc;
+}
+
+/* compress_weighted */
+TEST(UtilTest, CompressWeightedTest) {
+  std::vector<stupa::Identifier> input;
+  random_integers(NUM_INTEGERS, input);
+  std::vector<double> weights;
+  for (size_t i = 0; i < input.size(); i++) {
+    weights.push_back(i % 2 == 0 ? 1.0 : i * 0.5);
+  }
+  char *enc = stupa::compress_weighted(input, weights);
+  std::vector<stupa::Identifier> output;
+  std::vector<double> output_weights;
+  stupa::decompress_weighted(enc, output, &output_weights);
+  EXPECT_TRUE(input == output);
+  EXPECT_TRUE(weights == output_weights);
+
+  // weights of 1 take no space
+  char *ones = stupa::compress_weighted(input, std::vector<double>());
+  EXPECT_GT(stupa::sizeof_weighted(enc), stupa::sizeof_weighted(ones));
+  output.clear();
+  stupa::decompress_weighted(ones, output);
+  EXPECT_TRUE(input == output);
+  delete [] enc;
+  delete [] ones;
+}
+
+/* merge_weighted */
+TEST(UtilTest, MergeWeightedTest) {
+  std::vector<stupa::Identifier> input;
+  input.push_back(3);
+  input.push_back(2);
+  input.push_back(3);
+  std::vector<double> weights;
+  stupa::merge_weighted(input, weights);
+  ASSERT_EQ(2, input.size());
+  EXPECT_EQ(2, input[0]);
+  EXPECT_EQ(3, input[1]);
+  EXPECT_DOUBLE_EQ(1.0, weights[0]);
+  EXPECT_DOUBLE_EQ(2.0, weights[1]);
+}
+
+/* split_weighted */
+TEST(UtilTest, SplitWeightedTest) {
+  std::vector<std::string> input;
+  input.push_back("a:2");
+  input.push_back("b");
+  input.push_back("c:d");
+  input.push_back("e:0.5:1.5");
+  input.push_back("f:-1");
+  std::vector<std::string> features;
+  std::vector<double> weights;
+  stupa::split_weighted(input, features, weights);
+  ASSERT_EQ(5, features.size());
+  EXPECT_EQ("a", features[0]);
+  EXPECT_DOUBLE_EQ(2.0, weights[0]);
+  EXPECT_EQ("b", features[1]);
+  EXPECT_DOUBLE_EQ(1.0, weights[1]);
+  EXPECT_EQ("c:d", features[2]);
+  EXPECT_DOUBLE_EQ(1.0, weights[2]);
+  EXPECT_EQ("e:0.5", features[3]);
+  EXPECT_DOUBLE_EQ(1.5, weights[3]);
+  EXPECT_EQ("f:-1", features[4]);
+  EXPECT_DOUBLE_EQ(1.0, weights[4]);
+}
+
 /* get_extention */
 TEST(UtilTest, GetExtensionTest) {
   std::string filename;